@@ -0,0 +1,138 @@
+//
+//  CondensationBenchmark.cpp
+//  Camellia
+//
+//  Compares the two static condensation paths in CondensedDofInterpreter on the local stiffness matrices of a Poisson mesh:
+//  the cell-by-cell interpretLocalData(), which condenses the interpreted data with an LU factorization of the field block,
+//  and the batched interpretLocalBatchData(), which condenses in the local dof ordering with a Cholesky factorization.
+//  Reports, for a few polynomial orders, the condensation time of each (means over MPI ranks, several repetitions) and the
+//  largest difference between their condensed matrices.
+//
+
+#include <iomanip>
+
+#include "Teuchos_GlobalMPISession.hpp"
+
+#include "Epetra_SerialComm.h"
+#include "Epetra_Time.h"
+
+#ifdef HAVE_MPI
+#include "Epetra_MpiComm.h"
+#endif
+
+#include "BasisCache.h"
+#include "CondensedDofInterpreter.h"
+#include "MeshFactory.h"
+#include "MPIWrapper.h"
+#include "PoissonFormulation.h"
+#include "RHS.h"
+
+using namespace std;
+
+void reportCondensation(PoissonFormulation &form, int H1Order, int numRepetitions) {
+  int rank = Teuchos::GlobalMPISession::getRank();
+  int numProcs = Teuchos::GlobalMPISession::getNProc();
+
+#ifdef HAVE_MPI
+  Epetra_MpiComm Comm(MPI_COMM_WORLD);
+#else
+  Epetra_SerialComm Comm;
+#endif
+
+  int pToAddTest = 2;
+  int horizontalElements = 16, verticalElements = 16;
+  MeshPtr mesh = MeshFactory::quadMesh(form.bf(), H1Order, pToAddTest, 1.0, 1.0, horizontalElements, verticalElements);
+
+  IPPtr ip = form.bf()->graphNorm();
+  RHSPtr rhs = RHS::rhs();
+  rhs->addTerm(1.0 * form.q());
+  LagrangeConstraints lagrangeConstraints;
+  set<int> fieldIDsToExclude;
+  bool storeLocalStiffnessMatrices = false;
+  CondensedDofInterpreter dofInterpreter(mesh.get(), ip, rhs, &lagrangeConstraints, fieldIDsToExclude, storeLocalStiffnessMatrices);
+
+  // the mesh is uniform, so all the rank-local cells share an element type
+  set<GlobalIndexType> myCellIDs = mesh->cellIDsInPartition();
+  vector<GlobalIndexType> cellIDs(myCellIDs.begin(), myCellIDs.end());
+  int numCells = cellIDs.size();
+  int numTrialDofs = (numCells > 0) ? mesh->getElementType(cellIDs[0])->trialOrderPtr->totalDofs() : 0;
+
+  FieldContainer<double> localStiffness(max(numCells,1),max(numTrialDofs,1),max(numTrialDofs,1));
+  FieldContainer<double> localLoad(max(numCells,1),max(numTrialDofs,1));
+  for (int cellOrdinal=0; cellOrdinal<numCells; cellOrdinal++) {
+    BasisCachePtr basisCache = BasisCache::basisCacheForCell(mesh, cellIDs[cellOrdinal]);
+    BasisCachePtr ipBasisCache = BasisCache::basisCacheForCell(mesh, cellIDs[cellOrdinal], true);
+    FieldContainer<double> cellStiffness(1,numTrialDofs,numTrialDofs), cellLoad(1,numTrialDofs);
+    form.bf()->localStiffnessMatrixAndRHS(cellStiffness, cellLoad, ip, ipBasisCache, rhs, basisCache);
+    for (int i=0; i<numTrialDofs; i++) {
+      localLoad(cellOrdinal,i) = cellLoad(0,i);
+      for (int j=0; j<numTrialDofs; j++) {
+        localStiffness(cellOrdinal,i,j) = cellStiffness(0,i,j);
+      }
+    }
+  }
+
+  vector< FieldContainer<double> > cellwiseStiffness(numCells), cellwiseLoad(numCells);
+  vector< FieldContainer<GlobalIndexType> > cellwiseDofIndices(numCells);
+  Epetra_Time cellwiseTimer(Comm);
+  for (int repetition=0; repetition<numRepetitions; repetition++) {
+    for (int cellOrdinal=0; cellOrdinal<numCells; cellOrdinal++) {
+      FieldContainer<double> cellStiffness(numTrialDofs,numTrialDofs), cellLoad(numTrialDofs);
+      for (int i=0; i<numTrialDofs; i++) {
+        cellLoad(i) = localLoad(cellOrdinal,i);
+        for (int j=0; j<numTrialDofs; j++) {
+          cellStiffness(i,j) = localStiffness(cellOrdinal,i,j);
+        }
+      }
+      dofInterpreter.interpretLocalData(cellIDs[cellOrdinal], cellStiffness, cellLoad, cellwiseStiffness[cellOrdinal],
+                                        cellwiseLoad[cellOrdinal], cellwiseDofIndices[cellOrdinal]);
+    }
+  }
+  double cellwiseTime = MPIWrapper::sum(cellwiseTimer.ElapsedTime() / numRepetitions) / numProcs;
+
+  vector< FieldContainer<double> > batchStiffness, batchLoad;
+  vector< FieldContainer<GlobalIndexType> > batchDofIndices;
+  Epetra_Time batchTimer(Comm);
+  for (int repetition=0; repetition<numRepetitions; repetition++) {
+    if (numCells > 0) {
+      dofInterpreter.interpretLocalBatchData(cellIDs, localStiffness, localLoad, batchStiffness, batchLoad, batchDofIndices);
+    }
+  }
+  double batchTime = MPIWrapper::sum(batchTimer.ElapsedTime() / numRepetitions) / numProcs;
+
+  double maxDiff = 0;
+  for (int cellOrdinal=0; cellOrdinal<numCells; cellOrdinal++) {
+    for (int i=0; i<cellwiseStiffness[cellOrdinal].size(); i++) {
+      maxDiff = max(maxDiff, abs(cellwiseStiffness[cellOrdinal][i] - batchStiffness[cellOrdinal][i]));
+    }
+  }
+  double myMaxDiff = maxDiff;
+  Comm.MaxAll(&myMaxDiff, &maxDiff, 1);
+
+  if (rank == 0) {
+    cout << setw(10) << H1Order << setw(14) << numTrialDofs << setprecision(3);
+    cout << setw(16) << cellwiseTime << setw(16) << batchTime << setw(12) << cellwiseTime / batchTime;
+    cout << setw(14) << maxDiff << endl;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  Teuchos::GlobalMPISession mpiSession(&argc, &argv, 0);
+  int rank = Teuchos::GlobalMPISession::getRank();
+
+  int spaceDim = 2;
+  bool conformingTraces = true;
+  PoissonFormulation form(spaceDim, conformingTraces);
+
+  if (rank == 0) {
+    cout << setw(10) << "H1 order" << setw(14) << "trial dofs" << setw(16) << "LU (s)" << setw(16) << "Cholesky (s)";
+    cout << setw(12) << "speedup" << setw(14) << "max diff." << endl;
+  }
+
+  int numRepetitions = 5;
+  for (int H1Order=2; H1Order<=5; H1Order++) {
+    reportCondensation(form, H1Order, numRepetitions);
+  }
+
+  return 0;
+}
@@ -0,0 +1,118 @@
+//
+//  DofOrderingBenchmark.cpp
+//  Camellia
+//
+//  Reports the bandwidth and envelope (an upper bound on fill-in for a banded/skyline factorization) of the global
+//  matrix graph, along with sparse matrix-vector product timings, for each of the GDAMinimumRule cell orderings.
+//  Intended to be run on a single MPI rank.
+//
+
+#include <iomanip>
+
+#include "Teuchos_GlobalMPISession.hpp"
+
+#include "Epetra_CrsMatrix.h"
+#include "Epetra_Map.h"
+#include "Epetra_SerialComm.h"
+#include "Epetra_Time.h"
+#include "Epetra_Vector.h"
+
+#include "GDAMinimumRule.h"
+#include "MeshFactory.h"
+#include "PoissonFormulation.h"
+
+using namespace std;
+
+void reportOrderingStatistics(MeshPtr mesh, string orderingName, int numMultiplies) {
+  GlobalIndexType numDofs = mesh->globalDofCount();
+  vector< set<GlobalIndexType> > rowEntries(numDofs);
+  set<GlobalIndexType> activeCellIDs = mesh->getActiveCellIDs();
+  for (set<GlobalIndexType>::iterator cellIDIt = activeCellIDs.begin(); cellIDIt != activeCellIDs.end(); cellIDIt++) {
+    set<GlobalIndexType> cellDofs = mesh->globalDofIndicesForCell(*cellIDIt);
+    for (set<GlobalIndexType>::iterator rowIt = cellDofs.begin(); rowIt != cellDofs.end(); rowIt++) {
+      rowEntries[*rowIt].insert(cellDofs.begin(), cellDofs.end());
+    }
+  }
+
+  GlobalIndexType bandwidth = 0;
+  long long envelope = 0, nonzeros = 0;
+  for (GlobalIndexType row=0; row<numDofs; row++) {
+    if (rowEntries[row].size() == 0) continue;
+    GlobalIndexType firstColumn = *rowEntries[row].begin();
+    GlobalIndexType lastColumn = *rowEntries[row].rbegin();
+    bandwidth = max(bandwidth, max(row - min(row,firstColumn), lastColumn - min(row,lastColumn)));
+    envelope += row - min(row,firstColumn);
+    nonzeros += rowEntries[row].size();
+  }
+
+  Epetra_SerialComm Comm;
+  Epetra_Map map((GlobalIndexTypeToCast)numDofs, 0, Comm);
+  vector<int> rowCounts(numDofs);
+  for (GlobalIndexType row=0; row<numDofs; row++) {
+    rowCounts[row] = rowEntries[row].size();
+  }
+  Epetra_CrsMatrix A(Copy, map, &rowCounts[0], true);
+  for (GlobalIndexType row=0; row<numDofs; row++) {
+    vector<GlobalIndexTypeToCast> columns(rowEntries[row].begin(), rowEntries[row].end());
+    vector<double> values(columns.size(), 1.0);
+    if (columns.size() > 0) A.InsertGlobalValues(row, columns.size(), &values[0], &columns[0]);
+  }
+  A.FillComplete();
+
+  Epetra_Vector x(map), y(map);
+  x.PutScalar(1.0);
+  Epetra_Time timer(Comm);
+  for (int i=0; i<numMultiplies; i++) {
+    A.Multiply(false, x, y);
+  }
+  double spmvTime = timer.ElapsedTime() / numMultiplies;
+
+  cout << setw(30) << orderingName << setw(12) << bandwidth << setw(16) << envelope << setw(14) << nonzeros;
+  cout << setw(16) << setprecision(4) << spmvTime * 1e6 << endl;
+}
+
+int main(int argc, char *argv[]) {
+  Teuchos::GlobalMPISession mpiSession(&argc, &argv, 0);
+
+  int spaceDim = 2;
+  bool conformingTraces = true;
+  PoissonFormulation formulation(spaceDim, conformingTraces);
+  BFPtr bf = formulation.bf();
+
+  int H1Order = 3, pToAddTest = 2;
+  int horizontalElements = 16, verticalElements = 16;
+  MeshPtr mesh = MeshFactory::quadMesh(bf, H1Order, pToAddTest, 1.0, 1.0, horizontalElements, verticalElements);
+
+  // adaptive-style refinements toward the origin, so that cell IDs of neighboring cells end up far apart
+  int numRefinements = 4;
+  for (int refinement=0; refinement<numRefinements; refinement++) {
+    set<GlobalIndexType> cellsToRefine;
+    set<GlobalIndexType> activeCellIDs = mesh->getActiveCellIDs();
+    double radius = 0.5 / (refinement + 1);
+    for (set<GlobalIndexType>::iterator cellIDIt = activeCellIDs.begin(); cellIDIt != activeCellIDs.end(); cellIDIt++) {
+      vector<double> centroid = mesh->getTopology()->getCellCentroid(*cellIDIt);
+      if (centroid[0] * centroid[0] + centroid[1] * centroid[1] < radius * radius) cellsToRefine.insert(*cellIDIt);
+    }
+    mesh->hRefine(cellsToRefine, RefinementPattern::regularRefinementPatternQuad());
+  }
+
+  GDAMinimumRule* minRule = dynamic_cast<GDAMinimumRule*>(mesh->globalDofAssignment().get());
+  if (minRule == NULL) {
+    cout << "DofOrderingBenchmark requires a minimum-rule mesh.\n";
+    return -1;
+  }
+
+  cout << mesh->numActiveElements() << " active elements, " << mesh->globalDofCount() << " global dofs.\n";
+  cout << setw(30) << "ordering" << setw(12) << "bandwidth" << setw(16) << "envelope" << setw(14) << "nonzeros";
+  cout << setw(16) << "SpMV (us)" << endl;
+
+  int numMultiplies = 200;
+  minRule->setCellOrderingForDofs(GDAMinimumRule::CELL_ID_ORDERING);
+  reportOrderingStatistics(mesh, "cell ID", numMultiplies);
+  minRule->setCellOrderingForDofs(GDAMinimumRule::HILBERT_CURVE_ORDERING);
+  reportOrderingStatistics(mesh, "Hilbert curve", numMultiplies);
+  minRule->setCellOrderingForDofs(GDAMinimumRule::REVERSE_CUTHILL_MCKEE_ORDERING);
+  reportOrderingStatistics(mesh, "reverse Cuthill-McKee", numMultiplies);
+
+  return 0;
+}
@@ -92,6 +92,15 @@ void refineUniformly(MeshTopologyPtr mesh) {
   }
 }
 
+void printPerCellCost(MeshTopologyPtr mesh, long long memoryFootprintInBytes) {
+  // cost per active cell is the figure of merit for large meshes; per cell (including inactive ancestors) shows the storage overhead of refinement history
+  IndexType activeCellCount = mesh->getActiveCellIndices().size();
+  IndexType cellCount = mesh->cellCount();
+  cout << "  " << activeCellCount << " active cells (" << cellCount << " total): ";
+  cout << setprecision(4) << (double) memoryFootprintInBytes / activeCellCount << " bytes per active cell, ";
+  cout << setprecision(4) << (double) memoryFootprintInBytes / cellCount << " bytes per cell.\n";
+}
+
 int main(int argc, char *argv[]) {
   { // 2D
     int horizontalCells = 128;
@@ -103,6 +112,7 @@ int main(int argc, char *argv[]) {
     long long memoryFootprintInBytes = mesh->approximateMemoryFootprint();
     double memoryFootprintInMegabytes = (double)memoryFootprintInBytes / (1024 * 1024);
     cout << setprecision(4) << memoryFootprintInMegabytes << " MB.\n";
+    printPerCellCost(mesh, memoryFootprintInBytes);
   
     mesh->printApproximateMemoryReport();
   
@@ -127,6 +137,7 @@ int main(int argc, char *argv[]) {
     long long memoryFootprintInBytes = mesh->approximateMemoryFootprint();
     double memoryFootprintInMegabytes = (double)memoryFootprintInBytes / (1024 * 1024);
     cout << setprecision(4) << memoryFootprintInMegabytes << " MB.\n";
+    printPerCellCost(mesh, memoryFootprintInBytes);
     
     mesh->printApproximateMemoryReport();
     
@@ -161,6 +172,7 @@ int main(int argc, char *argv[]) {
     long long memoryFootprintInBytes = mesh->approximateMemoryFootprint();
     double memoryFootprintInMegabytes = (double)memoryFootprintInBytes / (1024 * 1024);
     cout << setprecision(4) << memoryFootprintInMegabytes << " MB.\n";
+    printPerCellCost(mesh, memoryFootprintInBytes);
     
     mesh->printApproximateMemoryReport();
     
@@ -185,6 +197,7 @@ int main(int argc, char *argv[]) {
     long long memoryFootprintInBytes = mesh->approximateMemoryFootprint();
     double memoryFootprintInMegabytes = (double)memoryFootprintInBytes / (1024 * 1024);
     cout << setprecision(4) << memoryFootprintInMegabytes << " MB.\n";
+    printPerCellCost(mesh, memoryFootprintInBytes);
     
     mesh->printApproximateMemoryReport();
     
@@ -225,6 +238,7 @@ int main(int argc, char *argv[]) {
     long long memoryFootprintInBytes = mesh->approximateMemoryFootprint();
     double memoryFootprintInMegabytes = (double)memoryFootprintInBytes / (1024 * 1024);
     cout << setprecision(4) << memoryFootprintInMegabytes << " MB.\n";
+    printPerCellCost(mesh, memoryFootprintInBytes);
     
     mesh->printApproximateMemoryReport();
     
@@ -0,0 +1,176 @@
+//
+//  PartitionBenchmark.cpp
+//  Camellia
+//
+//  Compares mesh partition policies -- Zoltan's geometric HSFC and RCB against graph partitioning of the side-neighbor
+//  graph weighted by shared trace dofs -- on a few benchmark meshes.  For each, reports the trace dofs on cut sides,
+//  the ghost (off-rank) dofs referenced by each rank's cells, and the iteration count of a GMG-preconditioned CG solve
+//  of the Poisson problem.  Then reports the cells and bytes migrated by repartitioning after each of a sequence of
+//  local refinements, from scratch versus incrementally.  Intended to be run on several MPI ranks.
+//
+
+#include <iomanip>
+
+#include "Teuchos_GlobalMPISession.hpp"
+
+#include "BC.h"
+#include "GMGSolver.h"
+#include "MeshFactory.h"
+#include "MeshPartitionPolicy.h"
+#include "MPIWrapper.h"
+#include "PoissonFormulation.h"
+#include "RHS.h"
+#include "Solution.h"
+#include "ZoltanMeshPartitionPolicy.h"
+
+using namespace std;
+
+void reportPartitionStatistics(MeshPtr mesh, PoissonFormulation &form, int pToAddTest, string policyName) {
+  int rank = Teuchos::GlobalMPISession::getRank();
+  int numProcs = Teuchos::GlobalMPISession::getNProc();
+
+  set<GlobalIndexType> rankLocalCells = mesh->cellIDsInPartition();
+  set<GlobalIndexType> ownedDofs = mesh->globalDofIndicesForPartition(rank);
+  set<GlobalIndexType> ghostDofs;
+  int cutTraceDofs = 0;
+  for (set<GlobalIndexType>::iterator cellIDIt = rankLocalCells.begin(); cellIDIt != rankLocalCells.end(); cellIDIt++) {
+    set<GlobalIndexType> cellDofs = mesh->globalDofIndicesForCell(*cellIDIt);
+    for (set<GlobalIndexType>::iterator dofIt = cellDofs.begin(); dofIt != cellDofs.end(); dofIt++) {
+      if (ownedDofs.find(*dofIt) == ownedDofs.end()) ghostDofs.insert(*dofIt);
+    }
+    map<GlobalIndexType, int> weights = MeshPartitionPolicy::traceCouplingWeights(mesh.get(), *cellIDIt);
+    for (map<GlobalIndexType, int>::iterator weightIt = weights.begin(); weightIt != weights.end(); weightIt++) {
+      if (rankLocalCells.find(weightIt->first) == rankLocalCells.end()) cutTraceDofs += weightIt->second;
+    }
+  }
+  int totalCutTraceDofs = MPIWrapper::sum(cutTraceDofs) / 2; // each cut side is seen from both of its ranks
+
+  FieldContainer<int> ghostDofCounts(numProcs);
+  MPIWrapper::allGather(ghostDofCounts, (int) ghostDofs.size());
+  int maxGhostDofs = 0, totalGhostDofs = 0;
+  for (int i=0; i<numProcs; i++) {
+    maxGhostDofs = max(maxGhostDofs, ghostDofCounts[i]);
+    totalGhostDofs += ghostDofCounts[i];
+  }
+
+  RHSPtr rhs = RHS::rhs();
+  rhs->addTerm(1.0 * form.q());
+  BCPtr bc = BC::bc();
+  bc->addDirichlet(form.phi_hat(), SpatialFilter::allSpace(), Function::zero());
+  SolutionPtr solution = Solution::solution(mesh, bc, rhs, form.bf()->graphNorm());
+
+  int H1OrderCoarse = 1;
+  MeshPtr coarseMesh = Teuchos::rcp( new Mesh(mesh->getTopology()->deepCopy(), form.bf(), H1OrderCoarse, pToAddTest) );
+  int maxIters = 2000;
+  double tol = 1e-8;
+  bool useStaticCondensation = false;
+  SolverPtr coarseSolver = Solver::getSolver(Solver::KLU, true);
+  Teuchos::RCP<GMGSolver> gmgSolver = Teuchos::rcp( new GMGSolver(solution, coarseMesh, maxIters, tol, coarseSolver, useStaticCondensation) );
+  gmgSolver->setAztecOutput(0);
+  solution->solve(gmgSolver);
+
+  if (rank == 0) {
+    cout << setw(16) << policyName << setw(14) << totalCutTraceDofs << setw(16) << maxGhostDofs;
+    cout << setw(16) << totalGhostDofs << setw(12) << gmgSolver->iterationCount() << endl;
+  }
+}
+
+void reportPolicies(MeshPtr mesh, PoissonFormulation &form, int pToAddTest, string meshName) {
+  int rank = Teuchos::GlobalMPISession::getRank();
+  if (rank == 0) {
+    cout << endl << meshName << ": " << mesh->numActiveElements() << " active elements, " << mesh->globalDofCount() << " global dofs.\n";
+    cout << setw(16) << "policy" << setw(14) << "cut traces" << setw(16) << "max ghost dofs";
+    cout << setw(16) << "total ghosts" << setw(12) << "GMG iters" << endl;
+  }
+
+  mesh->setPartitionPolicy(Teuchos::rcp( new ZoltanMeshPartitionPolicy("HSFC") ));
+  reportPartitionStatistics(mesh, form, pToAddTest, "HSFC");
+  mesh->setPartitionPolicy(Teuchos::rcp( new ZoltanMeshPartitionPolicy("RCB") ));
+  reportPartitionStatistics(mesh, form, pToAddTest, "RCB");
+  mesh->setPartitionPolicy(MeshPartitionPolicy::traceGraphPartitionPolicy());
+  reportPartitionStatistics(mesh, form, pToAddTest, "trace graph");
+}
+
+void reportRefinementMigration(PoissonFormulation &form, int H1Order, int pToAddTest, bool incremental) {
+  int rank = Teuchos::GlobalMPISession::getRank();
+  
+  Teuchos::RCP<ZoltanMeshPartitionPolicy> policy = Teuchos::rcp( new ZoltanMeshPartitionPolicy("HSFC") );
+  if (incremental) {
+    double imbalanceThreshold = 1.1;
+    policy->setIncrementalRepartitioning(true, imbalanceThreshold);
+  }
+  MeshPtr mesh = MeshFactory::quadMesh(form.bf(), H1Order, pToAddTest, 1.0, 1.0, 16, 16);
+  mesh->setPartitionPolicy(policy);
+  
+  if (rank == 0) {
+    cout << endl << (incremental ? "incremental repartitioning (threshold 1.1)" : "HSFC from scratch") << ", refining toward the origin:\n";
+    cout << setw(12) << "refinement" << setw(14) << "active cells" << setw(12) << "imbalance" << setw(12) << "rebalanced";
+    cout << setw(16) << "migrated cells" << setw(16) << "migrated bytes" << endl;
+  }
+  int numRefinements = 6;
+  for (int refinement=0; refinement<numRefinements; refinement++) {
+    // refine the cells nearest the origin, a few at a time
+    set<GlobalIndexType> cellsToRefine;
+    set<GlobalIndexType> activeCellIDs = mesh->getActiveCellIDs();
+    double radius = 0.25 / (refinement + 1);
+    for (set<GlobalIndexType>::iterator cellIDIt = activeCellIDs.begin(); cellIDIt != activeCellIDs.end(); cellIDIt++) {
+      vector<double> centroid = mesh->getTopology()->getCellCentroid(*cellIDIt);
+      if (centroid[0] * centroid[0] + centroid[1] * centroid[1] < radius * radius) cellsToRefine.insert(*cellIDIt);
+    }
+    mesh->hRefine(cellsToRefine, RefinementPattern::regularRefinementPatternQuad());
+    if (rank == 0) {
+      cout << setw(12) << refinement << setw(14) << mesh->numActiveElements() << setw(12) << setprecision(3) << policy->imbalanceBeforePartitioning();
+      cout << setw(12) << (policy->didRebalance() ? "yes" : "no") << setw(16) << policy->migratedCellCount();
+      cout << setw(16) << policy->migratedBytes() << endl;
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  Teuchos::GlobalMPISession mpiSession(&argc, &argv, 0);
+
+  int spaceDim = 2;
+  bool conformingTraces = true;
+  PoissonFormulation form(spaceDim, conformingTraces);
+
+  int H1Order = 3, pToAddTest = 2;
+  int horizontalElements = 16, verticalElements = 16;
+
+  MeshPtr uniformMesh = MeshFactory::quadMesh(form.bf(), H1Order, pToAddTest, 1.0, 1.0, horizontalElements, verticalElements);
+  reportPolicies(uniformMesh, form, pToAddTest, "uniform");
+
+  // adaptive-style refinements toward the origin
+  MeshPtr hRefinedMesh = MeshFactory::quadMesh(form.bf(), H1Order, pToAddTest, 1.0, 1.0, horizontalElements, verticalElements);
+  int numRefinements = 4;
+  for (int refinement=0; refinement<numRefinements; refinement++) {
+    set<GlobalIndexType> cellsToRefine;
+    set<GlobalIndexType> activeCellIDs = hRefinedMesh->getActiveCellIDs();
+    double radius = 0.5 / (refinement + 1);
+    for (set<GlobalIndexType>::iterator cellIDIt = activeCellIDs.begin(); cellIDIt != activeCellIDs.end(); cellIDIt++) {
+      vector<double> centroid = hRefinedMesh->getTopology()->getCellCentroid(*cellIDIt);
+      if (centroid[0] * centroid[0] + centroid[1] * centroid[1] < radius * radius) cellsToRefine.insert(*cellIDIt);
+    }
+    hRefinedMesh->hRefine(cellsToRefine, RefinementPattern::regularRefinementPatternQuad());
+  }
+  reportPolicies(hRefinedMesh, form, pToAddTest, "h-refined toward origin");
+
+  // p-refinements on the left half, so that trace dof counts vary across sides
+  MeshPtr pRefinedMesh = MeshFactory::quadMesh(form.bf(), H1Order, pToAddTest, 1.0, 1.0, horizontalElements, verticalElements);
+  set<GlobalIndexType> cellsToPRefine;
+  set<GlobalIndexType> activeCellIDs = pRefinedMesh->getActiveCellIDs();
+  for (set<GlobalIndexType>::iterator cellIDIt = activeCellIDs.begin(); cellIDIt != activeCellIDs.end(); cellIDIt++) {
+    vector<double> centroid = pRefinedMesh->getTopology()->getCellCentroid(*cellIDIt);
+    if (centroid[0] < 0.5) cellsToPRefine.insert(*cellIDIt);
+  }
+  int pToAdd = 2;
+  pRefinedMesh->pRefine(cellsToPRefine, pToAdd);
+  reportPolicies(pRefinedMesh, form, pToAddTest, "p-refined left half");
+
+  // migration volume when repartitioning after each of a sequence of local refinements
+  bool incremental = false;
+  reportRefinementMigration(form, H1Order, pToAddTest, incremental);
+  incremental = true;
+  reportRefinementMigration(form, H1Order, pToAddTest, incremental);
+
+  return 0;
+}
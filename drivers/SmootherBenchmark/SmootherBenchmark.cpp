@@ -0,0 +1,114 @@
+//
+//  SmootherBenchmark.cpp
+//  Camellia
+//
+//  Compares the GMGOperator smoothers -- point and block Jacobi, symmetric Gauss-Seidel, Ifpack and Camellia additive
+//  Schwarz, and Chebyshev -- on two-level GMG-preconditioned CG solves of the Poisson problem, reporting for each the
+//  smoother setup time, the smoother apply time, the total solve time, and the iteration count.  Times are means over
+//  MPI ranks.  Chebyshev is run at a few polynomial degrees.
+//
+
+#include <iomanip>
+#include <sstream>
+
+#include "Teuchos_GlobalMPISession.hpp"
+
+#include "Epetra_SerialComm.h"
+#include "Epetra_Time.h"
+
+#ifdef HAVE_MPI
+#include "Epetra_MpiComm.h"
+#endif
+
+#include "BC.h"
+#include "GMGSolver.h"
+#include "MeshFactory.h"
+#include "MPIWrapper.h"
+#include "PoissonFormulation.h"
+#include "RHS.h"
+#include "Solution.h"
+
+using namespace std;
+
+void reportSmoother(MeshPtr fineMesh, MeshPtr coarseMesh, PoissonFormulation &form, GMGOperator::SmootherChoice smootherType,
+                    int chebyshevDegree, string smootherName) {
+  int rank = Teuchos::GlobalMPISession::getRank();
+  int numProcs = Teuchos::GlobalMPISession::getNProc();
+
+#ifdef HAVE_MPI
+  Epetra_MpiComm Comm(MPI_COMM_WORLD);
+#else
+  Epetra_SerialComm Comm;
+#endif
+
+  RHSPtr rhs = RHS::rhs();
+  rhs->addTerm(1.0 * form.q());
+  BCPtr bc = BC::bc();
+  bc->addDirichlet(form.phi_hat(), SpatialFilter::allSpace(), Function::zero());
+  SolutionPtr solution = Solution::solution(fineMesh, bc, rhs, form.bf()->graphNorm());
+
+  int maxIters = 2000;
+  double tol = 1e-8;
+  bool useStaticCondensation = false;
+  SolverPtr coarseSolver = Solver::getSolver(Solver::KLU, true);
+  Teuchos::RCP<GMGSolver> gmgSolver = Teuchos::rcp( new GMGSolver(solution, coarseMesh, maxIters, tol, coarseSolver, useStaticCondensation) );
+  gmgSolver->setAztecOutput(0);
+  gmgSolver->gmgOperator().setSmootherType(smootherType);
+  if (smootherType == GMGOperator::CHEBYSHEV) {
+    gmgSolver->gmgOperator().setChebyshevParameters(chebyshevDegree);
+  }
+
+  Epetra_Time solveTimer(Comm);
+  solution->solve(gmgSolver);
+  double solveTime = solveTimer.ElapsedTime();
+
+  double setUpTime = MPIWrapper::sum(gmgSolver->gmgOperator().getSmootherSetUpTime()) / numProcs;
+  double applyTime = MPIWrapper::sum(gmgSolver->gmgOperator().getSmootherApplyTime()) / numProcs;
+  solveTime = MPIWrapper::sum(solveTime) / numProcs;
+
+  if (rank == 0) {
+    cout << setw(20) << smootherName << setprecision(3);
+    cout << setw(14) << setUpTime << setw(14) << applyTime << setw(14) << solveTime;
+    cout << setw(12) << gmgSolver->iterationCount() << endl;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  Teuchos::GlobalMPISession mpiSession(&argc, &argv, 0);
+  int rank = Teuchos::GlobalMPISession::getRank();
+
+  int spaceDim = 2;
+  bool conformingTraces = true;
+  PoissonFormulation form(spaceDim, conformingTraces);
+
+  int H1Order = 3, pToAddTest = 2;
+  int horizontalElements = 32, verticalElements = 32;
+  MeshPtr fineMesh = MeshFactory::quadMesh(form.bf(), H1Order, pToAddTest, 1.0, 1.0, horizontalElements, verticalElements);
+
+  // p-coarsening to linears on the same topology
+  int H1OrderCoarse = 1;
+  MeshPtr coarseMesh = Teuchos::rcp( new Mesh(fineMesh->getTopology()->deepCopy(), form.bf(), H1OrderCoarse, pToAddTest) );
+
+  if (rank == 0) {
+    cout << "Fine mesh: " << fineMesh->numActiveElements() << " active elements, " << fineMesh->globalDofCount() << " global dofs.\n";
+    cout << setw(20) << "smoother" << setw(14) << "setup (s)" << setw(14) << "apply (s)" << setw(14) << "solve (s)";
+    cout << setw(12) << "iterations" << endl;
+  }
+
+  int unusedDegree = -1;
+  reportSmoother(fineMesh, coarseMesh, form, GMGOperator::POINT_JACOBI, unusedDegree, "point Jacobi");
+  reportSmoother(fineMesh, coarseMesh, form, GMGOperator::POINT_SYMMETRIC_GAUSS_SEIDEL, unusedDegree, "point sym. GS");
+  reportSmoother(fineMesh, coarseMesh, form, GMGOperator::BLOCK_JACOBI, unusedDegree, "block Jacobi");
+  reportSmoother(fineMesh, coarseMesh, form, GMGOperator::BLOCK_SYMMETRIC_GAUSS_SEIDEL, unusedDegree, "block sym. GS");
+  reportSmoother(fineMesh, coarseMesh, form, GMGOperator::IFPACK_ADDITIVE_SCHWARZ, unusedDegree, "Ifpack Schwarz");
+  reportSmoother(fineMesh, coarseMesh, form, GMGOperator::CAMELLIA_ADDITIVE_SCHWARZ, unusedDegree, "Camellia Schwarz");
+
+  int chebyshevDegrees[3] = {2, 3, 5};
+  for (int i=0; i<3; i++) {
+    ostringstream name;
+    name << "Chebyshev (deg. " << chebyshevDegrees[i] << ")";
+    reportSmoother(fineMesh, coarseMesh, form, GMGOperator::CHEBYSHEV, chebyshevDegrees[i], name.str());
+  }
+
+  return 0;
+}
@@ -0,0 +1,115 @@
+//
+//  GMGSolverSlowTests.cpp
+//  Camellia
+//
+
+#include "BC.h"
+#include "GMGSolver.h"
+#include "MeshFactory.h"
+#include "PoissonFormulation.h"
+#include "RHS.h"
+#include "Solution.h"
+#include "StokesVGPFormulation.h"
+
+#include "Teuchos_UnitTestHarness.hpp"
+namespace {
+  enum ProblemChoice {
+    POISSON,
+    STOKES
+  };
+
+  int multilevelIterationCount(BFPtr bf, BCPtr bc, RHSPtr rhs, vector<MeshPtr> &meshes, int numLevels, GMGOperator::CycleType cycleType) {
+    // meshes[0] is the coarsest; the fine mesh is meshes[numLevels-1]
+    MeshPtr fineMesh = meshes[numLevels-1];
+    vector<MeshPtr> coarseMeshes;
+    for (int level=numLevels-2; level>=0; level--) {
+      coarseMeshes.push_back(meshes[level]);
+    }
+
+    SolutionPtr solution = Solution::solution(fineMesh, bc, rhs, bf->graphNorm());
+
+    int maxIters = 500;
+    double tol = 1e-8;
+    bool useStaticCondensation = false;
+    SolverPtr coarsestSolver = Solver::getSolver(Solver::KLU, true);
+    Teuchos::RCP<GMGSolver> gmgSolver = Teuchos::rcp( new GMGSolver(solution, coarseMeshes, maxIters, tol, coarsestSolver, useStaticCondensation) );
+    gmgSolver->setAztecOutput(0);
+    gmgSolver->gmgOperator().setCycleType(cycleType);
+    solution->solve(gmgSolver);
+    return gmgSolver->iterationCount();
+  }
+
+  void testLevelIndependentIterations(ProblemChoice problem, GMGOperator::CycleType cycleType, Teuchos::FancyOStream &out, bool &success) {
+    int spaceDim = 2;
+    bool conformingTraces = true;
+
+    BFPtr bf;
+    VarPtr pressure;
+    RHSPtr rhs = RHS::rhs();
+    BCPtr bc = BC::bc();
+    if (problem == POISSON) {
+      PoissonFormulation form(spaceDim, conformingTraces);
+      bf = form.bf();
+      rhs->addTerm(1.0 * form.q());
+      bc->addDirichlet(form.phi_hat(), SpatialFilter::allSpace(), Function::zero());
+    } else {
+      StokesVGPFormulation form(spaceDim, conformingTraces);
+      bf = form.bf();
+      rhs->addTerm(1.0 * form.v(1));
+      for (int d=1; d<=spaceDim; d++) {
+        bc->addDirichlet(form.u_hat(d), SpatialFilter::allSpace(), Function::zero());
+      }
+      pressure = form.p();
+    }
+
+    int H1Order = 2, pToAddTest = 2;
+    vector<MeshPtr> meshes;
+    meshes.push_back(MeshFactory::quadMesh(bf, H1Order, pToAddTest, 1.0, 1.0, 2, 2));
+    int maxLevels = 5; // finest mesh is 32 x 32
+    for (int level=1; level<maxLevels; level++) {
+      MeshPtr mesh = meshes[level-1]->deepCopy();
+      mesh->hRefine(mesh->getActiveCellIDs(), RefinementPattern::regularRefinementPatternQuad());
+      meshes.push_back(mesh);
+    }
+
+    if (pressure != Teuchos::null) {
+      // fix the pressure at the center vertex, which belongs to every level.  (As in the Stokes preconditioning driver, we avoid
+      // a zero-mean constraint, which makes the system indefinite and so unsuitable for CG.)
+      vector<double> center(spaceDim, 0.5);
+      IndexType centerVertexIndex;
+      TEST_ASSERT(meshes[0]->getTopology()->getVertexIndex(center, centerVertexIndex));
+      bc->addSinglePointBC(pressure->ID(), 0.0, centerVertexIndex);
+    }
+
+    // with the same coarsest mesh, adding levels (and halving h each time) should not grow the iteration count appreciably
+    vector<int> iterationCounts;
+    for (int numLevels=2; numLevels<=maxLevels; numLevels++) {
+      iterationCounts.push_back(multilevelIterationCount(bf, bc, rhs, meshes, numLevels, cycleType));
+      out << numLevels << " levels: " << iterationCounts.back() << " iterations.\n";
+    }
+    int maxIterationGrowth = 5;
+    for (int i=1; i<iterationCounts.size(); i++) {
+      TEST_COMPARE(iterationCounts[i], <=, iterationCounts[0] + maxIterationGrowth);
+    }
+  }
+
+  TEUCHOS_UNIT_TEST( GMGSolver, LevelIndependentIterations_VCycle_Poisson )
+  {
+    testLevelIndependentIterations(POISSON, GMGOperator::V_CYCLE, out, success);
+  }
+
+  TEUCHOS_UNIT_TEST( GMGSolver, LevelIndependentIterations_WCycle_Poisson )
+  {
+    testLevelIndependentIterations(POISSON, GMGOperator::W_CYCLE, out, success);
+  }
+
+  TEUCHOS_UNIT_TEST( GMGSolver, LevelIndependentIterations_VCycle_Stokes )
+  {
+    testLevelIndependentIterations(STOKES, GMGOperator::V_CYCLE, out, success);
+  }
+
+  TEUCHOS_UNIT_TEST( GMGSolver, LevelIndependentIterations_WCycle_Stokes )
+  {
+    testLevelIndependentIterations(STOKES, GMGOperator::W_CYCLE, out, success);
+  }
+} // namespace
@@ -862,8 +862,36 @@ set<int> BasisFactory::sideFieldIndices( BasisPtr basis, bool includeSideSubcell
   }
 }
 
+bool BasisFactory::useLobattoForQuadHGrad() {
+  return _useLobattoForQuadHGRAD;
+}
+
 void BasisFactory::setUseLobattoForQuadHGrad(bool value) {
+  if (value == _useLobattoForQuadHGRAD) return;
   _useLobattoForQuadHGRAD = value;
+  // swap the cached quad HGRAD bases with those of the newly chosen family (empty the first time) so that subsequent
+  // requests get the new family; the swapped-out bases stay alive, since the maps above (and other caches) are keyed on
+  // Basis pointers, and are reused if the choice is changed back
+  typedef map< pair< pair<int,int>, Camellia::EFunctionSpace >, BasisPtr > BasisCache;
+  BasisCache* caches[2] = {&_existingBases, &_conformingBases};
+  BasisCache* inactiveCaches[2] = {&_inactiveQuadHGRADBases, &_inactiveConformingQuadHGRADBases};
+  for (int i=0; i<2; i++) {
+    BasisCache* cache = caches[i];
+    BasisCache swappedOut;
+    for (BasisCache::iterator entryIt = cache->begin(); entryIt != cache->end();) {
+      unsigned cellTopoKey = entryIt->first.first.second;
+      Camellia::EFunctionSpace fs = entryIt->first.second;
+      if ((cellTopoKey == shards::Quadrilateral<4>::key) &&
+          ((fs == Camellia::FUNCTION_SPACE_HGRAD) || (fs == Camellia::FUNCTION_SPACE_HGRAD_DISC))) {
+        swappedOut.insert(*entryIt);
+        cache->erase(entryIt++);
+      } else {
+        entryIt++;
+      }
+    }
+    cache->insert(inactiveCaches[i]->begin(), inactiveCaches[i]->end());
+    inactiveCaches[i]->swap(swappedOut);
+  }
 }
 void BasisFactory::setUseLobattoForQuadHDiv(bool value) {
   _useLobattoForQuadHDIV = value;
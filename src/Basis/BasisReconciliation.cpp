@@ -12,6 +12,9 @@
 #include "CamelliaCellTools.h"
 #include "CamelliaDebugUtility.h" // includes print() methods
 #include "CellTopology.h"
+#include "LegendreHVOL_LineBasis.h"
+#include "LobattoHGRAD_LineBasis.h"
+#include "LobattoHGRAD_QuadBasis.h"
 #include "SerialDenseMatrixUtility.h"
 #include "SerialDenseWrapper.h"
 #include "TensorBasis.h"
@@ -19,8 +22,53 @@
 #include "Intrepid_FunctionSpaceTools.hpp"
 #include "Intrepid_DefaultCubatureFactory.hpp"
 
+#include <fstream>
+#include <iomanip>
+#include <list>
+#include <sstream>
+
 using namespace Camellia;
 
+// process-wide cache of subcell reconciliation weights, and of the basis signatures in its keys; all access is within the
+// BasisReconciliationSharedCache critical section
+struct SharedWeightsEntry {
+  Teuchos::RCP<SubBasisReconciliationWeights> weights;
+  list<string>::iterator lruPosition;
+  long long bytes;
+};
+static map<string, SharedWeightsEntry> _sharedWeights;
+static list<string> _sharedWeightsLRU; // most recently used first
+static long long _sharedWeightsBytes = 0;
+static long long _sharedWeightsCapacity = 256LL * 1024 * 1024;
+static map< Camellia::Basis<>*, pair<BasisPtr, string> > _basisSignatures; // holding the BasisPtr keeps the address from being reused by another basis
+static long long _basisSignaturesBytes = 0; // the signatures count against the capacity, too
+
+static long long basisSignatureEntryBytes(const string &signature) {
+  // approximate: the signature, the map node, and the BasisPtr's reference count node
+  return signature.size() + sizeof(Camellia::Basis<>*) + sizeof(pair<BasisPtr, string>) + 64;
+}
+
+static long long sharedWeightsEntryBytes(const string &key, const SubBasisReconciliationWeights &weights) {
+  // approximate: the weights, the ordinal sets (including their tree nodes), and the key stored in both the map and the LRU list
+  long long setNodeBytes = 32 + sizeof(int);
+  return weights.weights.size() * sizeof(double) + (weights.fineOrdinals.size() + weights.coarseOrdinals.size()) * setNodeBytes
+       + 2 * key.size() + sizeof(SharedWeightsEntry) + 64;
+}
+
+static void evictSharedCacheToCapacity() {
+  while ((_sharedWeightsBytes + _basisSignaturesBytes > _sharedWeightsCapacity) && (_sharedWeightsLRU.size() > 0)) {
+    string key = _sharedWeightsLRU.back();
+    _sharedWeightsLRU.pop_back();
+    _sharedWeightsBytes -= _sharedWeights[key].bytes;
+    _sharedWeights.erase(key);
+  }
+  if (_sharedWeightsBytes + _basisSignaturesBytes > _sharedWeightsCapacity) {
+    // signatures are cheap to recompute; dropping them also releases the bases they hold
+    _basisSignatures.clear();
+    _basisSignaturesBytes = 0;
+  }
+}
+
 void sizeFCForBasisValues(FieldContainer<double> &fc, BasisPtr basis, int numPoints, bool includeCellDimension = false, int numBasisFieldsToInclude = -1) {
   // values should have shape: (F,P[,D,D,...]) where the # of D's = rank of the basis's range
   Teuchos::Array<int> dim;
@@ -589,11 +637,283 @@ const SubBasisReconciliationWeights & BasisReconciliation::constrainedWeights(un
   pair< SubcellRefinedBasisPair, Permutation> cacheKey = make_pair(refinedBasisPair, vertexNodePermutation);
   
   if (_subcellReconcilationWeights.find(cacheKey) == _subcellReconcilationWeights.end()) {
-    _subcellReconcilationWeights[cacheKey] = computeConstrainedWeights(subcellDimension, finerBasis, finerBasisSubcellOrdinal, refinements,
-                                                                       coarserBasis, coarserBasisSubcellOrdinal, vertexNodePermutation);
+    Teuchos::RCP<SubBasisReconciliationWeights> weights;
+    bool useSharedCache = (sharedCacheCapacity() > 0);
+    string sharedKey;
+    if (useSharedCache) {
+      ostringstream sharedKeyStream;
+      sharedKeyStream << subcellDimension << "; " << basisSignature(finerBasis) << "; " << finerBasisSubcellOrdinal << "; ";
+      sharedKeyStream << basisSignature(coarserBasis) << "; " << coarserBasisSubcellOrdinal << "; " << vertexNodePermutation << "; ";
+      sharedKeyStream << refinementBranchSignature(refinements);
+      sharedKey = sharedKeyStream.str();
+      weights = sharedCacheLookup(sharedKey);
+    }
+    if (weights == Teuchos::null) {
+      weights = Teuchos::rcp( new SubBasisReconciliationWeights(computeConstrainedWeights(subcellDimension, finerBasis, finerBasisSubcellOrdinal, refinements,
+                                                                                          coarserBasis, coarserBasisSubcellOrdinal, vertexNodePermutation)) );
+      if (useSharedCache) sharedCacheInsert(sharedKey, weights);
+    }
+    _subcellReconcilationWeights[cacheKey] = weights;
   }
   
-  return _subcellReconcilationWeights[cacheKey];
+  return *_subcellReconcilationWeights[cacheKey];
+}
+
+string BasisReconciliation::basisSignature(BasisPtr basis) {
+  bool found = false;
+  string signature;
+#ifdef _OPENMP
+#pragma omp critical (BasisReconciliationSharedCache)
+#endif
+  {
+    if (_basisSignatures.find(basis.get()) != _basisSignatures.end()) {
+      signature = _basisSignatures[basis.get()].second;
+      found = true;
+    }
+  }
+  if (found) return signature;
+  
+  CellTopoPtr domainTopo = basis->domainTopology();
+  ostringstream signatureStream;
+  signatureStream << setprecision(17);
+  signatureStream << "fs " << basis->functionSpace() << " topo " << domainTopo->getKey().first << "," << domainTopo->getKey().second;
+  signatureStream << " card " << basis->getCardinality() << " deg " << basis->getDegree() << " rank " << basis->rangeRank();
+  
+  // values at an asymmetric interior point distinguish basis families that agree in all of the above (e.g. Lobatto and Lagrange H^1 bases)
+  int domainDim = domainTopo->getDimension();
+  if (domainDim > 0) {
+    FieldContainer<double> refCellNodes;
+    CamelliaCellTools::refCellNodesForTopology(refCellNodes, domainTopo);
+    FieldContainer<double> point(1,domainDim);
+    double weightSum = 0;
+    for (int node=0; node<refCellNodes.dimension(0); node++) {
+      double weight = node + 1;
+      weightSum += weight;
+      for (int d=0; d<domainDim; d++) {
+        point(0,d) += weight * refCellNodes(node,d);
+      }
+    }
+    for (int d=0; d<domainDim; d++) {
+      point(0,d) /= weightSum;
+    }
+    FieldContainer<double> values;
+    sizeFCForBasisValues(values, basis, 1);
+    basis->getValues(values, point, Intrepid::OPERATOR_VALUE);
+    signatureStream << " values";
+    for (int i=0; i<values.size(); i++) {
+      signatureStream << " " << values[i];
+    }
+  }
+  signature = signatureStream.str();
+  
+#ifdef _OPENMP
+#pragma omp critical (BasisReconciliationSharedCache)
+#endif
+  {
+    if ((_sharedWeightsCapacity > 0) && (_basisSignatures.find(basis.get()) == _basisSignatures.end())) {
+      _basisSignatures[basis.get()] = make_pair(basis, signature);
+      _basisSignaturesBytes += basisSignatureEntryBytes(signature);
+      evictSharedCacheToCapacity();
+    }
+  }
+  return signature;
+}
+
+string BasisReconciliation::refinementBranchSignature(RefinementBranch &refinements) {
+  ostringstream signatureStream;
+  signatureStream << setprecision(17);
+  for (int i=0; i<refinements.size(); i++) {
+    RefinementPattern* refPattern = refinements[i].first;
+    CellTopoPtr parentTopo = refPattern->parentTopology();
+    signatureStream << "[" << parentTopo->getKey().first << "," << parentTopo->getKey().second << " child " << refinements[i].second << " nodes";
+    const FieldContainer<double>* refinedNodes = &refPattern->refinedNodes();
+    for (int j=0; j<refinedNodes->size(); j++) {
+      signatureStream << " " << (*refinedNodes)[j];
+    }
+    signatureStream << "]";
+  }
+  return signatureStream.str();
+}
+
+Teuchos::RCP<SubBasisReconciliationWeights> BasisReconciliation::sharedCacheLookup(const string &key) {
+  Teuchos::RCP<SubBasisReconciliationWeights> weights;
+#ifdef _OPENMP
+#pragma omp critical (BasisReconciliationSharedCache)
+#endif
+  {
+    map<string, SharedWeightsEntry>::iterator entryIt = _sharedWeights.find(key);
+    if (entryIt != _sharedWeights.end()) {
+      // move to the front of the LRU list
+      _sharedWeightsLRU.splice(_sharedWeightsLRU.begin(), _sharedWeightsLRU, entryIt->second.lruPosition);
+      weights = entryIt->second.weights;
+    }
+  }
+  return weights;
+}
+
+void BasisReconciliation::sharedCacheInsert(const string &key, Teuchos::RCP<SubBasisReconciliationWeights> weights) {
+#ifdef _OPENMP
+#pragma omp critical (BasisReconciliationSharedCache)
+#endif
+  {
+    // another thread may have inserted the same weights while we computed ours; if so, ours simply replace them
+    map<string, SharedWeightsEntry>::iterator entryIt = _sharedWeights.find(key);
+    if (entryIt != _sharedWeights.end()) {
+      _sharedWeightsBytes -= entryIt->second.bytes;
+      _sharedWeightsLRU.erase(entryIt->second.lruPosition);
+      _sharedWeights.erase(entryIt);
+    }
+    SharedWeightsEntry entry;
+    entry.weights = weights;
+    entry.bytes = sharedWeightsEntryBytes(key, *weights);
+    _sharedWeightsLRU.push_front(key);
+    entry.lruPosition = _sharedWeightsLRU.begin();
+    _sharedWeights[key] = entry;
+    _sharedWeightsBytes += entry.bytes;
+    evictSharedCacheToCapacity();
+  }
+}
+
+void BasisReconciliation::setSharedCacheCapacity(long long capacityInBytes) {
+#ifdef _OPENMP
+#pragma omp critical (BasisReconciliationSharedCache)
+#endif
+  {
+    _sharedWeightsCapacity = capacityInBytes;
+    evictSharedCacheToCapacity();
+  }
+}
+
+long long BasisReconciliation::sharedCacheCapacity() {
+  long long capacity;
+#ifdef _OPENMP
+#pragma omp critical (BasisReconciliationSharedCache)
+#endif
+  {
+    capacity = _sharedWeightsCapacity;
+  }
+  return capacity;
+}
+
+long long BasisReconciliation::sharedCacheSize() {
+  long long size;
+#ifdef _OPENMP
+#pragma omp critical (BasisReconciliationSharedCache)
+#endif
+  {
+    size = _sharedWeightsBytes + _basisSignaturesBytes;
+  }
+  return size;
+}
+
+int BasisReconciliation::sharedCacheEntryCount() {
+  int entryCount;
+#ifdef _OPENMP
+#pragma omp critical (BasisReconciliationSharedCache)
+#endif
+  {
+    entryCount = _sharedWeights.size();
+  }
+  return entryCount;
+}
+
+void BasisReconciliation::clearSharedCache() {
+#ifdef _OPENMP
+#pragma omp critical (BasisReconciliationSharedCache)
+#endif
+  {
+    _sharedWeights.clear();
+    _sharedWeightsLRU.clear();
+    _sharedWeightsBytes = 0;
+    _basisSignatures.clear();
+    _basisSignaturesBytes = 0;
+  }
+}
+
+void BasisReconciliation::saveSharedCache(string filePath) {
+  ofstream fout(filePath.c_str());
+  if (!fout.good()) {
+    cout << "BasisReconciliation::saveSharedCache(): could not open " << filePath << " for writing.\n";
+    TEUCHOS_TEST_FOR_EXCEPTION(true, std::invalid_argument, "could not open file for writing");
+  }
+  fout << setprecision(17);
+#ifdef _OPENMP
+#pragma omp critical (BasisReconciliationSharedCache)
+#endif
+  {
+    fout << "BasisReconciliationSharedCache 1\n";
+    fout << _sharedWeights.size() << "\n";
+    // least recently used first, so that loading the file reproduces the recency order
+    for (list<string>::reverse_iterator keyIt = _sharedWeightsLRU.rbegin(); keyIt != _sharedWeightsLRU.rend(); keyIt++) {
+      SubBasisReconciliationWeights* weights = _sharedWeights[*keyIt].weights.get();
+      fout << *keyIt << "\n";
+      fout << weights->fineOrdinals.size();
+      for (set<int>::iterator ordinalIt = weights->fineOrdinals.begin(); ordinalIt != weights->fineOrdinals.end(); ordinalIt++) {
+        fout << " " << *ordinalIt;
+      }
+      fout << "\n" << weights->coarseOrdinals.size();
+      for (set<int>::iterator ordinalIt = weights->coarseOrdinals.begin(); ordinalIt != weights->coarseOrdinals.end(); ordinalIt++) {
+        fout << " " << *ordinalIt;
+      }
+      Teuchos::Array<int> dim;
+      weights->weights.dimensions(dim);
+      fout << "\n" << dim.size();
+      for (int r=0; r<dim.size(); r++) {
+        fout << " " << dim[r];
+      }
+      for (int i=0; i<weights->weights.size(); i++) {
+        fout << " " << weights->weights[i];
+      }
+      fout << "\n";
+    }
+  }
+  fout.close();
+}
+
+void BasisReconciliation::loadSharedCache(string filePath) {
+  ifstream fin(filePath.c_str());
+  string header;
+  int version = 0, entryCount = 0;
+  fin >> header >> version >> entryCount;
+  if (!fin.good() || (header != "BasisReconciliationSharedCache") || (version != 1)) {
+    cout << "BasisReconciliation::loadSharedCache(): " << filePath << " is not a BasisReconciliation cache file.\n";
+    TEUCHOS_TEST_FOR_EXCEPTION(true, std::invalid_argument, "file is not a BasisReconciliation cache file");
+  }
+  string restOfLine;
+  getline(fin, restOfLine);
+  for (int entry=0; entry<entryCount; entry++) {
+    string key;
+    getline(fin, key);
+    Teuchos::RCP<SubBasisReconciliationWeights> weights = Teuchos::rcp( new SubBasisReconciliationWeights );
+    int fineCount, coarseCount, rank;
+    fin >> fineCount;
+    for (int i=0; i<fineCount; i++) {
+      int ordinal;
+      fin >> ordinal;
+      weights->fineOrdinals.insert(ordinal);
+    }
+    fin >> coarseCount;
+    for (int i=0; i<coarseCount; i++) {
+      int ordinal;
+      fin >> ordinal;
+      weights->coarseOrdinals.insert(ordinal);
+    }
+    fin >> rank;
+    Teuchos::Array<int> dim(rank);
+    for (int r=0; r<rank; r++) {
+      fin >> dim[r];
+    }
+    if (rank > 0) weights->weights.resize(dim);
+    for (int i=0; i<weights->weights.size(); i++) {
+      fin >> weights->weights[i];
+    }
+    getline(fin, restOfLine);
+    if (fin.fail()) {
+      cout << "BasisReconciliation::loadSharedCache(): error reading entry " << entry << " of " << filePath << ".\n";
+      TEUCHOS_TEST_FOR_EXCEPTION(true, std::invalid_argument, "error reading BasisReconciliation cache file");
+    }
+    sharedCacheInsert(key, weights);
+  }
 }
 
 FieldContainer<double> BasisReconciliation::filterBasisValues(const FieldContainer<double> &basisValues, set<int> &filter) {
@@ -699,6 +1019,57 @@ SubBasisReconciliationWeights BasisReconciliation::filterToInclude(set<int> &row
   return filteredWeights;
 }
 
+bool BasisReconciliation::hierarchicalEmbeddingWeights(BasisPtr finerBasis, BasisPtr coarserBasis, SubBasisReconciliationWeights &weights) {
+  int fineDegree = finerBasis->getDegree(), coarseDegree = coarserBasis->getDegree();
+  if (fineDegree < coarseDegree) return false;
+
+  vector<int> fineOrdinalsForCoarse(coarserBasis->getCardinality()); // entry i: the finer basis's ordinal for the coarser basis's function i
+
+  LobattoHGRAD_QuadBasis<>* fineLobattoQuad = dynamic_cast< LobattoHGRAD_QuadBasis<>* >(finerBasis.get());
+  LobattoHGRAD_QuadBasis<>* coarseLobattoQuad = dynamic_cast< LobattoHGRAD_QuadBasis<>* >(coarserBasis.get());
+  LobattoHGRAD_LineBasis<>* fineLobattoLine = dynamic_cast< LobattoHGRAD_LineBasis<>* >(finerBasis.get());
+  LobattoHGRAD_LineBasis<>* coarseLobattoLine = dynamic_cast< LobattoHGRAD_LineBasis<>* >(coarserBasis.get());
+  LegendreHVOL_LineBasis<>* fineLegendreLine = dynamic_cast< LegendreHVOL_LineBasis<>* >(finerBasis.get());
+  LegendreHVOL_LineBasis<>* coarseLegendreLine = dynamic_cast< LegendreHVOL_LineBasis<>* >(coarserBasis.get());
+
+  if ((fineLobattoQuad != NULL) && (coarseLobattoQuad != NULL)) {
+    if (fineLobattoQuad->isConforming() != coarseLobattoQuad->isConforming()) return false;
+    // only the isotropic case, where the degree determines the cardinality
+    if (finerBasis->getCardinality() != (fineDegree + 1) * (fineDegree + 1)) return false;
+    if (coarserBasis->getCardinality() != (coarseDegree + 1) * (coarseDegree + 1)) return false;
+    for (int i=0; i<=coarseDegree; i++) {
+      for (int j=0; j<=coarseDegree; j++) {
+        fineOrdinalsForCoarse[coarseLobattoQuad->dofOrdinalMap(i,j)] = fineLobattoQuad->dofOrdinalMap(i,j);
+      }
+    }
+  } else if (((fineLobattoLine != NULL) && (coarseLobattoLine != NULL)) || ((fineLegendreLine != NULL) && (coarseLegendreLine != NULL))) {
+    if ((fineLobattoLine != NULL) && (fineLobattoLine->isConforming() != coarseLobattoLine->isConforming())) return false;
+    // the ordinal is the polynomial index
+    for (int i=0; i<fineOrdinalsForCoarse.size(); i++) {
+      fineOrdinalsForCoarse[i] = i;
+    }
+  } else {
+    return false;
+  }
+
+  weights.fineOrdinals = set<int>(fineOrdinalsForCoarse.begin(), fineOrdinalsForCoarse.end());
+  weights.coarseOrdinals.clear();
+  for (int i=0; i<fineOrdinalsForCoarse.size(); i++) {
+    weights.coarseOrdinals.insert(i);
+  }
+  map<int,int> fineOrdinalPositions;
+  int position = 0;
+  for (set<int>::iterator fineOrdinalIt = weights.fineOrdinals.begin(); fineOrdinalIt != weights.fineOrdinals.end(); fineOrdinalIt++, position++) {
+    fineOrdinalPositions[*fineOrdinalIt] = position;
+  }
+  weights.weights.resize(weights.fineOrdinals.size(), weights.coarseOrdinals.size());
+  weights.weights.initialize(0.0);
+  for (int i=0; i<fineOrdinalsForCoarse.size(); i++) {
+    weights.weights(fineOrdinalPositions[fineOrdinalsForCoarse[i]], i) = 1.0;
+  }
+  return true;
+}
+
 set<int> BasisReconciliation::interiorDofOrdinalsForBasis(BasisPtr basis) {
   // if L2, we include all dofs, not just the interior ones
   bool isL2 = (basis->functionSpace() == Camellia::FUNCTION_SPACE_HVOL) || (basis->functionSpace() == Camellia::FUNCTION_SPACE_VECTOR_HVOL);
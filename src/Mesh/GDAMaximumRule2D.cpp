@@ -1179,7 +1179,7 @@ void GDAMaximumRule2D::verticesForCell(FieldContainer<double>& vertices, GlobalI
   
   //vertices.resize(numVertices,dimension);
   for (unsigned vertexIndex = 0; vertexIndex < numVertices; vertexIndex++) {
-    vector<double> vertex = _meshTopology->getVertex(vertexIndices[vertexIndex]);
+    const double* vertex = _meshTopology->getVertexCoordinates(vertexIndices[vertexIndex]);
     for (int d=0; d<spaceDim; d++) {
       vertices(vertexIndex,d) = vertex[d];
     }
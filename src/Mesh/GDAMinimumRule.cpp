@@ -22,11 +22,21 @@
 
 #include "GDAMinimumRuleConstraints.h"
 
+#ifdef HAVE_MPI
+#include "Epetra_MpiComm.h"
+#else
+#include "Epetra_SerialComm.h"
+#endif
+#include "Epetra_Import.h"
+#include "Epetra_IntVector.h"
+#include "Epetra_Map.h"
+
 GDAMinimumRule::GDAMinimumRule(MeshPtr mesh, VarFactory varFactory, DofOrderingFactoryPtr dofOrderingFactory, MeshPartitionPolicyPtr partitionPolicy,
                                unsigned initialH1OrderTrial, unsigned testOrderEnhancement)
 : GlobalDofAssignment(mesh,varFactory,dofOrderingFactory,partitionPolicy, initialH1OrderTrial, testOrderEnhancement, false)
 {
-
+  _cellOrderingForDofs = CELL_ID_ORDERING;
+  _cellCachesAreCurrent = false;
 }
 
 vector<unsigned> GDAMinimumRule::allBasisDofOrdinalsVector(int basisCardinality) {
@@ -74,6 +84,8 @@ void GDAMinimumRule::didHRefine(const set<GlobalIndexType> &parentCellIDs) {
   for (set<GlobalIndexType>::iterator cellIDIt = neighborsOfNewElements.begin(); cellIDIt != neighborsOfNewElements.end(); cellIDIt++) {
     assignParities(*cellIDIt);
   }
+  
+  invalidateCellCachesNear(parentCellIDs);
 //  for (set<GlobalIndexType>::const_iterator cellIDIt = parentCellIDs.begin(); cellIDIt != parentCellIDs.end(); cellIDIt++) {
 //    GlobalIndexType parentCellID = *cellIDIt;
 //    ElementTypePtr elemType = elementType(parentCellID);
@@ -121,11 +133,13 @@ void GDAMinimumRule::didPRefine(const set<GlobalIndexType> &cellIDs, int deltaP)
       (*solutionIt)->projectOldCellOntoNewCells(*cellIDIt,oldType,childIDs);
     }
   }
+  invalidateCellCachesNear(cellIDs);
 //  rebuildLookups();
 }
 
 void GDAMinimumRule::didHUnrefine(const set<GlobalIndexType> &parentCellIDs) {
   this->GlobalDofAssignment::didHUnrefine(parentCellIDs);
+  _cellCachesAreCurrent = false; // no local invalidation for unrefinements; rebuildLookups() will start over
   // TODO: implement this
   cout << "WARNING: GDAMinimumRule::didHUnrefine() unimplemented.\n";
   // will need to treat cell side parities here--probably suffices to redo those in parentCellIDs plus all their neighbors.
@@ -235,8 +249,7 @@ GlobalIndexType GDAMinimumRule::globalDofCount() {
 set<GlobalIndexType> GDAMinimumRule::globalDofIndicesForCell(GlobalIndexType cellID) {
   set<GlobalIndexType> globalDofIndices;
   
-  CellConstraints constraints = getCellConstraints(cellID);
-  LocalDofMapperPtr dofMapper = getDofMapper(cellID, constraints);
+  LocalDofMapperPtr dofMapper = dofMapperForCell(cellID);
   vector<GlobalIndexType> globalIndexVector = dofMapper->globalIndices();
   
   globalDofIndices.insert(globalIndexVector.begin(),globalIndexVector.end());
@@ -340,8 +353,7 @@ int GDAMinimumRule::H1Order(GlobalIndexType cellID, unsigned sideOrdinal) {
 }
 
 void GDAMinimumRule::interpretGlobalCoefficients(GlobalIndexType cellID, FieldContainer<double> &localCoefficients, const Epetra_MultiVector &globalCoefficients) {
-  CellConstraints constraints = getCellConstraints(cellID);
-  LocalDofMapperPtr dofMapper = getDofMapper(cellID, constraints);
+  LocalDofMapperPtr dofMapper = dofMapperForCell(cellID);
   vector<GlobalIndexType> globalIndexVector = dofMapper->globalIndices();
   
   // DEBUGGING
@@ -387,8 +399,7 @@ void GDAMinimumRule::interpretGlobalCoefficients(GlobalIndexType cellID, FieldCo
 
 void GDAMinimumRule::interpretLocalData(GlobalIndexType cellID, const FieldContainer<double> &localData,
                                         FieldContainer<double> &globalData, FieldContainer<GlobalIndexType> &globalDofIndices) {
-  CellConstraints constraints = getCellConstraints(cellID);
-  LocalDofMapperPtr dofMapper = getDofMapper(cellID, constraints);
+  LocalDofMapperPtr dofMapper = dofMapperForCell(cellID);
   
   // DEBUGGING
 //  if (Teuchos::GlobalMPISession::getRank()==0) {
@@ -919,7 +930,7 @@ BasisMap GDAMinimumRule::getBasisMapOld(GlobalIndexType cellID, SubCellDofIndexI
   // assumption is that the basis is defined on the side
   BasisPtr basis = trialOrdering->getBasis(var->ID(), sideOrdinal);
   
-  typedef pair<AnnotatedEntity, SubBasisReconciliationWeights > AppliedWeightPair;
+  typedef pair<AnnotatedEntity, int > AppliedWeightPair; // second: index into _constraintWeights for the weights applied thus far
   typedef pair< unsigned, unsigned > SubcellForDofIndexInfo; // first: subcdim, second: subcordInCell
   typedef vector< AppliedWeightPair > AppliedWeightVector;
   
@@ -931,18 +942,23 @@ BasisMap GDAMinimumRule::getBasisMapOld(GlobalIndexType cellID, SubCellDofIndexI
   defaultConstraint.subcellOrdinal = 0;
   defaultConstraint.dimension = sideDim;
 
-  SubBasisReconciliationWeights unitWeights;
-  unitWeights.weights.resize(basis->getCardinality(), basis->getCardinality());
-  set<int> allOrdinals;
-  for (int i=0; i<basis->getCardinality(); i++) {
-    allOrdinals.insert(i);
-    unitWeights.weights(i,i) = 1.0;
+  int basisCardinality = basis->getCardinality();
+  if (_unitConstraintWeightsID.find(basisCardinality) == _unitConstraintWeightsID.end()) {
+    SubBasisReconciliationWeights unitWeights;
+    unitWeights.weights.resize(basisCardinality, basisCardinality);
+    set<int> allOrdinals;
+    for (int i=0; i<basis->getCardinality(); i++) {
+      allOrdinals.insert(i);
+      unitWeights.weights(i,i) = 1.0;
+    }
+    unitWeights.fineOrdinals = allOrdinals;
+    unitWeights.coarseOrdinals = allOrdinals;
+    _unitConstraintWeightsID[basisCardinality] = _constraintWeights.size();
+    _constraintWeights.push_back(unitWeights);
   }
-  unitWeights.fineOrdinals = allOrdinals;
-  unitWeights.coarseOrdinals = allOrdinals;
 
   GlobalIndexType sideEntityIndex = cell->entityIndex(sideDim, sideOrdinal);
-  appliedWeights[sideDim][sideEntityIndex].push_back(make_pair(defaultConstraint, unitWeights));
+  appliedWeights[sideDim][sideEntityIndex].push_back(make_pair(defaultConstraint, _unitConstraintWeightsID[basisCardinality]));
   
   int minimumConstraintDimension = BasisReconciliation::minimumSubcellDimension(basis);
   
@@ -962,7 +978,7 @@ BasisMap GDAMinimumRule::getBasisMapOld(GlobalIndexType cellID, SubCellDofIndexI
   {
     int d = appliedWeightsGreatestEntryDimension; // the dimension of the subcell being constrained.
     
-    map< GlobalIndexType, vector< pair<AnnotatedEntity, SubBasisReconciliationWeights > > > appliedWeightsForDimension = appliedWeights[d];
+    map< GlobalIndexType, AppliedWeightVector > appliedWeightsForDimension = appliedWeights[d];
     
     // clear these out from the main container:
     appliedWeights[d].clear();
@@ -979,7 +995,7 @@ BasisMap GDAMinimumRule::getBasisMapOld(GlobalIndexType cellID, SubCellDofIndexI
         AppliedWeightPair appliedWeightsForSubcell = *appliedWeightPairIt;
         
         AnnotatedEntity subcellInfo = appliedWeightsForSubcell.first;
-        SubBasisReconciliationWeights prevWeights = appliedWeightsForSubcell.second;
+        int prevWeightsID = appliedWeightsForSubcell.second;
         
         if (subcellInfo.dimension != d) {
           cout << "INTERNAL ERROR: subcellInfo.dimension should be d!\n";
@@ -1057,8 +1073,6 @@ BasisMap GDAMinimumRule::getBasisMapOld(GlobalIndexType cellID, SubCellDofIndexI
         
         CellTopoPtr constrainingTopo = constrainingCell->topology()->getSubcell(subcellConstraint.dimension, subcellOrdinalInConstrainingCell);
         
-        SubBasisReconciliationWeights composedWeights;
-        
         CellPtr ancestralCell = appliedConstraintCell->ancestralCellForSubcell(d, subcordInAppliedConstraintCell);
         
         RefinementBranch volumeRefinements = appliedConstraintCell->refinementBranchForSubcell(d, subcordInAppliedConstraintCell);
@@ -1136,6 +1150,8 @@ BasisMap GDAMinimumRule::getBasisMapOld(GlobalIndexType cellID, SubCellDofIndexI
           TEUCHOS_TEST_FOR_EXCEPTION(true, std::invalid_argument, "Error: ancestralSideOrdinal not found.");
         }
         
+        unsigned composedPermutation;
+        RefinementBranch constraintRefinements; // volume refinements for unlike-dimensional constraints, side refinements for like-dimensional
         if (subcellConstraint.dimension != d) {
           // OLD (pre-8/9/14) code; computes *side* permutations (which is clearly wrong; the two sides could have different topologies)
 //          unsigned ancestralPermutation = ancestralCell->sideSubcellPermutation(ancestralSideOrdinal, sideDim, 0);// side permutation as seen from the perspective of the fine cell's side's ancestor
@@ -1151,35 +1167,10 @@ BasisMap GDAMinimumRule::getBasisMapOld(GlobalIndexType cellID, SubCellDofIndexI
           
           unsigned constrainingPermutationInverse = CamelliaCellTools::permutationInverse(constrainingTopo, constrainingPermutation);
           
-          unsigned composedPermutation = CamelliaCellTools::permutationComposition(constrainingTopo, constrainingPermutationInverse, ancestralPermutation);
-          
-          SubBasisReconciliationWeights newWeightsToApply = BasisReconciliation::computeConstrainedWeights(d, appliedConstraintBasis, subcellInfo.subcellOrdinal,
-                                                                                                           volumeRefinements, subcellInfo.sideOrdinal, subcellConstraint.dimension,
-                                                                                                           constrainingBasis, subcellConstraint.subcellOrdinal,
-                                                                                                           ancestralSideOrdinal, composedPermutation);
-          
-          composedWeights = BasisReconciliation::composedSubBasisReconciliationWeights(prevWeights, newWeightsToApply);
-          
-// DEBUGGING
-          if ((cellID==DEBUG_CELL_ID) && (sideOrdinal==DEBUG_SIDE_ORDINAL) && (var->ID()==DEBUG_VAR_ID)) {
-            cout << "prevWeights:\n";
-            Camellia::print("prevWeights fine ordinals", prevWeights.fineOrdinals);
-            Camellia::print("prevWeights coarse ordinals", prevWeights.coarseOrdinals);
-            cout << "prevWeights weights:\n" << prevWeights.weights;
-            
-            cout << "newWeightsToApply:\n";
-            Camellia::print("newWeightsToApply fine ordinals", newWeightsToApply.fineOrdinals);
-            Camellia::print("newWeightsToApply coarse ordinals", newWeightsToApply.coarseOrdinals);
-            cout << "newWeightsToApply weights:\n" << newWeightsToApply.weights;
-            
-            cout << "composedWeights:\n";
-            Camellia::print("composedWeights fine ordinals", composedWeights.fineOrdinals);
-            Camellia::print("composedWeights coarse ordinals", composedWeights.coarseOrdinals);
-            cout << "composedWeights weights:\n" << composedWeights.weights;
-          }
-          
+          composedPermutation = CamelliaCellTools::permutationComposition(constrainingTopo, constrainingPermutationInverse, ancestralPermutation);
+          constraintRefinements = volumeRefinements;
         } else {
-          RefinementBranch sideRefinements = RefinementPattern::subcellRefinementBranch(volumeRefinements, sideDim, ancestralSideOrdinal);
+          constraintRefinements = RefinementPattern::subcellRefinementBranch(volumeRefinements, sideDim, ancestralSideOrdinal);
           
           IndexType constrainingEntityIndex = constrainingCell->entityIndex(subcellConstraint.dimension, subcellOrdinalInConstrainingCell);
           
@@ -1192,32 +1183,68 @@ BasisMap GDAMinimumRule::getBasisMapOld(GlobalIndexType cellID, SubCellDofIndexI
           
           unsigned constrainingPermutationInverse = CamelliaCellTools::permutationInverse(constrainingTopo, constrainingPermutation);
           
-          unsigned composedPermutation = CamelliaCellTools::permutationComposition(constrainingTopo, constrainingPermutationInverse, ancestralPermutation);
-          
-          SubBasisReconciliationWeights newWeightsToApply = _br.constrainedWeights(d, appliedConstraintBasis, subcellInfo.subcellOrdinal, sideRefinements,
-                                                                                   constrainingBasis, subcellConstraint.subcellOrdinal, composedPermutation);
+          composedPermutation = CamelliaCellTools::permutationComposition(constrainingTopo, constrainingPermutationInverse, ancestralPermutation);
+        }
+        
+        // everything from here until we need global dof ordinals depends only on the local constraint configuration, which we use as a key
+        ConstraintStepKey stepKey;
+        stepKey.prevWeightsID = prevWeightsID;
+        stepKey.appliedBasis = appliedConstraintBasis.get();
+        stepKey.appliedDimension = d;
+        stepKey.appliedSubcellOrdinal = subcellInfo.subcellOrdinal;
+        stepKey.appliedSideOrdinal = subcellInfo.sideOrdinal;
+        stepKey.refinements = constraintRefinements;
+        stepKey.ancestralSideOrdinal = ancestralSideOrdinal;
+        stepKey.constrainingBasis = constrainingBasis.get();
+        stepKey.constrainingCellTopoKey = constrainingCell->topology()->getKey();
+        stepKey.constrainingDimension = subcellConstraint.dimension;
+        stepKey.constrainingSideOrdinal = subcellConstraint.sideOrdinal;
+        stepKey.constrainingSubcellOrdinal = subcellConstraint.subcellOrdinal;
+        stepKey.composedPermutation = composedPermutation;
+        stepKey.minimumConstraintDimension = minimumConstraintDimension;
+        
+        if (_constraintSteps.find(stepKey) == _constraintSteps.end()) {
+          SubBasisReconciliationWeights prevWeights = _constraintWeights[prevWeightsID]; // copy: _constraintWeights may grow below
+          SubBasisReconciliationWeights newWeightsToApply;
+          if (subcellConstraint.dimension != d) {
+            newWeightsToApply = BasisReconciliation::computeConstrainedWeights(d, appliedConstraintBasis, subcellInfo.subcellOrdinal,
+                                                                               volumeRefinements, subcellInfo.sideOrdinal, subcellConstraint.dimension,
+                                                                               constrainingBasis, subcellConstraint.subcellOrdinal,
+                                                                               ancestralSideOrdinal, composedPermutation);
+          } else {
+            newWeightsToApply = _br.constrainedWeights(d, appliedConstraintBasis, subcellInfo.subcellOrdinal, constraintRefinements,
+                                                       constrainingBasis, subcellConstraint.subcellOrdinal, composedPermutation);
+          }
           
           // compose the new weights with existing weights for this subcell
-          composedWeights = BasisReconciliation::composedSubBasisReconciliationWeights(prevWeights, newWeightsToApply);
+          SubBasisReconciliationWeights composedWeights = BasisReconciliation::composedSubBasisReconciliationWeights(prevWeights, newWeightsToApply);
           
-          // DEBUGGING
-          if ((cellID==DEBUG_CELL_ID) && (sideOrdinal==DEBUG_SIDE_ORDINAL) && (var->ID()==DEBUG_VAR_ID)) {
-            cout << "prevWeights:\n";
-            Camellia::print("prevWeights fine ordinals", prevWeights.fineOrdinals);
-            Camellia::print("prevWeights coarse ordinals", prevWeights.coarseOrdinals);
-            cout << "prevWeights weights:\n" << prevWeights.weights;
-            
-            cout << "newWeightsToApply:\n";
-            Camellia::print("newWeightsToApply fine ordinals", newWeightsToApply.fineOrdinals);
-            Camellia::print("newWeightsToApply coarse ordinals", newWeightsToApply.coarseOrdinals);
-            cout << "newWeightsToApply weights:\n" << newWeightsToApply.weights;
-            
-            cout << "composedWeights:\n";
-            Camellia::print("composedWeights fine ordinals", composedWeights.fineOrdinals);
-            Camellia::print("composedWeights coarse ordinals", composedWeights.coarseOrdinals);
-            cout << "composedWeights weights:\n" << composedWeights.weights;
+          ConstraintStep step;
+          // weights for the (d-1)-dimensional constituents of the constraining subcell, in the constraining subcell's ordering
+          if (subcellConstraint.dimension >= minimumConstraintDimension + 1) {
+            int d1 = subcellConstraint.dimension-1;
+            unsigned sscCount = constrainingTopo->getSubcellCount(d1);
+            CellTopoPtr constrainingCellTopo = constrainingCell->topology();
+            for (unsigned ssubcord=0; ssubcord<sscCount; ssubcord++) {
+              unsigned ssubcordInCell = CamelliaCellTools::subcellOrdinalMap(constrainingCellTopo, subcellConstraint.dimension, subcellOrdinalInConstrainingCell, d1, ssubcord);
+              unsigned ssubcordInSide = CamelliaCellTools::subcellReverseOrdinalMap(constrainingCellTopo, sideDim, subcellConstraint.sideOrdinal, d1, ssubcordInCell);
+              SubBasisReconciliationWeights composedWeightsForSubSubcell = BasisReconciliation::weightsForCoarseSubcell(composedWeights, constrainingBasis, d1,
+                                                                                                                        ssubcordInSide, true);
+              if (composedWeightsForSubSubcell.weights.size() > 0) {
+                step.subSubcellWeightsIDs.push_back(_constraintWeights.size());
+                _constraintWeights.push_back(composedWeightsForSubSubcell);
+              } else {
+                step.subSubcellWeightsIDs.push_back(-1);
+              }
+            }
           }
+          
+          // filter the weights whose coarse dofs are interior to this subcell
+          step.interiorWeights = BasisReconciliation::weightsForCoarseSubcell(composedWeights, constrainingBasis, subcellConstraint.dimension,
+                                                                              subcellConstraint.subcellOrdinal, false);
+          _constraintSteps[stepKey] = step;
         }
+        const ConstraintStep &constraintStep = _constraintSteps[stepKey];
         
         // populate the containers for the (d-1)-dimensional constituents of the constraining subcell
         if (subcellConstraint.dimension >= minimumConstraintDimension + 1) {
@@ -1225,45 +1252,26 @@ BasisMap GDAMinimumRule::getBasisMapOld(GlobalIndexType cellID, SubCellDofIndexI
           unsigned sscCount = constrainingTopo->getSubcellCount(d1);
           CellTopoPtr constrainingCellTopo = constrainingCell->topology();
           for (unsigned ssubcord=0; ssubcord<sscCount; ssubcord++) {
+            int subSubcellWeightsID = constraintStep.subSubcellWeightsIDs[ssubcord];
+            if (subSubcellWeightsID == -1) continue;
+            
             unsigned ssubcordInCell = CamelliaCellTools::subcellOrdinalMap(constrainingCellTopo, subcellConstraint.dimension, subcellOrdinalInConstrainingCell, d1, ssubcord);
             IndexType ssEntityIndex = constrainingCell->entityIndex(d1, ssubcordInCell);
-            // DEBUGGING:
-//            if ((d1==0) && (ssEntityIndex==12)) {
-//              cout << "Adding vertex 12 to the list.\n";
-//            }
             
             AnnotatedEntity subsubcellConstraint;
             subsubcellConstraint.cellID = subcellConstraint.cellID;
             subsubcellConstraint.sideOrdinal = subcellConstraint.sideOrdinal;
             subsubcellConstraint.dimension = d1;
-            
-            CellPtr constrainingCell = _meshTopology->getCell(subcellConstraint.cellID);
             subsubcellConstraint.subcellOrdinal = CamelliaCellTools::subcellReverseOrdinalMap(constrainingCellTopo, sideDim, subsubcellConstraint.sideOrdinal,
                                                                                               d1, ssubcordInCell);
             
-            //          if ((cellID==21) && (sideOrdinal==2) && (d1==0) && (subcellConstraint.cellID==6) && ((ssubcordInCell==3) || (ssubcordInCell==0))) {
-            //            cout << "About to compute composed weights for sub subcell.\n";
-            //          }
-            
-            SubBasisReconciliationWeights composedWeightsForSubSubcell = BasisReconciliation::weightsForCoarseSubcell(composedWeights, constrainingBasis, d1,
-                                                                                                                      subsubcellConstraint.subcellOrdinal, true);
-            // DEBUGGING
-            if ((cellID==DEBUG_CELL_ID) && (sideOrdinal==DEBUG_SIDE_ORDINAL) && (var->ID()==DEBUG_VAR_ID)) {
-              Camellia::print("composedWeightsForSubSubcell.coarseOrdinals", composedWeightsForSubSubcell.coarseOrdinals);
-              Camellia::print("composedWeightsForSubSubcell.fineOrdinals", composedWeightsForSubSubcell.fineOrdinals);
-              cout << "composed weights for subSubSubcell:\n" << composedWeightsForSubSubcell.weights;
-            }
-            
-            if (composedWeightsForSubSubcell.weights.size() > 0) {
-              appliedWeights[d1][ssEntityIndex].push_back(make_pair(subsubcellConstraint, composedWeightsForSubSubcell));
-            }
+            appliedWeights[d1][ssEntityIndex].push_back(make_pair(subsubcellConstraint, subSubcellWeightsID));
           }
         }
       
         // add sub-basis map for dofs interior to the constraining subcell
-        // filter the weights whose coarse dofs are interior to this subcell, and create a SubBasisDofMapper for these (add it to varSideMap)
-        SubBasisReconciliationWeights subcellInteriorWeights = BasisReconciliation::weightsForCoarseSubcell(composedWeights, constrainingBasis, subcellConstraint.dimension,
-                                                                                                            subcellConstraint.subcellOrdinal, false);
+        // create a SubBasisDofMapper for the interior weights (add it to varSideMap); only the global dof ordinals are specific to this cell
+        const SubBasisReconciliationWeights &subcellInteriorWeights = constraintStep.interiorWeights;
         
         if ((subcellInteriorWeights.coarseOrdinals.size() > 0) && (subcellInteriorWeights.fineOrdinals.size() > 0)) {
           CellConstraints constrainingCellConstraints = getCellConstraints(subcellConstraint.cellID);
@@ -1472,7 +1480,7 @@ BasisMap GDAMinimumRule::getBasisMapOld(GlobalIndexType cellID, SubCellDofIndexI
 
 CellConstraints GDAMinimumRule::getCellConstraints(GlobalIndexType cellID) {
   
-  if (_constraintsCache.find(cellID) == _constraintsCache.end()) {
+  if (!cellCache(cellID).hasConstraints) {
   
 //    cout << "Getting cell constraints for cellID " << cellID << endl;
     
@@ -1605,14 +1613,17 @@ CellConstraints GDAMinimumRule::getCellConstraints(GlobalIndexType cellID) {
     cellConstraints.owningCellIDForSubcell[spaceDim][0].owningSubcellEntityIndex = cellID;
     cellConstraints.owningCellIDForSubcell[spaceDim][0].dimension = spaceDim;
     
-    _constraintsCache[cellID] = cellConstraints;
+    // (fetch the entry again: computing the constraints may have added entries for other cells)
+    CellCacheEntry &cacheEntry = cellCache(cellID);
+    cacheEntry.constraints = cellConstraints;
+    cacheEntry.hasConstraints = true;
     
 //    if (cellID==4) { // DEBUGGING
 //      printConstraintInfo(cellID);
 //    }
   }
   
-  return _constraintsCache[cellID];
+  return cellCache(cellID).constraints;
 }
 
 typedef map<int, vector<GlobalIndexType> > VarIDToDofIndices; // key: varID
@@ -1690,9 +1701,30 @@ set<GlobalIndexType> GDAMinimumRule::getFittableGlobalDofIndices(GlobalIndexType
 SubCellDofIndexInfo GDAMinimumRule::getOwnedGlobalDofIndices(GlobalIndexType cellID, CellConstraints &constraints) {
   // there's a lot of redundancy between this method and the dof-counting bit of rebuild lookups.  May be worth factoring that out.
   
-  if (_ownedGlobalDofIndicesCache.find(cellID) != _ownedGlobalDofIndicesCache.end()) {
-    return _ownedGlobalDofIndicesCache[cellID];
+  // the cache stores dof indices relative to the cell's first global dof index, so that entries remain valid when offsets shift
+  GlobalIndexType cellDofOffset = globalCellDofOffset(cellID); // this cell's first globalDofIndex
+  
+  if (!cellCache(cellID).hasOwnedDofIndices) {
+    SubCellDofIndexInfo relativeDofIndices = getOwnedCellRelativeDofIndices(cellID, constraints);
+    CellCacheEntry &cacheEntry = cellCache(cellID);
+    cacheEntry.ownedDofIndices = relativeDofIndices;
+    cacheEntry.hasOwnedDofIndices = true;
+  }
+  
+  SubCellDofIndexInfo scInfo = cellCache(cellID).ownedDofIndices;
+  for (int d=0; d<scInfo.size(); d++) {
+    for (SubCellOrdinalToMap::iterator scordIt = scInfo[d].begin(); scordIt != scInfo[d].end(); scordIt++) {
+      for (VarIDToDofIndices::iterator varIt = scordIt->second.begin(); varIt != scordIt->second.end(); varIt++) {
+        for (int i=0; i<varIt->second.size(); i++) {
+          varIt->second[i] += cellDofOffset;
+        }
+      }
+    }
   }
+  return scInfo;
+}
+
+SubCellDofIndexInfo GDAMinimumRule::getOwnedCellRelativeDofIndices(GlobalIndexType cellID, CellConstraints &constraints) {
   
   int spaceDim = _meshTopology->getSpaceDim();
   int sideDim = spaceDim - 1;
@@ -1708,7 +1740,7 @@ SubCellDofIndexInfo GDAMinimumRule::getOwnedGlobalDofIndices(GlobalIndexType cel
   
 //  cout << "Owned global dof indices for cell " << cellID << endl;
   
-  GlobalIndexType globalDofIndex = _globalCellDofOffsets[cellID]; // this cell's first globalDofIndex
+  GlobalIndexType globalDofIndex = 0; // relative to this cell's first globalDofIndex
 
   for (map<int, VarPtr>::iterator varIt = trialVars.begin(); varIt != trialVars.end(); varIt++) {
     map< pair<unsigned,IndexType>, pair<unsigned, unsigned> > entitiesClaimedForVariable; // maps from the constraining entity claimed to the (d, scord) entry that claimed it.
@@ -1779,7 +1811,6 @@ SubCellDofIndexInfo GDAMinimumRule::getOwnedGlobalDofIndices(GlobalIndexType cel
       }
     }
   }
-  _ownedGlobalDofIndicesCache[cellID] = scInfo;
   return scInfo;
 }
 
@@ -1874,18 +1905,17 @@ set<GlobalIndexType> GDAMinimumRule::getGlobalDofIndicesForIntegralContribution(
 LocalDofMapperPtr GDAMinimumRule::getDofMapper(GlobalIndexType cellID, CellConstraints &constraints, int varIDToMap, int sideOrdinalToMap) {
   if ((varIDToMap == -1) && (sideOrdinalToMap == -1)) {
     // a mapper for the whole dof ordering: we cache these separately...
-    if (_dofMapperCache.find(cellID) != _dofMapperCache.end()) {
-      return _dofMapperCache[cellID];
+    LocalDofMapperPtr cachedDofMapper = cellCache(cellID).dofMapper;
+    if (cachedDofMapper != Teuchos::null) {
+      return cachedDofMapper;
     }
   } else {
-    map< GlobalIndexType, map<int, map<int, LocalDofMapperPtr> > >::iterator cellMapEntry = _dofMapperForVariableOnSideCache.find(cellID);
-    if (cellMapEntry != _dofMapperForVariableOnSideCache.end()) {
-      map<int, map<int, LocalDofMapperPtr> >::iterator sideMapEntry = cellMapEntry->second.find(sideOrdinalToMap);
-      if (sideMapEntry != cellMapEntry->second.end()) {
-        map<int, LocalDofMapperPtr>::iterator varMapEntry = sideMapEntry->second.find(varIDToMap);
-        if (varMapEntry != sideMapEntry->second.end()) {
-          return varMapEntry->second;
-        }
+    map<int, map<int, LocalDofMapperPtr> > *cellMapEntry = &cellCache(cellID).dofMapperForVariableOnSide;
+    map<int, map<int, LocalDofMapperPtr> >::iterator sideMapEntry = cellMapEntry->find(sideOrdinalToMap);
+    if (sideMapEntry != cellMapEntry->end()) {
+      map<int, LocalDofMapperPtr>::iterator varMapEntry = sideMapEntry->second.find(varIDToMap);
+      if (varMapEntry != sideMapEntry->second.end()) {
+        return varMapEntry->second;
       }
     }
   }
@@ -1950,14 +1980,22 @@ LocalDofMapperPtr GDAMinimumRule::getDofMapper(GlobalIndexType cellID, CellConst
                                                                  sideMaps,fittableGlobalDofOrdinalsOnSides,emptyGlobalIDSet,varIDToMap,sideOrdinalToMap) );
   if ((varIDToMap == -1) && (sideOrdinalToMap == -1)) {
     // a mapper for the whole dof ordering: we cache these...
-    _dofMapperCache[cellID] = dofMapper;
-    return _dofMapperCache[cellID];
+    cellCache(cellID).dofMapper = dofMapper;
+    return dofMapper;
   } else {
-    _dofMapperForVariableOnSideCache[cellID][sideOrdinalToMap][varIDToMap] = dofMapper;
+    cellCache(cellID).dofMapperForVariableOnSide[sideOrdinalToMap][varIDToMap] = dofMapper;
     return dofMapper;
   }
 }
 
+LocalDofMapperPtr GDAMinimumRule::dofMapperForCell(GlobalIndexType cellID) {
+  LocalDofMapperPtr cachedDofMapper = cellCache(cellID).dofMapper;
+  if (cachedDofMapper != Teuchos::null) return cachedDofMapper;
+  
+  CellConstraints constraints = getCellConstraints(cellID);
+  return getDofMapper(cellID, constraints);
+}
+
 PartitionIndexType GDAMinimumRule::partitionForGlobalDofIndex( GlobalIndexType globalDofIndex ) {
   PartitionIndexType numRanks = _partitionDofCounts.size();
   GlobalIndexType totalDofCount = 0;
@@ -2006,24 +2044,375 @@ void GDAMinimumRule::printGlobalDofInfo() {
   }
 }
 
+// Skilling's algorithm ("Programming the Hilbert curve," AIP Conf. Proc. 707, 2004): converts integer coordinates (each with
+// bitsPerCoordinate bits) into the "transposed" Hilbert index, which is then interleaved into a single key.
+static unsigned long long hilbertKey(vector<unsigned> coords, int bitsPerCoordinate) {
+  int n = coords.size();
+  unsigned M = 1U << (bitsPerCoordinate-1);
+  for (unsigned Q = M; Q > 1; Q >>= 1) { // inverse undo
+    unsigned P = Q - 1;
+    for (int i=0; i<n; i++) {
+      if (coords[i] & Q) {
+        coords[0] ^= P;
+      } else {
+        unsigned t = (coords[0] ^ coords[i]) & P;
+        coords[0] ^= t;
+        coords[i] ^= t;
+      }
+    }
+  }
+  for (int i=1; i<n; i++) { // Gray encode
+    coords[i] ^= coords[i-1];
+  }
+  unsigned t = 0;
+  for (unsigned Q = M; Q > 1; Q >>= 1) {
+    if (coords[n-1] & Q) t ^= Q - 1;
+  }
+  for (int i=0; i<n; i++) {
+    coords[i] ^= t;
+  }
+  unsigned long long key = 0;
+  for (int bit=bitsPerCoordinate-1; bit>=0; bit--) {
+    for (int i=0; i<n; i++) {
+      key = (key << 1) | ((coords[i] >> bit) & 1);
+    }
+  }
+  return key;
+}
+
+void GDAMinimumRule::CellCacheEntry::swap(CellCacheEntry &other) {
+  std::swap(hasConstraints, other.hasConstraints);
+  constraints.subcellConstraints.swap(other.constraints.subcellConstraints);
+  constraints.owningCellIDForSubcell.swap(other.constraints.owningCellIDForSubcell);
+  std::swap(hasOwnedDofIndices, other.hasOwnedDofIndices);
+  ownedDofIndices.swap(other.ownedDofIndices);
+  std::swap(dofMapper, other.dofMapper);
+  dofMapperForVariableOnSide.swap(other.dofMapperForVariableOnSide);
+}
+
+bool GDAMinimumRule::ConstraintStepKey::operator<(const ConstraintStepKey &other) const {
+  if (prevWeightsID != other.prevWeightsID) return prevWeightsID < other.prevWeightsID;
+  if (appliedBasis != other.appliedBasis) return appliedBasis < other.appliedBasis;
+  if (appliedDimension != other.appliedDimension) return appliedDimension < other.appliedDimension;
+  if (appliedSubcellOrdinal != other.appliedSubcellOrdinal) return appliedSubcellOrdinal < other.appliedSubcellOrdinal;
+  if (appliedSideOrdinal != other.appliedSideOrdinal) return appliedSideOrdinal < other.appliedSideOrdinal;
+  if (ancestralSideOrdinal != other.ancestralSideOrdinal) return ancestralSideOrdinal < other.ancestralSideOrdinal;
+  if (constrainingBasis != other.constrainingBasis) return constrainingBasis < other.constrainingBasis;
+  if (constrainingCellTopoKey != other.constrainingCellTopoKey) return constrainingCellTopoKey < other.constrainingCellTopoKey;
+  if (constrainingDimension != other.constrainingDimension) return constrainingDimension < other.constrainingDimension;
+  if (constrainingSideOrdinal != other.constrainingSideOrdinal) return constrainingSideOrdinal < other.constrainingSideOrdinal;
+  if (constrainingSubcellOrdinal != other.constrainingSubcellOrdinal) return constrainingSubcellOrdinal < other.constrainingSubcellOrdinal;
+  if (composedPermutation != other.composedPermutation) return composedPermutation < other.composedPermutation;
+  if (minimumConstraintDimension != other.minimumConstraintDimension) return minimumConstraintDimension < other.minimumConstraintDimension;
+  return refinements < other.refinements; // compare the branch last; it is the most expensive comparison
+}
+
+int GDAMinimumRule::ownedCellOrdinal(GlobalIndexType cellID) {
+  // cells created since the last rebuild lie beyond the end of _ownedCellOrdinals; none of them is owned yet
+  if (cellID >= _ownedCellOrdinals.size()) return -1;
+  return _ownedCellOrdinals[cellID];
+}
+
+GDAMinimumRule::CellCacheEntry & GDAMinimumRule::cellCache(GlobalIndexType cellID) {
+  int ownedOrdinal = ownedCellOrdinal(cellID);
+  if (ownedOrdinal != -1) return _ownedCellCaches[ownedOrdinal];
+  return _ghostCellCaches[cellID];
+}
+
+GlobalIndexType GDAMinimumRule::globalCellDofOffset(GlobalIndexType cellID) {
+  int ownedOrdinal = ownedCellOrdinal(cellID);
+  if (ownedOrdinal != -1) return _partitionDofOffset + _ownedCellDofOffsets[ownedOrdinal];
+  
+  map<GlobalIndexType, GlobalIndexType>::iterator offsetEntry = _globalCellDofOffsets.find(cellID);
+  if (offsetEntry == _globalCellDofOffsets.end()) {
+    // inactive (constraining) cells own no dofs apart from their interiors, which are never referenced; any offset will do
+    if (_meshTopology->getCell(cellID)->isParent()) return 0;
+    // rebuildLookups() fetches offsets only for cells near our own; others must be requested with importCellDofOffsets()
+    cout << "GDAMinimumRule: global dof offset not found for cell " << cellID << "; was importCellDofOffsets() called for it?" << endl;
+    TEUCHOS_TEST_FOR_EXCEPTION(true, std::invalid_argument, "global dof offset not found for cell");
+  }
+  return offsetEntry->second;
+}
+
+void GDAMinimumRule::importCellDofOffsets(const set<GlobalIndexType> &cellIDs) {
+  set<IndexType> cellsToVisit(cellIDs.begin(), cellIDs.end());
+  importDofOffsetsForCells(cellsOwningDofsFor(cellsToVisit));
+}
+
+set<GlobalIndexType> GDAMinimumRule::cellsOwningDofsFor(const set<IndexType> &cellsToVisit) {
+  // the cells themselves, the owners of their subcells, and the owners of subcells of the (possibly coarser) cells that constrain them
+  set<GlobalIndexType> constrainingCellIDs;
+  set<GlobalIndexType> neededCellIDs;
+  for (set<IndexType>::const_iterator cellIDIt = cellsToVisit.begin(); cellIDIt != cellsToVisit.end(); cellIDIt++) {
+    neededCellIDs.insert(*cellIDIt);
+    CellConstraints constraints = getCellConstraints(*cellIDIt);
+    for (int d=0; d<constraints.owningCellIDForSubcell.size(); d++) {
+      for (int scord=0; scord<constraints.owningCellIDForSubcell[d].size(); scord++) {
+        neededCellIDs.insert(constraints.owningCellIDForSubcell[d][scord].cellID);
+        constrainingCellIDs.insert(constraints.subcellConstraints[d][scord].cellID);
+      }
+    }
+  }
+  for (set<GlobalIndexType>::iterator cellIDIt = constrainingCellIDs.begin(); cellIDIt != constrainingCellIDs.end(); cellIDIt++) {
+    if (*cellIDIt == (GlobalIndexType)-1) continue; // unset entry
+    if (cellsToVisit.find(*cellIDIt) != cellsToVisit.end()) continue;
+    CellConstraints constraints = getCellConstraints(*cellIDIt);
+    for (int d=0; d<constraints.owningCellIDForSubcell.size(); d++) {
+      for (int scord=0; scord<constraints.owningCellIDForSubcell[d].size(); scord++) {
+        neededCellIDs.insert(constraints.owningCellIDForSubcell[d][scord].cellID);
+      }
+    }
+  }
+  neededCellIDs.erase((GlobalIndexType)-1); // unset entry
+  return neededCellIDs;
+}
+
+void GDAMinimumRule::importDofOffsetsForCells(const set<GlobalIndexType> &cellIDs) {
+  vector<GlobalIndexTypeToCast> nonOwnedCellIDs;
+  for (set<GlobalIndexType>::const_iterator cellIDIt = cellIDs.begin(); cellIDIt != cellIDs.end(); cellIDIt++) {
+    if (ownedCellOrdinal(*cellIDIt) != -1) continue;
+    if (_globalCellDofOffsets.find(*cellIDIt) != _globalCellDofOffsets.end()) continue; // already have it
+    if (_meshTopology->getCell(*cellIDIt)->isParent()) continue; // inactive cells own no dofs that get referenced
+    nonOwnedCellIDs.push_back(*cellIDIt);
+  }
+  
+  // Each rank contributes the offsets for its own cells; the import communicates only with the ranks owning the cells we need.
+  // (This replaces an all-reduce over an array with one entry per active cell in the mesh.)
+#ifdef HAVE_MPI
+  Epetra_MpiComm Comm(MPI_COMM_WORLD);
+#else
+  Epetra_SerialComm Comm;
+#endif
+  vector<GlobalIndexTypeToCast> ownedCellIDs(_ownedCellIDs.begin(), _ownedCellIDs.end());
+  int numOwned = ownedCellIDs.size(), numNonOwned = nonOwnedCellIDs.size();
+  Epetra_Map ownedCellMap(-1, numOwned, (numOwned > 0) ? &ownedCellIDs[0] : NULL, 0, Comm);
+  Epetra_Map nonOwnedCellMap(-1, numNonOwned, (numNonOwned > 0) ? &nonOwnedCellIDs[0] : NULL, 0, Comm);
+  
+  Epetra_IntVector ownedCellOffsets(ownedCellMap);
+  for (int ownedOrdinal=0; ownedOrdinal<numOwned; ownedOrdinal++) {
+    ownedCellOffsets[ownedOrdinal] = _partitionDofOffset + _ownedCellDofOffsets[ownedOrdinal];
+  }
+  Epetra_Import offsetImporter(nonOwnedCellMap, ownedCellMap);
+  Epetra_IntVector nonOwnedCellOffsets(nonOwnedCellMap);
+  int err = nonOwnedCellOffsets.Import(ownedCellOffsets, offsetImporter, Insert);
+  if (err != 0) {
+    cout << "GDAMinimumRule: import of cell dof offsets failed with error code " << err << endl;
+    TEUCHOS_TEST_FOR_EXCEPTION(true, std::invalid_argument, "import of cell dof offsets failed");
+  }
+  
+  for (int i=0; i<numNonOwned; i++) {
+    _globalCellDofOffsets[nonOwnedCellIDs[i]] = nonOwnedCellOffsets[i];
+  }
+}
+
+void GDAMinimumRule::importNonOwnedCellDofOffsets() {
+  // Determine the cells owned by other ranks whose owned dofs we may refer to in the course of assembly: those needed for our
+  // cells and the ghost cells around them.
+  set<IndexType> myCellIDs(_ownedCellIDs.begin(), _ownedCellIDs.end());
+  set<IndexType> cellsToVisit = _meshTopology->getGhostCellIndices(myCellIDs);
+  cellsToVisit.insert(myCellIDs.begin(), myCellIDs.end());
+  
+  _globalCellDofOffsets.clear();
+  importDofOffsetsForCells(cellsOwningDofsFor(cellsToVisit));
+}
+
+void GDAMinimumRule::reindexOwnedCellCaches(const vector<GlobalIndexType> &orderedOwnedCellIDs) {
+  vector<CellCacheEntry> ownedCellCaches(orderedOwnedCellIDs.size());
+  vector<int> ownedCellOrdinals(_meshTopology->cellCount(), -1);
+  for (int ownedOrdinal=0; ownedOrdinal<orderedOwnedCellIDs.size(); ownedOrdinal++) {
+    ownedCellOrdinals[orderedOwnedCellIDs[ownedOrdinal]] = ownedOrdinal;
+  }
+  
+  // carry over entries for cells we owned before: to the new position if we still own them, otherwise to the ghost map
+  for (int previousOrdinal=0; previousOrdinal<_ownedCellIDs.size(); previousOrdinal++) {
+    GlobalIndexType cellID = _ownedCellIDs[previousOrdinal];
+    int ownedOrdinal = (cellID < ownedCellOrdinals.size()) ? ownedCellOrdinals[cellID] : -1;
+    CellCacheEntry* previousEntry = &_ownedCellCaches[previousOrdinal];
+    if (ownedOrdinal != -1) {
+      ownedCellCaches[ownedOrdinal].swap(*previousEntry);
+    } else if (previousEntry->hasConstraints || previousEntry->hasOwnedDofIndices) {
+      _ghostCellCaches[cellID].swap(*previousEntry);
+    }
+  }
+  // and entries for cells that we have newly come to own (including the children of refined cells) move out of the ghost map
+  for (map<GlobalIndexType, CellCacheEntry>::iterator entryIt = _ghostCellCaches.begin(); entryIt != _ghostCellCaches.end();) {
+    GlobalIndexType cellID = entryIt->first;
+    int ownedOrdinal = (cellID < ownedCellOrdinals.size()) ? ownedCellOrdinals[cellID] : -1;
+    if (ownedOrdinal != -1) {
+      ownedCellCaches[ownedOrdinal].swap(entryIt->second);
+      _ghostCellCaches.erase(entryIt++);
+    } else {
+      // the dof mappers embed global dof indices, which shift whenever any partition's dof count changes
+      entryIt->second.dofMapper = Teuchos::null;
+      entryIt->second.dofMapperForVariableOnSide.clear();
+      entryIt++;
+    }
+  }
+  for (int ownedOrdinal=0; ownedOrdinal<ownedCellCaches.size(); ownedOrdinal++) {
+    ownedCellCaches[ownedOrdinal].dofMapper = Teuchos::null;
+    ownedCellCaches[ownedOrdinal].dofMapperForVariableOnSide.clear();
+  }
+  
+  _ownedCellIDs = orderedOwnedCellIDs;
+  _ownedCellOrdinals.swap(ownedCellOrdinals);
+  _ownedCellCaches.swap(ownedCellCaches);
+}
+
+void GDAMinimumRule::invalidateCellCachesNear(const set<GlobalIndexType> &changedCellIDs) {
+  if (!_cellCachesAreCurrent) return; // rebuildLookups() will clear the caches entirely
+  
+  // A cell's constraints depend on the active cells sharing its subcells and on the constraining ancestors of those cells.
+  // Refinement (or p-enrichment) of a cell can change the constraining entity or owner for the neighbors that share its vertices,
+  // and those in turn can change ownership for their own vertex neighbors; we invalidate two such layers.
+  set<IndexType> seedCells;
+  for (set<GlobalIndexType>::const_iterator cellIDIt = changedCellIDs.begin(); cellIDIt != changedCellIDs.end(); cellIDIt++) {
+    seedCells.insert(*cellIDIt);
+    CellPtr cell = _meshTopology->getCell(*cellIDIt);
+    vector<IndexType> childIndices = cell->getChildIndices();
+    seedCells.insert(childIndices.begin(), childIndices.end());
+  }
+  
+  set<IndexType> affectedCells = seedCells;
+  int numLayers = 2;
+  for (int layer=0; layer<numLayers; layer++) {
+    set<IndexType> neighbors = _meshTopology->getGhostCellIndices(affectedCells);
+    affectedCells.insert(neighbors.begin(), neighbors.end());
+  }
+  set<IndexType> ancestors = _meshTopology->getAncestorCellIndices(affectedCells);
+  affectedCells.insert(ancestors.begin(), ancestors.end());
+  
+  for (set<IndexType>::iterator cellIDIt = affectedCells.begin(); cellIDIt != affectedCells.end(); cellIDIt++) {
+    int ownedOrdinal = ownedCellOrdinal(*cellIDIt);
+    if (ownedOrdinal == -1) {
+      _ghostCellCaches.erase(*cellIDIt);
+    } else {
+      _ownedCellCaches[ownedOrdinal] = CellCacheEntry();
+    }
+  }
+}
+
+vector<GlobalIndexType> GDAMinimumRule::orderedCellIDsForDofNumbering(const set<GlobalIndexType> &cellIDs) {
+  vector<GlobalIndexType> orderedCellIDs(cellIDs.begin(),cellIDs.end());
+  if ((_cellOrderingForDofs == CELL_ID_ORDERING) || (cellIDs.size() <= 2)) return orderedCellIDs;
+  
+  if (_cellOrderingForDofs == HILBERT_CURVE_ORDERING) {
+    int spaceDim = _meshTopology->getSpaceDim();
+    vector< vector<double> > centroids;
+    vector<double> minCoords, maxCoords;
+    for (vector<GlobalIndexType>::iterator cellIDIt = orderedCellIDs.begin(); cellIDIt != orderedCellIDs.end(); cellIDIt++) {
+      vector<double> centroid = _meshTopology->getCellCentroid(*cellIDIt);
+      if (centroids.size() == 0) {
+        minCoords = centroid;
+        maxCoords = centroid;
+      }
+      for (int d=0; d<spaceDim; d++) {
+        minCoords[d] = min(minCoords[d], centroid[d]);
+        maxCoords[d] = max(maxCoords[d], centroid[d]);
+      }
+      centroids.push_back(centroid);
+    }
+    double maxExtent = 0;
+    for (int d=0; d<spaceDim; d++) {
+      maxExtent = max(maxExtent, maxCoords[d] - minCoords[d]);
+    }
+    int bitsPerCoordinate = min(31, 63 / spaceDim);
+    double scale = (maxExtent > 0) ? ((double)((1U << bitsPerCoordinate) - 1)) / maxExtent : 0; // same scale in each direction, so the curve isn't distorted
+    vector< pair<unsigned long long, GlobalIndexType> > keysAndCellIDs;
+    for (int cellOrdinal=0; cellOrdinal<orderedCellIDs.size(); cellOrdinal++) {
+      vector<unsigned> coords(spaceDim);
+      for (int d=0; d<spaceDim; d++) {
+        coords[d] = (unsigned) ((centroids[cellOrdinal][d] - minCoords[d]) * scale);
+      }
+      keysAndCellIDs.push_back(make_pair(hilbertKey(coords, bitsPerCoordinate), orderedCellIDs[cellOrdinal]));
+    }
+    std::sort(keysAndCellIDs.begin(), keysAndCellIDs.end());
+    for (int cellOrdinal=0; cellOrdinal<keysAndCellIDs.size(); cellOrdinal++) {
+      orderedCellIDs[cellOrdinal] = keysAndCellIDs[cellOrdinal].second;
+    }
+  } else if (_cellOrderingForDofs == REVERSE_CUTHILL_MCKEE_ORDERING) {
+    // adjacency among the given cells: cells sharing a vertex or a side share dofs
+    map< GlobalIndexType, vector<GlobalIndexType> > neighbors;
+    for (vector<GlobalIndexType>::iterator cellIDIt = orderedCellIDs.begin(); cellIDIt != orderedCellIDs.end(); cellIDIt++) {
+      set<IndexType> cellSet;
+      cellSet.insert(*cellIDIt);
+      set<IndexType> neighborCells = _meshTopology->getGhostCellIndices(cellSet);
+      vector<GlobalIndexType>* cellNeighbors = &neighbors[*cellIDIt];
+      for (set<IndexType>::iterator neighborIt = neighborCells.begin(); neighborIt != neighborCells.end(); neighborIt++) {
+        if (cellIDs.find(*neighborIt) != cellIDs.end()) cellNeighbors->push_back(*neighborIt);
+      }
+    }
+    // Cuthill-McKee: breadth-first search, visiting neighbors in order of increasing degree, starting each connected
+    // component from an unvisited cell of minimal degree.
+    vector< pair<int, GlobalIndexType> > degreesAndCellIDs;
+    for (map< GlobalIndexType, vector<GlobalIndexType> >::iterator entryIt = neighbors.begin(); entryIt != neighbors.end(); entryIt++) {
+      degreesAndCellIDs.push_back(make_pair(entryIt->second.size(), entryIt->first));
+    }
+    std::sort(degreesAndCellIDs.begin(), degreesAndCellIDs.end());
+    set<GlobalIndexType> visited;
+    vector<GlobalIndexType> cuthillMcKeeOrder;
+    for (int startOrdinal=0; startOrdinal<degreesAndCellIDs.size(); startOrdinal++) {
+      GlobalIndexType startCellID = degreesAndCellIDs[startOrdinal].second;
+      if (visited.find(startCellID) != visited.end()) continue;
+      visited.insert(startCellID);
+      int queueStart = cuthillMcKeeOrder.size();
+      cuthillMcKeeOrder.push_back(startCellID);
+      for (int queueOrdinal=queueStart; queueOrdinal<cuthillMcKeeOrder.size(); queueOrdinal++) {
+        vector<GlobalIndexType>* cellNeighbors = &neighbors[cuthillMcKeeOrder[queueOrdinal]];
+        vector< pair<int, GlobalIndexType> > unvisitedNeighbors;
+        for (vector<GlobalIndexType>::iterator neighborIt = cellNeighbors->begin(); neighborIt != cellNeighbors->end(); neighborIt++) {
+          if (visited.find(*neighborIt) == visited.end()) {
+            visited.insert(*neighborIt);
+            unvisitedNeighbors.push_back(make_pair(neighbors[*neighborIt].size(), *neighborIt));
+          }
+        }
+        std::sort(unvisitedNeighbors.begin(), unvisitedNeighbors.end());
+        for (int i=0; i<unvisitedNeighbors.size(); i++) {
+          cuthillMcKeeOrder.push_back(unvisitedNeighbors[i].second);
+        }
+      }
+    }
+    orderedCellIDs.assign(cuthillMcKeeOrder.rbegin(), cuthillMcKeeOrder.rend());
+  }
+  return orderedCellIDs;
+}
+
+GDAMinimumRule::CellOrderingForDofs GDAMinimumRule::getCellOrderingForDofs() {
+  return _cellOrderingForDofs;
+}
+
+void GDAMinimumRule::setCellOrderingForDofs(CellOrderingForDofs ordering) {
+  _cellOrderingForDofs = ordering;
+  rebuildLookups();
+  reinitializeRegisteredSolutions(); // every global dof index may have changed
+}
+
 void GDAMinimumRule::rebuildLookups() {
-  _constraintsCache.clear(); // to free up memory, could clear this again after the lookups are rebuilt.  Having the cache is most important during the construction below.
-  _dofMapperCache.clear();
-  _dofMapperForVariableOnSideCache.clear();
-  _ownedGlobalDofIndicesCache.clear();
+  if (!_cellCachesAreCurrent) {
+    // to free up memory, could clear this again after the lookups are rebuilt.  Having the cache is most important during the construction below.
+    _ownedCellIDs.clear();
+    _ownedCellCaches.clear();
+    _ghostCellCaches.clear();
+    _cellCachesAreCurrent = true;
+  }
+  // otherwise, refinements since the last rebuild have erased just the entries near the refined cells, and the rest remain valid:
+  // constraints are independent of the partitioning, and owned dof indices are cached relative to the cell's global offset.
   
   _partitionFluxIndexOffsets.clear();
   _partitionTraceIndexOffsets.clear();
   _partitionIndexOffsetsForVarID.clear();
   
+  // the memoized constraint steps are keyed on basis pointers, which are only guaranteed to stay meaningful while the element
+  // types that hold the bases do; the dof mappers built from the steps are dropped below in any case, so we start afresh
+  _constraintSteps.clear();
+  _constraintWeights.clear();
+  _unitConstraintWeightsID.clear();
+  
   int rank = Teuchos::GlobalMPISession::getRank();
 //  cout << "GDAMinimumRule: Rebuilding lookups on rank " << rank << endl;
   set<GlobalIndexType> myCellIDs = _partitions[rank];
   
   map<int, VarPtr> trialVars = _varFactory.trialVars();
   
-  _cellDofOffsets.clear(); // within the partition, offsets for the owned dofs in cell
-  
   int spaceDim = _meshTopology->getSpaceDim();
   int sideDim = spaceDim - 1;
   
@@ -2032,10 +2421,14 @@ void GDAMinimumRule::rebuildLookups() {
   // the design of MeshTopology and Cell to take better advantage of regularities (or just to store better lookups), we should be able to do better.
   // But in the interest of avoiding wasting development time on premature optimization, I'm leaving it as is for now...
   
+  vector<GlobalIndexType> myOrderedCellIDs = orderedCellIDsForDofNumbering(myCellIDs);
+  reindexOwnedCellCaches(myOrderedCellIDs); // also drops the dof mappers, which embed global dof indices
+  
+  _ownedCellDofOffsets.resize(myOrderedCellIDs.size()); // within the partition, offsets for the owned dofs in cell
   _partitionDofCount = 0; // how many dofs we own locally
-  for (set<GlobalIndexType>::iterator cellIDIt = myCellIDs.begin(); cellIDIt != myCellIDs.end(); cellIDIt++) {
-    GlobalIndexType cellID = *cellIDIt;
-    _cellDofOffsets[cellID] = _partitionDofCount;
+  for (int ownedOrdinal=0; ownedOrdinal<myOrderedCellIDs.size(); ownedOrdinal++) {
+    GlobalIndexType cellID = myOrderedCellIDs[ownedOrdinal];
+    _ownedCellDofOffsets[ownedOrdinal] = _partitionDofCount;
     CellPtr cell = _meshTopology->getCell(cellID);
     CellTopoPtr topo = cell->topology();
     CellConstraints constraints = getCellConstraints(cellID);
@@ -2109,7 +2502,7 @@ void GDAMinimumRule::rebuildLookups() {
   _partitionDofCounts[rank] = _partitionDofCount;
   MPIWrapper::entryWiseSum(_partitionDofCounts);
 //  if (rank==0) cout << "partitionDofCounts:\n" << _partitionDofCounts;
-  _partitionDofOffset = 0; // add this to a local partition dof index to get the global dof index
+  _partitionDofOffset = 0; // add this to a local partition dof index to get the global dof index (exclusive prefix sum of the partition counts)
   for (int i=0; i<rank; i++) {
     _partitionDofOffset += _partitionDofCounts[i];
   }
@@ -2118,34 +2511,8 @@ void GDAMinimumRule::rebuildLookups() {
     _globalDofCount += _partitionDofCounts[i];
   }
 //  if (rank==0) cout << "globalDofCount: " << _globalDofCount << endl;
-  // collect and communicate global cell dof offsets:
-  int activeCellCount = _meshTopology->getActiveCellIndices().size();
-  FieldContainer<int> globalCellIDDofOffsets(activeCellCount);
-  int partitionCellOffset = 0;
-  for (int i=0; i<rank; i++) {
-    partitionCellOffset += _partitions[i].size();
-  }
-  // fill in our _cellDofOffsets:
-
-  int i=0;
-  for (set<GlobalIndexType>::iterator cellIDIt = myCellIDs.begin(); cellIDIt != myCellIDs.end(); cellIDIt++) {
-    globalCellIDDofOffsets[partitionCellOffset+i] = _cellDofOffsets[*cellIDIt] + _partitionDofOffset;
-    i++;
-  }
-  // global copy:
-  MPIWrapper::entryWiseSum(globalCellIDDofOffsets);
-  // fill in the lookup table:
-  _globalCellDofOffsets.clear();
-  int globalCellIndex = 0;
-  for (int i=0; i<numRanks; i++) {
-    set<GlobalIndexType> rankCellIDs = _partitions[i];
-    for (set<GlobalIndexType>::iterator cellIDIt = rankCellIDs.begin(); cellIDIt != rankCellIDs.end(); cellIDIt++) {
-      GlobalIndexType cellID = *cellIDIt;
-      _globalCellDofOffsets[cellID] = globalCellIDDofOffsets[globalCellIndex];
-//      if (rank==numRanks-1) cout << "global dof offset for cell " << cellID << ": " << _globalCellDofOffsets[cellID] << endl;
-      globalCellIndex++;
-    }
-  }
+  // our own cells' global offsets are _partitionDofOffset + _ownedCellDofOffsets; fetch the others we need from their owners:
+  importNonOwnedCellDofOffsets();
   
   _cellIDsForElementType = vector< map< ElementType*, vector<GlobalIndexType> > >(numRanks);
   for (int i=0; i<numRanks; i++) {
@@ -241,6 +241,10 @@ void GlobalDofAssignment::constructActiveCellMap() {
 
 void GlobalDofAssignment::repartitionAndMigrate() {
   _partitionPolicy->partitionMesh(_mesh.get(),_numPartitions);
+  reinitializeRegisteredSolutions();
+}
+
+void GlobalDofAssignment::reinitializeRegisteredSolutions() {
   for (vector< Solution* >::iterator solutionIt = _registeredSolutions.begin();
        solutionIt != _registeredSolutions.end(); solutionIt++) {
     // if solution has a condensed dof interpreter, we should reinitialize the mapping from interpreted to global dofs
@@ -367,6 +371,10 @@ int GlobalDofAssignment::getTestOrderEnrichment() {
   return _testOrderEnhancement;
 }
 
+void GlobalDofAssignment::importCellDofOffsets(const set<GlobalIndexType> &cellIDs) {
+  // default: global dof indices are available for every cell, so there is nothing to do
+}
+
 void GlobalDofAssignment::interpretLocalCoefficients(GlobalIndexType cellID, const FieldContainer<double> &localCoefficients, Epetra_MultiVector &globalCoefficients) {
   DofOrderingPtr trialOrder = elementType(cellID)->trialOrderPtr;
   FieldContainer<double> basisCoefficients; // declared here so that we can sometimes avoid mallocs, if we get lucky in terms of the resize()
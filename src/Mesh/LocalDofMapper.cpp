@@ -178,39 +178,94 @@ vector<GlobalIndexType> LocalDofMapper::fittableGlobalIndices() {
   return _fittableGlobalIndices;
 }
 
-FieldContainer<double> LocalDofMapper::mapLocalDataMatrix(const FieldContainer<double> &localData, bool fittableGlobalDofsOnly) {
-  int dataSize = localData.dimension(0);
-  if (localData.dimension(1) != dataSize) {
-    cout << "Error: localData matrix must be square.\n";
-    TEUCHOS_TEST_FOR_EXCEPTION(true, std::invalid_argument, "localData matrix must be square");
-  }
-  FieldContainer<double> dataVector(dataSize);
-  FieldContainer<double> intermediateDataMatrix;
-  int mappedDataSize;
-  for (int i=0; i<dataSize; i++) {
-    for (int j=0; j<dataSize; j++) {
-      dataVector(j) = localData(i,j);
-    }
-    FieldContainer<double> mappedDataVector = mapLocalData(dataVector, fittableGlobalDofsOnly);
-    if (i==0) { // size intermediateDataMatrix once we know the entry for the first row
-      mappedDataSize = mappedDataVector.size();
-      intermediateDataMatrix.resize(dataSize,mappedDataSize);
-    }
-    for (int j=0; j<mappedDataSize; j++) {
-      intermediateDataMatrix(i,j) = mappedDataVector(j);
+LocalDofMapper::CompactMap & LocalDofMapper::compactMap(bool fittableGlobalDofsOnly) {
+  CompactMap* compact = &_compactMaps[fittableGlobalDofsOnly ? 1 : 0];
+  if (compact->isBuilt) return *compact;
+  
+  unsigned dofCount;
+  if (_varIDToMap == -1) {
+    dofCount = _dofOrdering->totalDofs();
+  } else {
+    dofCount = _dofOrdering->getBasisCardinality(_varIDToMap, _sideOrdinalToMap);
+  }
+  
+  vector< map<unsigned, double> > localRows(dofCount); // local dof index --> (global ordinal --> weight)
+  
+  for (map< int, BasisMap >::iterator volumeMapIt = _volumeMaps.begin(); volumeMapIt != _volumeMaps.end(); volumeMapIt++) {
+    int varID = volumeMapIt->first;
+    bool skipVar = (_varIDToMap != -1) && (varID != _varIDToMap);
+    if (skipVar) continue;
+    int volumeSideIndex = 0;
+    addCompactEntries(varID, volumeSideIndex, volumeMapIt->second, fittableGlobalDofsOnly, localRows);
+  }
+  int sideCount = _sideMaps.size();
+  for (unsigned sideOrdinal=0; sideOrdinal < sideCount; sideOrdinal++) {
+    bool skipSide = (_sideOrdinalToMap != -1) && (sideOrdinal != _sideOrdinalToMap);
+    if (skipSide) continue;
+    for (map< int, BasisMap >::iterator sideMapIt = _sideMaps[sideOrdinal].begin(); sideMapIt != _sideMaps[sideOrdinal].end(); sideMapIt++) {
+      int varID = sideMapIt->first;
+      bool skipVar = (_varIDToMap != -1) && (varID != _varIDToMap);
+      if (skipVar) continue;
+      addCompactEntries(varID, sideOrdinal, sideMapIt->second, fittableGlobalDofsOnly, localRows);
     }
   }
-  FieldContainer<double> globalData(mappedDataSize,mappedDataSize);
-  for (int j=0; j<mappedDataSize; j++) {
-    for (int i=0; i<dataSize; i++) {
-      dataVector(i) = intermediateDataMatrix(i,j);
+  
+  int mappedDofCount = _globalIndexToOrdinal.size();
+  compact->rowOffsets.resize(dofCount + 1);
+  compact->globalOrdinals.clear();
+  compact->weights.clear();
+  compact->isGather = true;
+  compact->localDofForGlobalOrdinal = vector<int>(mappedDofCount, -1);
+  for (unsigned localDofIndex=0; localDofIndex<dofCount; localDofIndex++) {
+    compact->rowOffsets[localDofIndex] = compact->globalOrdinals.size();
+    map<unsigned, double>* row = &localRows[localDofIndex];
+    if (row->size() > 1) compact->isGather = false;
+    for (map<unsigned, double>::iterator entryIt = row->begin(); entryIt != row->end(); entryIt++) {
+      unsigned globalOrdinal = entryIt->first;
+      compact->globalOrdinals.push_back(globalOrdinal);
+      compact->weights.push_back(entryIt->second);
+      if ((entryIt->second != 1.0) || (compact->localDofForGlobalOrdinal[globalOrdinal] != -1)) {
+        compact->isGather = false;
+      }
+      compact->localDofForGlobalOrdinal[globalOrdinal] = localDofIndex;
     }
-    FieldContainer<double> mappedDataVector = mapLocalData(dataVector, fittableGlobalDofsOnly);
-    for (int i=0; i<mappedDataSize; i++) {
-      globalData(i,j) = mappedDataVector(i);
+  }
+  compact->rowOffsets[dofCount] = compact->globalOrdinals.size();
+  if (!compact->isGather) compact->localDofForGlobalOrdinal.clear();
+  compact->isBuilt = true;
+  return *compact;
+}
+
+void LocalDofMapper::addCompactEntries(int varID, int sideOrdinal, BasisMap &basisMap, bool fittableGlobalDofsOnly, vector< map<unsigned, double> > &localRows) {
+  // probe each sub-basis mapper with unit basis data, so that the compact map agrees exactly with addSubBasisMapVectorContribution()
+  vector<int> varDofIndices = _dofOrdering->getDofIndices(varID, sideOrdinal);
+  FieldContainer<double> basisData(varDofIndices.size());
+  FieldContainer<double> globalData(_globalIndexToOrdinal.size());
+  set<GlobalIndexType> *fittableDofs;
+  if (_volumeMaps.find(varID) != _volumeMaps.end()) {
+    fittableDofs = &_fittableGlobalDofOrdinalsInVolume;
+  } else {
+    fittableDofs = &_fittableGlobalDofOrdinalsOnSides[sideOrdinal];
+  }
+  for (vector<SubBasisDofMapperPtr>::iterator subBasisMapIt = basisMap.begin(); subBasisMapIt != basisMap.end(); subBasisMapIt++) {
+    SubBasisDofMapperPtr subBasisDofMapper = *subBasisMapIt;
+    vector<GlobalIndexType> mappedGlobalIndices = subBasisDofMapper->mappedGlobalDofOrdinals();
+    const set<unsigned>* basisOrdinalFilter = &subBasisDofMapper->basisDofOrdinalFilter();
+    for (set<unsigned>::const_iterator basisOrdinalIt = basisOrdinalFilter->begin(); basisOrdinalIt != basisOrdinalFilter->end(); basisOrdinalIt++) {
+      unsigned basisOrdinal = *basisOrdinalIt;
+      unsigned localDofIndex = (_varIDToMap == -1) ? varDofIndices[basisOrdinal] : basisOrdinal;
+      basisData[basisOrdinal] = 1.0;
+      subBasisDofMapper->mapDataIntoGlobalContainer(basisData, _globalIndexToOrdinal, fittableGlobalDofsOnly, *fittableDofs, globalData);
+      basisData[basisOrdinal] = 0.0;
+      for (int i=0; i<mappedGlobalIndices.size(); i++) {
+        unsigned globalOrdinal = _globalIndexToOrdinal[mappedGlobalIndices[i]];
+        if (globalData[globalOrdinal] != 0.0) {
+          localRows[localDofIndex][globalOrdinal] += globalData[globalOrdinal];
+          globalData[globalOrdinal] = 0.0;
+        }
+      }
     }
   }
-  return globalData;
 }
 
 FieldContainer<double> LocalDofMapper::fitLocalCoefficients(const FieldContainer<double> &localCoefficients) {
@@ -297,40 +352,63 @@ FieldContainer<double> LocalDofMapper::mapLocalData(const FieldContainer<double>
       TEUCHOS_TEST_FOR_EXCEPTION(true, std::invalid_argument, "data dimension 1 must match dofCount.");
     }
   }
-  if (localData.rank()==2) {
-    return mapLocalDataMatrix(localData, fittableGlobalDofsOnly);
-  }
   
+  CompactMap* compact = &compactMap(fittableGlobalDofsOnly);
   int mappedDofCount =  _globalIndexToOrdinal.size();
-  Teuchos::Array<int> dim;
-  localData.dimensions(dim);
-  dim[0] = mappedDofCount;
-  FieldContainer<double> mappedData(dim);
   
-  // map volume data
-  for (map< int, BasisMap >::iterator volumeMapIt = _volumeMaps.begin(); volumeMapIt != _volumeMaps.end(); volumeMapIt++) {
-    int varID = volumeMapIt->first;
-    bool skipVar = (_varIDToMap != -1) && (varID != _varIDToMap);
-    if (skipVar) continue;
-    BasisMap basisMap = volumeMapIt->second;
-    int volumeSideIndex = 0;
-    addSubBasisMapVectorContribution(varID, volumeSideIndex, basisMap, localData, mappedData, fittableGlobalDofsOnly);
+  if (localData.rank()==1) {
+    FieldContainer<double> mappedData(mappedDofCount);
+    if (compact->isGather) {
+      for (int globalOrdinal=0; globalOrdinal<mappedDofCount; globalOrdinal++) {
+        int localDofIndex = compact->localDofForGlobalOrdinal[globalOrdinal];
+        if (localDofIndex != -1) mappedData(globalOrdinal) = localData(localDofIndex);
+      }
+      return mappedData;
+    }
+    for (int i=0; i<dofCount; i++) {
+      double value = localData(i);
+      if (value == 0.0) continue;
+      for (int entry=compact->rowOffsets[i]; entry<compact->rowOffsets[i+1]; entry++) {
+        mappedData(compact->globalOrdinals[entry]) += compact->weights[entry] * value;
+      }
+    }
+    return mappedData;
   }
   
-  // map side data
-  int sideCount = _sideMaps.size();
-  for (unsigned sideOrdinal=0; sideOrdinal < sideCount; sideOrdinal++) {
-    bool skipSide = (_sideOrdinalToMap != -1) && (sideOrdinal != _sideOrdinalToMap);
-    if (skipSide) continue;
-    for (map< int, BasisMap >::iterator sideMapIt = _sideMaps[sideOrdinal].begin(); sideMapIt != _sideMaps[sideOrdinal].end(); sideMapIt++) {
-      int varID = sideMapIt->first;
-      bool skipVar = (_varIDToMap != -1) && (varID != _varIDToMap);
-      if (skipVar) continue;
-      BasisMap basisMap = sideMapIt->second;
-      addSubBasisMapVectorContribution(varID, sideOrdinal, basisMap, localData, mappedData, fittableGlobalDofsOnly);
+  // rank 2: globalData = A * localData * A^T, where A is the (sparse) local-to-global map
+  FieldContainer<double> globalData(mappedDofCount,mappedDofCount);
+  if (compact->isGather) {
+    for (int I=0; I<mappedDofCount; I++) {
+      int i = compact->localDofForGlobalOrdinal[I];
+      if (i == -1) continue;
+      for (int J=0; J<mappedDofCount; J++) {
+        int j = compact->localDofForGlobalOrdinal[J];
+        if (j != -1) globalData(I,J) = localData(i,j);
+      }
+    }
+    return globalData;
+  }
+  
+  FieldContainer<double> intermediateData(mappedDofCount,dofCount); // A * localData
+  for (int i=0; i<dofCount; i++) {
+    for (int entry=compact->rowOffsets[i]; entry<compact->rowOffsets[i+1]; entry++) {
+      unsigned I = compact->globalOrdinals[entry];
+      double weight = compact->weights[entry];
+      for (int j=0; j<dofCount; j++) {
+        intermediateData(I,j) += weight * localData(i,j);
+      }
     }
   }
-  return mappedData;
+  for (int j=0; j<dofCount; j++) {
+    for (int entry=compact->rowOffsets[j]; entry<compact->rowOffsets[j+1]; entry++) {
+      unsigned J = compact->globalOrdinals[entry];
+      double weight = compact->weights[entry];
+      for (int I=0; I<mappedDofCount; I++) {
+        globalData(I,J) += weight * intermediateData(I,j);
+      }
+    }
+  }
+  return globalData;
 }
 
 void LocalDofMapper::mapLocalDataSide(const FieldContainer<double> &localData, FieldContainer<double> &mappedData, bool fittableGlobalDofsOnly, int sideOrdinal) {
@@ -489,4 +567,6 @@ void LocalDofMapper::reverseParity(set<int> fluxVarIDs, set<unsigned int> sideOr
     }
   }
   _localCoefficientsFitMatrix.resize(0); // this will need to be recomputed
+  _compactMaps[0] = CompactMap();
+  _compactMaps[1] = CompactMap();
 }
\ No newline at end of file
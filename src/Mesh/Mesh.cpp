@@ -77,6 +77,8 @@ Mesh::Mesh(MeshTopologyPtr meshTopology, BFPtr bilinearForm, int H1Order, int pT
            MeshPartitionPolicyPtr partitionPolicy) : DofInterpreter(Teuchos::rcp(this,false)) {
   
   _meshTopology = meshTopology;
+  _measuredCellCostTotal = 0;
+  _modeledCellCostTotalForMeasuredCells = 0;
   
   DofOrderingFactoryPtr dofOrderingFactoryPtr = Teuchos::rcp( new DofOrderingFactory(bilinearForm, trialOrderEnhancements,testOrderEnhancements) );
   _enforceMBFluxContinuity = false;
@@ -108,6 +110,8 @@ Mesh::Mesh(const vector<vector<double> > &vertices, vector< vector<unsigned> > &
   
   MeshGeometryPtr meshGeometry = Teuchos::rcp( new MeshGeometry(vertices, elementVertices) );
   _meshTopology = Teuchos::rcp( new MeshTopology(meshGeometry, periodicBCs) );
+  _measuredCellCostTotal = 0;
+  _modeledCellCostTotalForMeasuredCells = 0;
   
   DofOrderingFactoryPtr dofOrderingFactoryPtr = Teuchos::rcp( new DofOrderingFactory(bilinearForm, trialOrderEnhancements,testOrderEnhancements) );
   _enforceMBFluxContinuity = false;
@@ -164,6 +168,8 @@ Mesh::Mesh(MeshTopologyPtr meshTopology, Teuchos::RCP<GlobalDofAssignment> gda,
   _useConformingTraces = useConformingTraces;
   _usePatchBasis = usePatchBasis;
   _enforceMBFluxContinuity = enforceMBFluxContinuity;
+  _measuredCellCostTotal = 0;
+  _modeledCellCostTotalForMeasuredCells = 0;
   
   _boundary.setMesh(this);
 
@@ -240,10 +246,40 @@ set<GlobalIndexType> Mesh::cellIDsInPartition() {
   return _gda->cellsInPartition(-1);
 }
 
+double Mesh::cellCost(GlobalIndexType cellID) {
+  map<GlobalIndexType, pair<double,double> >::iterator measuredEntry = _measuredCellCosts.find(cellID);
+  if (measuredEntry != _measuredCellCosts.end()) return measuredEntry->second.first;
+  double modeledCost = modeledCellCost(cellID);
+  if (_modeledCellCostTotalForMeasuredCells > 0) {
+    // express in the units of the measured costs, so that measured and modeled cells can be weighed against each other
+    return modeledCost * _measuredCellCostTotal / _modeledCellCostTotalForMeasuredCells;
+  }
+  return modeledCost;
+}
+
 int Mesh::cellPolyOrder(GlobalIndexType cellID) { // aka H1Order
   return _gda->getH1Order(cellID);
 }
 
+void Mesh::clearCellAssemblyCosts() {
+  _measuredCellCosts.clear();
+  _measuredCellCostTotal = 0;
+  _modeledCellCostTotalForMeasuredCells = 0;
+}
+
+void Mesh::discardCellAssemblyCost(GlobalIndexType cellID) {
+  map<GlobalIndexType, pair<double,double> >::iterator measuredEntry = _measuredCellCosts.find(cellID);
+  if (measuredEntry == _measuredCellCosts.end()) return;
+  _measuredCellCostTotal -= measuredEntry->second.first;
+  _modeledCellCostTotalForMeasuredCells -= measuredEntry->second.second;
+  _measuredCellCosts.erase(measuredEntry);
+  if (_measuredCellCosts.size() == 0) {
+    // avoid leaving round-off behind in the calibration
+    _measuredCellCostTotal = 0;
+    _modeledCellCostTotalForMeasuredCells = 0;
+  }
+}
+
 vector<GlobalIndexType> Mesh::cellIDsForPoints(const FieldContainer<double> &physicalPoints, bool minusOnesIfOffRank) {
   vector<GlobalIndexType> cellIDs = _meshTopology->cellIDsForPoints(physicalPoints);
   
@@ -567,16 +603,32 @@ void Mesh::hRefine(const set<GlobalIndexType> &cellIDs, Teuchos::RCP<RefinementP
       cout << "cellID " << cellID << " is not active, but Mesh received request for h-refinement.\n";
       TEUCHOS_TEST_FOR_EXCEPTION(true, std::invalid_argument, "inactive cell");
     }
-    
-    _meshTopology->refineCell(cellID, refPattern);
-    
-    // TODO: figure out what it is that breaks in GDAMaximumRule when we use didHRefine to notify about all cells together outside this loop
-    //       (and/or try moving outside the loop if and only if we are using the minimum rule)
-    set<GlobalIndexType> cellIDset;
-    cellIDset.insert(cellID);
+  }
+  
+  for (cellIt = cellIDs.begin(); cellIt != cellIDs.end(); cellIt++) {
+    discardCellAssemblyCost(*cellIt);
+  }
+  
+  GDAMinimumRule* minRule = dynamic_cast<GDAMinimumRule *>(_gda.get());
+  if (minRule != NULL) {
+    // minimum rule: refine all the cells together, and notify GDA once
+    _meshTopology->refineCells(cellIDs, refPattern);
     
     // TODO: consider making GDA a refinementObserver, using that interface to send it the notification
-    _gda->didHRefine(cellIDset);
+    _gda->didHRefine(cellIDs);
+  } else {
+    for (cellIt = cellIDs.begin(); cellIt != cellIDs.end(); cellIt++) {
+      GlobalIndexType cellID = *cellIt;
+      
+      _meshTopology->refineCell(cellID, refPattern);
+      
+      // TODO: figure out what it is that breaks in GDAMaximumRule when we use didHRefine to notify about all cells together outside this loop
+      set<GlobalIndexType> cellIDset;
+      cellIDset.insert(cellID);
+      
+      // TODO: consider making GDA a refinementObserver, using that interface to send it the notification
+      _gda->didHRefine(cellIDset);
+    }
   }
   
   // NVR 12/10/14 the code below moved from inside the loop above, where it was doing the below one cell at a time...
@@ -711,6 +763,21 @@ void Mesh::interpretLocalData(GlobalIndexType cellID, const FieldContainer<doubl
   _gda->interpretLocalData(cellID, localDofs, globalDofs, globalDofIndices);
 }
 
+double Mesh::modeledCellCost(GlobalIndexType cellID) {
+  ElementTypePtr elemType = getElementType(cellID);
+  double trialDofs = elemType->trialOrderPtr->totalDofs();
+  double testDofs = elemType->testOrderPtr->totalDofs();
+  int spaceDim = elemType->cellTopoPtr->getDimension();
+  // the local integrals have degree (trial degree + test degree); estimate the cubature point count as that of a tensor-product Gauss rule
+  int cubatureDegree = elemType->trialOrderPtr->maxBasisDegree() + elemType->testOrderPtr->maxBasisDegree();
+  double cubaturePointCount = pow(cubatureDegree / 2 + 1.0, spaceDim);
+  
+  double integrationCost = cubaturePointCount * testDofs * (testDofs + trialDofs);
+  double gramFactorizationCost = testDofs * testDofs * testDofs / 3.0;
+  double testSolveCost = trialDofs * testDofs * testDofs;
+  return integrationCost + gramFactorizationCost + testSolveCost;
+}
+
 GlobalIndexType Mesh::numActiveElements() {
   return _meshTopology->activeCellCount();
 }
@@ -803,7 +870,7 @@ FieldContainer<double> Mesh::physicalCellNodesForCell( GlobalIndexType cellID )
   for (int vertex=0; vertex<vertexCount; vertex++) {
     unsigned vertexIndex = vertexIndices[vertex];
     for (int i=0; i<spaceDim; i++) {
-      physicalCellNodes(0,vertex,i) = _meshTopology->getVertex(vertexIndex)[i];
+      physicalCellNodes(0,vertex,i) = _meshTopology->getVertexCoordinates(vertexIndex)[i];
     }
   }
   return physicalCellNodes;
@@ -845,6 +912,66 @@ void Mesh::printVertices() {
   }
 }
 
+void Mesh::recordCellAssemblyCost(GlobalIndexType cellID, double cost) {
+  discardCellAssemblyCost(cellID);
+  double modeledCost = modeledCellCost(cellID);
+  _measuredCellCosts[cellID] = make_pair(cost, modeledCost);
+  _measuredCellCostTotal += cost;
+  _modeledCellCostTotalForMeasuredCells += modeledCost;
+}
+
+void Mesh::synchronizeCellAssemblyCosts() {
+  int numProcs = Teuchos::GlobalMPISession::getNProc();
+  if (numProcs == 1) return;
+  int rank = Teuchos::GlobalMPISession::getRank();
+  
+  FieldContainer<int> measuredCounts(numProcs);
+  MPIWrapper::allGather(measuredCounts, (int)_measuredCellCosts.size());
+  int totalCount = 0, myOffset = 0;
+  for (int i=0; i<numProcs; i++) {
+    if (i == rank) myOffset = totalCount;
+    totalCount += measuredCounts[i];
+  }
+  if (totalCount == 0) return;
+  
+  // each rank fills in its own (cellID, measured cost, modeled cost) rows; the sum gathers them all
+  FieldContainer<double> entries(totalCount, 3);
+  int entryOrdinal = myOffset;
+  for (map<GlobalIndexType, pair<double,double> >::iterator entryIt = _measuredCellCosts.begin();
+       entryIt != _measuredCellCosts.end(); entryIt++, entryOrdinal++) {
+    entries(entryOrdinal,0) = entryIt->first;
+    entries(entryOrdinal,1) = entryIt->second.first;
+    entries(entryOrdinal,2) = entryIt->second.second;
+  }
+  MPIWrapper::entryWiseSum(entries);
+  
+  // a cell may have been measured on more than one rank (before and after it migrated): prefer the measurement of its current
+  // owner, and otherwise that of the lowest rank
+  map<GlobalIndexType, pair<double,double> > measuredCellCosts;
+  set<GlobalIndexType> measuredByOwner;
+  entryOrdinal = 0;
+  for (int i=0; i<numProcs; i++) {
+    for (int j=0; j<measuredCounts[i]; j++, entryOrdinal++) {
+      GlobalIndexType cellID = (GlobalIndexType) entries(entryOrdinal,0);
+      bool isOwner = (partitionForCellID(cellID) == i);
+      if ((measuredCellCosts.find(cellID) == measuredCellCosts.end()) || (isOwner && (measuredByOwner.find(cellID) == measuredByOwner.end()))) {
+        measuredCellCosts[cellID] = make_pair(entries(entryOrdinal,1), entries(entryOrdinal,2));
+        if (isOwner) measuredByOwner.insert(cellID);
+      }
+    }
+  }
+  
+  // summing in cellID order, so that every rank arrives at the same calibration
+  _measuredCellCosts = measuredCellCosts;
+  _measuredCellCostTotal = 0;
+  _modeledCellCostTotalForMeasuredCells = 0;
+  for (map<GlobalIndexType, pair<double,double> >::iterator entryIt = _measuredCellCosts.begin();
+       entryIt != _measuredCellCosts.end(); entryIt++) {
+    _measuredCellCostTotal += entryIt->second.first;
+    _modeledCellCostTotalForMeasuredCells += entryIt->second.second;
+  }
+}
+
 void Mesh::registerObserver(Teuchos::RCP<RefinementObserver> observer) {
   _registeredObservers.push_back(observer);
 }
@@ -888,6 +1015,10 @@ void Mesh::pRefine(const set<GlobalIndexType> &cellIDsForPRefinements){
 void Mesh::pRefine(const set<GlobalIndexType> &cellIDsForPRefinements, int pToAdd) {
   if (cellIDsForPRefinements.size() == 0) return;
   
+  for (set<GlobalIndexType>::const_iterator cellIDIt = cellIDsForPRefinements.begin(); cellIDIt != cellIDsForPRefinements.end(); cellIDIt++) {
+    discardCellAssemblyCost(*cellIDIt);
+  }
+  
   // refine any registered meshes
   for (vector< Teuchos::RCP<RefinementObserver> >::iterator meshIt = _registeredObservers.begin();
        meshIt != _registeredObservers.end(); meshIt++) {
@@ -1017,7 +1148,7 @@ FieldContainer<double> Mesh::vertexCoordinates(GlobalIndexType vertexIndex) {
   int spaceDim = _meshTopology->getSpaceDim();
   FieldContainer<double> vertex(spaceDim);
   for (int d=0; d<spaceDim; d++) {
-    vertex(d) = _meshTopology->getVertex(vertexIndex)[d];
+    vertex(d) = _meshTopology->getVertexCoordinates(vertexIndex)[d];
   }
   return vertex;
 }
@@ -1044,7 +1175,7 @@ void Mesh::verticesForCell(FieldContainer<double>& vertices, GlobalIndexType cel
   //vertices.resize(numVertices,dimension);
   for (unsigned vertexIndex = 0; vertexIndex < numVertices; vertexIndex++) {
     for (int d=0; d<spaceDim; d++) {
-      vertices(vertexIndex,d) = _meshTopology->getVertex(vertexIndices[vertexIndex])[d];
+      vertices(vertexIndex,d) = _meshTopology->getVertexCoordinates(vertexIndices[vertexIndex])[d];
     }
   }
 }
@@ -1104,7 +1235,7 @@ void Mesh::verticesForSide(FieldContainer<double>& vertices, GlobalIndexType cel
   
   for (unsigned vertexIndex = 0; vertexIndex < numVertices; vertexIndex++) {
     for (int d=0; d<spaceDim; d++) {
-      vertices(vertexIndex,d) = _meshTopology->getVertex(vertexIndex)[d];
+      vertices(vertexIndex,d) = _meshTopology->getVertexCoordinates(vertexIndex)[d];
     }
   }
 }
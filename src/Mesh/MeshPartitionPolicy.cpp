@@ -11,29 +11,126 @@
 #include "MeshPartitionPolicy.h"
 #include "ZoltanMeshPartitionPolicy.h"
 
+#include "ElementType.h"
 #include "GlobalDofAssignment.h"
 
-void MeshPartitionPolicy::partitionMesh(Mesh *mesh, PartitionIndexType numPartitions) {
-  // default simply divides the active cells into equally-sized partitions, in the order listed in activeCells…
-  MeshTopologyPtr meshTopology = mesh->getTopology();
-  int numActiveCells = meshTopology->activeCellCount(); // leaf nodes
-  FieldContainer<GlobalIndexType> partitionedActiveCells(numPartitions,numActiveCells);
+namespace {
+  int sideTraceDofCount(ElementTypePtr elemType, unsigned sideOrdinal) {
+    // trace and flux variables are the ones defined on more than one side
+    DofOrderingPtr trialOrder = elemType->trialOrderPtr;
+    const set<int> &varIDs = trialOrder->getVarIDs();
+    int dofCount = 0;
+    for (set<int>::const_iterator varIDIt = varIDs.begin(); varIDIt != varIDs.end(); varIDIt++) {
+      if (trialOrder->getNumSidesForVarID(*varIDIt) <= 1) continue;
+      if (!trialOrder->hasBasisEntry(*varIDIt, sideOrdinal)) continue;
+      dofCount += trialOrder->getBasisCardinality(*varIDIt, sideOrdinal);
+    }
+    return dofCount;
+  }
+}
+
+vector< set<GlobalIndexType> > MeshPartitionPolicy::contiguousPartitions(Mesh *mesh, PartitionIndexType numPartitions,
+                                                                         bool weightByCellCost) {
+  set<GlobalIndexType> cellIDSet = mesh->getActiveCellIDs();
+  vector<GlobalIndexType> activeCellIDs(cellIDSet.begin(),cellIDSet.end());
+  int numActiveCells = activeCellIDs.size();
+  
+  // with unit weights, the chunk boundaries below reproduce chunks of size numActiveCells / numPartitions, with the remainder
+  // distributed one apiece to the first partitions
+  vector<double> cellWeights(numActiveCells, 1.0);
+  if (weightByCellCost) {
+    mesh->synchronizeCellAssemblyCosts(); // every rank must compute the same partitions
+    for (int cellOrdinal=0; cellOrdinal<numActiveCells; cellOrdinal++) {
+      cellWeights[cellOrdinal] = mesh->cellCost(activeCellIDs[cellOrdinal]);
+    }
+  }
   
-  partitionedActiveCells.initialize(-1); // cellID == -1 signals end of partition
-  int chunkSize = numActiveCells / numPartitions;
-  int remainder = numActiveCells % numPartitions;
-  IndexType activeCellIndex = 0;
-  vector<GlobalIndexType> activeCellIDs;
-  set<IndexType> cellIDSet = meshTopology->getActiveCellIndices();
-  activeCellIDs.insert(activeCellIDs.begin(),cellIDSet.begin(),cellIDSet.end());
-  for (int i=0; i<numPartitions; i++) {
-    int chunkSizeWithRemainder = (i < remainder) ? chunkSize + 1 : chunkSize;
-    for (int j=0; j<chunkSizeWithRemainder; j++) {
-      partitionedActiveCells(i,j) = activeCellIDs[activeCellIndex];
-      activeCellIndex++;
+  vector< set<GlobalIndexType> > partitions(numPartitions);
+  if (!weightByCellCost) {
+    int chunkSize = numActiveCells / numPartitions;
+    int remainder = numActiveCells % numPartitions;
+    int activeCellIndex = 0;
+    for (int i=0; i<numPartitions; i++) {
+      int chunkSizeWithRemainder = (i < remainder) ? chunkSize + 1 : chunkSize;
+      for (int j=0; j<chunkSizeWithRemainder; j++) {
+        partitions[i].insert(activeCellIDs[activeCellIndex]);
+        activeCellIndex++;
+      }
+    }
+    return partitions;
+  }
+  
+  double totalWeight = 0;
+  for (int cellOrdinal=0; cellOrdinal<numActiveCells; cellOrdinal++) {
+    totalWeight += cellWeights[cellOrdinal];
+  }
+  double targetWeight = totalWeight / numPartitions;
+  
+  // assign each cell to the partition containing the midpoint of its interval in the running total of weights
+  double weightBeforeCell = 0;
+  for (int cellOrdinal=0; cellOrdinal<numActiveCells; cellOrdinal++) {
+    double midpoint = weightBeforeCell + cellWeights[cellOrdinal] / 2.0;
+    int partitionNumber = (targetWeight > 0) ? (int) (midpoint / targetWeight) : 0;
+    partitionNumber = min(partitionNumber, (int)numPartitions - 1);
+    partitions[partitionNumber].insert(activeCellIDs[cellOrdinal]);
+    weightBeforeCell += cellWeights[cellOrdinal];
+  }
+  return partitions;
+}
+
+double MeshPartitionPolicy::costImbalance(Mesh *mesh, const vector< set<GlobalIndexType> > &partitions) {
+  double maxCost = 0, totalCost = 0;
+  for (int partitionNumber=0; partitionNumber<partitions.size(); partitionNumber++) {
+    double partitionCost = 0;
+    for (set<GlobalIndexType>::const_iterator cellIDIt = partitions[partitionNumber].begin();
+         cellIDIt != partitions[partitionNumber].end(); cellIDIt++) {
+      partitionCost += mesh->cellCost(*cellIDIt);
     }
+    maxCost = max(maxCost, partitionCost);
+    totalCost += partitionCost;
   }
-  mesh->globalDofAssignment()->setPartitions(partitionedActiveCells);
+  if (totalCost == 0) return 1.0;
+  return maxCost / (totalCost / partitions.size());
+}
+
+map<GlobalIndexType, int> MeshPartitionPolicy::traceCouplingWeights(Mesh *mesh, GlobalIndexType cellID) {
+  MeshTopologyPtr meshTopo = mesh->getTopology();
+  CellPtr cell = meshTopo->getCell(cellID);
+  ElementTypePtr elemType = mesh->getElementType(cellID);
+  
+  map<GlobalIndexType, int> weights;
+  int sideCount = cell->getSideCount();
+  for (int sideOrdinal=0; sideOrdinal<sideCount; sideOrdinal++) {
+    pair<GlobalIndexType, unsigned> neighborInfo = cell->getNeighborInfo(sideOrdinal);
+    if (neighborInfo.first == (GlobalIndexType) -1) continue; // boundary side
+    int mySideDofCount = sideTraceDofCount(elemType, sideOrdinal);
+    
+    // the neighbor is either active (a peer, or the larger cell constraining a hanging side), or a peer whose active
+    // descendants along the side are our neighbors
+    CellPtr neighbor = meshTopo->getCell(neighborInfo.first);
+    vector< pair<GlobalIndexType, unsigned> > activeNeighbors = neighbor->getDescendantsForSide(neighborInfo.second);
+    for (int i=0; i<activeNeighbors.size(); i++) {
+      GlobalIndexType neighborCellID = activeNeighbors[i].first;
+      if (neighborCellID == cellID) continue;
+      int neighborSideDofCount = sideTraceDofCount(mesh->getElementType(neighborCellID), activeNeighbors[i].second);
+      weights[neighborCellID] += min(mySideDofCount, neighborSideDofCount);
+    }
+  }
+  return weights;
+}
+
+void MeshPartitionPolicy::partitionMesh(Mesh *mesh, PartitionIndexType numPartitions) {
+  // default simply divides the active cells into contiguous partitions, in cellID order…
+  vector< set<GlobalIndexType> > partitions = contiguousPartitions(mesh, numPartitions, _weightByCellCost);
+  mesh->globalDofAssignment()->setPartitions(partitions);
+}
+
+void MeshPartitionPolicy::setWeightByCellCost(bool value) {
+  _weightByCellCost = value;
+}
+
+bool MeshPartitionPolicy::weightByCellCost() {
+  return _weightByCellCost;
 }
 
 MeshPartitionPolicyPtr MeshPartitionPolicy::standardPartitionPolicy() {
@@ -41,6 +138,11 @@ MeshPartitionPolicyPtr MeshPartitionPolicy::standardPartitionPolicy() {
   return partitionPolicy;
 }
 
+MeshPartitionPolicyPtr MeshPartitionPolicy::traceGraphPartitionPolicy() {
+  MeshPartitionPolicyPtr partitionPolicy = Teuchos::rcp( new ZoltanMeshPartitionPolicy("GRAPH") );
+  return partitionPolicy;
+}
+
 class OneRankPartitionPolicy : public MeshPartitionPolicy {
   int _rankNumber;
 public:
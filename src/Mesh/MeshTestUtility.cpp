@@ -444,6 +444,7 @@ bool MeshTestUtility::neighborBasesAgreeOnSides(Teuchos::RCP<Mesh> mesh, Epetra_
   int spaceDim = meshTopo->getSpaceDim();
   
   set<IndexType> activeCellIndices = meshTopo->getActiveCellIndices();
+  mesh->globalDofAssignment()->importCellDofOffsets(set<GlobalIndexType>(activeCellIndices.begin(),activeCellIndices.end()));
   for (set<IndexType>::iterator cellIt=activeCellIndices.begin(); cellIt != activeCellIndices.end(); cellIt++) {
     IndexType cellIndex = *cellIt;
     CellPtr cell = meshTopo->getCell(cellIndex);
@@ -27,9 +27,10 @@ void MeshTopology::init(unsigned spaceDim) {
   // for nontrivial mesh topology, we store entities with dimension sideDim down to vertices, so _spaceDim total possibilities
   // for trivial mesh topology (just a node), we allow storage of 0-dimensional (vertex) entity
   int numEntityDimensions = (_spaceDim > 0) ? _spaceDim : 1;
-  _entities = vector< vector< vector< unsigned > > >(numEntityDimensions);
-  _knownEntities = vector< map< vector<unsigned>, unsigned > >(numEntityDimensions); // map keys are sets of vertices, values are entity indices in _entities[d]
-  _canonicalEntityOrdering = vector< vector< vector<unsigned> > >(numEntityDimensions);
+  _vertexCount = 0;
+  _entityVertexOffsets = vector< vector<IndexType> >(numEntityDimensions, vector<IndexType>(1,0));
+  _entityVertices = vector< vector<IndexType> >(numEntityDimensions);
+  _entityHashTables = vector< vector<IndexType> >(numEntityDimensions);
   _activeCellsForEntities = vector< vector< vector< pair<unsigned, unsigned> > > >(numEntityDimensions); // pair entries are (cellIndex, entityIndexInCell) (entityIndexInCell aka subcord)
   _sidesForEntities = vector< vector< vector< unsigned > > >(numEntityDimensions);
   _parentEntities = vector< map< unsigned, vector< pair<unsigned, unsigned> > > >(numEntityDimensions); // map to possible parents
@@ -38,6 +39,10 @@ void MeshTopology::init(unsigned spaceDim) {
   _entityCellTopologyKeys = vector< vector< CellTopologyKey > >(numEntityDimensions);
   
   _gda = NULL;
+  
+  _cellGridBuildActiveCellCount = 0;
+  
+  _isPruned = false;
 }
 
 MeshTopology::MeshTopology(unsigned spaceDim, vector<PeriodicBCPtr> periodicBCs) {
@@ -141,13 +146,8 @@ map<string, long long> MeshTopology::approximateMemoryCosts() {
   
   variableCost["_spaceDim"] = sizeof(_spaceDim);
   
-  variableCost["_vertexMap"] = approximateMapSizeLLVM(_vertexMap);
-  
-  variableCost["_vertices"] = VECTOR_OVERHEAD; // for the outer vector _vertices.
-  for (vector< vector<double> >::iterator entryIt = _vertices.begin(); entryIt != _vertices.end(); entryIt++) {
-    variableCost["_vertices"] += approximateVectorSizeLLVM(*entryIt);
-  }
-  variableCost["_vertices"] += VECTOR_OVERHEAD * (_vertices.capacity() - _vertices.size());
+  variableCost["_vertexCoordinates"] = approximateVectorSizeLLVM(_vertexCoordinates);
+  variableCost["_vertexHashTable"] = approximateVectorSizeLLVM(_vertexHashTable);
   
   variableCost["_periodicBCs"] = approximateVectorSizeLLVM(_periodicBCs);
   
@@ -160,35 +160,18 @@ map<string, long long> MeshTopology::approximateMemoryCosts() {
   
   variableCost["_equivalentNodeViaPeriodicBC"] = approximateMapSizeLLVM(_equivalentNodeViaPeriodicBC); // for map _equivalentNodeViaPeriodicBC
   
-  variableCost["_entities"] = VECTOR_OVERHEAD; // for outer vector _entities
-  for (vector< vector< vector<IndexType> > >::iterator entryIt = _entities.begin(); entryIt != _entities.end(); entryIt++) {
-    variableCost["_entities"] += VECTOR_OVERHEAD; //
-    for (vector< vector<IndexType> >::iterator entry2It = entryIt->begin(); entry2It != entryIt->end(); entry2It++) {
-      variableCost["_entities"] += approximateVectorSizeLLVM(*entry2It);
-    }
-    variableCost["_entities"] += VECTOR_OVERHEAD * (entryIt->capacity() - entryIt->size());
+  variableCost["_entityVertexOffsets"] = VECTOR_OVERHEAD; // for outer vector _entityVertexOffsets
+  for (vector< vector<IndexType> >::iterator entryIt = _entityVertexOffsets.begin(); entryIt != _entityVertexOffsets.end(); entryIt++) {
+    variableCost["_entityVertexOffsets"] += approximateVectorSizeLLVM(*entryIt);
   }
-  variableCost["_entities"] += VECTOR_OVERHEAD * (_entities.capacity() - _entities.size());
-  
-  variableCost["_knownEntities"] = VECTOR_OVERHEAD; // for outer vector _knownEntities
-  for (vector< map< vector<IndexType>, IndexType > >::iterator entryIt = _knownEntities.begin(); entryIt != _knownEntities.end(); entryIt++) {
-    variableCost["_knownEntities"] += MAP_OVERHEAD; // for inner map
-    for (map< vector<IndexType>, IndexType >::iterator entry2It = entryIt->begin(); entry2It != entryIt->end(); entry2It++) {
-      vector<IndexType> entryVector = entry2It->first;
-      variableCost["_knownEntities"] += approximateVectorSizeLLVM(entryVector) + sizeof(IndexType);
-    }
+  variableCost["_entityVertices"] = VECTOR_OVERHEAD; // for outer vector _entityVertices
+  for (vector< vector<IndexType> >::iterator entryIt = _entityVertices.begin(); entryIt != _entityVertices.end(); entryIt++) {
+    variableCost["_entityVertices"] += approximateVectorSizeLLVM(*entryIt);
   }
-  variableCost["_knownEntities"] += MAP_OVERHEAD * (_knownEntities.capacity() - _knownEntities.size());
-  
-  variableCost["_canonicalEntityOrdering"] = VECTOR_OVERHEAD; // for outer vector _canonicalEntityOrdering
-  for (vector< vector< vector<IndexType> > >::iterator entryIt = _canonicalEntityOrdering.begin(); entryIt != _canonicalEntityOrdering.end(); entryIt++) {
-    variableCost["_canonicalEntityOrdering"] += VECTOR_OVERHEAD;
-    for (vector< vector<IndexType> >::iterator entry2It = entryIt->begin(); entry2It != entryIt->end(); entry2It++) {
-      variableCost["_canonicalEntityOrdering"] += approximateVectorSizeLLVM(*entry2It);
-    }
-    variableCost["_canonicalEntityOrdering"] += VECTOR_OVERHEAD * (entryIt->capacity() - entryIt->size());
+  variableCost["_entityHashTables"] = VECTOR_OVERHEAD; // for outer vector _entityHashTables
+  for (vector< vector<IndexType> >::iterator entryIt = _entityHashTables.begin(); entryIt != _entityHashTables.end(); entryIt++) {
+    variableCost["_entityHashTables"] += approximateVectorSizeLLVM(*entryIt);
   }
-  variableCost["_canonicalEntityOrdering"] += MAP_OVERHEAD * (_canonicalEntityOrdering.capacity() - _canonicalEntityOrdering.size());
   
   variableCost["_activeCellsForEntities"] += VECTOR_OVERHEAD; // for outer vector _activeCellsForEntities
   for (vector< vector< vector< pair<IndexType, unsigned> > > >::iterator entryIt = _activeCellsForEntities.begin(); entryIt != _activeCellsForEntities.end(); entryIt++) {
@@ -211,9 +194,9 @@ map<string, long long> MeshTopology::approximateMemoryCosts() {
   }
   variableCost["_sidesForEntities"] += VECTOR_OVERHEAD * (_sidesForEntities.capacity() - _sidesForEntities.size());
   
-  variableCost["_cellsForSideEntities"] = approximateMapSizeLLVM(_cellsForSideEntities);
+  variableCost["_cellsForSideEntities"] = approximateVectorSizeLLVM(_cellsForSideEntities);
   
-  variableCost["_boundarySides"] = approximateSetSizeLLVM(_boundarySides);
+  variableCost["_boundarySides"] = VECTOR_OVERHEAD + _boundarySides.capacity() / 8; // vector<bool> is a bitset
   
   variableCost["_parentEntities"] = VECTOR_OVERHEAD; // vector _parentEntities
   for (vector< map< IndexType, vector< pair<IndexType, unsigned> > > >::iterator entryIt = _parentEntities.begin(); entryIt != _parentEntities.end(); entryIt++) {
@@ -257,12 +240,22 @@ map<string, long long> MeshTopology::approximateMemoryCosts() {
   
   variableCost["_cells"] = VECTOR_OVERHEAD; // _cells vector
   for (vector< CellPtr >::iterator entryIt = _cells.begin(); entryIt != _cells.end(); entryIt++) {
+    if (entryIt->get() == NULL) continue; // pruned
     variableCost["_cells"] += (*entryIt)->approximateMemoryFootprint();
   }
   variableCost["_cells"] += sizeof(CellPtr) * (_cells.capacity() - _cells.size());
   
   variableCost["_activeCells"] = approximateSetSizeLLVM(_activeCells);
   variableCost["_rootCells"] = approximateSetSizeLLVM(_rootCells);
+  variableCost["_prunedOwnedCells"] = approximateSetSizeLLVM(_prunedOwnedCells);
+  variableCost["_prunedFirstChildIndices"] = approximateMapSizeLLVM(_prunedFirstChildIndices);
+  
+  variableCost["_cellGridBuckets"] = VECTOR_OVERHEAD;
+  for (vector< vector<IndexType> >::iterator entryIt = _cellGridBuckets.begin(); entryIt != _cellGridBuckets.end(); entryIt++) {
+    variableCost["_cellGridBuckets"] += approximateVectorSizeLLVM(*entryIt);
+  }
+  variableCost["_cellGridBuckets"] += VECTOR_OVERHEAD * (_cellGridBuckets.capacity() - _cellGridBuckets.size());
+  variableCost["_cellBoundingBoxes"] = approximateVectorSizeLLVM(_cellBoundingBoxes);
   
   variableCost["_cellIDsWithCurves"] = approximateSetSizeLLVM(_cellIDsWithCurves);
   
@@ -316,7 +309,7 @@ unsigned MeshTopology::addCell(CellTopoPtr cellTopo, const vector<unsigned> &cel
     else cellEntityPermutations.push_back(vector<unsigned>(0)); // empty vector for d=0 -- we don't track permutations here...
     cellEntityIndices[d] = vector<unsigned>(entityCount);
     for (int j=0; j<entityCount; j++) {
-      // for now, we treat vertices just like all the others--could save a bit of memory, etc. by not storing in _knownEntities[0], etc.
+      // we treat vertices just like all the others (though they are not stored in the entity tables: a vertex's entity index is its vertex index)
       unsigned entityIndex, entityPermutation;
       vector< unsigned > nodes;
       if (d != 0) {
@@ -361,6 +354,13 @@ unsigned MeshTopology::addCell(CellTopoPtr cellTopo, const vector<unsigned> &cel
   if (parentCellIndex != -1) {
     cell->setParent(getCell(parentCellIndex));
   }
+  if (_cellGridBuckets.size() > 0) {
+    if (parentCellIndex == -1) {
+      _cellGridBuckets.clear(); // a new root cell may lie outside the grid; rebuild on next use
+    } else {
+      addCellToGrid(cellIndex); // children lie within their parent's bounding box
+    }
+  }
   
   // set neighbors:
   unsigned sideDim = _spaceDim - 1;
@@ -379,12 +379,12 @@ unsigned MeshTopology::addCell(CellTopoPtr cellTopo, const vector<unsigned> &cel
       CellPtr secondCell = _cells[secondNeighbor.first];
       firstCell->setNeighbor(firstNeighbor.second, secondNeighbor.first, secondNeighbor.second);
       secondCell->setNeighbor(secondNeighbor.second, firstNeighbor.first, firstNeighbor.second);
-      if (_boundarySides.find(sideEntityIndex) != _boundarySides.end()) {
+      if (isBoundarySide(sideEntityIndex)) {
         if (_childEntities[sideDim].find(sideEntityIndex) != _childEntities[sideDim].end()) {
           cout << "Unhandled case: boundary side acquired neighbor after being refined.\n";
           TEUCHOS_TEST_FOR_EXCEPTION(true, std::invalid_argument, "Unhandled case: boundary side acquired neighbor after being refined");
         }
-        _boundarySides.erase(sideEntityIndex);
+        setBoundarySide(sideEntityIndex, false);
       }
       // if the pre-existing neighbor is refined, set its descendants to have the appropriate neighbor.
       if (firstCell->isParent()) {
@@ -405,7 +405,7 @@ unsigned MeshTopology::addCell(CellTopoPtr cellTopo, const vector<unsigned> &cel
       }
     } else if (cellCountForSide == 1) { // just this side
       if (parentCellIndex == -1) { // for now anyway, we are on the boundary...
-        _boundarySides.insert(sideEntityIndex);
+        setBoundarySide(sideEntityIndex, true);
       } else {
         vector< pair<unsigned, unsigned> > sideAncestry = getConstrainingSideAncestry(sideEntityIndex);
         // the last entry, if any, should refer to an active cell's side...
@@ -454,7 +454,11 @@ unsigned MeshTopology::addCell(CellTopoPtr cellTopo, const vector<unsigned> &cel
 }
 
 void MeshTopology::addCellForSide(unsigned int cellIndex, unsigned int sideOrdinal, unsigned int sideEntityIndex) {
-  if (_cellsForSideEntities.find(sideEntityIndex) == _cellsForSideEntities.end()) {
+  if (_cellsForSideEntities.size() <= sideEntityIndex) { // expand container
+    pair< unsigned, unsigned > noCell = make_pair(-1, -1);
+    _cellsForSideEntities.resize(sideEntityIndex + 1, make_pair(noCell, noCell));
+  }
+  if (_cellsForSideEntities[sideEntityIndex].first.first == -1) {
     pair< unsigned, unsigned > cell1 = make_pair(cellIndex, sideOrdinal);
     pair< unsigned, unsigned > cell2 = make_pair(-1, -1);
     _cellsForSideEntities[sideEntityIndex] = make_pair(cell1, cell2);
@@ -495,19 +499,19 @@ void MeshTopology::addEdgeCurve(pair<unsigned,unsigned> edge, ParametricCurvePtr
   
   std::sort(edgeNodes.begin(), edgeNodes.end());
   
-  if (_knownEntities[edgeDim].find(edgeNodes) == _knownEntities[edgeDim].end() ) {
+  unsigned edgeIndex = findEntity(edgeDim, edgeNodes);
+  if (edgeIndex == -1) {
     TEUCHOS_TEST_FOR_EXCEPTION(true, std::invalid_argument, "edge not found.");
   }
-  unsigned edgeIndex = _knownEntities[edgeDim][edgeNodes];
   if (getChildEntities(edgeDim, edgeIndex).size() > 0) {
     TEUCHOS_TEST_FOR_EXCEPTION(true, std::invalid_argument, "setting curves along broken edges not supported.  Should set for each piece separately.");
   }
   
   // check that the curve agrees with the vertices in the mesh:
-  vector<double> v0 = getVertex(edge.first);
-  vector<double> v1 = getVertex(edge.second);
+  const double* v0 = getVertexCoordinates(edge.first);
+  const double* v1 = getVertexCoordinates(edge.second);
   
-  int spaceDim = v0.size();
+  int spaceDim = _spaceDim;
   FieldContainer<double> curve0(spaceDim);
   FieldContainer<double> curve1(spaceDim);
   curve->value(0, curve0(0), curve0(1));
@@ -552,10 +556,18 @@ unsigned MeshTopology::addEntity(CellTopoPtr entityTopo, const vector<unsigned>
   
   if ( entityIndex == -1 ) {
     // new entity
-    entityIndex = _entities[d].size();
-    _entities[d].push_back(sortedVertices);
-    _knownEntities[d].insert(make_pair(sortedVertices, entityIndex));
-    if (d != 0) _canonicalEntityOrdering[d].push_back(entityVertices);
+    entityIndex = _entityVertexOffsets[d].size() - 1;
+    _entityVertices[d].insert(_entityVertices[d].end(), entityVertices.begin(), entityVertices.end());
+    _entityVertexOffsets[d].push_back(_entityVertices[d].size());
+    // keep the hash table at most half full, so that probe sequences stay short
+    if (2 * _entityVertexOffsets[d].size() > _entityHashTables[d].size()) {
+      _entityHashTables[d].assign(max((IndexType)64, 2 * (IndexType)_entityHashTables[d].size()), (IndexType)-1);
+      for (IndexType existingEntityIndex=0; existingEntityIndex<=entityIndex; existingEntityIndex++) {
+        addEntityToHashTable(d, existingEntityIndex);
+      }
+    } else {
+      addEntityToHashTable(d, entityIndex);
+    }
     entityPermutation = 0;
     if (_knownTopologies.find(entityTopo->getKey()) == _knownTopologies.end()) {
       _knownTopologies[entityTopo->getKey()] = entityTopo;
@@ -567,7 +579,7 @@ unsigned MeshTopology::addEntity(CellTopoPtr entityTopo, const vector<unsigned>
     //
     //    Camellia::print("canonicalEntityOrdering",_canonicalEntityOrdering[d][entityIndex]);
     if (d==0) entityPermutation = 0;
-    else entityPermutation = CamelliaCellTools::permutationMatchingOrder(entityTopo, _canonicalEntityOrdering[d][entityIndex], canonicalVertices);
+    else entityPermutation = CamelliaCellTools::permutationMatchingOrder(entityTopo, getEntityVertexIndices(d, entityIndex), canonicalVertices);
   }
   return entityIndex;
 }
@@ -620,7 +632,7 @@ vector<IndexType> MeshTopology::getCanonicalEntityNodesViaPeriodicBCs(unsigned d
   vector<IndexType> sortedNodes(myEntityNodes.begin(),myEntityNodes.end());
   std::sort(sortedNodes.begin(), sortedNodes.end());
   
-  if (_knownEntities[d].find(sortedNodes) != _knownEntities[d].end()) {
+  if (findEntity(d, sortedNodes) != -1) {
     return myEntityNodes;
   } else {
     // compute the intersection of the periodic BCs that match each node in nodeSet
@@ -658,7 +670,7 @@ vector<IndexType> MeshTopology::getCanonicalEntityNodesViaPeriodicBCs(unsigned d
       vector<IndexType> sortedEquivalentNodeVector = equivalentNodeVector;
       std::sort(sortedEquivalentNodeVector.begin(), sortedEquivalentNodeVector.end());
       
-      if (_knownEntities[d].find(sortedEquivalentNodeVector) != _knownEntities[d].end()) {
+      if (findEntity(d, sortedEquivalentNodeVector) != -1) {
         return equivalentNodeVector;
       }
     }
@@ -676,8 +688,9 @@ bool MeshTopology::cellHasCurvedEdges(unsigned cellIndex) {
   unsigned edgeDim = 1;
   for (int edgeOrdinal=0; edgeOrdinal<edgeCount; edgeOrdinal++) {
     unsigned edgeIndex = cell->entityIndex(edgeDim, edgeOrdinal);
-    unsigned v0 = _canonicalEntityOrdering[edgeDim][edgeIndex][0];
-    unsigned v1 = _canonicalEntityOrdering[edgeDim][edgeIndex][1];
+    vector<IndexType> edgeVertices = getEntityVertexIndices(edgeDim, edgeIndex);
+    unsigned v0 = edgeVertices[0];
+    unsigned v1 = edgeVertices[1];
     pair<unsigned, unsigned> edge = make_pair(v0, v1);
     pair<unsigned, unsigned> edgeReversed = make_pair(v1, v0);
     if (_edgeToCurveMap.find(edge) != _edgeToCurveMap.end()) {
@@ -722,98 +735,299 @@ vector<IndexType> MeshTopology::cellIDsForPoints(const FieldContainer<double> &p
   
   int spaceDim = this->getSpaceDim();
   
-  set<GlobalIndexType> rootCellIndices = this->getRootCellIndices();
-  
-  // NOTE: the above does depend on the domain of the mesh remaining fixed after refinements begin.
+  // bounding boxes computed from vertices need not contain curvilinear cells, so in that case we search from the root cells
+  bool useCellGrid = (_cellIDsWithCurves.size() == 0) && (_activeCells.size() > 0);
+  if (useCellGrid) {
+    if ((_cellGridBuckets.size() == 0) || (_activeCells.size() > 4 * _cellGridBuildActiveCellCount)) {
+      buildCellGrid();
+    }
+  }
   
+  vector<double> point(spaceDim);
   for (int pointIndex=0; pointIndex<numPoints; pointIndex++) {
-    vector<double> point;
-    
     for (int d=0; d<spaceDim; d++) {
-      point.push_back(physicalPoints(pointIndex,d));
+      point[d] = physicalPoints(pointIndex,d);
     }
     
-    // find the element from the original mesh that contains this point
-    CellPtr cell;
-    for (set<GlobalIndexType>::iterator cellIt = rootCellIndices.begin(); cellIt != rootCellIndices.end(); cellIt++) {
-      GlobalIndexType cellID = *cellIt;
-      int cubatureDegreeForCell = 1;
-      if (_gda != NULL) {
-        cubatureDegreeForCell = _gda->getCubatureDegree(cellID);
+    GlobalIndexType cellID = -1;
+    if (useCellGrid) {
+      int bucketOrdinal = 0, stride = 1;
+      bool pointInGrid = true;
+      for (int d=0; d<spaceDim; d++) {
+        double relativeCoord = (point[d] - _cellGridMin[d]) / _cellGridSpacing[d];
+        if ((relativeCoord < 0) || (relativeCoord > _cellGridDims[d])) {
+          pointInGrid = false;
+          break;
+        }
+        int bucketCoord = min((int)relativeCoord, _cellGridDims[d] - 1);
+        bucketOrdinal += stride * bucketCoord;
+        stride *= _cellGridDims[d];
       }
-      if (cellContainsPoint(cellID,point,cubatureDegreeForCell)) {
-        cell = getCell(cellID);
-        break;
+      if (!pointInGrid) {
+        // outside the bounding box of the mesh: no cell contains this point
+        cellIDs.push_back(cellID);
+        continue;
       }
+      // bucket entries are sorted, so that points on cell interfaces are consistently assigned to the lowest-numbered cell
+      const vector<IndexType>* candidates = &_cellGridBuckets[bucketOrdinal];
+      for (vector<IndexType>::const_iterator cellIt = candidates->begin(); cellIt != candidates->end(); cellIt++) {
+        if (!cellBoundingBoxContainsPoint(*cellIt, point)) continue;
+        int cubatureDegreeForCell = 1;
+        if (_gda != NULL) {
+          cubatureDegreeForCell = _gda->getCubatureDegree(*cellIt);
+        }
+        if (cellContainsPoint(*cellIt, point, cubatureDegreeForCell)) {
+          cellID = *cellIt;
+          break;
+        }
+      }
+      if (cellID == -1) {
+        // e.g. a point within tolerance of the mesh boundary, or within the bounding box of a non-convex domain: use the tree search
+        cellID = cellIDForPointFromRootCells(point);
+      }
+    } else {
+      cellID = cellIDForPointFromRootCells(point);
     }
-    if (cell.get() != NULL) {
-      while ( cell->isParent() ) {
-        int numChildren = cell->numChildren();
-        bool foundMatchingChild = false;
-        for (int childOrdinal = 0; childOrdinal < numChildren; childOrdinal++) {
-          CellPtr child = cell->children()[childOrdinal];
-          int cubatureDegreeForCell = 1;
-          if (_gda != NULL) {
-            cubatureDegreeForCell = _gda->getCubatureDegree(child->cellIndex());
-          }
-          if ( cellContainsPoint(child->cellIndex(),point,cubatureDegreeForCell) ) {
-            cell = child;
-            foundMatchingChild = true;
-            break;
+    cellIDs.push_back(cellID);
+  }
+  return cellIDs;
+}
+
+IndexType MeshTopology::cellIDForPointFromRootCells(const vector<double> &point) {
+  // finds the root cell containing the point, and then descends the refinement tree to find an active cell
+  int spaceDim = this->getSpaceDim();
+  
+  set<GlobalIndexType> rootCellIndices = this->getRootCellIndices();
+  
+  // NOTE: the above does depend on the domain of the mesh remaining fixed after refinements begin.
+  
+  // find the element from the original mesh that contains this point
+  CellPtr cell;
+  for (set<GlobalIndexType>::iterator cellIt = rootCellIndices.begin(); cellIt != rootCellIndices.end(); cellIt++) {
+    GlobalIndexType cellID = *cellIt;
+    int cubatureDegreeForCell = 1;
+    if (_gda != NULL) {
+      cubatureDegreeForCell = _gda->getCubatureDegree(cellID);
+    }
+    if (cellContainsPoint(cellID,point,cubatureDegreeForCell)) {
+      cell = getCell(cellID);
+      break;
+    }
+  }
+  if (cell.get() != NULL) {
+    while ( cell->isParent() ) {
+      int numChildren = cell->numChildren();
+      bool foundMatchingChild = false;
+      for (int childOrdinal = 0; childOrdinal < numChildren; childOrdinal++) {
+        CellPtr child = cell->children()[childOrdinal];
+        int cubatureDegreeForCell = 1;
+        if (_gda != NULL) {
+          cubatureDegreeForCell = _gda->getCubatureDegree(child->cellIndex());
+        }
+        if ( cellContainsPoint(child->cellIndex(),point,cubatureDegreeForCell) ) {
+          cell = child;
+          foundMatchingChild = true;
+          break;
+        }
+      }
+      if (!foundMatchingChild) {
+        cout << "parent matches, but none of its children do... will return nearest cell centroid\n";
+        int numVertices = cell->vertices().size();
+        FieldContainer<double> vertices(numVertices,spaceDim);
+        vector<unsigned> vertexIndices = cell->vertices();
+        
+        //vertices.resize(numVertices,dimension);
+        for (unsigned vertexOrdinal = 0; vertexOrdinal < numVertices; vertexOrdinal++) {
+          for (int d=0; d<spaceDim; d++) {
+            vertices(vertexOrdinal,d) = getVertexCoordinates(vertexIndices[vertexOrdinal])[d];
           }
         }
-        if (!foundMatchingChild) {
-          cout << "parent matches, but none of its children do... will return nearest cell centroid\n";
-          int numVertices = cell->vertices().size();
+        
+        cout << "parent vertices:\n" << vertices;
+        double minDistance = numeric_limits<double>::max();
+        int childSelected = -1;
+        for (int childIndex = 0; childIndex < numChildren; childIndex++) {
+          CellPtr child = cell->children()[childIndex];
+          int numVertices = child->vertices().size();
           FieldContainer<double> vertices(numVertices,spaceDim);
-          vector<unsigned> vertexIndices = cell->vertices();
+          vector<unsigned> vertexIndices = child->vertices();
           
           //vertices.resize(numVertices,dimension);
           for (unsigned vertexOrdinal = 0; vertexOrdinal < numVertices; vertexOrdinal++) {
             for (int d=0; d<spaceDim; d++) {
-              vertices(vertexOrdinal,d) = getVertex(vertexIndices[vertexOrdinal])[d];
+              vertices(vertexOrdinal,d) = getVertexCoordinates(vertexIndices[vertexOrdinal])[d];
             }
           }
+          cout << "child " << childIndex << ", vertices:\n" << vertices;
+          vector<double> cellCentroid = getCellCentroid(child->cellIndex());
+          double squaredDistance = 0;
+          for (int d=0; d<spaceDim; d++) {
+            squaredDistance += (cellCentroid[d] - point[d]) * (cellCentroid[d] - point[d]);
+          }
           
-          cout << "parent vertices:\n" << vertices;
-          double minDistance = numeric_limits<double>::max();
-          int childSelected = -1;
-          for (int childIndex = 0; childIndex < numChildren; childIndex++) {
-            CellPtr child = cell->children()[childIndex];
-            int numVertices = child->vertices().size();
-            FieldContainer<double> vertices(numVertices,spaceDim);
-            vector<unsigned> vertexIndices = child->vertices();
-            
-            //vertices.resize(numVertices,dimension);
-            for (unsigned vertexOrdinal = 0; vertexOrdinal < numVertices; vertexOrdinal++) {
-              for (int d=0; d<spaceDim; d++) {
-                vertices(vertexOrdinal,d) = getVertex(vertexIndices[vertexOrdinal])[d];
-              }
-            }
-            cout << "child " << childIndex << ", vertices:\n" << vertices;
-            vector<double> cellCentroid = getCellCentroid(child->cellIndex());
-            double squaredDistance = 0;
-            for (int d=0; d<spaceDim; d++) {
-              squaredDistance += (cellCentroid[d] - physicalPoints(pointIndex,d)) * (cellCentroid[d] - physicalPoints(pointIndex,d));
-            }
-            
-            double distance = sqrt(squaredDistance);
-            if (distance < minDistance) {
-              minDistance = distance;
-              childSelected = childIndex;
-            }
+          double distance = sqrt(squaredDistance);
+          if (distance < minDistance) {
+            minDistance = distance;
+            childSelected = childIndex;
           }
-          cell = cell->children()[childSelected];
         }
+        cell = cell->children()[childSelected];
       }
     }
-    GlobalIndexType cellID = -1;
-    if (cell.get() != NULL) {
-      cellID = cell->cellIndex();
+  }
+  GlobalIndexType cellID = -1;
+  if (cell.get() != NULL) {
+    cellID = cell->cellIndex();
+  }
+  return cellID;
+}
+
+void MeshTopology::storeCellBoundingBox(IndexType cellIndex) {
+  IndexType boxSize = 2 * _spaceDim;
+  if (_cellBoundingBoxes.size() < (cellIndex + 1) * boxSize) {
+    _cellBoundingBoxes.resize(_cells.size() * boxSize);
+  }
+  double* minCoords = &_cellBoundingBoxes[cellIndex * boxSize];
+  double* maxCoords = minCoords + _spaceDim;
+  const vector<IndexType>* vertexIndices = &getCell(cellIndex)->vertices();
+  const double* firstVertex = getVertexCoordinates((*vertexIndices)[0]);
+  for (int d=0; d<_spaceDim; d++) {
+    minCoords[d] = firstVertex[d];
+    maxCoords[d] = firstVertex[d];
+  }
+  for (int vertexOrdinal=1; vertexOrdinal<vertexIndices->size(); vertexOrdinal++) {
+    const double* vertex = getVertexCoordinates((*vertexIndices)[vertexOrdinal]);
+    for (int d=0; d<_spaceDim; d++) {
+      minCoords[d] = min(minCoords[d], vertex[d]);
+      maxCoords[d] = max(maxCoords[d], vertex[d]);
     }
-    cellIDs.push_back(cellID);
   }
-  return cellIDs;
+  // inflate slightly, so that points that cellContainsPoint() accepts (it allows a small tolerance) pass the bounding box test
+  double maxExtent = 0;
+  for (int d=0; d<_spaceDim; d++) {
+    maxExtent = max(maxExtent, maxCoords[d] - minCoords[d]);
+  }
+  double tol = 1e-8 * maxExtent;
+  for (int d=0; d<_spaceDim; d++) {
+    minCoords[d] -= tol;
+    maxCoords[d] += tol;
+  }
+}
+
+bool MeshTopology::cellBoundingBoxContainsPoint(IndexType cellIndex, const vector<double> &point) {
+  const double* minCoords = &_cellBoundingBoxes[cellIndex * 2 * _spaceDim];
+  const double* maxCoords = minCoords + _spaceDim;
+  for (int d=0; d<_spaceDim; d++) {
+    if ((point[d] < minCoords[d]) || (point[d] > maxCoords[d])) return false;
+  }
+  return true;
+}
+
+vector<int> MeshTopology::cellGridBucketsForCell(IndexType cellIndex) {
+  const double* minCoords = &_cellBoundingBoxes[cellIndex * 2 * _spaceDim];
+  const double* maxCoords = minCoords + _spaceDim;
+  vector<int> minBucket(_spaceDim), maxBucket(_spaceDim);
+  for (int d=0; d<_spaceDim; d++) {
+    minBucket[d] = (int) floor((minCoords[d] - _cellGridMin[d]) / _cellGridSpacing[d]);
+    maxBucket[d] = (int) floor((maxCoords[d] - _cellGridMin[d]) / _cellGridSpacing[d]);
+    minBucket[d] = max(0, min(minBucket[d], _cellGridDims[d] - 1));
+    maxBucket[d] = max(0, min(maxBucket[d], _cellGridDims[d] - 1));
+  }
+  vector<int> bucketOrdinals;
+  vector<int> bucket = minBucket;
+  while (true) {
+    int bucketOrdinal = 0, stride = 1;
+    for (int d=0; d<_spaceDim; d++) {
+      bucketOrdinal += stride * bucket[d];
+      stride *= _cellGridDims[d];
+    }
+    bucketOrdinals.push_back(bucketOrdinal);
+    // increment, odometer-style:
+    int d = 0;
+    while ((d < _spaceDim) && (bucket[d] == maxBucket[d])) {
+      bucket[d] = minBucket[d];
+      d++;
+    }
+    if (d == _spaceDim) break;
+    bucket[d]++;
+  }
+  return bucketOrdinals;
+}
+
+void MeshTopology::addCellToGrid(IndexType cellIndex) {
+  storeCellBoundingBox(cellIndex);
+  vector<int> bucketOrdinals = cellGridBucketsForCell(cellIndex);
+  for (vector<int>::iterator bucketIt = bucketOrdinals.begin(); bucketIt != bucketOrdinals.end(); bucketIt++) {
+    vector<IndexType>* bucket = &_cellGridBuckets[*bucketIt];
+    bucket->insert(lower_bound(bucket->begin(), bucket->end(), cellIndex), cellIndex);
+  }
+}
+
+void MeshTopology::removeCellFromGrid(IndexType cellIndex) {
+  vector<int> bucketOrdinals = cellGridBucketsForCell(cellIndex);
+  for (vector<int>::iterator bucketIt = bucketOrdinals.begin(); bucketIt != bucketOrdinals.end(); bucketIt++) {
+    vector<IndexType>* bucket = &_cellGridBuckets[*bucketIt];
+    vector<IndexType>::iterator entryIt = lower_bound(bucket->begin(), bucket->end(), cellIndex);
+    if ((entryIt != bucket->end()) && (*entryIt == cellIndex)) bucket->erase(entryIt);
+  }
+}
+
+void MeshTopology::buildCellGrid() {
+  // compute the bounding boxes of the active cells, and from these the bounding box of the mesh
+  _cellBoundingBoxes.resize(_cells.size() * 2 * _spaceDim);
+  vector<double> domainMin, domainMax;
+  for (set<IndexType>::iterator cellIt = _activeCells.begin(); cellIt != _activeCells.end(); cellIt++) {
+    storeCellBoundingBox(*cellIt);
+    const double* minCoords = &_cellBoundingBoxes[*cellIt * 2 * _spaceDim];
+    const double* maxCoords = minCoords + _spaceDim;
+    if (cellIt == _activeCells.begin()) {
+      domainMin.assign(minCoords, minCoords + _spaceDim);
+      domainMax.assign(maxCoords, maxCoords + _spaceDim);
+    } else {
+      for (int d=0; d<_spaceDim; d++) {
+        domainMin[d] = min(domainMin[d], minCoords[d]);
+        domainMax[d] = max(domainMax[d], maxCoords[d]);
+      }
+    }
+  }
+  
+  // choose roughly one active cell per bucket, with approximately cubical buckets
+  int activeCellCount = _activeCells.size();
+  double maxExtent = 0;
+  for (int d=0; d<_spaceDim; d++) {
+    maxExtent = max(maxExtent, domainMax[d] - domainMin[d]);
+  }
+  double volume = 1.0;
+  int nonDegenerateDimensions = 0;
+  for (int d=0; d<_spaceDim; d++) {
+    double extent = domainMax[d] - domainMin[d];
+    if (extent > 1e-12 * maxExtent) {
+      volume *= extent;
+      nonDegenerateDimensions++;
+    }
+  }
+  double bucketWidth = (nonDegenerateDimensions > 0) ? pow(volume / activeCellCount, 1.0 / nonDegenerateDimensions) : 1.0;
+  
+  _cellGridMin = domainMin;
+  _cellGridSpacing.resize(_spaceDim);
+  _cellGridDims.resize(_spaceDim);
+  int bucketCount = 1;
+  for (int d=0; d<_spaceDim; d++) {
+    double extent = domainMax[d] - domainMin[d];
+    _cellGridDims[d] = (extent > 1e-12 * maxExtent) ? max(1, (int) ceil(extent / bucketWidth)) : 1;
+    _cellGridSpacing[d] = (extent > 0) ? extent / _cellGridDims[d] : 1.0;
+    bucketCount *= _cellGridDims[d];
+  }
+  
+  _cellGridBuckets.clear();
+  _cellGridBuckets.resize(bucketCount);
+  for (set<IndexType>::iterator cellIt = _activeCells.begin(); cellIt != _activeCells.end(); cellIt++) {
+    vector<int> bucketOrdinals = cellGridBucketsForCell(*cellIt);
+    for (vector<int>::iterator bucketIt = bucketOrdinals.begin(); bucketIt != bucketOrdinals.end(); bucketIt++) {
+      _cellGridBuckets[*bucketIt].push_back(*cellIt); // _activeCells is ordered, so the buckets come out sorted
+    }
+  }
+  _cellGridBuildActiveCellCount = activeCellCount;
 }
 
 CellPtr MeshTopology::findCellWithVertices(const vector< vector<double> > &cellVertices) {
@@ -857,10 +1071,227 @@ CellPtr MeshTopology::findCellWithVertices(const vector< vector<double> > &cellV
   return cell;
 }
 
+set<IndexType> MeshTopology::getAncestorCellIndices(const set<IndexType> &cellIndices) {
+  set<IndexType> ancestors;
+  for (set<IndexType>::const_iterator cellIt = cellIndices.begin(); cellIt != cellIndices.end(); cellIt++) {
+    CellPtr parent = getCell(*cellIt)->getParent();
+    while (parent.get() != NULL) {
+      if (ancestors.find(parent->cellIndex()) != ancestors.end()) break; // this ancestor (and therefore its ancestors) already recorded
+      ancestors.insert(parent->cellIndex());
+      parent = parent->getParent();
+    }
+  }
+  return ancestors;
+}
+
+set<IndexType> MeshTopology::getGhostCellIndices(const set<IndexType> &ownedCellIndices) {
+  set<IndexType> ghostCells;
+  unsigned vertexDim = 0;
+  for (set<IndexType>::const_iterator cellIt = ownedCellIndices.begin(); cellIt != ownedCellIndices.end(); cellIt++) {
+    CellPtr cell = getCell(*cellIt);
+
+    // active cells that share a vertex with this one:
+    const vector<IndexType>* vertexIndices = &cell->vertices();
+    for (vector<IndexType>::const_iterator vertexIt = vertexIndices->begin(); vertexIt != vertexIndices->end(); vertexIt++) {
+      if (_activeCellsForEntities[vertexDim].size() <= *vertexIt) continue;
+      const vector< pair<IndexType,unsigned> >* activeCellEntries = &_activeCellsForEntities[vertexDim][*vertexIt];
+      for (vector< pair<IndexType,unsigned> >::const_iterator entryIt = activeCellEntries->begin(); entryIt != activeCellEntries->end(); entryIt++) {
+        ghostCells.insert(entryIt->first);
+      }
+    }
+
+    // in 3D, active cells that share an edge with this one, or contain a coarser edge or face that constrains one of its edges
+    // (a coarser cell may share only a broken edge with this one, with none of its vertices)
+    unsigned edgeDim = 1;
+    if (edgeDim < _spaceDim - 1) {
+      int edgeCount = cell->topology()->getSubcellCount(edgeDim);
+      for (int edgeOrdinal=0; edgeOrdinal<edgeCount; edgeOrdinal++) {
+        IndexType edgeIndex = cell->entityIndex(edgeDim, edgeOrdinal);
+        vector< pair<IndexType, unsigned> > entities; // (entity index, dimension)
+        entities.push_back(make_pair(edgeIndex, edgeDim));
+        entities.push_back(make_pair(getConstrainingEntityIndexOfLikeDimension(edgeDim, edgeIndex), edgeDim));
+        pair<IndexType, unsigned> constrainingEntity = getConstrainingEntity(edgeDim, edgeIndex);
+        entities.push_back(make_pair(constrainingEntity.first, constrainingEntity.second));
+        for (vector< pair<IndexType, unsigned> >::iterator entityIt = entities.begin(); entityIt != entities.end(); entityIt++) {
+          if (_activeCellsForEntities[entityIt->second].size() <= entityIt->first) continue;
+          const vector< pair<IndexType,unsigned> >* activeCellEntries = &_activeCellsForEntities[entityIt->second][entityIt->first];
+          for (vector< pair<IndexType,unsigned> >::const_iterator entryIt = activeCellEntries->begin(); entryIt != activeCellEntries->end(); entryIt++) {
+            ghostCells.insert(entryIt->first);
+          }
+        }
+      }
+    }
+
+    // side neighbors: these may be coarser than the cell (hanging vertices are not vertices of the coarse neighbor), or
+    // inactive peers whose active descendants lie along the side.
+    int sideCount = cell->getSideCount();
+    for (int sideOrdinal=0; sideOrdinal<sideCount; sideOrdinal++) {
+      pair<GlobalIndexType, unsigned> neighborInfo = cell->getNeighborInfo(sideOrdinal);
+      if (neighborInfo.first == -1) continue; // boundary
+      CellPtr neighbor = getCell(neighborInfo.first);
+      vector< pair< IndexType, unsigned> > neighborDescendants = neighbor->getDescendantsForSide(neighborInfo.second);
+      for (vector< pair< IndexType, unsigned> >::iterator descIt = neighborDescendants.begin(); descIt != neighborDescendants.end(); descIt++) {
+        ghostCells.insert(descIt->first);
+      }
+    }
+  }
+  for (set<IndexType>::const_iterator cellIt = ownedCellIndices.begin(); cellIt != ownedCellIndices.end(); cellIt++) {
+    ghostCells.erase(*cellIt);
+  }
+  return ghostCells;
+}
+
+set<IndexType> MeshTopology::getRankLocalCellIndices(const set<IndexType> &ownedCellIndices) {
+  set<IndexType> rankLocalCells = getGhostCellIndices(ownedCellIndices);
+  rankLocalCells.insert(ownedCellIndices.begin(), ownedCellIndices.end());
+  set<IndexType> ancestors = getAncestorCellIndices(rankLocalCells);
+  rankLocalCells.insert(ancestors.begin(), ancestors.end());
+  return rankLocalCells;
+}
+
+bool MeshTopology::isPruned() {
+  return _isPruned;
+}
+
+bool MeshTopology::cellIsStored(IndexType cellIndex) {
+  return (cellIndex < _cells.size()) && (_cells[cellIndex].get() != NULL);
+}
+
+void MeshTopology::pruneToRankLocalCells(const set<IndexType> &ownedCellIndices) {
+  TEUCHOS_TEST_FOR_EXCEPTION((_transformationFunction.get() != NULL) || (_edgeToCurveMap.size() > 0), std::invalid_argument,
+                             "pruneToRankLocalCells() does not support curvilinear geometry");
+  if (_isPruned) {
+    // the ghosts of cells we did not own before may not be stored here
+    for (set<IndexType>::const_iterator cellIt = ownedCellIndices.begin(); cellIt != ownedCellIndices.end(); cellIt++) {
+      TEUCHOS_TEST_FOR_EXCEPTION(!cellIsStored(*cellIt), std::invalid_argument, "owned cell is not stored in this pruned topology");
+      CellPtr ancestor = getCell(*cellIt);
+      while ((ancestor.get() != NULL) && (_prunedOwnedCells.find(ancestor->cellIndex()) == _prunedOwnedCells.end())) {
+        ancestor = ancestor->getParent();
+      }
+      TEUCHOS_TEST_FOR_EXCEPTION(ancestor.get() == NULL, std::invalid_argument,
+                                 "a pruned topology can only be pruned to cells that were owned (or descend from cells that were owned) before");
+    }
+  }
+  
+  set<IndexType> cellsToKeep = getRankLocalCellIndices(ownedCellIndices);
+  // refinement creates all of a cell's children at once, so we also keep the siblings of the cells we need
+  set<IndexType> rankLocalCells = cellsToKeep;
+  for (set<IndexType>::iterator cellIt = rankLocalCells.begin(); cellIt != rankLocalCells.end(); cellIt++) {
+    vector<IndexType> childIndices = getCell(*cellIt)->getChildIndices();
+    cellsToKeep.insert(childIndices.begin(), childIndices.end());
+  }
+  
+  // Record the steps that build the kept cells: adding a root cell, or refining a kept cell (at the index of its first child).
+  // Cell indices are assigned in creation order, so replaying these in order of cell index reproduces the kept cells' indices.
+  // A kept cell that is refined, none of whose children are kept, is still refined, but its children are not stored.
+  unsigned sideDim = _spaceDim - 1;
+  vector<IndexType> stepCellIndices;
+  vector<IndexType> refinedCellIndices; // -1 for root cells
+  vector<RefinementPatternPtr> refPatterns;
+  vector<bool> childrenAreStored;
+  vector< CellTopoPtr > rootTopos;
+  vector< vector< vector<double> > > rootVertices;
+  vector< vector<bool> > rootSideIsBoundary; // rootSideIsBoundary[rootOrdinal][sideOrdinal]
+  for (set<IndexType>::iterator cellIt = cellsToKeep.begin(); cellIt != cellsToKeep.end(); cellIt++) {
+    CellPtr cell = getCell(*cellIt);
+    CellPtr parent = cell->getParent();
+    if (parent.get() == NULL) {
+      stepCellIndices.push_back(*cellIt);
+      refinedCellIndices.push_back(-1);
+      refPatterns.push_back(Teuchos::null);
+      childrenAreStored.push_back(false);
+      rootTopos.push_back(cell->topology());
+      vector< vector<double> > vertices;
+      const vector<IndexType>* vertexIndices = &cell->vertices();
+      for (int vertexOrdinal=0; vertexOrdinal<vertexIndices->size(); vertexOrdinal++) {
+        vertices.push_back(getVertex((*vertexIndices)[vertexOrdinal]));
+      }
+      rootVertices.push_back(vertices);
+      int sideCount = cell->getSideCount();
+      vector<bool> sideIsBoundary(sideCount);
+      for (int sideOrdinal=0; sideOrdinal<sideCount; sideOrdinal++) {
+        sideIsBoundary[sideOrdinal] = isBoundarySide(cell->entityIndex(sideDim, sideOrdinal));
+      }
+      rootSideIsBoundary.push_back(sideIsBoundary);
+    } else if (parent->getChildIndices()[0] == *cellIt) {
+      stepCellIndices.push_back(*cellIt);
+      refinedCellIndices.push_back(parent->cellIndex());
+      refPatterns.push_back(parent->refinementPattern());
+      childrenAreStored.push_back(true);
+    }
+    IndexType firstUnstoredChildIndex = -1;
+    if (cell->isParent()) {
+      IndexType firstChildIndex = cell->getChildIndices()[0];
+      if (cellsToKeep.find(firstChildIndex) == cellsToKeep.end()) firstUnstoredChildIndex = firstChildIndex;
+    } else if (_prunedFirstChildIndices.find(*cellIt) != _prunedFirstChildIndices.end()) {
+      firstUnstoredChildIndex = _prunedFirstChildIndices[*cellIt]; // refined, with children not stored, at a previous pruning
+    }
+    if (firstUnstoredChildIndex != -1) {
+      stepCellIndices.push_back(firstUnstoredChildIndex);
+      refinedCellIndices.push_back(*cellIt);
+      refPatterns.push_back(cell->refinementPattern());
+      childrenAreStored.push_back(false);
+    }
+  }
+  vector< pair<IndexType, int> > stepOrder; // (step cell index, step ordinal), sorted by cell index
+  for (int stepOrdinal=0; stepOrdinal<stepCellIndices.size(); stepOrdinal++) {
+    stepOrder.push_back(make_pair(stepCellIndices[stepOrdinal], stepOrdinal));
+  }
+  std::sort(stepOrder.begin(), stepOrder.end());
+  
+  // discard everything, and rebuild from the recorded steps
+  IndexType cellCount = _cells.size();
+  GlobalDofAssignment* gda = _gda;
+  init(_spaceDim);
+  _gda = gda;
+  vector<double>().swap(_vertexCoordinates);
+  vector<IndexType>().swap(_vertexHashTable);
+  _periodicBCIndicesMatchingNode.clear();
+  _equivalentNodeViaPeriodicBC.clear();
+  vector< pair< pair<IndexType, unsigned>, pair<IndexType, unsigned> > >().swap(_cellsForSideEntities);
+  vector<bool>().swap(_boundarySides);
+  vector< CellPtr >().swap(_cells);
+  _activeCells.clear();
+  _rootCells.clear();
+  _cellIDsWithCurves.clear();
+  vector< vector<IndexType> >().swap(_cellGridBuckets);
+  vector<double>().swap(_cellBoundingBoxes);
+  _isPruned = true;
+  _prunedOwnedCells = ownedCellIndices;
+  _prunedFirstChildIndices.clear();
+  
+  int rootOrdinal = 0;
+  for (int stepOrderOrdinal=0; stepOrderOrdinal<stepOrder.size(); stepOrderOrdinal++) {
+    int stepOrdinal = stepOrder[stepOrderOrdinal].second;
+    _cells.resize(stepCellIndices[stepOrdinal], Teuchos::null); // cells in between are not stored here
+    if (refinedCellIndices[stepOrdinal] == (IndexType)-1) {
+      CellPtr cell = addCell(rootTopos[rootOrdinal], rootVertices[rootOrdinal]);
+      // sides shared with cells that are not stored here are interior sides, not boundary sides
+      for (int sideOrdinal=0; sideOrdinal<cell->getSideCount(); sideOrdinal++) {
+        if (!rootSideIsBoundary[rootOrdinal][sideOrdinal]) {
+          setBoundarySide(cell->entityIndex(sideDim, sideOrdinal), false);
+        }
+      }
+      rootOrdinal++;
+    } else if (childrenAreStored[stepOrdinal]) {
+      refineCell(refinedCellIndices[stepOrdinal], refPatterns[stepOrdinal]);
+    } else {
+      // as in refineCellWithVertices(), without adding the children: the cell becomes inactive, and its children's indices are reserved
+      CellPtr cell = _cells[refinedCellIndices[stepOrdinal]];
+      refineCellEntities(cell, refPatterns[stepOrdinal]);
+      cell->setRefinementPattern(refPatterns[stepOrdinal]);
+      deactivateCell(cell);
+      determineGeneralizedParentsForRefinement(cell, refPatterns[stepOrdinal]);
+      _prunedFirstChildIndices[cell->cellIndex()] = stepCellIndices[stepOrdinal];
+    }
+  }
+  _cells.resize(cellCount, Teuchos::null);
+}
+
 set< pair<IndexType, unsigned> > MeshTopology::getActiveBoundaryCells() { // (cellIndex, sideOrdinal)
   set< pair<IndexType, unsigned> > boundaryCells;
-  for (set<IndexType>::iterator boundarySideIt = _boundarySides.begin(); boundarySideIt != _boundarySides.end(); boundarySideIt++) {
-    IndexType sideEntityIndex = *boundarySideIt;
+  for (IndexType sideEntityIndex = 0; sideEntityIndex < _boundarySides.size(); sideEntityIndex++) {
+    if (!_boundarySides[sideEntityIndex]) continue;
     int cellCount = getCellCountForSide(sideEntityIndex);
     if (cellCount == 1) {
       pair<IndexType, unsigned> cellInfo = _cellsForSideEntities[sideEntityIndex].first;
@@ -890,7 +1321,7 @@ vector<double> MeshTopology::getCellCentroid(IndexType cellIndex) {
   for (unsigned vertexOrdinal=0; vertexOrdinal<vertexCount; vertexOrdinal++) {
     unsigned vertexIndex = cell->vertices()[vertexOrdinal];
     for (unsigned d=0; d<_spaceDim; d++) {
-      centroid[d] += _vertices[vertexIndex][d];
+      centroid[d] += _vertexCoordinates[vertexIndex * _spaceDim + d];
     }
   }
   for (unsigned d=0; d<_spaceDim; d++) {
@@ -900,7 +1331,7 @@ vector<double> MeshTopology::getCellCentroid(IndexType cellIndex) {
 }
 
 unsigned MeshTopology::getCellCountForSide(IndexType sideEntityIndex) {
-  if (_cellsForSideEntities.find(sideEntityIndex) == _cellsForSideEntities.end()) {
+  if ((_cellsForSideEntities.size() <= sideEntityIndex) || (_cellsForSideEntities[sideEntityIndex].first.first == -1)) {
     return 0;
   } else {
     pair<IndexType, unsigned> cell1 = _cellsForSideEntities[sideEntityIndex].first;
@@ -914,20 +1345,34 @@ unsigned MeshTopology::getCellCountForSide(IndexType sideEntityIndex) {
 }
 
 pair<IndexType, unsigned> MeshTopology::getFirstCellForSide(IndexType sideEntityIndex) {
+  if (_cellsForSideEntities.size() <= sideEntityIndex) return make_pair(-1,-1);
   return _cellsForSideEntities[sideEntityIndex].first;
 }
 
 pair<IndexType, unsigned> MeshTopology::getSecondCellForSide(IndexType sideEntityIndex) {
+  if (_cellsForSideEntities.size() <= sideEntityIndex) return make_pair(-1,-1);
   return _cellsForSideEntities[sideEntityIndex].second;
 }
 
+bool MeshTopology::isBoundarySide(IndexType sideEntityIndex) {
+  return (sideEntityIndex < _boundarySides.size()) && _boundarySides[sideEntityIndex];
+}
+
+void MeshTopology::setBoundarySide(IndexType sideEntityIndex, bool isBoundary) {
+  if (_boundarySides.size() <= sideEntityIndex) {
+    if (!isBoundary) return;
+    _boundarySides.resize(sideEntityIndex + 1, false);
+  }
+  _boundarySides[sideEntityIndex] = isBoundary;
+}
+
 void MeshTopology::deactivateCell(CellPtr cell) {
   //  cout << "deactivating cell " << cell->cellIndex() << endl;
   CellTopoPtr cellTopo = cell->topology();
   for (int d=0; d<_spaceDim; d++) { // start with vertices, and go up to sides
     int entityCount = cellTopo->getSubcellCount(d);
     for (int j=0; j<entityCount; j++) {
-      // for now, we treat vertices just like all the others--could save a bit of memory, etc. by not storing in _knownEntities[0], etc.
+      // we treat vertices just like all the others (though they are not stored in the entity tables: a vertex's entity index is its vertex index)
       int entityNodeCount = cellTopo->getNodeCount(d, j);
       set< unsigned > nodeSet;
       if (d != 0) {
@@ -1009,6 +1454,7 @@ void MeshTopology::deactivateCell(CellPtr cell) {
       }
     }
   }
+  if (_cellGridBuckets.size() > 0) removeCellFromGrid(cell->cellIndex());
   _activeCells.erase(cell->cellIndex());
 }
 
@@ -1026,12 +1472,14 @@ void MeshTopology::deepCopyCells() {
   // first pass: construct cells
   for (int cellOrdinal=0; cellOrdinal<numCells; cellOrdinal++) {
     CellPtr oldCell = oldCells[cellOrdinal];
+    if (oldCell.get() == NULL) continue; // pruned
     _cells[cellOrdinal] = Teuchos::rcp( new Cell(oldCell->topology(), oldCell->vertices(), oldCell->subcellPermutations(), oldCell->cellIndex(), this) );
   }
 
   // second pass: establish parent-child relationships
   for (int cellOrdinal=0; cellOrdinal<numCells; cellOrdinal++) {
     CellPtr oldCell = oldCells[cellOrdinal];
+    if (oldCell.get() == NULL) continue; // pruned
     CellPtr oldParent = oldCell->getParent();
     if (oldParent != Teuchos::null) {
       CellPtr newParent = _cells[oldParent->cellIndex()];
@@ -1108,12 +1556,16 @@ CellPtr MeshTopology::getCell(unsigned cellIndex) {
     cout << "MeshTopology::getCell: cellIndex " << cellIndex << " out of bounds (0, " << _cells.size() - 1 << ").\n";
     TEUCHOS_TEST_FOR_EXCEPTION(true, std::invalid_argument, "cellIndex out of bounds.\n");
   }
+  if (_isPruned && (_cells[cellIndex].get() == NULL)) {
+    cout << "MeshTopology::getCell: cellIndex " << cellIndex << " is not stored in this pruned topology.\n";
+    TEUCHOS_TEST_FOR_EXCEPTION(true, std::invalid_argument, "cell is not stored in this pruned topology.\n");
+  }
   return _cells[cellIndex];
 }
 
 unsigned MeshTopology::getEntityCount(unsigned int d) {
-  if (d==0) return _vertices.size();
-  return _entities[d].size();
+  if (d==0) return _vertexCount;
+  return _entityVertexOffsets[d].size() - 1;
 }
 
 pair<IndexType, unsigned> MeshTopology::getEntityGeneralizedParent(unsigned int d, IndexType entityIndex) {
@@ -1153,8 +1605,9 @@ unsigned MeshTopology::getEntityIndex(unsigned d, const set<unsigned> &nodeSet)
     }
   }
   vector<unsigned> sortedNodes(nodeSet.begin(),nodeSet.end());
-  if (_knownEntities[d].find(sortedNodes) != _knownEntities[d].end()) {
-    return _knownEntities[d][sortedNodes];
+  IndexType entityIndex = findEntity(d, sortedNodes);
+  if (entityIndex != -1) {
+    return entityIndex;
   } else {
     // look for alternative, equivalent nodeSets, arrived at via periodic BCs
     vector<IndexType> nodeVector(nodeSet.begin(),nodeSet.end());
@@ -1165,9 +1618,7 @@ unsigned MeshTopology::getEntityIndex(unsigned d, const set<unsigned> &nodeSet)
       std::sort(sortedEquivalentNodeVector.begin(), sortedEquivalentNodeVector.end());
       
 //      set<IndexType> equivalentNodeSet(equivalentNodeVector.begin(),equivalentNodeVector.end());
-      if (_knownEntities[d].find(sortedEquivalentNodeVector) != _knownEntities[d].end()) {
-        return _knownEntities[d][sortedEquivalentNodeVector];
-      }
+      return findEntity(d, sortedEquivalentNodeVector);
     }
   }
   return -1;
@@ -1195,13 +1646,14 @@ vector<unsigned> MeshTopology::getEntityVertexIndices(unsigned d, unsigned entit
   if (d==_spaceDim) {
     return getCell(entityIndex)->vertices();
   }
-  if (d > _canonicalEntityOrdering.size()) {
+  if (d >= _entityVertexOffsets.size()) {
     TEUCHOS_TEST_FOR_EXCEPTION(true, std::invalid_argument, "d out of bounds");
   }
-  if (_canonicalEntityOrdering[d].size() <= entityIndex) {
+  if (_entityVertexOffsets[d].size() <= entityIndex + 1) {
     TEUCHOS_TEST_FOR_EXCEPTION(true, std::invalid_argument, "entityIndex out of bounds");
   }
-  return _canonicalEntityOrdering[d][entityIndex];
+  vector<IndexType>::const_iterator entityVerticesBegin = _entityVertices[d].begin();
+  return vector<IndexType>(entityVerticesBegin + _entityVertexOffsets[d][entityIndex], entityVerticesBegin + _entityVertexOffsets[d][entityIndex+1]);
 }
 
 set<unsigned> MeshTopology::getEntitiesForSide(unsigned sideEntityIndex, unsigned d) {
@@ -1301,34 +1753,146 @@ unsigned MeshTopology::getSubEntityIndex(unsigned int d, unsigned int entityInde
   return subEntityIndex;
 }
 
-const vector<double>& MeshTopology::getVertex(unsigned vertexIndex) {
-  return _vertices[vertexIndex];
+IndexType MeshTopology::entityHashTableSlot(unsigned d, const vector<IndexType> &sortedVertices) {
+  // FNV-style mixing of the sorted vertex indices; table size is a power of 2
+  unsigned long long hash = 14695981039346656037ULL;
+  for (int i=0; i<sortedVertices.size(); i++) {
+    hash ^= sortedVertices[i];
+    hash *= 1099511628211ULL;
+  }
+  return (IndexType) (hash & (_entityHashTables[d].size() - 1));
+}
+
+void MeshTopology::addEntityToHashTable(unsigned d, IndexType entityIndex) {
+  vector<IndexType> sortedVertices = getEntityVertexIndices(d, entityIndex);
+  std::sort(sortedVertices.begin(), sortedVertices.end());
+  IndexType mask = _entityHashTables[d].size() - 1;
+  IndexType slot = entityHashTableSlot(d, sortedVertices);
+  while (_entityHashTables[d][slot] != (IndexType)-1) {
+    slot = (slot + 1) & mask;
+  }
+  _entityHashTables[d][slot] = entityIndex;
+}
+
+IndexType MeshTopology::findEntity(unsigned d, const vector<IndexType> &sortedVertices) {
+  if (d==0) {
+    if ((sortedVertices.size() == 1) && (sortedVertices[0] < _vertexCount)) return sortedVertices[0];
+    return -1;
+  }
+  if (_entityHashTables[d].size() == 0) return -1;
+  IndexType mask = _entityHashTables[d].size() - 1;
+  IndexType slot = entityHashTableSlot(d, sortedVertices);
+  while (_entityHashTables[d][slot] != (IndexType)-1) {
+    IndexType entityIndex = _entityHashTables[d][slot];
+    IndexType entityVertexStart = _entityVertexOffsets[d][entityIndex];
+    IndexType entityVertexCount = _entityVertexOffsets[d][entityIndex+1] - entityVertexStart;
+    if (entityVertexCount == sortedVertices.size()) {
+      // entity vertices are distinct, so it suffices to check that each stored vertex is in sortedVertices
+      bool matches = true;
+      for (IndexType i=0; i<entityVertexCount; i++) {
+        if (!std::binary_search(sortedVertices.begin(), sortedVertices.end(), _entityVertices[d][entityVertexStart + i])) {
+          matches = false;
+          break;
+        }
+      }
+      if (matches) return entityIndex;
+    }
+    slot = (slot + 1) & mask;
+  }
+  return -1;
+}
+
+vector<double> MeshTopology::getVertex(unsigned vertexIndex) {
+  const double* vertex = getVertexCoordinates(vertexIndex);
+  return vector<double>(vertex, vertex + _spaceDim);
+}
+
+const double* MeshTopology::getVertexCoordinates(IndexType vertexIndex) {
+  return &_vertexCoordinates[vertexIndex * _spaceDim];
+}
+
+// bucket width for the quantized coordinates used to hash vertices.  Must comfortably exceed the tolerances used for vertex identification;
+// the lookup is correct for any width, but very small widths relative to tol mean more buckets to check, and very large ones more collisions.
+static const double VERTEX_HASH_BUCKET_WIDTH = 1e-8;
+
+static long long quantizeVertexCoordinate(double x) {
+  double q = floor(x / VERTEX_HASH_BUCKET_WIDTH);
+  const double Q_MAX = 1e18; // clamp to avoid overflow; vertices beyond this just share buckets
+  q = max(-Q_MAX, min(Q_MAX, q));
+  return (long long) q;
+}
+
+unsigned MeshTopology::vertexHashTableSlot(const vector<long long> &quantizedCoords) {
+  // FNV-style mixing of the quantized coordinates; table size is a power of 2
+  unsigned long long hash = 14695981039346656037ULL;
+  for (int d=0; d<quantizedCoords.size(); d++) {
+    hash ^= (unsigned long long) quantizedCoords[d];
+    hash *= 1099511628211ULL;
+    hash ^= hash >> 29;
+  }
+  return (unsigned) (hash & (_vertexHashTable.size() - 1));
+}
+
+void MeshTopology::addVertexToHashTable(IndexType vertexIndex) {
+  vector<long long> quantizedCoords(_spaceDim);
+  for (int d=0; d<_spaceDim; d++) {
+    quantizedCoords[d] = quantizeVertexCoordinate(_vertexCoordinates[vertexIndex * _spaceDim + d]);
+  }
+  unsigned mask = _vertexHashTable.size() - 1;
+  unsigned slot = vertexHashTableSlot(quantizedCoords);
+  while (_vertexHashTable[slot] != (IndexType)-1) {
+    slot = (slot + 1) & mask;
+  }
+  _vertexHashTable[slot] = vertexIndex;
+}
+
+void MeshTopology::rebuildVertexHashTable(unsigned tableSize) {
+  _vertexHashTable.assign(tableSize, (IndexType)-1);
+  for (IndexType vertexIndex=0; vertexIndex<_vertexCount; vertexIndex++) {
+    addVertexToHashTable(vertexIndex);
+  }
 }
 
 bool MeshTopology::getVertexIndex(const vector<double> &vertex, IndexType &vertexIndex, double tol) {
-  vector<double> vertexForLowerBound;
+  if (_vertexHashTable.size() == 0) return false;
+  
+  // determine the range of buckets within tol of vertex (typically just one bucket, unless vertex is near a bucket boundary)
+  vector<long long> minBucket(_spaceDim), maxBucket(_spaceDim);
   for (int d=0; d<_spaceDim; d++) {
-    vertexForLowerBound.push_back(vertex[d]-tol);
+    minBucket[d] = quantizeVertexCoordinate(vertex[d] - tol);
+    maxBucket[d] = quantizeVertexCoordinate(vertex[d] + tol);
   }
   
-  map< vector<double>, unsigned >::iterator lowerBoundIt = _vertexMap.lower_bound(vertexForLowerBound);
   long bestMatchIndex = -1;
   double bestMatchDistance = tol;
-  double xDist = 0; // xDist because vector<double> sorts according to the first entry: so we'll end up looking at
-  // all the vertices that are near (x,...) in x...
-  while ((lowerBoundIt != _vertexMap.end()) && (xDist < tol)) {
-    double dist = 0;
-    for (int d=0; d<_spaceDim; d++) {
-      double ddist = (lowerBoundIt->first[d] - vertex[d]);
-      dist += ddist * ddist;
+  unsigned mask = _vertexHashTable.size() - 1;
+  vector<long long> bucket = minBucket;
+  while (true) {
+    // all vertices hashed to this bucket lie in the probe sequence before the first empty slot (vertices are never removed)
+    unsigned slot = vertexHashTableSlot(bucket);
+    while (_vertexHashTable[slot] != (IndexType)-1) {
+      IndexType candidateIndex = _vertexHashTable[slot];
+      const double* candidate = &_vertexCoordinates[candidateIndex * _spaceDim];
+      double dist = 0;
+      for (int d=0; d<_spaceDim; d++) {
+        double ddist = (candidate[d] - vertex[d]);
+        dist += ddist * ddist;
+      }
+      dist = sqrt( dist );
+      if (dist < bestMatchDistance) {
+        bestMatchDistance = dist;
+        bestMatchIndex = candidateIndex;
+      }
+      slot = (slot + 1) & mask;
     }
-    dist = sqrt( dist );
-    if (dist < bestMatchDistance) {
-      bestMatchDistance = dist;
-      bestMatchIndex = lowerBoundIt->second;
+    // increment, odometer-style:
+    int d = 0;
+    while ((d < _spaceDim) && (bucket[d] == maxBucket[d])) {
+      bucket[d] = minBucket[d];
+      d++;
     }
-    xDist = abs(lowerBoundIt->first[0] - vertex[0]);
-    lowerBoundIt++;
+    if (d == _spaceDim) break;
+    bucket[d]++;
   }
   if (bestMatchIndex == -1) {
     return false;
@@ -1344,23 +1908,14 @@ unsigned MeshTopology::getVertexIndexAdding(const vector<double> &vertex, double
     return vertexIndex;
   }
   // if we get here, then we should add
-  vertexIndex = _vertices.size();
-  _vertices.push_back(vertex);
-  
-  if (_vertexMap.find(vertex) != _vertexMap.end() ) {
-    cout << "Mesh error: attempting to add existing vertex.\n";
-    TEUCHOS_TEST_FOR_EXCEPTION(true, std::invalid_argument, "Mesh error: attempting to add existing vertex");
+  vertexIndex = _vertexCount;
+  for (int d=0; d<_spaceDim; d++) {
+    _vertexCoordinates.push_back(vertex[d]);
   }
-  _vertexMap[vertex] = vertexIndex;
   
   { // update the various entity containers
     int vertexDim = 0;
-    vector<IndexType> nodeVector(1,vertexIndex);
-    _entities[vertexDim].push_back(nodeVector);
-    _knownEntities[vertexDim][nodeVector] = vertexIndex;
-    vector<IndexType> entityVertices;
-    entityVertices.push_back(vertexIndex);
-    //_canonicalEntityOrdering[vertexDim][vertexIndex] = entityVertices;
+    _vertexCount++;
     CellTopoPtr nodeTopo = CellTopology::point();
     if (_knownTopologies.find(nodeTopo->getKey()) == _knownTopologies.end()) {
       _knownTopologies[nodeTopo->getKey()] = nodeTopo;
@@ -1368,6 +1923,13 @@ unsigned MeshTopology::getVertexIndexAdding(const vector<double> &vertex, double
     _entityCellTopologyKeys[vertexDim].push_back(nodeTopo->getKey());
   }
   
+  // keep the hash table at most half full, so that probe sequences stay short
+  if (2 * _vertexCount > _vertexHashTable.size()) {
+    rebuildVertexHashTable(max((unsigned)64, 2 * (unsigned)_vertexHashTable.size()));
+  } else {
+    addVertexToHashTable(vertexIndex);
+  }
+  
   set< pair<int,int> > matchingPeriodicBCs;
   
   for (int i=0; i<_periodicBCs.size(); i++) {
@@ -1392,7 +1954,7 @@ unsigned MeshTopology::getVertexIndexAdding(const vector<double> &vertex, double
   return vertexIndex;
 }
 
-// key: index in vertices; value: index in _vertices
+// key: index in vertices; value: vertex index
 vector<unsigned> MeshTopology::getVertexIndices(const FieldContainer<double> &vertices) {
   double tol = 1e-14; // tolerance for vertex equality
   
@@ -1408,7 +1970,7 @@ vector<unsigned> MeshTopology::getVertexIndices(const FieldContainer<double> &ve
   return localToGlobalVertexIndex;
 }
 
-// key: index in vertices; value: index in _vertices
+// key: index in vertices; value: vertex index
 map<unsigned, IndexType> MeshTopology::getVertexIndicesMap(const FieldContainer<double> &vertices) {
   map<unsigned, IndexType> vertexMap;
   vector<IndexType> vertexVector = getVertexIndices(vertices);
@@ -1546,7 +2108,7 @@ vector< pair<unsigned,unsigned> > MeshTopology::getConstrainingSideAncestry(unsi
   // 1) and 2) mean unconstrained.  3) means constrained (by parent)
   unsigned sideDim = _spaceDim - 1;
   vector< pair<unsigned, unsigned> > ancestry;
-  if (_boundarySides.find(sideEntityIndex) != _boundarySides.end()) {
+  if (isBoundarySide(sideEntityIndex)) {
     return ancestry; // sides on boundary are unconstrained...
   }
   
@@ -1775,7 +2337,7 @@ unsigned MeshTopology::getSubEntityPermutation(unsigned d, IndexType entityIndex
   subEntityNodes = getCanonicalEntityNodesViaPeriodicBCs(subEntityDim, subEntityNodes);
   unsigned subEntityIndex = getSubEntityIndex(d, entityIndex, subEntityDim, subEntityOrdinal);
   CellTopoPtr subEntityTopo = getEntityTopology(subEntityDim, subEntityIndex);
-  return CamelliaCellTools::permutationMatchingOrder(subEntityTopo, _canonicalEntityOrdering[subEntityDim][subEntityOrdinal], subEntityNodes);
+  return CamelliaCellTools::permutationMatchingOrder(subEntityTopo, getEntityVertexIndices(subEntityDim, subEntityOrdinal), subEntityNodes);
 }
 
 //pair<IndexType,IndexType> MeshTopology::leastActiveCellIndexContainingEntityConstrainedByConstrainingEntity(unsigned d, unsigned constrainingEntityIndex) {
@@ -1842,8 +2404,8 @@ vector< ParametricCurvePtr > MeshTopology::parametricEdgesForCell(unsigned cellI
   for (int nodeIndex=0; nodeIndex<numNodes; nodeIndex++) {
     int v0_index = vertices[nodeIndex];
     int v1_index = vertices[(nodeIndex+1)%numNodes];
-    vector<double> v0 = getVertex(v0_index);
-    vector<double> v1 = getVertex(v1_index);
+    const double* v0 = getVertexCoordinates(v0_index);
+    const double* v1 = getVertexCoordinates(v1_index);
     
     pair<int, int> edge = make_pair(v0_index, v1_index);
     pair<int, int> reverse_edge = make_pair(v1_index, v0_index);
@@ -1892,7 +2454,7 @@ void MeshTopology::printApproximateMemoryReport() {
 }
 
 void MeshTopology::printConstraintReport(unsigned d) {
-  IndexType entityCount = _entities[d].size();
+  IndexType entityCount = getEntityCount(d);
   cout << "******* MeshTopology, constraints for d = " << d << " *******\n";
   for (IndexType entityIndex=0; entityIndex<entityCount; entityIndex++) {
     pair<IndexType, unsigned> constrainingEntity = getConstrainingEntity(d, entityIndex);
@@ -1906,7 +2468,7 @@ void MeshTopology::printConstraintReport(unsigned d) {
 void MeshTopology::printVertex(unsigned int vertexIndex) {
   cout << "vertex " << vertexIndex << ": (";
   for (unsigned d=0; d<_spaceDim; d++) {
-    cout << _vertices[vertexIndex][d];
+    cout << _vertexCoordinates[vertexIndex * _spaceDim + d];
     if (d != _spaceDim-1) cout << ",";
   }
   cout << ")\n";
@@ -1924,7 +2486,7 @@ void MeshTopology::printEntityVertices(unsigned int d, unsigned int entityIndex)
     printVertex(entityIndex);
     return;
   }
-  vector<unsigned> entityVertices = _canonicalEntityOrdering[d][entityIndex];
+  vector<unsigned> entityVertices = getEntityVertexIndices(d, entityIndex);
   for (vector<unsigned>::iterator vertexIt=entityVertices.begin(); vertexIt !=entityVertices.end(); vertexIt++) {
     printVertex(*vertexIt);
   }
@@ -1990,7 +2552,7 @@ FieldContainer<double> MeshTopology::physicalCellNodesForCell(unsigned int cellI
   for (unsigned vertexOrdinal=0; vertexOrdinal<vertexCount; vertexOrdinal++) {
     unsigned vertexIndex = cell->vertices()[vertexOrdinal];
     for (unsigned d=0; d<_spaceDim; d++) {
-      nodes(vertexOrdinal,d) = _vertices[vertexIndex][d];
+      nodes(vertexOrdinal,d) = _vertexCoordinates[vertexIndex * _spaceDim + d];
     }
   }
   if (includeCellDimension) {
@@ -2003,11 +2565,16 @@ void MeshTopology::refineCell(unsigned cellIndex, RefinementPatternPtr refPatter
   // TODO: worry about the case (currently unsupported in RefinementPattern) of children that do not share topology with the parent.  E.g. quad broken into triangles.  (3D has better examples.)
   
   CellPtr cell = _cells[cellIndex];
+  if (_isPruned && (cell.get() == NULL)) {
+    // cell is not stored on this rank; reserve its children's indices, so that later cells get the same indices as on other ranks
+    _cells.resize(_cells.size() + refPattern->numChildren(), Teuchos::null);
+    return;
+  }
   FieldContainer<double> cellNodes(cell->vertices().size(), _spaceDim);
   
   for (int vertexIndex=0; vertexIndex < cellNodes.dimension(0); vertexIndex++) {
     for (int d=0; d<_spaceDim; d++) {
-      cellNodes(vertexIndex,d) = _vertices[cell->vertices()[vertexIndex]][d];
+      cellNodes(vertexIndex,d) = _vertexCoordinates[cell->vertices()[vertexIndex] * _spaceDim + d];
     }
   }
   
@@ -2016,8 +2583,68 @@ void MeshTopology::refineCell(unsigned cellIndex, RefinementPatternPtr refPatter
     bool changedVertices = _transformationFunction->mapRefCellPointsUsingExactGeometry(vertices, refPattern->verticesOnReferenceCell(), cellIndex);
     //    cout << "transformed vertices:\n" << vertices;
   }
-  map<unsigned, IndexType> vertexOrdinalToVertexIndex = getVertexIndicesMap(vertices); // key: index in vertices; value: index in _vertices
-  map<unsigned, GlobalIndexType> localToGlobalVertexIndex(vertexOrdinalToVertexIndex.begin(),vertexOrdinalToVertexIndex.end());
+  vector<IndexType> refinedVertexIndices = getVertexIndices(vertices);
+  
+  refineCellWithVertices(cell, refPattern, refinedVertexIndices);
+}
+
+void MeshTopology::refineCells(const set<IndexType> &cellIndices, RefinementPatternPtr refPattern) {
+  if (cellIndices.size() == 0) return;
+  
+  if ((_transformationFunction.get() != NULL) || (_edgeToCurveMap.size() > 0) || _isPruned) {
+    // vertices may need to be mapped using exact geometry, cell by cell; or, in a pruned topology, some of the cells may not be
+    // stored here (refineCell() reserves indices for their children).  Just refine individually.
+    for (set<IndexType>::const_iterator cellIt = cellIndices.begin(); cellIt != cellIndices.end(); cellIt++) {
+      refineCell(*cellIt, refPattern);
+    }
+    return;
+  }
+  
+  // first phase: compute the post-refinement vertices for all the cells in one mapToPhysicalFrame() call
+  int numCells = cellIndices.size();
+  int parentVertexCount = getCell(*cellIndices.begin())->vertices().size();
+  FieldContainer<double> cellNodes(numCells, parentVertexCount, _spaceDim);
+  int cellOrdinal = 0;
+  for (set<IndexType>::const_iterator cellIt = cellIndices.begin(); cellIt != cellIndices.end(); cellIt++, cellOrdinal++) {
+    const vector<IndexType>* cellVertices = &getCell(*cellIt)->vertices();
+    if (cellVertices->size() != parentVertexCount) {
+      TEUCHOS_TEST_FOR_EXCEPTION(true, std::invalid_argument, "refineCells() requires all cells to have the same topology");
+    }
+    for (int vertexOrdinal=0; vertexOrdinal < parentVertexCount; vertexOrdinal++) {
+      for (int d=0; d<_spaceDim; d++) {
+        cellNodes(cellOrdinal,vertexOrdinal,d) = _vertexCoordinates[(*cellVertices)[vertexOrdinal] * _spaceDim + d];
+      }
+    }
+  }
+  FieldContainer<double> vertices = refPattern->verticesForRefinement(cellNodes); // (C,V,D)
+  
+  // second phase: identify/add the vertices.  The per-cell ordering here matches that of refineCell(), so that
+  // vertex indices (and hence everything downstream) are the same as they would be if the cells were refined one by one.
+  double tol = 1e-14; // tolerance for vertex equality
+  int refinedVertexCount = vertices.dimension(1);
+  vector< vector<IndexType> > refinedVertexIndices(numCells, vector<IndexType>(refinedVertexCount));
+  vector<double> vertex(_spaceDim);
+  for (cellOrdinal=0; cellOrdinal<numCells; cellOrdinal++) {
+    for (int vertexOrdinal=0; vertexOrdinal<refinedVertexCount; vertexOrdinal++) {
+      for (int d=0; d<_spaceDim; d++) {
+        vertex[d] = vertices(cellOrdinal,vertexOrdinal,d);
+      }
+      refinedVertexIndices[cellOrdinal][vertexOrdinal] = getVertexIndexAdding(vertex, tol);
+    }
+  }
+  
+  // third phase: entities, children, and neighbor relationships
+  cellOrdinal = 0;
+  for (set<IndexType>::const_iterator cellIt = cellIndices.begin(); cellIt != cellIndices.end(); cellIt++, cellOrdinal++) {
+    refineCellWithVertices(getCell(*cellIt), refPattern, refinedVertexIndices[cellOrdinal]);
+  }
+}
+
+void MeshTopology::refineCellWithVertices(CellPtr cell, RefinementPatternPtr refPattern, const vector<IndexType> &refinedVertexIndices) {
+  map<unsigned, GlobalIndexType> localToGlobalVertexIndex; // key: index in refinedVertexIndices; value: vertex index
+  for (unsigned vertexOrdinal=0; vertexOrdinal<refinedVertexIndices.size(); vertexOrdinal++) {
+    localToGlobalVertexIndex[vertexOrdinal] = refinedVertexIndices[vertexOrdinal];
+  }
   
   // get the children, as vectors of vertex indices:
   vector< vector<GlobalIndexType> > childVerticesGlobalType = refPattern->children(localToGlobalVertexIndex);
@@ -2080,7 +2707,7 @@ void MeshTopology::refineCellEntities(CellPtr cell, RefinementPatternPtr refPatt
   
   for (int vertexIndex=0; vertexIndex < cellNodes.dimension(1); vertexIndex++) {
     for (int d=0; d<_spaceDim; d++) {
-      cellNodes(0,vertexIndex,d) = _vertices[cell->vertices()[vertexIndex]][d];
+      cellNodes(0,vertexIndex,d) = _vertexCoordinates[cell->vertices()[vertexIndex] * _spaceDim + d];
     }
   }
   
@@ -2146,7 +2773,7 @@ void MeshTopology::refineCellEntities(CellPtr cell, RefinementPatternPtr refPatt
           
           // add vertices as necessary and get their indices
           physicalNodes.resize(nodeCount,_spaceDim);
-          vector<unsigned> childEntityVertices = getVertexIndices(physicalNodes); // key: index in physicalNodes; value: index in _vertices
+          vector<unsigned> childEntityVertices = getVertexIndices(physicalNodes); // key: index in physicalNodes; value: vertex index
           
           unsigned entityPermutation;
           CellTopoPtr childTopo = cellTopo->getSubcell(d, subcord);
@@ -2159,8 +2786,10 @@ void MeshTopology::refineCellEntities(CellPtr cell, RefinementPatternPtr refPatt
         }
         _childEntities[d][parentIndex] = vector< pair<RefinementPatternPtr,vector<unsigned> > >(1, make_pair(subcellRefPattern, childEntityIndices) ); // TODO: this also needs to change when we work through recipes.  Note that the correct parent will vary here...  i.e. in the anisotropic case, the child we're ultimately interested in will have an anisotropic parent, and *its* parent would be the bigger guy referred to here.
         if (d==_spaceDim-1) { // side
-          if (_boundarySides.find(parentIndex) != _boundarySides.end()) { // parent is a boundary side, so children are, too
-            _boundarySides.insert(childEntityIndices.begin(),childEntityIndices.end());
+          if (isBoundarySide(parentIndex)) { // parent is a boundary side, so children are, too
+            for (vector<unsigned>::iterator childIt = childEntityIndices.begin(); childIt != childEntityIndices.end(); childIt++) {
+              setBoundarySide(*childIt, true);
+            }
           }
         }
       }
@@ -2173,7 +2802,7 @@ void MeshTopology::determineGeneralizedParentsForRefinement(CellPtr cell, Refine
   
   for (int vertexIndex=0; vertexIndex < cellNodes.dimension(1); vertexIndex++) {
     for (int d=0; d<_spaceDim; d++) {
-      cellNodes(0,vertexIndex,d) = _vertices[cell->vertices()[vertexIndex]][d];
+      cellNodes(0,vertexIndex,d) = _vertexCoordinates[cell->vertices()[vertexIndex] * _spaceDim + d];
     }
   }
   
@@ -34,11 +34,24 @@ ZoltanMeshPartitionPolicy::ZoltanMeshPartitionPolicy(){
 //  cout << "ZoltanMeshPartitionPolicy: Defaulting to HSFC partitioner" << endl;
   _ZoltanPartitioner = partitionerName;
   _debug_level = debug_level;
+  initializeRepartitioningState();
 }
 ZoltanMeshPartitionPolicy::ZoltanMeshPartitionPolicy(string partitionerName){
   string debug_level = "0";
   _ZoltanPartitioner = partitionerName;  
   _debug_level = debug_level;
+  initializeRepartitioningState();
+}
+
+void ZoltanMeshPartitionPolicy::initializeRepartitioningState() {
+  _incremental = false;
+  _imbalanceThreshold = 1.1;
+  _repartitionMultiplier = 100; // Zoltan's default
+  _reportMigration = false;
+  _imbalanceBeforePartitioning = 1.0;
+  _didRebalance = false;
+  _migratedCellCount = 0;
+  _migratedBytes = 0;
 }
 
 void ZoltanMeshPartitionPolicy::partitionMesh(Mesh *mesh, PartitionIndexType numPartitions) {
@@ -55,8 +68,47 @@ void ZoltanMeshPartitionPolicy::partitionMesh(Mesh *mesh, PartitionIndexType num
   
   MeshTopologyPtr meshTopology = mesh->getTopology();
   
+  _imbalanceBeforePartitioning = 1.0;
+  _didRebalance = false;
+  _migratedCellCount = 0;
+  _migratedBytes = 0;
+  
   if (numNodes>1){
 #ifdef HAVE_MPI
+    Epetra_MpiComm Comm(MPI_COMM_WORLD);
+    
+    if (_weightByCellCost) {
+      // measured costs are recorded by the ranks that assembled the cells; share them, so that all ranks weigh cells alike
+      mesh->synchronizeCellAssemblyCosts();
+    }
+    
+    // the current partition, with children of refined cells assigned to their parents' ranks:
+    set<GlobalIndexType> rankLocalCells = getRankLocalCellIDs(mesh);
+    
+    double myLoad = 0, maxLoad, totalLoad;
+    for (set<GlobalIndexType>::iterator cellIDIt = rankLocalCells.begin(); cellIDIt != rankLocalCells.end(); cellIDIt++) {
+      myLoad += _weightByCellCost ? mesh->cellCost(*cellIDIt) : 1.0;
+    }
+    Comm.MaxAll(&myLoad, &maxLoad, 1);
+    Comm.SumAll(&myLoad, &totalLoad, 1);
+    _imbalanceBeforePartitioning = (totalLoad > 0) ? maxLoad / (totalLoad / numNodes) : 1.0;
+    
+    if (_incremental && (_imbalanceBeforePartitioning <= _imbalanceThreshold)) {
+      // balanced enough: keep the current partition, so that nothing migrates
+      setPartitionsFromRankLocalCells(mesh, rankLocalCells, numNodes);
+      if (_reportMigration && (myNode == 0)) {
+        cout << "ZoltanMeshPartitionPolicy: imbalance " << _imbalanceBeforePartitioning << " is within threshold; kept current partition.\n";
+      }
+      return;
+    }
+    _didRebalance = true;
+    
+    // geometric methods have no notion of the current distribution, so incremental repartitioning uses PHG graph repartitioning
+    string partitioner = _ZoltanPartitioner;
+    if (_incremental && (partitioner != "GRAPH") && (partitioner != "HYPERGRAPH")) {
+      partitioner = "GRAPH";
+    }
+    
     Zoltan *zz = new Zoltan(MPI::COMM_WORLD);
     if (zz == NULL){
       cout << "ZoltanMeshPartititionPolicy: construction of new Zoltan object failed.\n";
@@ -76,15 +128,29 @@ void ZoltanMeshPartitionPolicy::partitionMesh(Mesh *mesh, PartitionIndexType num
     
     /* Calling Zoltan Load-balancing routine */
     //cout << "Setting zoltan params" << endl;
-    zz->Set_Param( "LB_METHOD", _ZoltanPartitioner.c_str());    /* Zoltan method */
+    zz->Set_Param( "LB_METHOD", partitioner.c_str());    /* Zoltan method */
     zz->Set_Param( "NUM_GID_ENTRIES", "1");  /* global ID is 1 integer */
     if (useLocalIDs){
       zz->Set_Param( "NUM_LID_ENTRIES", "1");  /* local ID is 1 integer */
     }else{
       zz->Set_Param( "NUM_LID_ENTRIES", "0");  /* local ID is null */
     }
-    zz->Set_Param( "OBJ_WEIGHT_DIM", "0");   
+    // with OBJ_WEIGHT_DIM = 1, get_object_list() supplies Mesh::cellCost() for each cell, and Zoltan balances assembly work rather than cell counts
+    zz->Set_Param( "OBJ_WEIGHT_DIM", _weightByCellCost ? "1" : "0");
     zz->Set_Param( "DEBUG_LEVEL", _debug_level);
+    if ((partitioner == "GRAPH") || (partitioner == "HYPERGRAPH")) {
+      // partition the side-neighbor graph, with edges weighted by the trace dofs they carry, so that cuts minimize interface dofs
+      zz->Set_Param( "GRAPH_PACKAGE", "PHG");
+      zz->Set_Param( "EDGE_WEIGHT_DIM", "1");
+    }
+    if (_incremental) {
+      // start from the current partition; PHG weighs communication volume against the migration cost of each cell, which it
+      // takes from get_elem_data_size() (the bytes CellDataMigration will ship)
+      ostringstream multiplierStream;
+      multiplierStream << _repartitionMultiplier;
+      zz->Set_Param( "LB_APPROACH", "REPARTITION");
+      zz->Set_Param( "PHG_REPART_MULTIPLIER", multiplierStream.str());
+    }
     //  zz->Set_Param( "REFTREE_INITPATH", "CONNECTED"); // no SFC on coarse meshTopology
     zz->Set_Param( "RANDOM_MOVE_FRACTION", "1.0");    /* Zoltan "random" partition param */
     
@@ -100,6 +166,10 @@ void ZoltanMeshPartitionPolicy::partitionMesh(Mesh *mesh, PartitionIndexType num
     zz->Set_Num_Geom_Fn(&get_num_geom, myData);
     zz->Set_Geom_Multi_Fn(&get_geom_list, myData);
     
+    // graph query functions
+    zz->Set_Num_Edges_Multi_Fn(&get_num_edges_list, myData);
+    zz->Set_Edge_List_Multi_Fn(&get_edge_list, myData);
+    
     // object sizing/packing functions:
     zz->Set_Obj_Size_Fn( &get_elem_data_size, myData);
     zz->Set_Pack_Obj_Fn( &pack_elem_data, myData);
@@ -140,7 +210,17 @@ void ZoltanMeshPartitionPolicy::partitionMesh(Mesh *mesh, PartitionIndexType num
       
       /* ----------- modify output array partitionedActiveCells ------- */
       
-      set<GlobalIndexType> rankLocalCells = getRankLocalCellIDs(mesh);
+      long myMigratedCellCount = numExport, myMigratedBytes = 0;
+      for (int i=0;i<numExport;i++){
+        myMigratedBytes += CellDataMigration::dataSize(mesh, exportGlobalIds[i]);
+      }
+      Comm.SumAll(&myMigratedCellCount, &_migratedCellCount, 1);
+      Comm.SumAll(&myMigratedBytes, &_migratedBytes, 1);
+      if (_reportMigration && (myNode == 0)) {
+        cout << "ZoltanMeshPartitionPolicy: imbalance " << _imbalanceBeforePartitioning << "; migrating " << _migratedCellCount;
+        cout << " cells (" << _migratedBytes << " bytes).\n";
+      }
+      
       // remove export IDs FOR THIS NODE
       for (int i=0;i<numExport;i++){
         rankLocalCells.erase(exportGlobalIds[i]);
@@ -158,42 +238,7 @@ void ZoltanMeshPartitionPolicy::partitionMesh(Mesh *mesh, PartitionIndexType num
         Camellia::print(rankListLabel.str(), rankLocalCells);
       }
       
-#ifdef HAVE_MPI
-      Epetra_MpiComm Comm(MPI_COMM_WORLD);
-      //cout << "rank: " << rank << " of " << numProcs << endl;
-#else
-      Epetra_SerialComm Comm;
-#endif
-      
-      int myPartitionSize = rankLocalCells.size();
-      int maxPartitionSize;
-      Comm.MaxAll(&myPartitionSize, &maxPartitionSize, 1);
-      
-      FieldContainer<GlobalIndexType> partitionedActiveCells(numNodes,maxPartitionSize);
-      
-      partitionedActiveCells.initialize(-1); // cellID == -1 signals end of partition
-
-      // need to pass around information about partitions here thru MPI - each processor must know all other processors' partitions
-      FieldContainer<int> myPartition(maxPartitionSize);
-      myPartition.initialize(-1);
-
-      int index = 0;
-      for (set<GlobalIndexType>::iterator myCellIt = rankLocalCells.begin(); myCellIt != rankLocalCells.end(); myCellIt++) {
-        myPartition[index] = *myCellIt;
-        index++;
-      }
-      FieldContainer<int> allPartitions(numNodes,maxPartitionSize);
-      MPIWrapper::allGather(allPartitions, myPartition);
-      
-      // convert the ints to GlobalIndexType -- if sizeof(GlobalIndexType) ever is bigger than sizeof(int), then we'll want to do something else above to pack the cell IDs into ints, etc.
-      for (int node=0;node<numNodes;node++){
-        for (int i=0;i<maxPartitionSize;i++){
-          partitionedActiveCells(node,i) = allPartitions(node,i);
-        }
-      }
-      
-      // now that we have the new partition, communicate it:
-      mesh->globalDofAssignment()->setPartitions(partitionedActiveCells);
+      setPartitionsFromRankLocalCells(mesh, rankLocalCells, numNodes);
       
 //      cout << "about to call zz->Migrate on rank " << myNode << endl;
       int rc = zz->Migrate(numImport, importGlobalIds, importLocalIds, importProcs, importToPart,
@@ -245,6 +290,35 @@ void ZoltanMeshPartitionPolicy::partitionMesh(Mesh *mesh, PartitionIndexType num
 //  return -1;    
 //}
 
+bool ZoltanMeshPartitionPolicy::didRebalance() {
+  return _didRebalance;
+}
+
+double ZoltanMeshPartitionPolicy::imbalanceBeforePartitioning() {
+  return _imbalanceBeforePartitioning;
+}
+
+long ZoltanMeshPartitionPolicy::migratedBytes() {
+  return _migratedBytes;
+}
+
+long ZoltanMeshPartitionPolicy::migratedCellCount() {
+  return _migratedCellCount;
+}
+
+void ZoltanMeshPartitionPolicy::setIncrementalRepartitioning(bool value, double imbalanceThreshold) {
+  _incremental = value;
+  _imbalanceThreshold = imbalanceThreshold;
+}
+
+void ZoltanMeshPartitionPolicy::setRepartitionMultiplier(double value) {
+  _repartitionMultiplier = value;
+}
+
+void ZoltanMeshPartitionPolicy::setReportMigration(bool value) {
+  _reportMigration = value;
+}
+
 /*-------------------------ZOLTAN QUERY FUNCTIONS -------------------*/
 
 // get number of active elements
@@ -280,6 +354,9 @@ void ZoltanMeshPartitionPolicy::get_object_list(void *data, int sizeGID, int siz
   int i=0;
   for (set<unsigned>::const_iterator cellIDIt = rankLocalCellIDs.begin(); cellIDIt != rankLocalCellIDs.end(); cellIDIt++) {
     globalID[i]= *cellIDIt;
+    if (wgt_dim > 0) {
+      obj_wgts[i * wgt_dim] = mesh->cellCost(*cellIDIt);
+    }
     i++;
   }
   //  cout << endl;
@@ -288,6 +365,38 @@ void ZoltanMeshPartitionPolicy::get_object_list(void *data, int sizeGID, int siz
   return; 
 }
 
+void ZoltanMeshPartitionPolicy::get_num_edges_list(void *data, int num_gid_entries, int num_lid_entries, int num_obj,
+                                                   ZOLTAN_ID_PTR global_ids, ZOLTAN_ID_PTR local_ids, int *num_edges, int *ierr) {
+  Mesh* mesh = (Mesh*) data;
+  for (int i=0; i<num_obj; i++) {
+    num_edges[i] = traceCouplingWeights(mesh, global_ids[i * num_gid_entries]).size();
+  }
+  *ierr = ZOLTAN_OK;
+}
+
+void ZoltanMeshPartitionPolicy::get_edge_list(void *data, int num_gid_entries, int num_lid_entries, int num_obj,
+                                              ZOLTAN_ID_PTR global_ids, ZOLTAN_ID_PTR local_ids, int *num_edges,
+                                              ZOLTAN_ID_PTR nbor_global_ids, int *nbor_procs, int wgt_dim, float *ewgts, int *ierr) {
+  Mesh* mesh = (Mesh*) data;
+  int edgeOrdinal = 0;
+  for (int i=0; i<num_obj; i++) {
+    map<GlobalIndexType, int> weights = traceCouplingWeights(mesh, global_ids[i * num_gid_entries]);
+    if (weights.size() != num_edges[i]) {
+      cout << "ZoltanMeshPartitionPolicy: edge count for cell " << global_ids[i * num_gid_entries] << " does not match get_num_edges_list().\n";
+      *ierr = ZOLTAN_FATAL;
+      return;
+    }
+    for (map<GlobalIndexType, int>::iterator weightIt = weights.begin(); weightIt != weights.end(); weightIt++, edgeOrdinal++) {
+      nbor_global_ids[edgeOrdinal * num_gid_entries] = weightIt->first;
+      nbor_procs[edgeOrdinal] = currentPartitionForCell(mesh, weightIt->first);
+      if (wgt_dim > 0) {
+        ewgts[edgeOrdinal * wgt_dim] = weightIt->second;
+      }
+    }
+  }
+  *ierr = ZOLTAN_OK;
+}
+
 int ZoltanMeshPartitionPolicy::get_num_geom(void *data, int *ierr){
   Mesh *mesh = (Mesh*)data;
   MeshTopologyPtr meshTopology = mesh->getTopology();
@@ -515,6 +624,56 @@ void ZoltanMeshPartitionPolicy::unpack_elem_data(void *data,
   *ierr = ZOLTAN_OK; // CellDataMigration throws exceptions if it's not OK
 }
 
+void ZoltanMeshPartitionPolicy::setPartitionsFromRankLocalCells(Mesh *mesh, const set<GlobalIndexType> &rankLocalCells, int numNodes) {
+#ifdef HAVE_MPI
+  Epetra_MpiComm Comm(MPI_COMM_WORLD);
+  //cout << "rank: " << rank << " of " << numProcs << endl;
+#else
+  Epetra_SerialComm Comm;
+#endif
+  
+  int myPartitionSize = rankLocalCells.size();
+  int maxPartitionSize;
+  Comm.MaxAll(&myPartitionSize, &maxPartitionSize, 1);
+  
+  FieldContainer<GlobalIndexType> partitionedActiveCells(numNodes,maxPartitionSize);
+  
+  partitionedActiveCells.initialize(-1); // cellID == -1 signals end of partition
+  
+  // need to pass around information about partitions here thru MPI - each processor must know all other processors' partitions
+  FieldContainer<int> myPartition(maxPartitionSize);
+  myPartition.initialize(-1);
+  
+  int index = 0;
+  for (set<GlobalIndexType>::const_iterator myCellIt = rankLocalCells.begin(); myCellIt != rankLocalCells.end(); myCellIt++) {
+    myPartition[index] = *myCellIt;
+    index++;
+  }
+  FieldContainer<int> allPartitions(numNodes,maxPartitionSize);
+  MPIWrapper::allGather(allPartitions, myPartition);
+  
+  // convert the ints to GlobalIndexType -- if sizeof(GlobalIndexType) ever is bigger than sizeof(int), then we'll want to do something else above to pack the cell IDs into ints, etc.
+  for (int node=0;node<numNodes;node++){
+    for (int i=0;i<maxPartitionSize;i++){
+      partitionedActiveCells(node,i) = allPartitions(node,i);
+    }
+  }
+  
+  // now that we have the new partition, communicate it:
+  mesh->globalDofAssignment()->setPartitions(partitionedActiveCells);
+}
+
+PartitionIndexType ZoltanMeshPartitionPolicy::currentPartitionForCell(Mesh *mesh, GlobalIndexType cellID) {
+  // cells created by refinement since the last partitioning belong to their nearest partitioned ancestor's rank
+  CellPtr cell = mesh->getTopology()->getCell(cellID);
+  PartitionIndexType partition = mesh->partitionForCellID(cellID);
+  while ((partition == (PartitionIndexType) -1) && (cell->getParent().get() != NULL)) {
+    cell = cell->getParent();
+    partition = mesh->partitionForCellID(cell->cellIndex());
+  }
+  return partition;
+}
+
 set<GlobalIndexType> ZoltanMeshPartitionPolicy::getRankLocalCellIDs(Mesh *mesh) {
   MeshTopologyPtr meshTopo = mesh->getTopology();
   
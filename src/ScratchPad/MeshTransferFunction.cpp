@@ -149,7 +149,7 @@ void MeshTransferFunction::rebuildMaps() {
       IndexType sideEntityIndex = cell->entityIndex(sideDim, boundarySideOrdinals[i]);
       vector<IndexType> vertexIndices = newMeshTopology->getEntityVertexIndices(sideDim, sideEntityIndex);
       for (int vertexOrdinal=0; vertexOrdinal<vertexIndices.size(); vertexOrdinal++) {
-        vector<double> vertex = newMeshTopology->getVertex(vertexIndices[vertexOrdinal]);
+        const double* vertex = newMeshTopology->getVertexCoordinates(vertexIndices[vertexOrdinal]);
         if (abs(vertex[timeDimOrdinal] - _interface_t) > tol) {
           sideMatchesInterface = false;
         }
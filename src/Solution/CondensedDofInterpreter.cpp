@@ -23,6 +23,9 @@
 
 #include "SerialDenseWrapper.h"
 
+#include "Teuchos_BLAS.hpp"
+#include "Teuchos_LAPACK.hpp"
+
 #include "CamelliaDebugUtility.h"
 
 #include "RHS.h"
@@ -33,6 +36,7 @@ CondensedDofInterpreter::CondensedDofInterpreter(Mesh* mesh, IPPtr ip, RHSPtr rh
   _rhs = rhs;
   _lagrangeConstraints = lagrangeConstraints;
   _storeLocalStiffnessMatrices = storeLocalStiffnessMatrices;
+  _storeFieldFactorizations = false;
   _uncondensibleVarIDs.insert(fieldIDsToExclude.begin(),fieldIDsToExclude.end());
   
   int numGlobalConstraints = lagrangeConstraints->numGlobalConstraints();
@@ -51,9 +55,10 @@ CondensedDofInterpreter::CondensedDofInterpreter(Mesh* mesh, IPPtr ip, RHSPtr rh
 }
 
 void CondensedDofInterpreter::reinitialize() {
-  _localLoadVectors.clear();
-  _localStiffnessMatrices.clear();
-  _localInterpretedDofIndices.clear();
+  _localData.clear();
+  _localCellIndices.clear();
+  _fieldFactorizations.clear();
+  _fieldFactorizationOrdinals.clear();
   
   initializeGlobalDofIndices();
 }
@@ -64,31 +69,112 @@ void CondensedDofInterpreter::computeAndStoreLocalStiffnessAndLoad(GlobalIndexTy
   MeshPtr meshPtr = Teuchos::rcp(_mesh, false);
   BasisCachePtr cellBasisCache = BasisCache::basisCacheForCell(meshPtr, cellID);
   BasisCachePtr ipBasisCache = BasisCache::basisCacheForCell(meshPtr, cellID, true);
-  _localStiffnessMatrices[cellID] = FieldContainer<double>(1,numTrialDofs,numTrialDofs);
-  _localLoadVectors[cellID] = FieldContainer<double>(1,numTrialDofs);
-  _mesh->bilinearForm()->localStiffnessMatrixAndRHS(_localStiffnessMatrices[cellID], _localLoadVectors[cellID], _ip, ipBasisCache, _rhs, cellBasisCache);
-  
-  _localStiffnessMatrices[cellID].resize(numTrialDofs,numTrialDofs);
-  _localLoadVectors[cellID].resize(numTrialDofs);
+  FieldContainer<double> localStiffness(1,numTrialDofs,numTrialDofs), localLoad(1,numTrialDofs);
+  _mesh->bilinearForm()->localStiffnessMatrixAndRHS(localStiffness, localLoad, _ip, ipBasisCache, _rhs, cellBasisCache);
+  
+  localStiffness.resize(numTrialDofs,numTrialDofs);
+  localLoad.resize(numTrialDofs);
+  storeStiffness(cellID, &localStiffness[0], numTrialDofs);
+  // a load that is already stored takes precedence: the stiffness alone may be missing (see interpretLocalBatchData())
+  FieldContainer<double>* load = &storedLoad(cellID);
+  if (load->size() == 0) {
+    *load = localLoad;
+  }
   
   FieldContainer<double> interpretedStiffnessData, interpretedLoadData;
   
-  FieldContainer<GlobalIndexType> interpretedDofIndices;
-  
-  _mesh->DofInterpreter::interpretLocalData(cellID, _localStiffnessMatrices[cellID], _localLoadVectors[cellID],
-                                            interpretedStiffnessData, interpretedLoadData, interpretedDofIndices);
-  
-  _localInterpretedDofIndices[cellID] = interpretedDofIndices;
+  _mesh->DofInterpreter::interpretLocalData(cellID, localStiffness, *load, interpretedStiffnessData, interpretedLoadData,
+                                            storedInterpretedDofIndices(cellID));
 }
 
-void CondensedDofInterpreter::getLocalData(GlobalIndexType cellID, FieldContainer<double> &stiffness, FieldContainer<double> &load, FieldContainer<GlobalIndexType> &interpretedDofIndices) {
-  if (_localStiffnessMatrices.find(cellID) == _localStiffnessMatrices.end()) {
+void CondensedDofInterpreter::getLocalData(GlobalIndexType cellID, const double* &packedStiffness, FieldContainer<double> &load, FieldContainer<GlobalIndexType> &interpretedDofIndices) {
+  if (!haveStoredStiffness(cellID)) {
     computeAndStoreLocalStiffnessAndLoad(cellID);
   }
   
-  stiffness = _localStiffnessMatrices[cellID];
-  load = _localLoadVectors[cellID];
-  interpretedDofIndices = _localInterpretedDofIndices[cellID];
+  packedStiffness = storedPackedStiffness(cellID);
+  load = storedLoad(cellID);
+  interpretedDofIndices = storedInterpretedDofIndices(cellID);
+}
+
+pair<ElementType*, int> CondensedDofInterpreter::localCellIndex(GlobalIndexType cellID) {
+  if (_localCellIndices.find(cellID) != _localCellIndices.end()) {
+    return _localCellIndices[cellID];
+  }
+  ElementTypePtr elemType = _mesh->getElementType(cellID);
+  if (_localData.find(elemType.get()) == _localData.end()) {
+    // first use of this element type: index all its rank-local cells
+    vector<GlobalIndexType> cellIDsOfType = _mesh->cellIDsOfType(elemType);
+    for (int cellIndex=0; cellIndex<cellIDsOfType.size(); cellIndex++) {
+      _localCellIndices[cellIDsOfType[cellIndex]] = make_pair(elemType.get(), cellIndex);
+    }
+    LocalDataStorage* storage = &_localData[elemType.get()];
+    storage->numTrialDofs = elemType->trialOrderPtr->totalDofs();
+    storage->isStored.assign(cellIDsOfType.size(), false);
+    storage->loadVectors.resize(cellIDsOfType.size());
+    storage->interpretedDofIndices.resize(cellIDsOfType.size());
+  }
+  if (_localCellIndices.find(cellID) == _localCellIndices.end()) {
+    // an off-rank cell (as when the global solution is imported): append it
+    LocalDataStorage* storage = &_localData[elemType.get()];
+    int cellIndex = storage->isStored.size();
+    storage->isStored.push_back(false);
+    storage->loadVectors.resize(storage->isStored.size());
+    storage->interpretedDofIndices.resize(storage->isStored.size());
+    if (storage->packedMatrices.size() > 0) {
+      storage->packedMatrices.resize(storage->isStored.size() * storage->numTrialDofs * (storage->numTrialDofs + 1) / 2);
+    }
+    _localCellIndices[cellID] = make_pair(elemType.get(), cellIndex);
+  }
+  return _localCellIndices[cellID];
+}
+
+bool CondensedDofInterpreter::haveStoredStiffness(GlobalIndexType cellID) {
+  pair<ElementType*, int> cellIndex = localCellIndex(cellID);
+  return _localData[cellIndex.first].isStored[cellIndex.second];
+}
+
+const double* CondensedDofInterpreter::storedPackedStiffness(GlobalIndexType cellID) {
+  pair<ElementType*, int> cellIndex = localCellIndex(cellID);
+  LocalDataStorage* storage = &_localData[cellIndex.first];
+  int packedSize = storage->numTrialDofs * (storage->numTrialDofs + 1) / 2;
+  return &storage->packedMatrices[cellIndex.second * packedSize];
+}
+
+FieldContainer<double> & CondensedDofInterpreter::storedLoad(GlobalIndexType cellID) {
+  pair<ElementType*, int> cellIndex = localCellIndex(cellID);
+  return _localData[cellIndex.first].loadVectors[cellIndex.second];
+}
+
+FieldContainer<GlobalIndexType> & CondensedDofInterpreter::storedInterpretedDofIndices(GlobalIndexType cellID) {
+  pair<ElementType*, int> cellIndex = localCellIndex(cellID);
+  return _localData[cellIndex.first].interpretedDofIndices[cellIndex.second];
+}
+
+void CondensedDofInterpreter::storeStiffness(GlobalIndexType cellID, const double *K, int n) {
+  pair<ElementType*, int> cellIndex = localCellIndex(cellID);
+  LocalDataStorage* storage = &_localData[cellIndex.first];
+  if (n != storage->numTrialDofs) {
+    cout << "stiffness matrix for cell " << cellID << " has dimension " << n << "; expected " << storage->numTrialDofs << ".\n";
+    TEUCHOS_TEST_FOR_EXCEPTION(true, std::invalid_argument, "stiffness matrix dimension does not match the cell's trial dof count");
+  }
+  // only the upper triangle is kept; a K that is not symmetric (e.g., up to roundoff larger than isSymmetric()'s default tolerance)
+  // is replaced by its symmetric part, (K + K^T) / 2
+  bool symmetric = isSymmetric(K, n);
+  if (!symmetric && !isSymmetric(K, n, 1e-6)) {
+    cout << "WARNING: stiffness matrix for cell " << cellID << " is not symmetric; storing its symmetric part.\n";
+  }
+  int packedSize = n * (n + 1) / 2;
+  if (storage->packedMatrices.size() == 0) {
+    storage->packedMatrices.resize(storage->isStored.size() * packedSize);
+  }
+  double* packedK = &storage->packedMatrices[cellIndex.second * packedSize];
+  for (int j=0; j<n; j++) {
+    for (int i=0; i<=j; i++) {
+      packedK[i + j * (j + 1) / 2] = symmetric ? K[i * n + j] : 0.5 * (K[i * n + j] + K[j * n + i]);
+    }
+  }
+  storage->isStored[cellIndex.second] = true;
 }
 
 void CondensedDofInterpreter::getSubmatrices(set<int> fieldIndices, set<int> fluxIndices,
@@ -141,6 +227,27 @@ void CondensedDofInterpreter::getSubmatrices(set<int> fieldIndices, set<int> flu
   }
 }
 
+void CondensedDofInterpreter::getSubmatrices(set<int> fieldIndices, set<int> fluxIndices, const double *packedK,
+                                             Epetra_SerialDenseMatrix &K_field, Epetra_SerialDenseMatrix &K_coupl) {
+  int numFieldDofs = fieldIndices.size();
+  int numFluxDofs = fluxIndices.size();
+  K_field.Reshape(numFieldDofs,numFieldDofs);
+  K_coupl.Reshape(numFieldDofs,numFluxDofs);
+  
+  int i = 0;
+  for (set<int>::iterator dofIt1 = fieldIndices.begin(); dofIt1 != fieldIndices.end(); dofIt1++, i++) {
+    int rowInd = *dofIt1;
+    int j = 0;
+    for (set<int>::iterator dofIt2 = fieldIndices.begin(); dofIt2 != fieldIndices.end(); dofIt2++, j++) {
+      K_field(i,j) = packedK[packedIndex(rowInd,*dofIt2)];
+    }
+    j = 0;
+    for (set<int>::iterator dofIt2 = fluxIndices.begin(); dofIt2 != fluxIndices.end(); dofIt2++, j++) {
+      K_coupl(i,j) = packedK[packedIndex(rowInd,*dofIt2)];
+    }
+  }
+}
+
 void CondensedDofInterpreter::getSubvectors(set<int> fieldIndices, set<int> fluxIndices, const FieldContainer<double> &b, Epetra_SerialDenseVector &b_field, Epetra_SerialDenseVector &b_flux){
   
   int numFieldDofs = fieldIndices.size();
@@ -164,6 +271,105 @@ void CondensedDofInterpreter::getSubvectors(set<int> fieldIndices, set<int> flux
   }
 }
 
+void CondensedDofInterpreter::getLocalFieldAndFluxIndices(DofOrderingPtr trialOrder, vector<int> &fieldIndices, vector<int> &fluxIndices) {
+  set<int> fieldIndexSet, fluxIndexSet;
+  set<int> trialIDs = trialOrder->getVarIDs();
+  for (set<int>::iterator trialIDIt = trialIDs.begin(); trialIDIt != trialIDs.end(); trialIDIt++) {
+    int trialID = *trialIDIt;
+    const vector<int>* sides = &trialOrder->getSidesForVarID(trialID);
+    for (vector<int>::const_iterator sideIt = sides->begin(); sideIt != sides->end(); sideIt++) {
+      int sideOrdinal = *sideIt;
+      vector<int> varIndices = trialOrder->getDofIndices(trialID, sideOrdinal);
+      if (varDofsAreCondensible(trialID, sideOrdinal, trialOrder)) {
+        fieldIndexSet.insert(varIndices.begin(), varIndices.end());
+      } else {
+        fluxIndexSet.insert(varIndices.begin(),varIndices.end());
+      }
+    }
+  }
+  fieldIndices.assign(fieldIndexSet.begin(), fieldIndexSet.end());
+  fluxIndices.assign(fluxIndexSet.begin(), fluxIndexSet.end());
+}
+
+bool CondensedDofInterpreter::isSymmetric(const double *K, int n, double relativeTol) {
+  double maxEntry = 0;
+  for (int i=0; i<n*n; i++) {
+    maxEntry = max(maxEntry, abs(K[i]));
+  }
+  double tol = relativeTol * maxEntry;
+  for (int i=0; i<n; i++) {
+    for (int j=0; j<i; j++) {
+      if (abs(K[i * n + j] - K[j * n + i]) > tol) return false;
+    }
+  }
+  return true;
+}
+
+bool CondensedDofInterpreter::choleskyCondense(const double *K, const double *f, int n, const vector<int> &fieldIndices,
+                                               const vector<int> &fluxIndices, FieldContainer<double> &K_condensed,
+                                               FieldContainer<double> &f_condensed) {
+  int fieldCount = fieldIndices.size();
+  int fluxCount = fluxIndices.size();
+  
+  K_condensed.resize(fluxCount, fluxCount);
+  f_condensed.resize(fluxCount);
+  if (fluxCount == 0) return true;
+  
+  // only the upper triangle of K is read below; a nonsymmetric K must take the LU path
+  if (!isSymmetric(K, n)) return false;
+  
+  // S is column-major; only its upper triangle is computed, and it is symmetrized at the end
+  double *S = &K_condensed[0];
+  for (int j=0; j<fluxCount; j++) {
+    f_condensed(j) = f[fluxIndices[j]];
+    for (int i=0; i<=j; i++) {
+      S[i + j * fluxCount] = K[fluxIndices[i] * n + fluxIndices[j]];
+    }
+  }
+  
+  if (fieldCount > 0) {
+    Teuchos::LAPACK<int, double> lapack;
+    Teuchos::BLAS<int, double> blas;
+    
+    _fieldBlockWorkspace.resize(fieldCount * fieldCount);
+    double *U = &_fieldBlockWorkspace[0];
+    for (int j=0; j<fieldCount; j++) {
+      for (int i=0; i<=j; i++) {
+        U[i + j * fieldCount] = K[fieldIndices[i] * n + fieldIndices[j]];
+      }
+    }
+    int info = 0;
+    lapack.POTRF('U', fieldCount, U, fieldCount, &info);
+    if (info != 0) return false;
+    
+    // Z = [K_fb | f_f], overwritten by U^-T Z
+    _couplingWorkspace.resize(fieldCount * (fluxCount + 1));
+    double *Z = &_couplingWorkspace[0];
+    for (int j=0; j<fluxCount; j++) {
+      for (int i=0; i<fieldCount; i++) {
+        Z[i + j * fieldCount] = K[fieldIndices[i] * n + fluxIndices[j]];
+      }
+    }
+    double *z_f = Z + fluxCount * fieldCount;
+    for (int i=0; i<fieldCount; i++) {
+      z_f[i] = f[fieldIndices[i]];
+    }
+    blas.TRSM(Teuchos::LEFT_SIDE, Teuchos::UPPER_TRI, Teuchos::TRANS, Teuchos::NON_UNIT_DIAG, fieldCount, fluxCount + 1,
+              1.0, U, fieldCount, Z, fieldCount);
+    
+    // K_bb - K_bf K_ff^-1 K_fb = K_bb - Z_b^T Z_b, and likewise for the load
+    blas.SYRK(Teuchos::UPPER_TRI, Teuchos::TRANS, fluxCount, fieldCount, -1.0, Z, fieldCount, 1.0, S, fluxCount);
+    blas.GEMV(Teuchos::TRANS, fieldCount, fluxCount, -1.0, Z, fieldCount, z_f, 1, 1.0, &f_condensed[0], 1);
+  }
+  
+  for (int j=0; j<fluxCount; j++) {
+    for (int i=0; i<j; i++) {
+      S[j + i * fluxCount] = S[i + j * fluxCount];
+    }
+  }
+  return true;
+}
+
 GlobalIndexType CondensedDofInterpreter::condensedGlobalIndex(GlobalIndexType meshGlobalIndex) {
   if (_interpretedToGlobalDofIndexMap.find(meshGlobalIndex) != _interpretedToGlobalDofIndexMap.end()) {
     return _interpretedToGlobalDofIndexMap[meshGlobalIndex];
@@ -408,12 +614,82 @@ void CondensedDofInterpreter::interpretLocalCoefficients(GlobalIndexType cellID,
 
 void CondensedDofInterpreter::interpretLocalData(GlobalIndexType cellID, const FieldContainer<double> &localData,
                                                  FieldContainer<double> &globalData, FieldContainer<GlobalIndexType> &globalDofIndices) {
-  if (_localStiffnessMatrices.find(cellID) == _localStiffnessMatrices.end()) {
+  // NOTE: cellID *MUST* belong to this partition.
+  int rank = Teuchos::GlobalMPISession::getRank();
+  if (_mesh->partitionForCellID(cellID) != rank) {
+    cout << "cellID " << cellID << " does not belong to partition " << rank << ".\n";
+    TEUCHOS_TEST_FOR_EXCEPTION(true, std::invalid_argument, "cellID does not belong to partition");
+  }
+  if (!haveStoredStiffness(cellID)) {
     computeAndStoreLocalStiffnessAndLoad(cellID);
 //    TEUCHOS_TEST_FOR_EXCEPTION(true, std::invalid_argument, "CondensedDofInterpreter requires both stiffness and load data to be provided.");
   }
-  FieldContainer<double> globalStiffnessData; // dummy container
-  interpretLocalData(cellID, _localStiffnessMatrices[cellID], localData, globalStiffnessData, globalData, globalDofIndices);
+  const double *packedK = storedPackedStiffness(cellID);
+  
+  // only the load changes, so we condense it with the stored stiffness, in the local dof ordering (as interpretLocalBatchData() does),
+  // and interpret just the condensed load
+  DofOrderingPtr trialOrder = _mesh->getElementType(cellID)->trialOrderPtr;
+  int numTrialDofs = trialOrder->totalDofs();
+  vector<int> fieldIndexVector, fluxIndexVector;
+  getLocalFieldAndFluxIndices(trialOrder, fieldIndexVector, fluxIndexVector);
+  set<int> fieldIndices(fieldIndexVector.begin(), fieldIndexVector.end());
+  set<int> fluxIndices(fluxIndexVector.begin(), fluxIndexVector.end());
+  
+  Epetra_SerialDenseVector b_field, b_flux;
+  getSubvectors(fieldIndices, fluxIndices, localData, b_field, b_flux);
+  
+  if (fieldIndices.size() > 0) {
+    Epetra_SerialDenseMatrix D, B;
+    getSubmatrices(fieldIndices, fluxIndices, packedK, D, B);
+    
+    // b_flux - B^T D^-1 b_field
+    Epetra_SerialDenseVector Dinvf(fieldIndices.size());
+    Epetra_SerialDenseSolver solver;
+    solver.SetMatrix(D);
+    solver.SetVectors(Dinvf,b_field);
+    bool equilibrated = false;
+    if ( solver.ShouldEquilibrate() ) {
+      solver.EquilibrateMatrix();
+      solver.EquilibrateRHS();
+      equilibrated = true;
+    }
+    solver.Solve();
+    if (equilibrated)
+      solver.UnequilibrateLHS();
+    
+    b_flux.Multiply('T','N',-1.0,B,Dinvf,1.0);
+  }
+  
+  FieldContainer<double> paddedLoad(numTrialDofs); // zero in the field entries
+  int fluxOrdinal = 0;
+  for (set<int>::iterator fluxIt = fluxIndices.begin(); fluxIt != fluxIndices.end(); fluxIt++, fluxOrdinal++) {
+    paddedLoad(*fluxIt) = b_flux(fluxOrdinal);
+  }
+  
+  FieldContainer<double> interpretedLoadData;
+  FieldContainer<GlobalIndexType> interpretedDofIndices;
+  _mesh->interpretLocalData(cellID, paddedLoad, interpretedLoadData, interpretedDofIndices);
+  
+  if (_storeLocalStiffnessMatrices) {
+    storedLoad(cellID) = localData;
+    storedInterpretedDofIndices(cellID) = interpretedDofIndices;
+  }
+  discardFieldFactorization(cellID); // the fields will be recovered from the local stiffness and load
+  
+  // keep the rows corresponding to fluxes; those for fields are zero
+  vector<int> interpretedFluxOrdinals;
+  for (int dofOrdinal=0; dofOrdinal < interpretedDofIndices.size(); dofOrdinal++) {
+    if (_interpretedToGlobalDofIndexMap.find(interpretedDofIndices(dofOrdinal)) != _interpretedToGlobalDofIndexMap.end()) {
+      interpretedFluxOrdinals.push_back(dofOrdinal);
+    }
+  }
+  int globalFluxCount = interpretedFluxOrdinals.size();
+  globalData.resize(globalFluxCount);
+  globalDofIndices.resize(globalFluxCount);
+  for (int i=0; i<globalFluxCount; i++) {
+    globalDofIndices(i) = _interpretedToGlobalDofIndexMap[interpretedDofIndices(interpretedFluxOrdinals[i])];
+    globalData(i) = interpretedLoadData(interpretedFluxOrdinals[i]);
+  }
 }
 
 void CondensedDofInterpreter::interpretLocalData(GlobalIndexType cellID, const FieldContainer<double> &localStiffnessData, const FieldContainer<double> &localLoadData,
@@ -438,16 +714,11 @@ void CondensedDofInterpreter::interpretLocalData(GlobalIndexType cellID, const F
                                             interpretedStiffnessData, interpretedLoadData, interpretedDofIndices);
   
   if (_storeLocalStiffnessMatrices) {
-    if (_localStiffnessMatrices.find(cellID) != _localStiffnessMatrices.end()) {
-      if (&_localStiffnessMatrices[cellID] != &localStiffnessData) {
-        _localStiffnessMatrices[cellID] = localStiffnessData;
-      }
-    } else {
-      _localStiffnessMatrices[cellID] = localStiffnessData;
-    }
-    _localLoadVectors[cellID] = localLoadData;
-    _localInterpretedDofIndices[cellID] = interpretedDofIndices;
+    storeStiffness(cellID, &localStiffnessData[0], localStiffnessData.dimension(0));
+    storedLoad(cellID) = localLoadData;
+    storedInterpretedDofIndices(cellID) = interpretedDofIndices;
   }
+  discardFieldFactorization(cellID); // the fields will be recovered from the local stiffness and load
   
   set<int> fieldIndices, fluxIndices; // which are fields and which are fluxes in the interpreted data containers
 //  set<GlobalIndexType> interpretedFluxIndices, interpretedFieldIndices; // debugging
@@ -479,62 +750,87 @@ void CondensedDofInterpreter::interpretLocalData(GlobalIndexType cellID, const F
   int fieldCount = fieldIndices.size();
   int fluxCount = fluxIndices.size();
   
-  Epetra_SerialDenseMatrix D, B, K_flux;
- 
-  getSubmatrices(fieldIndices, fluxIndices, interpretedStiffnessData, D, B, K_flux);
-  
-  // reduce matrix
-  Epetra_SerialDenseMatrix Bcopy = B;
-  Epetra_SerialDenseSolver solver;
+  vector<int> fieldOrdinals(fieldIndices.begin(), fieldIndices.end());
+  vector<int> fluxOrdinals(fluxIndices.begin(), fluxIndices.end());
+  bool condensed = choleskyCondense(&interpretedStiffnessData[0], &interpretedLoadData[0], interpretedDofIndices.size(),
+                                    fieldOrdinals, fluxOrdinals, globalStiffnessData, globalLoadData);
+  
+  if (!condensed) {
+    // the stiffness is not symmetric, or its field block is not numerically SPD (e.g. after a filter has been applied);
+    // fall back on an LU factorization
+    Epetra_SerialDenseMatrix D, B, K_flux;
+   
+    getSubmatrices(fieldIndices, fluxIndices, interpretedStiffnessData, D, B, K_flux);
+    
+    // the flux/field coupling (B^T, if the stiffness is symmetric)
+    Epetra_SerialDenseMatrix C(fluxCount,fieldCount);
+    int i = 0;
+    for (set<int>::iterator fluxIt = fluxIndices.begin(); fluxIt != fluxIndices.end(); fluxIt++, i++) {
+      int j = 0;
+      for (set<int>::iterator fieldIt = fieldIndices.begin(); fieldIt != fieldIndices.end(); fieldIt++, j++) {
+        C(i,j) = interpretedStiffnessData(*fluxIt,*fieldIt);
+      }
+    }
+    
+    // reduce matrix
+    Epetra_SerialDenseMatrix Bcopy = B;
+    Epetra_SerialDenseSolver solver;
 
-  Epetra_SerialDenseMatrix DinvB(fieldCount,fluxCount);
-  solver.SetMatrix(D);
-  solver.SetVectors(DinvB, Bcopy);
-  bool equilibrated = false;
-  if ( solver.ShouldEquilibrate() ) {
-    solver.EquilibrateMatrix();
-    solver.EquilibrateRHS();
-    equilibrated = true;
-  }
-  int err = solver.Solve();
-  if (err != 0) {
-    cout << "CondensedDofInterpreter: Epetra_SerialDenseMatrix::Solve() returned error code " << err << endl;
-    cout << "matrix:\n" << D;
-  }
-  if (equilibrated)
-    solver.UnequilibrateLHS();
-  
-  K_flux.Multiply('T','N',-1.0,B,DinvB,1.0); // assemble condensed matrix - A - B^T*inv(D)*B
-  
-  // reduce vector
-  Epetra_SerialDenseVector Dinvf(fieldCount);
-  Epetra_SerialDenseVector BtDinvf(fluxCount);
-  Epetra_SerialDenseVector b_field, b_flux;
-  getSubvectors(fieldIndices, fluxIndices, interpretedLoadData, b_field, b_flux);
+    Epetra_SerialDenseMatrix DinvB(fieldCount,fluxCount);
+    solver.SetMatrix(D);
+    solver.SetVectors(DinvB, Bcopy);
+    bool equilibrated = false;
+    if ( solver.ShouldEquilibrate() ) {
+      solver.EquilibrateMatrix();
+      solver.EquilibrateRHS();
+      equilibrated = true;
+    }
+    int err = solver.Solve();
+    if (err != 0) {
+      cout << "CondensedDofInterpreter: Epetra_SerialDenseMatrix::Solve() returned error code " << err << endl;
+      cout << "matrix:\n" << D;
+    }
+    if (equilibrated)
+      solver.UnequilibrateLHS();
+    
+    K_flux.Multiply('N','N',-1.0,C,DinvB,1.0); // assemble condensed matrix - A - C*inv(D)*B
+    
+    // reduce vector
+    Epetra_SerialDenseVector Dinvf(fieldCount);
+    Epetra_SerialDenseVector BtDinvf(fluxCount);
+    Epetra_SerialDenseVector b_field, b_flux;
+    getSubvectors(fieldIndices, fluxIndices, interpretedLoadData, b_field, b_flux);
 
-  solver.SetVectors(Dinvf, b_field);
-  equilibrated = false;
-  //    solver.SetMatrix(D);
-  if ( solver.ShouldEquilibrate() ) {
-    solver.EquilibrateMatrix();
-    solver.EquilibrateRHS();
-    equilibrated = true;
-  }
-  err = solver.Solve();
-  if (err != 0) {
-    cout << "CondensedDofInterpreter: Epetra_SerialDenseMatrix::Solve() returned error code " << err << endl;
-    cout << "matrix:\n" << D;
+    solver.SetVectors(Dinvf, b_field);
+    equilibrated = false;
+    //    solver.SetMatrix(D);
+    if ( solver.ShouldEquilibrate() ) {
+      solver.EquilibrateMatrix();
+      solver.EquilibrateRHS();
+      equilibrated = true;
+    }
+    err = solver.Solve();
+    if (err != 0) {
+      cout << "CondensedDofInterpreter: Epetra_SerialDenseMatrix::Solve() returned error code " << err << endl;
+      cout << "matrix:\n" << D;
+    }
+    
+    if (equilibrated)
+      solver.UnequilibrateLHS();
+    
+    b_flux.Multiply('N','N',-1.0,C,Dinvf,1.0); // condensed RHS - f - C*inv(D)*g
+    
+    globalStiffnessData.resize( fluxCount, fluxCount );
+    globalLoadData.resize( fluxCount );
+    for (int i=0; i<fluxCount; i++) {
+      globalLoadData(i) = b_flux(i);
+      for (int j=0; j<fluxCount; j++) {
+        globalStiffnessData(i,j) = K_flux(i,j);
+      }
+    }
   }
   
-  if (equilibrated)
-    solver.UnequilibrateLHS();
-  
-  b_flux.Multiply('T','N',-1.0,B,Dinvf,1.0); // condensed RHS - f - B^T*inv(D)*g
-  
-  // resize output FieldContainers
   globalDofIndices.resize(fluxCount);
-  globalStiffnessData.resize( fluxCount, fluxCount );
-  globalLoadData.resize( fluxCount );
   
   set<int>::iterator indexIt;
   int i = 0;
@@ -545,11 +841,138 @@ void CondensedDofInterpreter::interpretLocalData(GlobalIndexType cellID, const F
     globalDofIndices(i) = condensedIndex;
     i++;
   }
+}
+
+void CondensedDofInterpreter::interpretLocalBatchData(const vector<GlobalIndexType> &cellIDs, const FieldContainer<double> &localStiffnessData,
+                                                      const FieldContainer<double> &localLoadData, vector< FieldContainer<double> > &globalStiffnessData,
+                                                      vector< FieldContainer<double> > &globalLoadData,
+                                                      vector< FieldContainer<GlobalIndexType> > &globalDofIndices) {
+  int numCells = cellIDs.size();
+  globalStiffnessData.resize(numCells);
+  globalLoadData.resize(numCells);
+  globalDofIndices.resize(numCells);
+  if (numCells == 0) return;
+  
+  // the field dofs are the volume dofs of discontinuous variables, which the mesh interprets one-to-one; the mesh's interpretation
+  // therefore commutes with condensation, and we can condense in the local dof ordering.  Cells of one element type share that
+  // ordering, so the field/flux split and the workspace are shared by the whole batch.
+  DofOrderingPtr trialOrder = _mesh->getElementType(cellIDs[0])->trialOrderPtr;
+  int numTrialDofs = trialOrder->totalDofs();
+  vector<int> fieldIndices, fluxIndices;
+  getLocalFieldAndFluxIndices(trialOrder, fieldIndices, fluxIndices);
+  int fieldCount = fieldIndices.size();
+  int fluxCount = fluxIndices.size();
   
-  for (int i=0; i<fluxCount; i++) {
-    globalLoadData(i) = b_flux(i);
-    for (int j=0; j<fluxCount; j++) {
-      globalStiffnessData(i,j) = K_flux(i,j);
+  FieldContainer<double> condensedStiffness, condensedLoad;
+  FieldContainer<double> paddedStiffness(numTrialDofs,numTrialDofs), paddedLoad(numTrialDofs); // condensed system, in the local dof ordering
+  FieldContainer<double> interpretedStiffnessData, interpretedLoadData;
+  FieldContainer<GlobalIndexType> interpretedDofIndices;
+  
+  int rank = Teuchos::GlobalMPISession::getRank();
+  for (int cellOrdinal=0; cellOrdinal<numCells; cellOrdinal++) {
+    GlobalIndexType cellID = cellIDs[cellOrdinal];
+    if (_mesh->partitionForCellID(cellID) != rank) {
+      cout << "cellID " << cellID << " does not belong to partition " << rank << ".\n";
+      TEUCHOS_TEST_FOR_EXCEPTION(true, std::invalid_argument, "cellID does not belong to partition");
+    }
+    const double *K = &localStiffnessData(cellOrdinal,0,0);
+    const double *f = &localLoadData(cellOrdinal,0);
+    
+    if (! choleskyCondense(K, f, numTrialDofs, fieldIndices, fluxIndices, condensedStiffness, condensedLoad)) {
+      // K is not symmetric, or its field block not positive definite: fall back on the cell-by-cell path, which uses an LU factorization
+      // (a stored K is replaced by its symmetric part, so the fields are recovered with that)
+      FieldContainer<double> cellStiffness(numTrialDofs,numTrialDofs), cellLoad(numTrialDofs);
+      for (int i=0; i<numTrialDofs; i++) {
+        cellLoad(i) = f[i];
+        for (int j=0; j<numTrialDofs; j++) {
+          cellStiffness(i,j) = K[i * numTrialDofs + j];
+        }
+      }
+      interpretLocalData(cellID, cellStiffness, cellLoad, globalStiffnessData[cellOrdinal], globalLoadData[cellOrdinal],
+                         globalDofIndices[cellOrdinal]); // discards any stored factorization for the cell
+      continue;
+    }
+    
+    bool storeFieldFactorization = _storeFieldFactorizations && (fieldCount > 0) && (fluxCount > 0);
+    if (storeFieldFactorization) {
+      // choleskyCondense() leaves U and U^-T [K_fb | f_f] in its workspace; U's upper triangle is kept, packed as in LocalDataStorage
+      ElementType* elemType = _mesh->getElementType(cellID).get();
+      FieldFactorization* factorization = &_fieldFactorizations[elemType];
+      int factorSize = fieldCount * (fieldCount + 1) / 2, couplingSize = fieldCount * (fluxCount + 1);
+      int factorizationOrdinal;
+      if (_fieldFactorizationOrdinals.find(cellID) != _fieldFactorizationOrdinals.end()) {
+        factorizationOrdinal = _fieldFactorizationOrdinals[cellID].second;
+      } else {
+        if (factorization->factors.size() == 0) {
+          factorization->fieldIndices = fieldIndices;
+          factorization->fluxIndices = fluxIndices;
+        }
+        if (factorization->freeOrdinals.size() > 0) {
+          factorizationOrdinal = factorization->freeOrdinals.back();
+          factorization->freeOrdinals.pop_back();
+        } else {
+          factorizationOrdinal = factorization->factors.size() / factorSize;
+          factorization->factors.resize((factorizationOrdinal + 1) * factorSize);
+          factorization->couplings.resize((factorizationOrdinal + 1) * couplingSize);
+        }
+        _fieldFactorizationOrdinals[cellID] = make_pair(elemType, factorizationOrdinal);
+      }
+      double *packedU = &factorization->factors[factorizationOrdinal * factorSize];
+      for (int j=0; j<fieldCount; j++) {
+        for (int i=0; i<=j; i++) {
+          packedU[i + j * (j + 1) / 2] = _fieldBlockWorkspace[i + j * fieldCount];
+        }
+      }
+      std::copy(_couplingWorkspace.begin(), _couplingWorkspace.begin() + couplingSize,
+                factorization->couplings.begin() + factorizationOrdinal * couplingSize);
+    }
+    
+    paddedStiffness.initialize(0.0);
+    paddedLoad.initialize(0.0);
+    for (int i=0; i<fluxCount; i++) {
+      paddedLoad(fluxIndices[i]) = condensedLoad(i);
+      for (int j=0; j<fluxCount; j++) {
+        paddedStiffness(fluxIndices[i],fluxIndices[j]) = condensedStiffness(i,j);
+      }
+    }
+    
+    _mesh->DofInterpreter::interpretLocalData(cellID, paddedStiffness, paddedLoad,
+                                              interpretedStiffnessData, interpretedLoadData, interpretedDofIndices);
+    
+    if (_storeLocalStiffnessMatrices || _storeFieldFactorizations) {
+      storedInterpretedDofIndices(cellID) = interpretedDofIndices; // the same for the condensed data as for the full data
+      FieldContainer<double> *load = &storedLoad(cellID);
+      load->resize(numTrialDofs);
+      for (int i=0; i<numTrialDofs; i++) {
+        (*load)(i) = f[i];
+      }
+    }
+    if (storeFieldFactorization) {
+      // the factorization stands in for the stiffness, which is recomputed if it is needed once the factorization is discarded
+      pair<ElementType*, int> cellIndex = localCellIndex(cellID);
+      _localData[cellIndex.first].isStored[cellIndex.second] = false;
+    } else if (_storeLocalStiffnessMatrices) {
+      storeStiffness(cellID, K, numTrialDofs);
+    }
+    
+    // keep the rows corresponding to fluxes; those for fields are zero
+    vector<int> interpretedFluxOrdinals;
+    for (int dofOrdinal=0; dofOrdinal < interpretedDofIndices.size(); dofOrdinal++) {
+      if (_interpretedToGlobalDofIndexMap.find(interpretedDofIndices(dofOrdinal)) != _interpretedToGlobalDofIndexMap.end()) {
+        interpretedFluxOrdinals.push_back(dofOrdinal);
+      }
+    }
+    int globalFluxCount = interpretedFluxOrdinals.size();
+    globalStiffnessData[cellOrdinal].resize(globalFluxCount,globalFluxCount);
+    globalLoadData[cellOrdinal].resize(globalFluxCount);
+    globalDofIndices[cellOrdinal].resize(globalFluxCount);
+    for (int i=0; i<globalFluxCount; i++) {
+      int interpretedOrdinal_i = interpretedFluxOrdinals[i];
+      globalDofIndices[cellOrdinal](i) = _interpretedToGlobalDofIndexMap[interpretedDofIndices(interpretedOrdinal_i)];
+      globalLoadData[cellOrdinal](i) = interpretedLoadData(interpretedOrdinal_i);
+      for (int j=0; j<globalFluxCount; j++) {
+        globalStiffnessData[cellOrdinal](i,j) = interpretedStiffnessData(interpretedOrdinal_i,interpretedFluxOrdinals[j]);
+      }
     }
   }
 }
@@ -561,10 +984,16 @@ void CondensedDofInterpreter::interpretGlobalCoefficients(GlobalIndexType cellID
 //  cout << "CondensedDofInterpreter::interpretGlobalCoefficients for cell " << cellID << endl;
   
   // get elem data and submatrix data
-  FieldContainer<double> K,rhs;
+  const double *packedK = NULL;
+  FieldContainer<double> rhs;
   FieldContainer<GlobalIndexType> interpretedDofIndices;
   
-  getLocalData(cellID, K, rhs, interpretedDofIndices);
+  bool haveFieldFactorization = (_fieldFactorizationOrdinals.find(cellID) != _fieldFactorizationOrdinals.end());
+  if (haveFieldFactorization) {
+    interpretedDofIndices = storedInterpretedDofIndices(cellID); // the local stiffness and load are not needed
+  } else {
+    getLocalData(cellID, packedK, rhs, interpretedDofIndices);
+  }
   
 //  cout << "CondensedDofInterpreter::interpretGlobalCoefficients, K:\n" << K;
 //  cout << "CondensedDofInterpreter::interpretGlobalCoefficients, rhs:\n" << rhs;
@@ -621,22 +1050,44 @@ void CondensedDofInterpreter::interpretGlobalCoefficients(GlobalIndexType cellID
   
 //  cout << "localCoefficients for cellID " << cellID << ":\n" << localCoefficients;
   
-  set<int> fieldIndices, fluxIndices; // which are fields and which are fluxes in the local cell coefficients
-  set<int> trialIDs = trialOrder->getVarIDs();
-  for (set<int>::iterator trialIDIt = trialIDs.begin(); trialIDIt != trialIDs.end(); trialIDIt++) {
-    int trialID = *trialIDIt;
-    const vector<int>* sides = &trialOrder->getSidesForVarID(trialID);
-    for (vector<int>::const_iterator sideIt = sides->begin(); sideIt != sides->end(); sideIt++) {
-      int sideOrdinal = *sideIt;
-      vector<int> varIndices = trialOrder->getDofIndices(trialID, sideOrdinal);
-      if (varDofsAreCondensible(trialID, sideOrdinal, trialOrder)) {
-        fieldIndices.insert(varIndices.begin(), varIndices.end());
-      } else {
-        fluxIndices.insert(varIndices.begin(),varIndices.end());
+  if (haveFieldFactorization) {
+    // with K_ff = U^T U and Z = U^-T [K_fb | f_f]: u_f = U^-1 (z_f - Z_b u_b)
+    FieldFactorization* factorization = &_fieldFactorizations[_fieldFactorizationOrdinals[cellID].first];
+    int factorizationOrdinal = _fieldFactorizationOrdinals[cellID].second;
+    const vector<int>* fieldIndices = &factorization->fieldIndices;
+    const vector<int>* fluxIndices = &factorization->fluxIndices;
+    int fieldCount = fieldIndices->size();
+    int fluxCount = fluxIndices->size();
+    const double *packedU = &factorization->factors[factorizationOrdinal * fieldCount * (fieldCount + 1) / 2];
+    const double *Z = &factorization->couplings[factorizationOrdinal * fieldCount * (fluxCount + 1)];
+    
+    vector<double> fluxDofs(fluxCount);
+    for (int fluxOrdinal=0; fluxOrdinal<fluxCount; fluxOrdinal++) {
+      fluxDofs[fluxOrdinal] = localCoefficients[(*fluxIndices)[fluxOrdinal]];
+    }
+    vector<double> fieldDofs(Z + fluxCount * fieldCount, Z + (fluxCount + 1) * fieldCount);
+    
+    Teuchos::BLAS<int, double> blas;
+    blas.GEMV(Teuchos::NO_TRANS, fieldCount, fluxCount, -1.0, Z, fieldCount, &fluxDofs[0], 1, 1.0, &fieldDofs[0], 1);
+    // back substitution with the packed U
+    for (int i=fieldCount-1; i>=0; i--) {
+      for (int j=i+1; j<fieldCount; j++) {
+        fieldDofs[i] -= packedU[i + j * (j + 1) / 2] * fieldDofs[j];
       }
+      fieldDofs[i] /= packedU[i + i * (i + 1) / 2];
+    }
+    
+    for (int fieldOrdinal=0; fieldOrdinal<fieldCount; fieldOrdinal++) {
+      localCoefficients[(*fieldIndices)[fieldOrdinal]] = fieldDofs[fieldOrdinal];
     }
+    return;
   }
   
+  vector<int> fieldIndexVector, fluxIndexVector;
+  getLocalFieldAndFluxIndices(trialOrder, fieldIndexVector, fluxIndexVector);
+  set<int> fieldIndices(fieldIndexVector.begin(), fieldIndexVector.end()); // which are fields and which are fluxes in the local cell coefficients
+  set<int> fluxIndices(fluxIndexVector.begin(), fluxIndexVector.end());
+  
   int fieldCount = fieldIndices.size();
   int fluxCount = fluxIndices.size();
   
@@ -647,9 +1098,9 @@ void CondensedDofInterpreter::interpretGlobalCoefficients(GlobalIndexType cellID
     flux_dofs[fluxOrdinal] = localCoefficients[*fluxIt];
   }
 
-  Epetra_SerialDenseMatrix D, B, fluxMat;
+  Epetra_SerialDenseMatrix D, B;
   Epetra_SerialDenseVector b_field, b_flux, field_dofs(fieldCount);
-  getSubmatrices(fieldIndices, fluxIndices, K, D, B, fluxMat);
+  getSubmatrices(fieldIndices, fluxIndices, packedK, D, B);
   getSubvectors(fieldIndices, fluxIndices, rhs, b_field, b_flux);
   
 //  cout << "K:\n" << K;
@@ -684,26 +1135,78 @@ void CondensedDofInterpreter::interpretGlobalCoefficients(GlobalIndexType cellID
 //  cout << "field_dofs:\n" << field_dofs;
 }
 
+void CondensedDofInterpreter::discardFieldFactorization(GlobalIndexType cellID) {
+  map<GlobalIndexType, pair<ElementType*, int> >::iterator ordinalIt = _fieldFactorizationOrdinals.find(cellID);
+  if (ordinalIt == _fieldFactorizationOrdinals.end()) return;
+  _fieldFactorizations[ordinalIt->second.first].freeOrdinals.push_back(ordinalIt->second.second);
+  _fieldFactorizationOrdinals.erase(ordinalIt);
+}
+
+void CondensedDofInterpreter::setStoreFieldFactorizations(bool value) {
+  _storeFieldFactorizations = value;
+  if (!_storeFieldFactorizations) {
+    _fieldFactorizations.clear();
+    _fieldFactorizationOrdinals.clear();
+  }
+}
+
+bool CondensedDofInterpreter::getStoreFieldFactorizations() {
+  return _storeFieldFactorizations;
+}
+
+long long CondensedDofInterpreter::fieldFactorizationStorageBytes() {
+  long long bytes = 0;
+  for (map<ElementType*, FieldFactorization>::iterator factorizationIt = _fieldFactorizations.begin();
+       factorizationIt != _fieldFactorizations.end(); factorizationIt++) {
+    FieldFactorization* factorization = &factorizationIt->second;
+    bytes += (factorization->factors.capacity() + factorization->couplings.capacity()) * sizeof(double);
+    bytes += (factorization->fieldIndices.capacity() + factorization->fluxIndices.capacity() + factorization->freeOrdinals.capacity()) * sizeof(int);
+  }
+  // the cellID lookup: roughly three pointers and a color per map node, plus the entry itself
+  bytes += _fieldFactorizationOrdinals.size() * (4 * sizeof(void*) + sizeof(GlobalIndexType) + sizeof(pair<ElementType*, int>));
+  return bytes;
+}
+
 void CondensedDofInterpreter::storeLoadForCell(GlobalIndexType cellID, const FieldContainer<double> &load) {
-  _localLoadVectors[cellID] = load;
+  storedLoad(cellID) = load;
+  discardFieldFactorization(cellID);
 }
 
 void CondensedDofInterpreter::storeStiffnessForCell(GlobalIndexType cellID, const FieldContainer<double> &stiffness) {
-  _localStiffnessMatrices[cellID] = stiffness;
+  storeStiffness(cellID, &stiffness[0], stiffness.dimension(0));
+  discardFieldFactorization(cellID);
 }
 
 const FieldContainer<double> & CondensedDofInterpreter::storedLocalLoadForCell(GlobalIndexType cellID) {
-  if (_localLoadVectors.find(cellID) != _localLoadVectors.end()) {
-    return _localLoadVectors[cellID];
-  } else {
+  const FieldContainer<double> *load = &storedLoad(cellID);
+  if (load->size() == 0) {
     TEUCHOS_TEST_FOR_EXCEPTION(true, std::invalid_argument, "no local load is stored for cell");
   }
+  return *load;
 }
 
-const FieldContainer<double> & CondensedDofInterpreter::storedLocalStiffnessForCell(GlobalIndexType cellID) {
-  if (_localStiffnessMatrices.find(cellID) != _localStiffnessMatrices.end()) {
-    return _localStiffnessMatrices[cellID];
-  } else {
-    TEUCHOS_TEST_FOR_EXCEPTION(true, std::invalid_argument, "no local stiffness matrix is stored for cell");
+FieldContainer<double> CondensedDofInterpreter::storedLocalStiffnessForCell(GlobalIndexType cellID) {
+  if (!haveStoredStiffness(cellID)) {
+    computeAndStoreLocalStiffnessAndLoad(cellID);
+  }
+  const double* packedK = storedPackedStiffness(cellID);
+  int n = _localData[localCellIndex(cellID).first].numTrialDofs;
+  FieldContainer<double> stiffness(n,n);
+  for (int i=0; i<n; i++) {
+    for (int j=0; j<n; j++) {
+      stiffness(i,j) = packedK[packedIndex(i,j)];
+    }
+  }
+  return stiffness;
+}
+
+long long CondensedDofInterpreter::localStiffnessStorageBytes() {
+  long long bytes = 0;
+  for (map<ElementType*, LocalDataStorage>::iterator storageIt = _localData.begin(); storageIt != _localData.end(); storageIt++) {
+    bytes += storageIt->second.packedMatrices.capacity() * sizeof(double);
+    bytes += storageIt->second.isStored.capacity() / 8;
   }
+  // the cellID lookup: roughly three pointers and a color per map node, plus the entry itself
+  bytes += _localCellIndices.size() * (4 * sizeof(void*) + sizeof(GlobalIndexType) + sizeof(pair<ElementType*, int>));
+  return bytes;
 }
\ No newline at end of file
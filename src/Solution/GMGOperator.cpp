@@ -28,6 +28,7 @@
 #include "Ifpack_Amesos.h"
 #include "Ifpack_ILU.h"
 #include "Ifpack_IC.h"
+#include "Ifpack_Chebyshev.h"
 #include "Ifpack_Graph.h"
 #include "Ifpack_Graph_Epetra_CrsGraph.h"
 #include "Ifpack_Graph_Epetra_RowMatrix.h"
@@ -38,6 +39,7 @@
 #include "Ifpack_DenseContainer.h"
 
 #include "CondensedDofInterpreter.h"
+#include "SerialDenseWrapper.h"
 
 #include "Epetra_Operator_to_Epetra_Matrix.h"
 
@@ -48,6 +50,54 @@ extern "C" void HPM_Start(char *);
 extern "C" void HPM_Stop(char *);
 #endif
 
+// true if A and B have the same row and column maps and the same nonzero locations on every rank
+static bool haveSameSparsityPattern(const Epetra_CrsMatrix &A, const Epetra_CrsMatrix &B) {
+  bool sameRowMap = A.RowMap().SameAs(B.RowMap()); // SameAs() is collective, so we call it on all ranks
+  bool sameColMap = A.ColMap().SameAs(B.ColMap());
+  int mismatch = (sameRowMap && sameColMap && (A.NumMyNonzeros() == B.NumMyNonzeros())) ? 0 : 1;
+  for (int localRow=0; (mismatch==0) && (localRow<A.NumMyRows()); localRow++) {
+    int numEntriesA, numEntriesB;
+    double *valuesA, *valuesB;
+    int *indicesA, *indicesB;
+    A.ExtractMyRowView(localRow, numEntriesA, valuesA, indicesA);
+    B.ExtractMyRowView(localRow, numEntriesB, valuesB, indicesB);
+    if (numEntriesA != numEntriesB) {
+      mismatch = 1;
+      break;
+    }
+    for (int i=0; i<numEntriesA; i++) {
+      if (indicesA[i] != indicesB[i]) {
+        mismatch = 1;
+        break;
+      }
+    }
+  }
+  int globalMismatch;
+  A.Comm().MaxAll(&mismatch, &globalMismatch, 1);
+  return globalMismatch == 0;
+}
+
+// ||B - A||_F / ||A||_F, for matrices with the same sparsity pattern
+static double relativeDifferenceNorm(const Epetra_CrsMatrix &A, const Epetra_CrsMatrix &B) {
+  double localSums[2] = {0.0, 0.0}; // squared norm of the difference, squared norm of A
+  for (int localRow=0; localRow<A.NumMyRows(); localRow++) {
+    int numEntriesA, numEntriesB;
+    double *valuesA, *valuesB;
+    int *indicesA, *indicesB;
+    A.ExtractMyRowView(localRow, numEntriesA, valuesA, indicesA);
+    B.ExtractMyRowView(localRow, numEntriesB, valuesB, indicesB);
+    for (int i=0; i<numEntriesA; i++) {
+      double diff = valuesB[i] - valuesA[i];
+      localSums[0] += diff * diff;
+      localSums[1] += valuesA[i] * valuesA[i];
+    }
+  }
+  double globalSums[2];
+  A.Comm().SumAll(localSums, globalSums, 2);
+  if (globalSums[1] == 0.0) return (globalSums[0] == 0.0) ? 0.0 : 1.0;
+  return sqrt(globalSums[0] / globalSums[1]);
+}
+
 GMGOperator::GMGOperator(BCPtr zeroBCs, MeshPtr coarseMesh, IPPtr coarseIP,
                          MeshPtr fineMesh, Teuchos::RCP<DofInterpreter> fineDofInterpreter, Epetra_Map finePartitionMap,
                          Teuchos::RCP<Solver> coarseSolver, bool useStaticCondensation, bool fineSolverUsesDiagonalScaling) :  _finePartitionMap(finePartitionMap), _br(true) {
@@ -58,6 +108,7 @@ GMGOperator::GMGOperator(BCPtr zeroBCs, MeshPtr coarseMesh, IPPtr coarseIP,
   _debugMode = false;
 
   _schwarzBlockFactorizationType = Direct;
+  _useCellSchwarzSubdomains = false;
 
   _applySmoothingOperator = true;
 
@@ -83,9 +134,24 @@ GMGOperator::GMGOperator(BCPtr zeroBCs, MeshPtr coarseMesh, IPPtr coarseIP,
 
   _coarseSolver = coarseSolver;
   _haveSolvedOnCoarseMesh = false;
+  _reuseCoarseSymbolicFactorization = false;
+  _coarseNumericReuseTolerance = 0.0;
+  _coarseFactorizationReuse = FULL_FACTORIZATION;
+  _coarseNumericFactorizationPending = false;
 
   _smootherType = IFPACK_ADDITIVE_SCHWARZ; // default
   _smootherOverlap = 0;
+  
+  _chebyshevDegree = 3;
+  _chebyshevPowerIterations = 10;
+  _chebyshevEigenvalueRatio = 30.0;
+  _chebyshevMaxEigenvalue = -1.0; // not yet computed
+
+  _fineStiffnessMatrix = NULL;
+  _cycleType = V_CYCLE;
+  _preSmoothingCount = 1;
+  _postSmoothingCount = 0; // (1,0) is the additive two-level scheme
+  _compositionType = ADDITIVE;
 
   if (( coarseMesh->meshUsesMaximumRule()) || (! fineMesh->meshUsesMinimumRule()) ) {
     cout << "GMGOperator only supports minimum rule.\n";
@@ -116,15 +182,13 @@ GMGOperator::GMGOperator(BCPtr zeroBCs, MeshPtr coarseMesh, IPPtr coarseIP,
 //    _coarseSolution->populateStiffnessAndLoad();
 //  }
 
-  Epetra_Time prolongationTimer(Comm);
 #ifdef HPCTW
   HPM_Start("constructProlongationOperator");
 #endif
-  constructProlongationOperator();
+  constructProlongationOperator(); // accumulates _timeProlongationOperatorConstruction
 #ifdef HPCTW
   HPM_Stop("constructProlongationOperator");
 #endif
-  _timeProlongationOperatorConstruction = prolongationTimer.ElapsedTime();
 
   int rank = Teuchos::GlobalMPISession::getRank();
   if (rank==0) {
@@ -138,7 +202,7 @@ GMGOperator::GMGOperator(BCPtr zeroBCs, MeshPtr coarseMesh, IPPtr coarseIP,
 }
 
 void GMGOperator::clearTimings() {
-  _timeMapFineToCoarse = 0, _timeMapCoarseToFine = 0, _timeConstruction = 0, _timeCoarseSolve = 0, _timeCoarseImport = 0, _timeLocalCoefficientMapConstruction = 0, _timeComputeCoarseStiffnessMatrix = 0, _timeProlongationOperatorConstruction = 0;
+  _timeMapFineToCoarse = 0, _timeMapCoarseToFine = 0, _timeConstruction = 0, _timeCoarseSolve = 0, _timeCoarseImport = 0, _timeLocalCoefficientMapConstruction = 0, _timeComputeCoarseStiffnessMatrix = 0, _timeProlongationOperatorConstruction = 0, _timeSetUpSmoother = 0, _timeApplySmoother = 0;
 }
 
 void GMGOperator::computeCoarseStiffnessMatrix(Epetra_CrsMatrix *fineStiffnessMatrix) {
@@ -161,6 +225,7 @@ void GMGOperator::computeCoarseStiffnessMatrix(Epetra_CrsMatrix *fineStiffnessMa
 #endif
   Epetra_Time coarseStiffnessTimer(Comm);
   
+  _fineStiffnessMatrix = fineStiffnessMatrix;
   setUpSmoother(fineStiffnessMatrix);
 
 //  EpetraExt::RowMatrixToMatrixMarketFile("/tmp/A.dat",*fineStiffnessMatrix, NULL, NULL, false); // false: don't write header
@@ -203,6 +268,18 @@ void GMGOperator::computeCoarseStiffnessMatrix(Epetra_CrsMatrix *fineStiffnessMa
 
   Teuchos::RCP<Epetra_CrsMatrix> coarseStiffness = Teuchos::rcp( new Epetra_CrsMatrix(*PT_A_P, coarseImporter) );
 
+  // decide, against the matrix from which the existing factorization was computed, whether that factorization can be reused
+  _coarseFactorizationReuse = FULL_FACTORIZATION;
+  if (_reuseCoarseSymbolicFactorization && _haveSolvedOnCoarseMesh && (_factoredCoarseStiffness != Teuchos::null)
+      && (_coarseOperator == Teuchos::null)) {
+    if (haveSameSparsityPattern(*_factoredCoarseStiffness, *coarseStiffness)) {
+      _coarseFactorizationReuse = NUMERIC_FACTORIZATION;
+      if ((_coarseNumericReuseTolerance > 0) && (relativeDifferenceNorm(*_factoredCoarseStiffness, *coarseStiffness) < _coarseNumericReuseTolerance)) {
+        _coarseFactorizationReuse = NO_FACTORIZATION;
+      }
+    }
+  }
+
   _coarseSolution->setStiffnessMatrix(coarseStiffness);
 
 //  cout << "type a number to continue:\n";
@@ -211,7 +288,18 @@ void GMGOperator::computeCoarseStiffnessMatrix(Epetra_CrsMatrix *fineStiffnessMa
 
   _timeComputeCoarseStiffnessMatrix = coarseStiffnessTimer.ElapsedTime();
   
-  _haveSolvedOnCoarseMesh = false; // having recomputed coarseStiffness, any existing factorization is invalid
+  if (_coarseFactorizationReuse == FULL_FACTORIZATION) {
+    _haveSolvedOnCoarseMesh = false; // having recomputed coarseStiffness, any existing factorization is invalid
+    _coarseNumericFactorizationPending = false;
+  } else {
+    // the existing factorization remains valid for _factoredCoarseStiffness, which the coarse solver's problem still refers to
+    _coarseNumericFactorizationPending = (_coarseFactorizationReuse == NUMERIC_FACTORIZATION);
+  }
+  
+  if (_coarseOperator != Teuchos::null) {
+    // the coarse stiffness matrix is the next level's fine stiffness matrix
+    _coarseOperator->computeCoarseStiffnessMatrix(coarseStiffness.get());
+  }
 }
 
 void GMGOperator::constructLocalCoefficientMaps() {
@@ -227,6 +315,8 @@ void GMGOperator::constructLocalCoefficientMaps() {
 }
 
 Teuchos::RCP<Epetra_CrsMatrix> GMGOperator::constructProlongationOperator() {
+  Epetra_Time timer(Comm());
+
   // row indices belong to the fine grid, columns to the coarse
   // maps coefficients from coarse to fine
 //  _globalStiffMatrix = Teuchos::rcp(new Epetra_FECrsMatrix(::Copy, partMap, maxRowSize));
@@ -241,126 +331,203 @@ Teuchos::RCP<Epetra_CrsMatrix> GMGOperator::constructProlongationOperator() {
   GlobalIndexType firstFineConstraintRowIndex = _fineDofInterpreter->globalDofCount();
   GlobalIndexType firstCoarseConstraintRowIndex = _coarseSolution->getDofInterpreter()->globalDofCount();
 
-  // strategy: we iterate on the rank-local global dof indices on the fine mesh.
-  //           we construct X, a canonical basis vector for the global dof index.
-  //           we then determine the coarse mesh coefficients for X.
-  //           This is a row of the matrix P.
+  // strategy: on each rank-local fine cell, P restricted to the cell is B_c^T * M * B_f, where
+  //   B_f maps fine global coefficients to the fine cell's local coefficients (the fine dof interpreter),
+  //   M maps fine local coefficients to coarse local coefficients (the local coefficient map, applied to the volume and
+  //     to the sides that the fine cell owns), and
+  //   B_c^T maps coarse local coefficients to coarse global coefficients (interpretLocalData() on the coarse dof interpreter).
+  //   We insert the rows that belong to this rank; contributions from several cells to the same entry are summed on assembly.
+  // M depends only on the fine and coarse element types, the refinement branch, side ownership and side parities, so we
+  // compute it once for each such group of fine cells.  B_c^T is computed once per coarse cell, B_f once per fine cell, and each
+  // cell's block of P is computed as a dense product and inserted with a single call.
   set<GlobalIndexType> cellsInPartition = _fineMesh->globalDofAssignment()->cellsInPartition(-1); // rank-local
 
-  {
-    Epetra_SerialComm SerialComm; // rank-local map
+  // the coarse cells underlying our fine cells need not be near the coarse cells this rank owns; fetch their global dof offsets
+  // (setCoarseRHSVector() relies on these as well)
+  set<GlobalIndexType> coarseCellIDs;
+  for (set<GlobalIndexType>::iterator cellIDIt = cellsInPartition.begin(); cellIDIt != cellsInPartition.end(); cellIDIt++) {
+    coarseCellIDs.insert(getCoarseCellID(*cellIDIt));
+  }
+  _coarseMesh->globalDofAssignment()->importCellDofOffsets(coarseCellIDs);
+
+  // constraint rows: by convention, these come at the end, and map one-to-one
+  for (int localID=0; localID < _finePartitionMap.NumMyElements(); localID++) {
+    GlobalIndexTypeToCast globalRow = _finePartitionMap.GID(localID);
+    if (globalRow >= firstFineConstraintRowIndex) {
+      int offset = globalRow - firstFineConstraintRowIndex;
+      GlobalIndexTypeToCast coarseGlobalRow = firstCoarseConstraintRowIndex + offset;
+      double one = 1.0;
+      P->InsertGlobalValues(globalRow, 1, &one, &coarseGlobalRow);
+    }
+  }
 
-    GlobalIndexTypeToCast* myGlobalIndicesPtr;
-    _finePartitionMap.MyGlobalElementsPtr(*&myGlobalIndicesPtr);
+  // B_f^T is the fine interpretation of local data.  With static condensation, the fine global dofs are the condensed
+  // interpreter's numbering of the mesh's flux dofs, so we use the mesh's interpretation and renumber (the field
+  // columns of M are zero, and the condensed interpreter's own interpretLocalData() condenses, storing what it is given).
+  CondensedDofInterpreter* condensedDofInterpreter = NULL;
+  if (_useStaticCondensation) {
+    condensedDofInterpreter = dynamic_cast<CondensedDofInterpreter*>(_fineDofInterpreter.get());
+  }
+  DofInterpreter* fineInterpreter = (condensedDofInterpreter != NULL) ? (DofInterpreter*) _fineMesh.get() : _fineDofInterpreter.get();
 
-    map<GlobalIndexTypeToCast, set<GlobalIndexType> > cellsForGlobalDofOrdinal;
-    vector<GlobalIndexTypeToCast> myGlobalIndices(_finePartitionMap.NumMyElements());
-    {
-      set<GlobalIndexTypeToCast> globalIndicesForRank;
-      for  (int i=0;i <_finePartitionMap.NumMyElements(); i++) {
-        globalIndicesForRank.insert(myGlobalIndicesPtr[i]);
-        myGlobalIndices[i] = myGlobalIndicesPtr[i];
-      }
+  typedef pair< pair<ElementType*, ElementType*>, pair<RefinementBranch, vector<int> > > ProlongationGroupKey;
+  map< ProlongationGroupKey, FieldContainer<double> > localProlongationForGroup; // M, indexed (coarse local, fine local)
+  map< GlobalIndexType, pair< vector<GlobalIndexTypeToCast>, FieldContainer<double> > > coarseInterpretationForCell; // B_c^T, indexed (coarse global, coarse local)
 
-      // for dof interpreter's sake, want to put 0's in slots for any seen-but-not-owned global coefficients
-      set<GlobalIndexType> myCellIDs = _fineMesh->globalDofAssignment()->cellsInPartition(-1);
-      for (set<GlobalIndexType>::iterator cellIDIt = myCellIDs.begin(); cellIDIt != myCellIDs.end(); cellIDIt++) {
-        GlobalIndexType cellID = *cellIDIt;
-        set<GlobalIndexType> globalDofsForCell = _fineDofInterpreter->globalDofIndicesForCell(cellID);
-        for (set<GlobalIndexType>::iterator globalDofIt = globalDofsForCell.begin(); globalDofIt != globalDofsForCell.end(); globalDofIt++) {
-          cellsForGlobalDofOrdinal[*globalDofIt].insert(cellID);
-          if (globalIndicesForRank.find(*globalDofIt) == globalIndicesForRank.end()) {
-            myGlobalIndices.push_back(*globalDofIt);
-//            offRankGlobalIndicesForMyCells.insert(*globalDofIt);
-          }
-        }
-      }
+  for (set<GlobalIndexType>::iterator cellIDIt = cellsInPartition.begin(); cellIDIt != cellsInPartition.end(); cellIDIt++) {
+    GlobalIndexType fineCellID = *cellIDIt;
+    GlobalIndexType coarseCellID = getCoarseCellID(fineCellID);
+    ElementTypePtr fineElementType = _fineMesh->getElementType(fineCellID);
+    ElementTypePtr coarseElementType = _coarseMesh->getElementType(coarseCellID);
+    int fineDofCount = fineElementType->trialOrderPtr->totalDofs();
+    int coarseDofCount = coarseElementType->trialOrderPtr->totalDofs();
+
+    // the rows of P that this cell contributes to and this rank owns
+    map<GlobalIndexTypeToCast, int> fineGlobalOrdinals;
+    vector<GlobalIndexTypeToCast> fineGlobalIndices;
+    set<GlobalIndexType> fineGlobalDofs = _fineDofInterpreter->globalDofIndicesForCell(fineCellID);
+    for (set<GlobalIndexType>::iterator globalDofIt = fineGlobalDofs.begin(); globalDofIt != fineGlobalDofs.end(); globalDofIt++) {
+      GlobalIndexTypeToCast globalRow = *globalDofIt;
+      if (!_finePartitionMap.MyGID(globalRow)) continue; // another rank's row
+      if (globalRow >= firstFineConstraintRowIndex) continue;
+      fineGlobalOrdinals[globalRow] = fineGlobalIndices.size();
+      fineGlobalIndices.push_back(globalRow);
     }
+    int fineGlobalCount = fineGlobalIndices.size();
+    if (fineGlobalCount == 0) continue;
 
-    Epetra_Map    localXMap(myGlobalIndices.size(), myGlobalIndices.size(), &myGlobalIndices[0], 0, SerialComm);
-    Teuchos::RCP<Epetra_Vector> XLocal = Teuchos::rcp( new Epetra_Vector(localXMap) );
-
-    for (int localID=0; localID < _finePartitionMap.NumMyElements(); localID++) {
-      GlobalIndexTypeToCast globalRow = _finePartitionMap.GID(localID);
-
-      map<GlobalIndexTypeToCast, double> coarseXVectorLocal; // rank-local representation, so we just use an STL map.  Has the advantage of growing as we need it to.
-      (*XLocal)[localID] = 1.0;
+    CellPtr fineCell = _fineMesh->getTopology()->getCell(fineCellID);
+    int sideCount = fineCell->getSideCount();
 
-      if (globalRow >= firstFineConstraintRowIndex) {
-        // belongs to a lagrange degree of freedom (zero-mean constraints are a special case), so we do a one-to-one map
-        int offset = globalRow - firstFineConstraintRowIndex;
-        GlobalIndexType coarseGlobalRow = firstCoarseConstraintRowIndex + offset;
-        coarseXVectorLocal[coarseGlobalRow] = 1.0;
-      } else {
+    ProlongationGroupKey groupKey;
+    groupKey.first = make_pair(fineElementType.get(), coarseElementType.get());
+    groupKey.second.first = getRefinementBranch(fineCellID);
+    vector<int>* signature = &groupKey.second.second;
+    FieldContainer<double> fineParities = _fineMesh->globalDofAssignment()->cellSideParitiesForCell(fineCellID);
+    FieldContainer<double> coarseParities = _coarseMesh->globalDofAssignment()->cellSideParitiesForCell(coarseCellID);
+    for (int sideOrdinal=0; sideOrdinal<sideCount; sideOrdinal++) {
+      signature->push_back(fineCell->ownsSide(sideOrdinal) ? 1 : 0);
+      signature->push_back(fineParities(0,sideOrdinal) > 0 ? 1 : -1);
+    }
+    for (int sideOrdinal=0; sideOrdinal<coarseParities.dimension(1); sideOrdinal++) {
+      signature->push_back(coarseParities(0,sideOrdinal) > 0 ? 1 : -1);
+    }
 
-        set<GlobalIndexType> cells = cellsForGlobalDofOrdinal[globalRow];
-        for (set<GlobalIndexType>::iterator cellIDIt=cells.begin(); cellIDIt != cells.end(); cellIDIt++) {
-          GlobalIndexType fineCellID = *cellIDIt;
-          int fineDofCount = _fineMesh->getElementType(fineCellID)->trialOrderPtr->totalDofs();
-          FieldContainer<double> fineCellData(fineDofCount);
-          _fineDofInterpreter->interpretGlobalCoefficients(fineCellID, fineCellData, *XLocal);
-  //        if (globalRow==1) {
-  //          cout << "fineCellData:\n" << fineCellData;
-  //        }
-          LocalDofMapperPtr fineMapper = getLocalCoefficientMap(fineCellID);
-          GlobalIndexType coarseCellID = getCoarseCellID(fineCellID);
-          int coarseDofCount = _coarseMesh->getElementType(coarseCellID)->trialOrderPtr->totalDofs();
-          FieldContainer<double> coarseCellData(coarseDofCount);
-          FieldContainer<double> mappedCoarseCellData(fineMapper->globalIndices().size());
-          fineMapper->mapLocalDataVolume(fineCellData, mappedCoarseCellData, false);
-
-          CellPtr fineCell = _fineMesh->getTopology()->getCell(fineCellID);
-          int sideCount = fineCell->getSideCount();
-          for (int sideOrdinal=0; sideOrdinal<sideCount; sideOrdinal++) {
-            if (fineCell->ownsSide(sideOrdinal)) {
-  //        cout << "fine cell " << fineCellID << " owns side " << sideOrdinal << endl;
-              fineMapper->mapLocalDataSide(fineCellData, mappedCoarseCellData, false, sideOrdinal);
-            }
+    if (localProlongationForGroup.find(groupKey) == localProlongationForGroup.end()) {
+      LocalDofMapperPtr fineMapper = getLocalCoefficientMap(fineCellID);
+      vector<GlobalIndexType> mappedCoarseDofIndices = fineMapper->globalIndices(); // "global" here means the coarse local
+      FieldContainer<double> M(coarseDofCount, fineDofCount);
+      FieldContainer<double> fineCellData(fineDofCount);
+      FieldContainer<double> mappedCoarseCellData(mappedCoarseDofIndices.size());
+      for (int fineOrdinal=0; fineOrdinal<fineDofCount; fineOrdinal++) {
+        fineCellData[fineOrdinal] = 1.0;
+        mappedCoarseCellData.initialize(0.0);
+        fineMapper->mapLocalDataVolume(fineCellData, mappedCoarseCellData, false);
+        for (int sideOrdinal=0; sideOrdinal<sideCount; sideOrdinal++) {
+          if (fineCell->ownsSide(sideOrdinal)) {
+            fineMapper->mapLocalDataSide(fineCellData, mappedCoarseCellData, false, sideOrdinal);
           }
-
-  //        if (globalRow==1) {
-  //          cout << "mappedCoarseCellData:\n" << mappedCoarseCellData;
-  //        }
-          vector<GlobalIndexType> mappedCoarseDofIndices = fineMapper->globalIndices(); // "global" here means the coarse local
-          for (int mappedCoarseDofOrdinal = 0; mappedCoarseDofOrdinal < mappedCoarseDofIndices.size(); mappedCoarseDofOrdinal++) {
-            GlobalIndexType coarseDofIndex = mappedCoarseDofIndices[mappedCoarseDofOrdinal];
-            coarseCellData[coarseDofIndex] = mappedCoarseCellData[mappedCoarseDofOrdinal];
+        }
+        for (int mappedCoarseDofOrdinal = 0; mappedCoarseDofOrdinal < mappedCoarseDofIndices.size(); mappedCoarseDofOrdinal++) {
+          M(mappedCoarseDofIndices[mappedCoarseDofOrdinal], fineOrdinal) = mappedCoarseCellData[mappedCoarseDofOrdinal];
+        }
+        fineCellData[fineOrdinal] = 0.0;
+      }
+      localProlongationForGroup[groupKey] = M;
+    }
+    const FieldContainer<double>* M = &localProlongationForGroup[groupKey];
+
+    if (coarseInterpretationForCell.find(coarseCellID) == coarseInterpretationForCell.end()) {
+      map<GlobalIndexTypeToCast, int> globalOrdinals;
+      vector<GlobalIndexTypeToCast> coarseGlobalIndices;
+      vector< FieldContainer<double> > interpretedData(coarseDofCount);
+      vector< FieldContainer<GlobalIndexType> > interpretedGlobalDofIndices(coarseDofCount);
+      FieldContainer<double> coarseCellData(coarseDofCount);
+      for (int coarseOrdinal=0; coarseOrdinal<coarseDofCount; coarseOrdinal++) {
+        coarseCellData[coarseOrdinal] = 1.0;
+        _coarseSolution->getDofInterpreter()->interpretLocalData(coarseCellID, coarseCellData, interpretedData[coarseOrdinal], interpretedGlobalDofIndices[coarseOrdinal]);
+        coarseCellData[coarseOrdinal] = 0.0;
+        for (int i=0; i<interpretedGlobalDofIndices[coarseOrdinal].size(); i++) {
+          GlobalIndexTypeToCast globalDofIndex = interpretedGlobalDofIndices[coarseOrdinal][i];
+          if (globalOrdinals.find(globalDofIndex) == globalOrdinals.end()) {
+            globalOrdinals[globalDofIndex] = coarseGlobalIndices.size();
+            coarseGlobalIndices.push_back(globalDofIndex);
           }
-          FieldContainer<double> interpretedCoarseData;
-          FieldContainer<GlobalIndexType> interpretedGlobalDofIndices;
-          _coarseSolution->getDofInterpreter()->interpretLocalData(coarseCellID, coarseCellData, interpretedCoarseData, interpretedGlobalDofIndices);
-
-  //        if (globalRow==1) {
-  //          cout << "interpretedCoarseData:\n" << interpretedCoarseData;
-  //          cout << "interpretedGlobalDofIndices:\n" << interpretedGlobalDofIndices;
-  //        }
-
-          for (int interpretedCoarseGlobalDofOrdinal=0; interpretedCoarseGlobalDofOrdinal < interpretedGlobalDofIndices.size(); interpretedCoarseGlobalDofOrdinal++) {
-            GlobalIndexType globalDofIndex = interpretedGlobalDofIndices[interpretedCoarseGlobalDofOrdinal];
-            coarseXVectorLocal[globalDofIndex] += interpretedCoarseData[interpretedCoarseGlobalDofOrdinal];
+        }
+      }
+      FieldContainer<double> coarseInterpretation(coarseGlobalIndices.size(), coarseDofCount);
+      for (int coarseOrdinal=0; coarseOrdinal<coarseDofCount; coarseOrdinal++) {
+        for (int i=0; i<interpretedGlobalDofIndices[coarseOrdinal].size(); i++) {
+          int globalOrdinal = globalOrdinals[interpretedGlobalDofIndices[coarseOrdinal][i]];
+          coarseInterpretation(globalOrdinal, coarseOrdinal) += interpretedData[coarseOrdinal][i];
+        }
+      }
+      coarseInterpretationForCell[coarseCellID] = make_pair(coarseGlobalIndices, coarseInterpretation);
+    }
+    const vector<GlobalIndexTypeToCast>* coarseGlobalIndices = &coarseInterpretationForCell[coarseCellID].first;
+    const FieldContainer<double>* coarseInterpretation = &coarseInterpretationForCell[coarseCellID].second;
+    int coarseGlobalCount = coarseGlobalIndices->size();
+    if (coarseGlobalCount == 0) continue;
+
+    // B_f, indexed (fine local, fine global), restricted to our rows: row k is the interpretation of the k-th fine local basis vector
+    FieldContainer<double> fineInterpretation(fineDofCount, fineGlobalCount);
+    {
+      FieldContainer<double> fineCellData(fineDofCount);
+      FieldContainer<double> interpretedData;
+      FieldContainer<GlobalIndexType> interpretedGlobalDofIndices;
+      for (int fineOrdinal=0; fineOrdinal<fineDofCount; fineOrdinal++) {
+        fineCellData[fineOrdinal] = 1.0;
+        fineInterpreter->interpretLocalData(fineCellID, fineCellData, interpretedData, interpretedGlobalDofIndices);
+        fineCellData[fineOrdinal] = 0.0;
+        for (int i=0; i<interpretedGlobalDofIndices.size(); i++) {
+          GlobalIndexType globalDofIndex = interpretedGlobalDofIndices[i];
+          if (condensedDofInterpreter != NULL) {
+            globalDofIndex = condensedDofInterpreter->condensedGlobalIndex(globalDofIndex); // -1 for fields
           }
+          map<GlobalIndexTypeToCast, int>::iterator ordinalIt = fineGlobalOrdinals.find((GlobalIndexTypeToCast)globalDofIndex);
+          if (ordinalIt == fineGlobalOrdinals.end()) continue; // not one of our rows
+          fineInterpretation(fineOrdinal, ordinalIt->second) += interpretedData[i];
         }
       }
+    }
 
-      FieldContainer<GlobalIndexTypeToCast> coarseGlobalIndices(coarseXVectorLocal.size());
-      FieldContainer<double> coarseGlobalValues(coarseXVectorLocal.size());
-      int nnz = 0; // nonzero entries
-//      cout << "P global row " << globalRow << ": ";
-      for (map<GlobalIndexTypeToCast, double>::iterator coarseXIt=coarseXVectorLocal.begin(); coarseXIt != coarseXVectorLocal.end(); coarseXIt++) {
-        if (coarseXIt->second != 0.0) {
-          coarseGlobalIndices[nnz] = coarseXIt->first;
-          coarseGlobalValues[nnz] = coarseXIt->second;
-//          cout << coarseGlobalIndices[nnz] << " --> " << coarseGlobalValues[nnz] << "; ";
-          nnz++;
+    // P restricted to the cell, indexed (fine global, coarse global): (B_c^T * M * B_f)^T
+    FieldContainer<double> MB_f(coarseDofCount, fineGlobalCount);
+    SerialDenseWrapper::multiply(MB_f, *M, fineInterpretation);
+    FieldContainer<double> cellBlock(fineGlobalCount, coarseGlobalCount);
+    SerialDenseWrapper::multiply(cellBlock, MB_f, *coarseInterpretation, 'T', 'T');
+
+    // drop the rows and columns that are exactly zero, and insert the rest as one block
+    vector<int> nonzeroRows, nonzeroCols;
+    vector<bool> colIsNonzero(coarseGlobalCount, false);
+    for (int i=0; i<fineGlobalCount; i++) {
+      bool rowIsNonzero = false;
+      for (int j=0; j<coarseGlobalCount; j++) {
+        if (cellBlock(i,j) != 0.0) {
+          rowIsNonzero = true;
+          colIsNonzero[j] = true;
         }
       }
-//      cout << endl;
-      if (nnz > 0) {
-        P->InsertGlobalValues(globalRow, nnz, &coarseGlobalValues[0], &coarseGlobalIndices[0]);
-//        cout << "Inserting values for row " << globalRow << endl;
+      if (rowIsNonzero) nonzeroRows.push_back(i);
+    }
+    for (int j=0; j<coarseGlobalCount; j++) {
+      if (colIsNonzero[j]) nonzeroCols.push_back(j);
+    }
+    if (nonzeroRows.size() == 0) continue;
+
+    int numRows = nonzeroRows.size(), numCols = nonzeroCols.size();
+    vector<GlobalIndexTypeToCast> rowIndices(numRows), colIndices(numCols);
+    vector<double> blockValues(numRows * numCols); // row-major
+    for (int i=0; i<numRows; i++) {
+      rowIndices[i] = fineGlobalIndices[nonzeroRows[i]];
+      for (int j=0; j<numCols; j++) {
+        blockValues[i * numCols + j] = cellBlock(nonzeroRows[i],nonzeroCols[j]);
       }
-      (*XLocal)[localID] = 0.0;
     }
+    for (int j=0; j<numCols; j++) {
+      colIndices[j] = (*coarseGlobalIndices)[nonzeroCols[j]];
+    }
+    P->InsertGlobalValues(numRows, &rowIndices[0], numCols, &colIndices[0], &blockValues[0], Epetra_FECrsMatrix::ROW_MAJOR);
   }
 
 //  cout << "before FillComplete(), _P has " << _P->NumGlobalRows64() << " rows and " << _P->NumGlobalCols64() << " columns.\n";
@@ -377,9 +544,27 @@ Teuchos::RCP<Epetra_CrsMatrix> GMGOperator::constructProlongationOperator() {
 
 //  cout << "after FillComplete(),  _P has " << _P->NumGlobalRows64() << " rows and " << _P->NumGlobalCols64() << " columns.\n";
 
+  _timeProlongationOperatorConstruction += timer.ElapsedTime();
+
   return _P;
 }
 
+RefinementBranch GMGOperator::getRefinementBranch(GlobalIndexType fineCellID) const {
+  const set<IndexType>* coarseCellIDs = &_coarseMesh->getTopology()->getActiveCellIndices();
+  CellPtr ancestor = _fineMesh->getTopology()->getCell(fineCellID);
+  RefinementBranch refBranch;
+  while (coarseCellIDs->find(ancestor->cellIndex()) == coarseCellIDs->end()) {
+    CellPtr parent = ancestor->getParent();
+    if (parent.get() == NULL) {
+      TEUCHOS_TEST_FOR_EXCEPTION(true, std::invalid_argument, "ancestor for fine cell not found in coarse mesh");
+    }
+    unsigned childOrdinal = parent->childOrdinal(ancestor->cellIndex());
+    refBranch.insert(refBranch.begin(), make_pair(parent->refinementPattern().get(), childOrdinal));
+    ancestor = parent;
+  }
+  return refBranch;
+}
+
 GlobalIndexType GMGOperator::getCoarseCellID(GlobalIndexType fineCellID) const {
   const set<IndexType>* coarseCellIDs = &_coarseMesh->getTopology()->getActiveCellIndices();
   CellPtr fineCell = _fineMesh->getTopology()->getCell(fineCellID);
@@ -397,10 +582,22 @@ GlobalIndexType GMGOperator::getCoarseCellID(GlobalIndexType fineCellID) const {
   return ancestor->cellIndex();
 }
 
+double GMGOperator::getChebyshevMaxEigenvalue() const {
+  return _chebyshevMaxEigenvalue;
+}
+
+GMGOperator::CoarseFactorizationReuse GMGOperator::getCoarseFactorizationReuse() const {
+  return _coarseFactorizationReuse;
+}
+
 SolutionPtr GMGOperator::getCoarseSolution() {
   return _coarseSolution;
 }
 
+Teuchos::RCP<GMGOperator> GMGOperator::getCoarseOperator() {
+  return _coarseOperator;
+}
+
 SolverPtr GMGOperator::getCoarseSolver() {
   return _coarseSolver;
 }
@@ -478,7 +675,11 @@ LocalDofMapperPtr GMGOperator::getLocalCoefficientMap(GlobalIndexType fineCellID
 //        cout << "Warning: for debugging purposes, skipping projection of fields in GMGOperator.\n";
         BasisPtr coarseBasis = coarseTrialOrdering->getBasis(trialID);
         BasisPtr fineBasis = fineTrialOrdering->getBasis(trialID);
-        SubBasisReconciliationWeights weights = _br.constrainedWeights(fineBasis, refBranch, coarseBasis, vertexNodePermutation);
+        // a pure p-coarsening of hierarchical bases needs no fitting
+        SubBasisReconciliationWeights weights;
+        if ((refBranch.size() > 0) || !BasisReconciliation::hierarchicalEmbeddingWeights(fineBasis, coarseBasis, weights)) {
+          weights = _br.constrainedWeights(fineBasis, refBranch, coarseBasis, vertexNodePermutation);
+        }
         set<unsigned> fineDofOrdinals(weights.fineOrdinals.begin(),weights.fineOrdinals.end());
 
         vector<GlobalIndexType> coarseDofIndices;
@@ -539,7 +740,10 @@ LocalDofMapperPtr GMGOperator::getLocalCoefficientMap(GlobalIndexType fineCellID
             }
             coarseBasis = coarseTrialOrdering->getBasis(trialID, coarseSideOrdinal);
             fineBasis = fineTrialOrdering->getBasis(trialID, sideOrdinal);
-            SubBasisReconciliationWeights weights = _br.constrainedWeights(fineBasis, sideRefBranches[sideOrdinal], coarseBasis, vertexNodePermutation);
+            SubBasisReconciliationWeights weights;
+            if ((sideRefBranches[sideOrdinal].size() > 0) || !BasisReconciliation::hierarchicalEmbeddingWeights(fineBasis, coarseBasis, weights)) {
+              weights = _br.constrainedWeights(fineBasis, sideRefBranches[sideOrdinal], coarseBasis, vertexNodePermutation);
+            }
             
             set<unsigned> fineDofOrdinals(weights.fineOrdinals.begin(),weights.fineOrdinals.end());
             vector<GlobalIndexType> coarseDofIndices;
@@ -632,51 +836,118 @@ int GMGOperator::ApplyInverse(const Epetra_MultiVector& X_in, Epetra_MultiVector
     if (printVerboseOutput) cout << "finished multiplying X by _diag_sqrt\n";
   }
   
-  if (printVerboseOutput) cout << "calling _coarseSolution->getRHSVector()\n";
-  Teuchos::RCP<Epetra_FEVector> coarseRHSVector = _coarseSolution->getRHSVector();
-  if (printVerboseOutput) cout << "returned from _coarseSolution->getRHSVector()\n";
-
-  timer.ResetStartTime();
-  if (printVerboseOutput) cout << "calling _P->Multiply(true, X, *coarseRHSVector);\n";
-  _P->Multiply(true, X, *coarseRHSVector);
-  if (printVerboseOutput) cout << "finished _P->Multiply(true, X, *coarseRHSVector);\n";
-  _timeMapFineToCoarse += timer.ElapsedTime();
-
-  timer.ResetStartTime();
-  if (!_haveSolvedOnCoarseMesh) {
-    if (printVerboseOutput) cout << "solving on coarse mesh\n";
-    _coarseSolution->setProblem(_coarseSolver);
-    _coarseSolution->solveWithPrepopulatedStiffnessAndLoad(_coarseSolver, false);
-    if (printVerboseOutput) cout << "finished solving on coarse mesh\n";
-    _haveSolvedOnCoarseMesh = true;
+  // in multiplicative composition, pre-smooth first and restrict the updated residual; otherwise restrict X itself
+  bool multiplicative = (_compositionType != ADDITIVE) && _applySmoothingOperator;
+  Epetra_MultiVector smoothedX(X.Map(), X.NumVectors());
+  Epetra_MultiVector fineResidual(X);
+  if (multiplicative) {
+    if (_fineStiffnessMatrix == NULL) {
+      cout << "GMGOperator::ApplyInverse: multiplicative composition requires computeCoarseStiffnessMatrix() to have been called.\n";
+      TEUCHOS_TEST_FOR_EXCEPTION(true, std::invalid_argument, "fine stiffness matrix not set");
+    }
+    bool initialGuessIsZero = true;
+    if (printVerboseOutput) cout << "pre-smoothing\n";
+    smooth(X, smoothedX, _preSmoothingCount, initialGuessIsZero);
+    _fineStiffnessMatrix->Multiply(false, smoothedX, fineResidual);
+    fineResidual.Update(1.0, X, -1.0);
+  }
+  
+  if (_coarseOperator == Teuchos::null) {
+    if (printVerboseOutput) cout << "calling _coarseSolution->getRHSVector()\n";
+    Teuchos::RCP<Epetra_FEVector> coarseRHSVector = _coarseSolution->getRHSVector();
+    if (printVerboseOutput) cout << "returned from _coarseSolution->getRHSVector()\n";
+
+    timer.ResetStartTime();
+    if (printVerboseOutput) cout << "calling _P->Multiply(true, fineResidual, *coarseRHSVector);\n";
+    _P->Multiply(true, fineResidual, *coarseRHSVector);
+    if (printVerboseOutput) cout << "finished _P->Multiply(true, fineResidual, *coarseRHSVector);\n";
+    _timeMapFineToCoarse += timer.ElapsedTime();
+
+    timer.ResetStartTime();
+    if (!_haveSolvedOnCoarseMesh) {
+      if (printVerboseOutput) cout << "solving on coarse mesh\n";
+      _coarseSolution->setProblem(_coarseSolver);
+      _coarseSolution->solveWithPrepopulatedStiffnessAndLoad(_coarseSolver, false);
+      if (printVerboseOutput) cout << "finished solving on coarse mesh\n";
+      _haveSolvedOnCoarseMesh = true;
+      _factoredCoarseStiffness = _coarseSolution->getStiffnessMatrix();
+    } else if (_coarseNumericFactorizationPending) {
+      if (printVerboseOutput) cout << "refactoring (numeric only) and resolving on coarse mesh\n";
+      _factoredCoarseStiffness = _coarseSolution->getStiffnessMatrix();
+      _coarseSolver->problem().SetOperator(_factoredCoarseStiffness.get());
+      _coarseSolver->problem().SetRHS(coarseRHSVector.get());
+      int err = _coarseSolver->resolveWithNewValues();
+      if (err != 0) {
+        int rank = Teuchos::GlobalMPISession::getRank();
+        if (rank==0) cout << "**** WARNING: in GMGOperator::ApplyInverse(), coarse resolveWithNewValues() failed with error code " << err << ". ****\n";
+      }
+      if (printVerboseOutput) cout << "finished refactoring and resolving on coarse mesh\n";
+      _coarseNumericFactorizationPending = false;
+    } else {
+      if (printVerboseOutput) cout << "resolving on coarse mesh\n";
+      _coarseSolver->problem().SetRHS(coarseRHSVector.get());
+      _coarseSolution->solveWithPrepopulatedStiffnessAndLoad(_coarseSolver, true); // call resolve() instead of solve() -- reuse factorization
+      if (printVerboseOutput) cout << "finished resolving on coarse mesh\n";
+    }
+    _timeCoarseSolve += timer.ElapsedTime();
+
+    timer.ResetStartTime();
+    if (printVerboseOutput) cout << "calling _coarseSolution->getLHSVector()\n";
+    Teuchos::RCP<Epetra_FEVector> coarseLHSVector = _coarseSolution->getLHSVector();
+    if (printVerboseOutput) cout << "finished _coarseSolution->getLHSVector()\n";
+    if (printVerboseOutput) cout << "calling _P->Multiply(false, *coarseLHSVector, Y)\n";
+    _P->Multiply(false, *coarseLHSVector, Y);
+    if (printVerboseOutput) cout << "finished _P->Multiply(false, *coarseLHSVector, Y)\n";
+    _timeMapCoarseToFine += timer.ElapsedTime();
   } else {
-    if (printVerboseOutput) cout << "resolving on coarse mesh\n";
-    _coarseSolver->problem().SetRHS(coarseRHSVector.get());
-    _coarseSolution->solveWithPrepopulatedStiffnessAndLoad(_coarseSolver, true); // call resolve() instead of solve() -- reuse factorization
-    if (printVerboseOutput) cout << "finished resolving on coarse mesh\n";
+    timer.ResetStartTime();
+    Epetra_MultiVector coarseRHS(_P->DomainMap(), X.NumVectors());
+    if (printVerboseOutput) cout << "calling _P->Multiply(true, fineResidual, coarseRHS);\n";
+    _P->Multiply(true, fineResidual, coarseRHS);
+    if (printVerboseOutput) cout << "finished _P->Multiply(true, fineResidual, coarseRHS);\n";
+    _timeMapFineToCoarse += timer.ElapsedTime();
+
+    // stationary iteration with the coarse operator: once for a V-cycle, twice for a W-cycle
+    timer.ResetStartTime();
+    int coarseCycleCount = (_cycleType == W_CYCLE) ? 2 : 1;
+    Epetra_MultiVector coarseLHS(_P->DomainMap(), X.NumVectors());
+    Epetra_MultiVector coarseResidual(coarseRHS);
+    Epetra_MultiVector coarseUpdate(_P->DomainMap(), X.NumVectors());
+    for (int cycle=0; cycle<coarseCycleCount; cycle++) {
+      if (cycle > 0) {
+        _coarseOperator->_fineStiffnessMatrix->Multiply(false, coarseLHS, coarseResidual);
+        coarseResidual.Update(1.0, coarseRHS, -1.0);
+      }
+      if (printVerboseOutput) cout << "applying coarse operator, cycle " << cycle << endl;
+      _coarseOperator->ApplyInverse(coarseResidual, coarseUpdate);
+      coarseLHS.Update(1.0, coarseUpdate, 1.0);
+    }
+    _timeCoarseSolve += timer.ElapsedTime();
+
+    timer.ResetStartTime();
+    if (printVerboseOutput) cout << "calling _P->Multiply(false, coarseLHS, Y)\n";
+    _P->Multiply(false, coarseLHS, Y);
+    if (printVerboseOutput) cout << "finished _P->Multiply(false, coarseLHS, Y)\n";
+    _timeMapCoarseToFine += timer.ElapsedTime();
   }
-  _timeCoarseSolve += timer.ElapsedTime();
-
-  timer.ResetStartTime();
-  if (printVerboseOutput) cout << "calling _coarseSolution->getLHSVector()\n";
-  Teuchos::RCP<Epetra_FEVector> coarseLHSVector = _coarseSolution->getLHSVector();
-  if (printVerboseOutput) cout << "finished _coarseSolution->getLHSVector()\n";
-  if (printVerboseOutput) cout << "calling _P->Multiply(false, *coarseLHSVector, Y)\n";
-  _P->Multiply(false, *coarseLHSVector, Y);
-  if (printVerboseOutput) cout << "finished _P->Multiply(false, *coarseLHSVector, Y)\n";
-  _timeMapCoarseToFine += timer.ElapsedTime();
-
-  // if _applySmoothingOperator is set, add S^(-1)X to Y.
+
+  // if _applySmoothingOperator is set, add the pre-smoothing sweeps applied to X to Y, then post-smooth starting from Y.
   if (_applySmoothingOperator) {
-    if (printVerboseOutput) cout << "copying X into X2\n";
-    Epetra_MultiVector X2(X); // copy, since I'm not sure ApplyInverse is generally OK with X and Y in same location (though Aztec seems to make that assumption, so it probably is OK).
-    if (printVerboseOutput) cout << "finished copying X into X2\n";
-    if (printVerboseOutput) cout << "calling _smoother->ApplyInverse(X2, X)\n";
-    _smoother->ApplyInverse(X2, X);
-    if (printVerboseOutput) cout << "finished _smoother->ApplyInverse(X2, X)\n";
-    if (printVerboseOutput) cout << "calling Y.Update(1.0, X, 1.0)\n";
-    Y.Update(1.0, X, 1.0);
-    if (printVerboseOutput) cout << "finished Y.Update(1.0, X, 1.0)\n";
+    bool initialGuessIsZero = true;
+    if (!multiplicative) {
+      if (printVerboseOutput) cout << "pre-smoothing\n";
+      smooth(X, smoothedX, _preSmoothingCount, initialGuessIsZero);
+    }
+    if (printVerboseOutput) cout << "calling Y.Update(1.0, smoothedX, 1.0)\n";
+    Y.Update(1.0, smoothedX, 1.0);
+    if (printVerboseOutput) cout << "finished Y.Update(1.0, smoothedX, 1.0)\n";
+    // the symmetric variant mirrors the pre-smoothing sweeps
+    int postSmoothingCount = (_compositionType == SYMMETRIC_MULTIPLICATIVE) ? _preSmoothingCount : _postSmoothingCount;
+    if (postSmoothingCount > 0) {
+      if (printVerboseOutput) cout << "post-smoothing\n";
+      initialGuessIsZero = false;
+      smooth(X, Y, postSmoothingCount, initialGuessIsZero);
+    }
   } else {
     //    cout << "_diag is NULL.\n";
   }
@@ -691,6 +962,11 @@ int GMGOperator::ApplyInverse(const Epetra_MultiVector& X_in, Epetra_MultiVector
   return 0;
 }
 
+int GMGOperator::levelCount() const {
+  if (_coarseOperator == Teuchos::null) return 2;
+  return 1 + _coarseOperator->levelCount();
+}
+
 double GMGOperator::NormInf() const {
   TEUCHOS_TEST_FOR_EXCEPTION(true, std::invalid_argument, "Unsupported method.");
 }
@@ -805,6 +1081,8 @@ void GMGOperator::reportTimings() const {
   reportValues["map coarse to fine"] = _timeMapCoarseToFine;
   reportValues["map fine to coarse"] = _timeMapFineToCoarse;
   reportValues["compute coarse stiffness matrix"] = _timeComputeCoarseStiffnessMatrix;
+  reportValues["set up smoother"] = _timeSetUpSmoother;
+  reportValues["apply smoother"] = _timeApplySmoother;
 
   for (map<string,double>::iterator reportIt = reportValues.begin(); reportIt != reportValues.end(); reportIt++) {
     TimeStatistics stats = getStatistics(reportIt->second);
@@ -822,8 +1100,43 @@ void GMGOperator::setApplySmoothingOperator(bool value) {
   _applySmoothingOperator = value;
 }
 
+void GMGOperator::setChebyshevParameters(int degree, int powerIterations, double eigenvalueRatio) {
+  _chebyshevDegree = degree;
+  _chebyshevPowerIterations = powerIterations;
+  _chebyshevEigenvalueRatio = eigenvalueRatio;
+}
+
+void GMGOperator::setCoarseFactorizationReuse(bool reuseSymbolicFactorization, double numericReuseTolerance) {
+  _reuseCoarseSymbolicFactorization = reuseSymbolicFactorization;
+  _coarseNumericReuseTolerance = numericReuseTolerance;
+}
+
+void GMGOperator::setCoarseOperator(Teuchos::RCP<GMGOperator> coarseOperator) {
+  _coarseOperator = coarseOperator;
+  if (_coarseOperator != Teuchos::null) {
+    // the coarse stiffness matrix is never diagonally scaled
+    _coarseOperator->setFineSolverUsesDiagonalScaling(false);
+    _coarseOperator->setCycleType(_cycleType);
+    _coarseOperator->setCompositionType(_compositionType);
+    _coarseOperator->setSmoothingCounts(_preSmoothingCount, _postSmoothingCount);
+  }
+}
+
 void GMGOperator::setCoarseSolver(SolverPtr coarseSolver) {
   _coarseSolver = coarseSolver;
+  _haveSolvedOnCoarseMesh = false; // the new solver has no factorization to reuse
+  _coarseNumericFactorizationPending = false;
+  _factoredCoarseStiffness = Teuchos::null;
+}
+
+void GMGOperator::setCompositionType(CompositionType compositionType) {
+  _compositionType = compositionType;
+  if (_coarseOperator != Teuchos::null) _coarseOperator->setCompositionType(compositionType);
+}
+
+void GMGOperator::setCycleType(CycleType cycleType) {
+  _cycleType = cycleType;
+  if (_coarseOperator != Teuchos::null) _coarseOperator->setCycleType(cycleType);
 }
 
 void GMGOperator::setDebugMode(bool value) {
@@ -857,6 +1170,16 @@ void GMGOperator::setSchwarzFactorizationType(FactorType choice) {
   _schwarzBlockFactorizationType = choice;
 }
 
+void GMGOperator::setSmoothingCounts(int preSmoothingCount, int postSmoothingCount) {
+  if ((preSmoothingCount < 0) || (postSmoothingCount < 0)) {
+    cout << "GMGOperator::setSmoothingCounts: smoothing counts must be non-negative.\n";
+    TEUCHOS_TEST_FOR_EXCEPTION(true, std::invalid_argument, "smoothing counts must be non-negative");
+  }
+  _preSmoothingCount = preSmoothingCount;
+  _postSmoothingCount = postSmoothingCount;
+  if (_coarseOperator != Teuchos::null) _coarseOperator->setSmoothingCounts(preSmoothingCount, postSmoothingCount);
+}
+
 void GMGOperator::setStiffnessDiagonal(Teuchos::RCP< Epetra_MultiVector> diagonal) {
   // this should be the true diagonal (before scaling) of the fine stiffness matrix.
     _diag = diagonal;
@@ -878,6 +1201,30 @@ void GMGOperator::setStiffnessDiagonal(Teuchos::RCP< Epetra_MultiVector> diagona
 
 }
 
+void GMGOperator::smooth(const Epetra_MultiVector &X, Epetra_MultiVector &Y, int sweepCount, bool initialGuessIsZero) const {
+  Epetra_Time smootherTimer(Comm());
+  Epetra_MultiVector residual(X);
+  Epetra_MultiVector correction(X.Map(), X.NumVectors());
+  for (int sweep=0; sweep<sweepCount; sweep++) {
+    if ((sweep > 0) || !initialGuessIsZero) {
+      if (_fineStiffnessMatrix == NULL) {
+        cout << "GMGOperator::smooth: repeated smoothing sweeps require computeCoarseStiffnessMatrix() to have been called.\n";
+        TEUCHOS_TEST_FOR_EXCEPTION(true, std::invalid_argument, "fine stiffness matrix not set");
+      }
+      _fineStiffnessMatrix->Multiply(false, Y, residual);
+      residual.Update(1.0, X, -1.0);
+    }
+    smootherTimer.ResetStartTime();
+    _smoother->ApplyInverse(residual, correction);
+    _timeApplySmoother += smootherTimer.ElapsedTime();
+    Y.Update(1.0, correction, 1.0);
+  }
+}
+
+void GMGOperator::setUseCellSchwarzSubdomains(bool value) {
+  _useCellSchwarzSubdomains = value;
+}
+
 void GMGOperator::setSmootherOverlap(int overlap) {
   _smootherOverlap = overlap;
 }
@@ -887,6 +1234,7 @@ void GMGOperator::setSmootherType(GMGOperator::SmootherChoice smootherType) {
 }
 
 void GMGOperator::setUpSmoother(Epetra_CrsMatrix *fineStiffnessMatrix) {
+  Epetra_Time smootherTimer(Comm());
   SmootherChoice choice = _smootherType;
 
   Teuchos::ParameterList List;
@@ -1008,9 +1356,32 @@ void GMGOperator::setUpSmoother(Epetra_CrsMatrix *fineStiffnessMatrix) {
         }
       }
 
+      if (choice==CAMELLIA_ADDITIVE_SCHWARZ) {
+        List.set("schwarz: subdomain type", string(_useCellSchwarzSubdomains ? "cell" : "rank"));
+      }
       List.set("schwarz: combine mode", "Add"); // The PDF doc says to use "Insert" to maintain symmetry, but the HTML docs (which are more recent) say to use "Add".  http://trilinos.org/docs/r11.10/packages/ifpack/doc/html/index.html
     }
       break;
+    case CHEBYSHEV:
+    {
+      // estimate the largest eigenvalue of D^-1 A by the power method
+      Epetra_Vector invDiagonal(fineStiffnessMatrix->RowMap());
+      fineStiffnessMatrix->ExtractDiagonalCopy(invDiagonal);
+      invDiagonal.Reciprocal(invDiagonal);
+      double lambdaMax;
+      int err = Ifpack_Chebyshev::PowerMethod(*fineStiffnessMatrix, invDiagonal, _chebyshevPowerIterations, lambdaMax);
+      if (err != 0) {
+        cout << "WARNING: In GMGOperator, Ifpack_Chebyshev::PowerMethod() returned with err " << err << endl;
+      }
+      _chebyshevMaxEigenvalue = 1.1 * lambdaMax; // the power method underestimates; eigenvalues above the interval would be amplified
+
+      smoother = Teuchos::rcp(new Ifpack_Chebyshev(fineStiffnessMatrix) );
+      List.set("chebyshev: degree", _chebyshevDegree);
+      List.set("chebyshev: max eigenvalue", _chebyshevMaxEigenvalue);
+      List.set("chebyshev: ratio eigenvalue", _chebyshevEigenvalueRatio);
+      List.set("chebyshev: zero starting solution", true);
+    }
+      break;
 
     default:
       break;
@@ -1065,12 +1436,21 @@ void GMGOperator::setUpSmoother(Epetra_CrsMatrix *fineStiffnessMatrix) {
 
   _smoother = smoother;
 
+  _timeSetUpSmoother += smootherTimer.ElapsedTime();
 }
 
 Teuchos::RCP<Epetra_CrsMatrix> GMGOperator::getProlongationOperator() {
   return _P;
 }
 
+double GMGOperator::getSmootherApplyTime() const {
+  return _timeApplySmoother;
+}
+
+double GMGOperator::getSmootherSetUpTime() const {
+  return _timeSetUpSmoother;
+}
+
 Teuchos::RCP<Epetra_CrsMatrix> GMGOperator::getSmootherAsMatrix() {
   return Epetra_Operator_to_Epetra_Matrix::constructInverseMatrix(*_smoother, _finePartitionMap);
 }
@@ -53,6 +53,39 @@ GMGSolver::GMGSolver(SolutionPtr fineSolution, MeshPtr coarseMesh, int maxIters,
   _azConvergenceOption = AZ_rhs;
 }
 
+GMGSolver::GMGSolver(SolutionPtr fineSolution, vector<MeshPtr> coarseMeshes, int maxIters, double tol,
+                     Teuchos::RCP<Solver> coarsestSolver, bool useStaticCondensation) :
+                    _finePartitionMap(fineSolution->getPartitionMap()),
+                    _gmgOperator(fineSolution->bc()->copyImposingZero(),coarseMeshes[0],
+                                 fineSolution->ip(), fineSolution->mesh(), fineSolution->getDofInterpreter(),
+                                 _finePartitionMap, coarsestSolver, useStaticCondensation, DIAGONAL_SCALING_DEFAULT)
+{
+  _maxIters = maxIters;
+  _printToConsole = false;
+  _tol = tol;
+  _applySmoothing = true;
+  _diagonalScaling = DIAGONAL_SCALING_DEFAULT;
+  
+  _computeCondest = true;
+  _azOutput = AZ_warnings;
+  
+  _useCG = true;
+  _azConvergenceOption = AZ_rhs;
+  
+  // each level's coarse solution supplies the dof interpreter and partition map for the next level's fine side
+  GMGOperator* fineOperator = &_gmgOperator;
+  for (int level=1; level<coarseMeshes.size(); level++) {
+    SolutionPtr coarseSolution = fineOperator->getCoarseSolution();
+    bool fineSolverUsesDiagonalScaling = false;
+    Teuchos::RCP<GMGOperator> coarseOperator = Teuchos::rcp( new GMGOperator(fineSolution->bc()->copyImposingZero(), coarseMeshes[level],
+                                                                             fineSolution->ip(), coarseMeshes[level-1],
+                                                                             coarseSolution->getDofInterpreter(), coarseSolution->getPartitionMap(),
+                                                                             coarsestSolver, useStaticCondensation, fineSolverUsesDiagonalScaling) );
+    fineOperator->setCoarseOperator(coarseOperator);
+    fineOperator = coarseOperator.get();
+  }
+}
+
 double GMGSolver::condest() {
   return _condest;
 }
@@ -61,6 +94,24 @@ vector<int> GMGSolver::getIterationCountLog() {
   return _iterationCountLog;
 }
 
+vector<MeshPtr> GMGSolver::pCoarsenedMeshes(MeshPtr fineMesh) {
+  // start from the lowest order on the fine mesh, so that no coarse cell has higher order than the corresponding fine cell
+  set<GlobalIndexType> activeCellIDs = fineMesh->getActiveCellIDs();
+  int H1Order = -1;
+  for (set<GlobalIndexType>::iterator cellIDIt = activeCellIDs.begin(); cellIDIt != activeCellIDs.end(); cellIDIt++) {
+    int cellH1Order = fineMesh->globalDofAssignment()->getH1Order(*cellIDIt);
+    if ((H1Order == -1) || (cellH1Order < H1Order)) H1Order = cellH1Order;
+  }
+  int pToAddTest = fineMesh->globalDofAssignment()->getTestOrderEnrichment();
+
+  vector<MeshPtr> coarseMeshes;
+  while (H1Order > 1) {
+    H1Order = max(1, H1Order / 2);
+    coarseMeshes.push_back(Teuchos::rcp( new Mesh(fineMesh->getTopology()->deepCopy(), fineMesh->bilinearForm(), H1Order, pToAddTest) ));
+  }
+  return coarseMeshes;
+}
+
 int GMGSolver::iterationCount() {
   return _iterationCount;
 }
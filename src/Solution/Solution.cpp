@@ -157,6 +157,7 @@ Solution::Solution(const Solution &soln) {
   _writeMatrixToMatrixMarketFile = false;
   _writeRHSToMatrixMarketFile = false;
   _cubatureEnrichmentDegree = soln.cubatureEnrichmentDegree();
+  _storeFieldFactorizations = false;
 }
 
 Solution::Solution(Teuchos::RCP<Mesh> mesh, Teuchos::RCP<BC> bc, Teuchos::RCP<RHS> rhs, IPPtr ip) {
@@ -192,6 +193,7 @@ void Solution::initialize() {
 
   _zmcsAsRankOneUpdate = false; // I believe this works, but it's slow!
   _zmcRho = -1; // default value: stabilization parameter for zero-mean constraints
+  _storeFieldFactorizations = false;
 }
 
 void Solution::addSolution(Teuchos::RCP<Solution> otherSoln, double weight, bool allowEmptyCells, bool replaceBoundaryTerms) {
@@ -468,6 +470,8 @@ void Solution::populateStiffnessAndLoad() {
   Epetra_Map timeMap(numProcs,indexBase,Comm);
   Epetra_Time timer(Comm);
   Epetra_Time subTimer(Comm);
+  Epetra_Time batchTimer(Comm); // per-cell assembly costs recorded on the mesh, for use as partitioning weights
+  Epetra_Time cellTimer(Comm);
 
   double testMatrixAssemblyTime = 0, testMatrixInversionTime = 0, localStiffnessDeterminationFromTestsTime = 0;
   double localStiffnessInterpretationTime = 0, rhsIntegrationAgainstOptimalTestsTime = 0, filterApplicationTime = 0;
@@ -499,6 +503,8 @@ void Solution::populateStiffnessAndLoad() {
       int cellsLeft = totalCellsForType - startCellIndexForBatch;
       int numCells = min(maxCellBatch,cellsLeft);
 
+      batchTimer.ResetStartTime();
+
       // determine cellIDs
       vector<GlobalIndexType> cellIDs;
       for (int cellIndex=0; cellIndex<numCells; cellIndex++) {
@@ -588,6 +594,9 @@ void Solution::populateStiffnessAndLoad() {
 //      cout << "local stiffness matrices:\n" << localStiffness;
 //      cout << "local loads:\n" << localRHSVector;
 
+      // the batch computes all its cells' local matrices together; charge each cell an equal share
+      double batchTimePerCell = batchTimer.ElapsedTime() / numCells;
+
       subTimer.ResetStartTime();
 
       FieldContainer<GlobalIndexType> globalDofIndices;
@@ -602,24 +611,53 @@ void Solution::populateStiffnessAndLoad() {
 
       Teuchos::Array<int> dim;
 
+      // static condensation is done for the whole batch at once
+      CondensedDofInterpreter* condensedDofInterpreter = dynamic_cast<CondensedDofInterpreter*>(_dofInterpreter.get());
+      vector< FieldContainer<double> > batchInterpretedStiffness, batchInterpretedRHS;
+      vector< FieldContainer<GlobalIndexType> > batchGlobalDofIndices;
+      double batchInterpretationTimePerCell = 0;
+      if (condensedDofInterpreter != NULL) {
+        vector<GlobalIndexType> batchCellIDs(numCells);
+        for (int cellIndex=0; cellIndex<numCells; cellIndex++) {
+          batchCellIDs[cellIndex] = _mesh->cellID(elemTypePtr,cellIndex+startCellIndexForBatch,rank);
+        }
+        cellTimer.ResetStartTime();
+        condensedDofInterpreter->interpretLocalBatchData(batchCellIDs, localStiffness, localRHSVector, batchInterpretedStiffness,
+                                                         batchInterpretedRHS, batchGlobalDofIndices);
+        batchInterpretationTimePerCell = cellTimer.ElapsedTime() / numCells;
+      }
+
       for (int cellIndex=0; cellIndex<numCells; cellIndex++) {
         GlobalIndexType cellID = _mesh->cellID(elemTypePtr,cellIndex+startCellIndexForBatch,rank);
-        FieldContainer<double> cellStiffness(localStiffnessDim,&localStiffness(cellIndex,0,0)); // shallow copy
-        FieldContainer<double> cellRHS(localRHSDim,&localRHSVector(cellIndex,0)); // shallow copy
 
-        _dofInterpreter->interpretLocalData(cellID, cellStiffness, cellRHS, interpretedStiffness, interpretedRHS, globalDofIndices);
+        FieldContainer<double>* cellInterpretedStiffness = &interpretedStiffness;
+        FieldContainer<double>* cellInterpretedRHS = &interpretedRHS;
+        FieldContainer<GlobalIndexType>* cellGlobalDofIndices = &globalDofIndices;
+
+        cellTimer.ResetStartTime();
+        if (condensedDofInterpreter != NULL) {
+          cellInterpretedStiffness = &batchInterpretedStiffness[cellIndex];
+          cellInterpretedRHS = &batchInterpretedRHS[cellIndex];
+          cellGlobalDofIndices = &batchGlobalDofIndices[cellIndex];
+        } else {
+          FieldContainer<double> cellStiffness(localStiffnessDim,&localStiffness(cellIndex,0,0)); // shallow copy
+          FieldContainer<double> cellRHS(localRHSDim,&localRHSVector(cellIndex,0)); // shallow copy
+          _dofInterpreter->interpretLocalData(cellID, cellStiffness, cellRHS, interpretedStiffness, interpretedRHS, globalDofIndices);
+        }
 
         // cast whatever the global index type is to a type that Epetra supports
-        globalDofIndices.dimensions(dim);
+        cellGlobalDofIndices->dimensions(dim);
         globalDofIndicesCast.resize(dim);
 
-        for (int dofOrdinal = 0; dofOrdinal < globalDofIndices.size(); dofOrdinal++) {
-          globalDofIndicesCast[dofOrdinal] = globalDofIndices[dofOrdinal];
+        int cellGlobalDofCount = cellGlobalDofIndices->size();
+        for (int dofOrdinal = 0; dofOrdinal < cellGlobalDofCount; dofOrdinal++) {
+          globalDofIndicesCast[dofOrdinal] = (*cellGlobalDofIndices)[dofOrdinal];
         }
 
-        globalStiffness->InsertGlobalValues(globalDofIndices.size(),&globalDofIndicesCast(0),
-                                               globalDofIndices.size(),&globalDofIndicesCast(0),&interpretedStiffness[0]);
-        _rhsVector->SumIntoGlobalValues(globalDofIndices.size(),&globalDofIndicesCast(0),&interpretedRHS[0]);
+        globalStiffness->InsertGlobalValues(cellGlobalDofCount,&globalDofIndicesCast(0),
+                                            cellGlobalDofCount,&globalDofIndicesCast(0),&(*cellInterpretedStiffness)[0]);
+        _rhsVector->SumIntoGlobalValues(cellGlobalDofCount,&globalDofIndicesCast(0),&(*cellInterpretedRHS)[0]);
+        _mesh->recordCellAssemblyCost(cellID, batchTimePerCell + batchInterpretationTimePerCell + cellTimer.ElapsedTime());
       }
       localStiffnessInterpretationTime += subTimer.ElapsedTime();
 
@@ -1236,6 +1274,7 @@ void Solution::importGlobalSolution() {
   solnCoeff.Import(*_lhsVector, solnImporter, Insert);
 
   set<GlobalIndexType> globalActiveCellIDs = _mesh->getActiveCellIDs();
+  _mesh->globalDofAssignment()->importCellDofOffsets(globalActiveCellIDs); // we interpret cells far from our own
   // copy the dof coefficients into our data structure
   for (set<GlobalIndexType>::iterator cellIDIt = globalActiveCellIDs.begin(); cellIDIt != globalActiveCellIDs.end(); cellIDIt++) {
     GlobalIndexType cellID = *cellIDIt;
@@ -1408,8 +1447,8 @@ void Solution::integrateBasisFunctions(FieldContainer<GlobalIndexTypeToCast> &gl
       FieldContainer<double> storedLoad;
       if (condensedDofInterpreter != NULL) {
         // condensedDofInterpreter requires the *true* local stiffness, because it will invert part of it...
-        // we assume that the condensedDofInterpreter already has the local stiffness stored:
-        // (CondensedDofInterpreter will throw an exception if not)
+        // the condensedDofInterpreter has the local stiffness stored, or computes it (as it does when it has kept
+        // only the cell's field factorization)
         dummyLocalStiffness = condensedDofInterpreter->storedLocalStiffnessForCell(cellID);
         // condensedDofInterpreter also requires that we restore the previous load vector for the cell once we're done
         // (otherwise it would store interpretedDiscreteValues as the load, causing errors)
@@ -2913,7 +2952,9 @@ void Solution::condensedSolve(Teuchos::RCP<Solver> globalSolver, bool reduceMemo
   // override reduceMemoryFootprint for now (since CondensedDofInterpreter doesn't yet support a true value)
   reduceMemoryFootprint = false;
 
-  Teuchos::RCP<DofInterpreter> dofInterpreter = Teuchos::rcp(new CondensedDofInterpreter(_mesh.get(), _ip, _rhs, _lagrangeConstraints.get(), fieldsToExclude, !reduceMemoryFootprint) );
+  Teuchos::RCP<CondensedDofInterpreter> condensedDofInterpreter = Teuchos::rcp(new CondensedDofInterpreter(_mesh.get(), _ip, _rhs, _lagrangeConstraints.get(), fieldsToExclude, !reduceMemoryFootprint) );
+  condensedDofInterpreter->setStoreFieldFactorizations(_storeFieldFactorizations);
+  Teuchos::RCP<DofInterpreter> dofInterpreter = condensedDofInterpreter;
 
   Teuchos::RCP<DofInterpreter> oldDofInterpreter = _dofInterpreter;
 
@@ -3781,7 +3822,9 @@ void Solution::setUseCondensedSolve(bool value) {
 
       _oldDofInterpreter = _dofInterpreter;
 
-      Teuchos::RCP<DofInterpreter> dofInterpreter = Teuchos::rcp(new CondensedDofInterpreter(_mesh.get(), _ip, _rhs, _lagrangeConstraints.get(), fieldsToExclude, !reduceMemoryFootprint) );
+      Teuchos::RCP<CondensedDofInterpreter> condensedDofInterpreter = Teuchos::rcp(new CondensedDofInterpreter(_mesh.get(), _ip, _rhs, _lagrangeConstraints.get(), fieldsToExclude, !reduceMemoryFootprint) );
+      condensedDofInterpreter->setStoreFieldFactorizations(_storeFieldFactorizations);
+      Teuchos::RCP<DofInterpreter> dofInterpreter = condensedDofInterpreter;
 
       setDofInterpreter(dofInterpreter);
     }
@@ -3793,6 +3836,18 @@ void Solution::setUseCondensedSolve(bool value) {
   }
 }
 
+void Solution::setStoreFieldFactorizations(bool value) {
+  _storeFieldFactorizations = value;
+  CondensedDofInterpreter* condensedDofInterpreter = dynamic_cast<CondensedDofInterpreter*>(_dofInterpreter.get());
+  if (condensedDofInterpreter != NULL) {
+    condensedDofInterpreter->setStoreFieldFactorizations(value);
+  }
+}
+
+bool Solution::getStoreFieldFactorizations() {
+  return _storeFieldFactorizations;
+}
+
 void Solution::setZeroMeanConstraintRho(double value) {
   _zmcRho = value;
 }
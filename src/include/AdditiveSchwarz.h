@@ -44,6 +44,11 @@
 #include "Epetra_CrsMatrix.h"
 #include "Teuchos_ParameterList.hpp"
 #include "Teuchos_RefCountPtr.hpp"
+#include "Teuchos_LAPACK.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #ifdef HAVE_IFPACK_AMESOS
   #include "Ifpack_AMDReordering.h"
@@ -250,6 +255,14 @@ public:
    * - \c "schwarz: compute condest" : if \c true, \c Compute() will
    *    estimate the condition number of the preconditioner. 
    *    Default: \c true.
+   * - \c "schwarz: subdomain type" (Camellia addition): \c "rank" uses
+   *    one local solver (of type T) per MPI rank; \c "cell" uses one dense
+   *    direct solve per rank-local cell, on the dofs of that cell and of its
+   *    rank-local neighbors up to the overlap level.  The cell solves are
+   *    independent, and are factored and applied in parallel when OpenMP is
+   *    enabled.  Overlapping contributions are summed, or averaged when the
+   *    combine mode is \c Average.  Singleton filtering and reordering are
+   *    not supported with cell subdomains.  Default: \c "rank".
    */
   virtual int SetParameters(Teuchos::ParameterList& List);
 
@@ -359,6 +372,24 @@ public:
     return(List_);
   }
 
+  //! Camellia addition: returns the number of cell subdomains (0 unless "schwarz: subdomain type" is "cell").
+  virtual int NumCellSubdomains() const
+  {
+    return(CellSubdomainRows_.size());
+  }
+
+  //! Camellia addition: bytes used by the factors of the cell subdomain matrices.
+  virtual long long CellSubdomainFactorBytes() const
+  {
+    long long bytes = CellSubdomainPackedFactors_.capacity() * sizeof(double);
+    bytes += CellSubdomainFactorOffsets_.capacity() * sizeof(size_t);
+    for (int subdomain=0; subdomain<CellSubdomainFactors_.size(); subdomain++) {
+      bytes += CellSubdomainFactors_[subdomain].capacity() * sizeof(double);
+      bytes += CellSubdomainPivots_[subdomain].capacity() * sizeof(int);
+    }
+    return(bytes);
+  }
+
 protected:
 
   // @}
@@ -371,6 +402,72 @@ protected:
 
   //! Sets up the localized matrix and the singleton filter.
   int Setup();
+
+  //! Camellia addition: determines the local rows of each cell subdomain.
+  int SetupCellSubdomains();
+
+  //! Camellia addition: extracts and factors the matrix of each cell subdomain (in parallel): Cholesky in packed storage,
+  //! or LU for a subdomain whose matrix is not positive definite.
+  int ComputeCellSubdomains();
+
+  //! Camellia addition: sums the cell subdomain solves applied to X into Y (in parallel).
+  int ApplyInverseCellSubdomains(const Epetra_MultiVector& X, Epetra_MultiVector& Y) const;
+
+  //! Camellia addition: Cholesky factorization A = U^T U, in place, of an SPD matrix whose upper triangle is packed
+  //! column by column (LAPACK's packed 'U' format).  Returns 0, or j+1 if the leading minor of order j+1 is not positive.
+  static int PackedCholeskyFactor(int n, double* AP)
+  {
+    for (int j=0; j<n; j++) {
+      double* columnJ = AP + j * (j + 1) / 2;
+      for (int i=0; i<j; i++) {
+        const double* columnI = AP + i * (i + 1) / 2;
+        double sum = columnJ[i];
+        for (int k=0; k<i; k++) sum -= columnI[k] * columnJ[k];
+        columnJ[i] = sum / columnI[i];
+      }
+      double diagonal = columnJ[j];
+      for (int k=0; k<j; k++) diagonal -= columnJ[k] * columnJ[k];
+      if (diagonal <= 0.0) return j + 1;
+      columnJ[j] = sqrt(diagonal);
+    }
+    return 0;
+  }
+
+  //! Camellia addition: solves U^T U x = b in place, with U as returned by PackedCholeskyFactor().
+  static void PackedCholeskySolve(int n, const double* UP, double* b)
+  {
+    for (int i=0; i<n; i++) {
+      const double* columnI = UP + i * (i + 1) / 2;
+      double sum = b[i];
+      for (int k=0; k<i; k++) sum -= columnI[k] * b[k];
+      b[i] = sum / columnI[i];
+    }
+    for (int k=n-1; k>=0; k--) {
+      const double* columnK = UP + k * (k + 1) / 2;
+      b[k] /= columnK[k];
+      for (int i=0; i<k; i++) b[i] -= columnK[i] * b[k];
+    }
+  }
+
+  //! Camellia addition: the number of threads used for cell subdomains.
+  static int NumThreads()
+  {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+  }
+
+  //! Camellia addition: the calling thread's index, in [0, NumThreads()).
+  static int ThreadNumber()
+  {
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+  }
   
   // @}
 
@@ -447,6 +544,23 @@ protected:
   Teuchos::RefCountPtr<Epetra_Time> Time_;
   //! Pointer to the local solver.
   Teuchos::RefCountPtr<T> Inverse_;
+  //! Camellia addition: if true, use one subdomain per rank-local cell instead of one per rank.
+  bool UseCellSubdomains_;
+  //! Camellia addition: overlap level for cell subdomains (OverlapLevel_ is zeroed on a single rank; this is not).
+  int CellOverlapLevel_;
+  //! Camellia addition: for each cell subdomain, its (sorted) local row indices.
+  std::vector< std::vector<int> > CellSubdomainRows_;
+  //! Camellia addition: the Cholesky factors of the cell subdomain matrices, packed (see PackedCholeskyFactor()) and stored
+  //! one subdomain after another; subdomain s starts at CellSubdomainFactorOffsets_[s].
+  std::vector<double> CellSubdomainPackedFactors_;
+  std::vector<size_t> CellSubdomainFactorOffsets_;
+  //! Camellia addition: LU factors (column-major) and pivots for the subdomains whose matrix is not SPD; empty for the rest.
+  std::vector< std::vector<double> > CellSubdomainFactors_;
+  std::vector< std::vector<int> > CellSubdomainPivots_;
+  //! Camellia addition: weight applied to each local row's summed contributions (1, or 1/multiplicity for Average).
+  std::vector<double> CellSubdomainRowWeights_;
+  //! Camellia addition: per-thread accumulators for ApplyInverse(), each holding one local-length entry per row and vector.
+  mutable std::vector< std::vector<double> > ThreadAccumulators_;
 }; // class AdditiveSchwarz<T>
 
 //==============================================================================
@@ -474,7 +588,9 @@ AdditiveSchwarz<T>::
   ApplyInverseTime_(0.0),
   InitializeFlops_(0.0),
   ComputeFlops_(0.0),
-  ApplyInverseFlops_(0.0)
+  ApplyInverseFlops_(0.0),
+  UseCellSubdomains_(false),
+  CellOverlapLevel_(OverlapLevel_in)
 {
   // Construct a reference-counted pointer with the input matrix; don't manage the memory.
   Matrix_ = Teuchos::rcp( Matrix_in, false );
@@ -642,6 +758,18 @@ int AdditiveSchwarz<T>::SetParameters(Teuchos::ParameterList& List_in)
   // singletons should help for PDE problems with Dirichlet BCs.
   FilterSingletons_ = List_in.get("schwarz: filter singletons", FilterSingletons_);
 
+  // Camellia addition: one subdomain per rank, or one per cell
+  std::string subdomainType = List_in.get("schwarz: subdomain type", std::string(UseCellSubdomains_ ? "cell" : "rank"));
+  if (subdomainType == "cell")
+    UseCellSubdomains_ = true;
+  else if (subdomainType == "rank")
+    UseCellSubdomains_ = false;
+  else
+  {
+    TEUCHOS_TEST_FOR_EXCEPTION(true, std::invalid_argument,
+                               "Error, the subdomain type \"" << subdomainType << "\" is not valid!  Only \"rank\" and \"cell\" are accepted!");
+  }
+
   // This copy may be needed by Amesos or other preconditioners.
   List_ = List_in;
 
@@ -679,9 +807,18 @@ int AdditiveSchwarz<T>::Initialize()
   if (LocalizedMatrix_ == Teuchos::null)
     IFPACK_CHK_ERR(-5);
 
-  IFPACK_CHK_ERR(Inverse_->SetUseTranspose(UseTranspose()));
-  IFPACK_CHK_ERR(Inverse_->SetParameters(List_));
-  IFPACK_CHK_ERR(Inverse_->Initialize());
+  if (UseCellSubdomains_) {
+    if (FilterSingletons_ || UseReordering_) {
+      cerr << "AdditiveSchwarz: singleton filtering and reordering are not supported with cell subdomains." << endl;
+      IFPACK_CHK_ERR(-1);
+    }
+    IFPACK_CHK_ERR(SetupCellSubdomains());
+  }
+  else {
+    IFPACK_CHK_ERR(Inverse_->SetUseTranspose(UseTranspose()));
+    IFPACK_CHK_ERR(Inverse_->SetParameters(List_));
+    IFPACK_CHK_ERR(Inverse_->Initialize());
+  }
 
   // Label is for Aztec-like solvers
   Label_ = "AdditiveSchwarz, ";
@@ -718,7 +855,10 @@ int AdditiveSchwarz<T>::Compute()
   IsComputed_ = false;
   Condest_ = -1.0;
   
-  IFPACK_CHK_ERR(Inverse_->Compute());
+  if (UseCellSubdomains_)
+    IFPACK_CHK_ERR(ComputeCellSubdomains());
+  else
+    IFPACK_CHK_ERR(Inverse_->Compute());
 
   IsComputed_ = true; // need this here for Condest(Ifpack_Cheap)
   ++NumCompute_;
@@ -892,7 +1032,10 @@ ApplyInverse(const Epetra_MultiVector& X, Epetra_MultiVector& Y) const
   }
   else {
     // process reordering
-    if (!UseReordering_) {
+    if (UseCellSubdomains_) {
+      IFPACK_CHK_ERR(ApplyInverseCellSubdomains(*OverlappingX,*OverlappingY));
+    }
+    else if (!UseReordering_) {
       IFPACK_CHK_ERR(Inverse_->ApplyInverse(*OverlappingX,*OverlappingY));
     }
     else {
@@ -1004,6 +1147,221 @@ Print(std::ostream& os) const
   return(os);
 }
 
+//==============================================================================
+template<typename T>
+int AdditiveSchwarz<T>::SetupCellSubdomains()
+{
+  // the localized matrix numbers its rows as the (overlapping) row map does
+  const Epetra_Map &rowMap = (OverlappingMatrix_ != Teuchos::null) ? OverlappingMatrix_->RowMatrixRowMap() : Matrix_->RowMatrixRowMap();
+  int numLocalRows = LocalizedMatrix_->NumMyRows();
+
+  std::set<GlobalIndexType> myCells = mesh_->cellIDsInPartition();
+  CellSubdomainRows_.clear();
+  std::vector<int> rowMultiplicity(numLocalRows, 0);
+  for (std::set<GlobalIndexType>::iterator cellIDIt = myCells.begin(); cellIDIt != myCells.end(); cellIDIt++) {
+    // the cell and its rank-local neighbors, out to CellOverlapLevel_
+    std::set<GlobalIndexType> subdomainCells, lastNeighbors;
+    subdomainCells.insert(*cellIDIt);
+    lastNeighbors.insert(*cellIDIt);
+    for (int overlap = 0; overlap < CellOverlapLevel_; ++overlap) {
+      std::set<GlobalIndexType> cellNeighbors;
+      for (std::set<GlobalIndexType>::iterator neighborIt = lastNeighbors.begin(); neighborIt != lastNeighbors.end(); neighborIt++) {
+        CellPtr cell = mesh_->getTopology()->getCell(*neighborIt);
+        int numSides = cell->getSideCount();
+        for (int sideOrdinal=0; sideOrdinal<numSides; sideOrdinal++) {
+          pair<GlobalIndexType, unsigned> neighborInfo = cell->getNeighborInfo(sideOrdinal);
+          if ((neighborInfo.first != -1) && (myCells.find(neighborInfo.first) != myCells.end())) {
+            if (subdomainCells.find(neighborInfo.first) == subdomainCells.end()) cellNeighbors.insert(neighborInfo.first);
+          }
+        }
+      }
+      subdomainCells.insert(cellNeighbors.begin(), cellNeighbors.end());
+      lastNeighbors = cellNeighbors;
+    }
+
+    std::set<int> subdomainRows;
+    for (std::set<GlobalIndexType>::iterator subdomainCellIt = subdomainCells.begin(); subdomainCellIt != subdomainCells.end(); subdomainCellIt++) {
+      std::set<GlobalIndexType> cellDofs = dofInterpreter_->globalDofIndicesForCell(*subdomainCellIt);
+      for (std::set<GlobalIndexType>::iterator dofIt = cellDofs.begin(); dofIt != cellDofs.end(); dofIt++) {
+        int localRow = rowMap.LID((GlobalIndexTypeToCast) *dofIt);
+        if ((localRow >= 0) && (localRow < numLocalRows)) subdomainRows.insert(localRow);
+      }
+    }
+    if (subdomainRows.size() == 0) continue;
+    CellSubdomainRows_.push_back(std::vector<int>(subdomainRows.begin(), subdomainRows.end()));
+    for (std::set<int>::iterator rowIt = subdomainRows.begin(); rowIt != subdomainRows.end(); rowIt++) {
+      rowMultiplicity[*rowIt]++;
+    }
+  }
+
+  CellSubdomainRowWeights_.resize(numLocalRows);
+  for (int localRow=0; localRow<numLocalRows; localRow++) {
+    if ((CombineMode_ == Average) && (rowMultiplicity[localRow] > 0))
+      CellSubdomainRowWeights_[localRow] = 1.0 / rowMultiplicity[localRow];
+    else
+      CellSubdomainRowWeights_[localRow] = 1.0;
+  }
+  return(0);
+}
+
+//==============================================================================
+template<typename T>
+int AdditiveSchwarz<T>::ComputeCellSubdomains()
+{
+  // Ifpack_LocalFilter::ExtractMyRowCopy() uses internal scratch space, so take a serial copy of the
+  // localized matrix in CRS form first; the threads then read only from that.
+  int numLocalRows = LocalizedMatrix_->NumMyRows();
+  std::vector<int> rowOffsets(numLocalRows + 1, 0);
+  std::vector<int> columns;
+  std::vector<double> values;
+  {
+    int maxEntries = LocalizedMatrix_->MaxNumEntries();
+    std::vector<int> rowIndices(maxEntries);
+    std::vector<double> rowValues(maxEntries);
+    for (int localRow=0; localRow<numLocalRows; localRow++) {
+      int numEntries;
+      IFPACK_CHK_ERR(LocalizedMatrix_->ExtractMyRowCopy(localRow, maxEntries, numEntries, &rowValues[0], &rowIndices[0]));
+      columns.insert(columns.end(), rowIndices.begin(), rowIndices.begin() + numEntries);
+      values.insert(values.end(), rowValues.begin(), rowValues.begin() + numEntries);
+      rowOffsets[localRow+1] = rowOffsets[localRow] + numEntries;
+    }
+  }
+
+  int numSubdomains = CellSubdomainRows_.size();
+  CellSubdomainFactorOffsets_.resize(numSubdomains + 1);
+  CellSubdomainFactorOffsets_[0] = 0;
+  for (int subdomain=0; subdomain<numSubdomains; subdomain++) {
+    size_t n = CellSubdomainRows_[subdomain].size();
+    CellSubdomainFactorOffsets_[subdomain+1] = CellSubdomainFactorOffsets_[subdomain] + n * (n + 1) / 2;
+  }
+  CellSubdomainPackedFactors_.resize(CellSubdomainFactorOffsets_[numSubdomains]);
+  CellSubdomainFactors_.resize(numSubdomains);
+  CellSubdomainPivots_.resize(numSubdomains);
+  std::vector<int> subdomainErrors(numSubdomains, 0);
+
+  // per-thread scratch: the position of each local row within the current subdomain, or -1
+  int numThreads = NumThreads();
+  std::vector< std::vector<int> > positionWorkspaces(numThreads, std::vector<int>(numLocalRows, -1));
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (int subdomain=0; subdomain<numSubdomains; subdomain++) {
+    std::vector<int> &position = positionWorkspaces[ThreadNumber()];
+    const std::vector<int> &rows = CellSubdomainRows_[subdomain];
+    int n = rows.size();
+    if (n == 0) continue;
+    for (int i=0; i<n; i++) position[rows[i]] = i;
+
+    // the upper triangle suffices for the (symmetric) DPG stiffness matrix
+    double* packed = &CellSubdomainPackedFactors_[CellSubdomainFactorOffsets_[subdomain]];
+    std::fill(packed, packed + n * (n + 1) / 2, 0.0);
+    for (int i=0; i<n; i++) {
+      for (int entry=rowOffsets[rows[i]]; entry<rowOffsets[rows[i]+1]; entry++) {
+        int j = position[columns[entry]];
+        if (j >= i) packed[i + j * (j + 1) / 2] = values[entry];
+      }
+    }
+
+    std::vector<double> &factors = CellSubdomainFactors_[subdomain];
+    if (PackedCholeskyFactor(n, packed) == 0) {
+      factors.clear();
+      CellSubdomainPivots_[subdomain].clear();
+    } else {
+      // not positive definite: LU-factor the full matrix instead
+      factors.assign(n * n, 0.0);
+      for (int i=0; i<n; i++) {
+        for (int entry=rowOffsets[rows[i]]; entry<rowOffsets[rows[i]+1]; entry++) {
+          int j = position[columns[entry]];
+          if (j >= 0) factors[i + j * n] = values[entry]; // column-major
+        }
+      }
+      Teuchos::LAPACK<int, double> lapack;
+      CellSubdomainPivots_[subdomain].resize(n);
+      lapack.GETRF(n, n, &factors[0], n, &CellSubdomainPivots_[subdomain][0], &subdomainErrors[subdomain]);
+    }
+    for (int i=0; i<n; i++) position[rows[i]] = -1;
+  }
+
+  for (int subdomain=0; subdomain<numSubdomains; subdomain++) {
+    if (subdomainErrors[subdomain] != 0) {
+      cerr << "AdditiveSchwarz: LU factorization of cell subdomain " << subdomain << " failed with info = " << subdomainErrors[subdomain] << endl;
+      IFPACK_CHK_ERR(-2);
+    }
+  }
+
+  return(0);
+}
+
+//==============================================================================
+template<typename T>
+int AdditiveSchwarz<T>::ApplyInverseCellSubdomains(const Epetra_MultiVector& X, Epetra_MultiVector& Y) const
+{
+  int numLocalRows = X.MyLength();
+  int numVectors = X.NumVectors();
+  int numSubdomains = CellSubdomainRows_.size();
+  int numThreads = NumThreads();
+  std::vector<int> subdomainErrors(numSubdomains, 0);
+
+  ThreadAccumulators_.resize(numThreads);
+  for (int thread=0; thread<numThreads; thread++) {
+    ThreadAccumulators_[thread].assign(numLocalRows * numVectors, 0.0);
+  }
+
+#ifdef _OPENMP
+#pragma omp parallel num_threads(numThreads)
+#endif
+  {
+    std::vector<double> &accumulator = ThreadAccumulators_[ThreadNumber()];
+    std::vector<double> subdomainVectors; // per-thread scratch
+    Teuchos::LAPACK<int, double> lapack;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+    for (int subdomain=0; subdomain<numSubdomains; subdomain++) {
+      const std::vector<int> &rows = CellSubdomainRows_[subdomain];
+      int n = rows.size();
+      subdomainVectors.resize(n * numVectors);
+      for (int vectorOrdinal=0; vectorOrdinal<numVectors; vectorOrdinal++) {
+        for (int i=0; i<n; i++) subdomainVectors[i + vectorOrdinal * n] = X[vectorOrdinal][rows[i]];
+      }
+      if (n == 0) continue;
+      if (CellSubdomainFactors_[subdomain].size() > 0) {
+        lapack.GETRS('N', n, numVectors, &CellSubdomainFactors_[subdomain][0], n, &CellSubdomainPivots_[subdomain][0],
+                     &subdomainVectors[0], n, &subdomainErrors[subdomain]);
+      } else {
+        const double* packed = &CellSubdomainPackedFactors_[CellSubdomainFactorOffsets_[subdomain]];
+        for (int vectorOrdinal=0; vectorOrdinal<numVectors; vectorOrdinal++) {
+          PackedCholeskySolve(n, packed, &subdomainVectors[vectorOrdinal * n]);
+        }
+      }
+      for (int vectorOrdinal=0; vectorOrdinal<numVectors; vectorOrdinal++) {
+        for (int i=0; i<n; i++) accumulator[rows[i] + vectorOrdinal * numLocalRows] += subdomainVectors[i + vectorOrdinal * n];
+      }
+    }
+  }
+
+  // sum the threads' contributions
+  for (int vectorOrdinal=0; vectorOrdinal<numVectors; vectorOrdinal++) {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (int localRow=0; localRow<numLocalRows; localRow++) {
+      double sum = 0.0;
+      for (int thread=0; thread<numThreads; thread++) sum += ThreadAccumulators_[thread][localRow + vectorOrdinal * numLocalRows];
+      Y[vectorOrdinal][localRow] = CellSubdomainRowWeights_[localRow] * sum;
+    }
+  }
+
+  for (int subdomain=0; subdomain<numSubdomains; subdomain++) {
+    if (subdomainErrors[subdomain] != 0) {
+      cerr << "AdditiveSchwarz: LU solve on cell subdomain " << subdomain << " failed with info = " << subdomainErrors[subdomain] << endl;
+      IFPACK_CHK_ERR(-3);
+    }
+  }
+  return(0);
+}
+
 #include "Ifpack_Condest.h"
 //==============================================================================
 template<typename T>
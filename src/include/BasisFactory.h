@@ -76,6 +76,10 @@ private:
   map< vector< Camellia::Basis<>* >, Camellia::MultiBasisPtr > _multiBasesMap;
   map< pair< Camellia::Basis<>*, vector<double> >, PatchBasisPtr > _patchBases;
   set< Camellia::Basis<>* > _patchBasisSet;
+  // quad HGRAD entries of _existingBases and _conformingBases for the family not currently chosen; swapped back in when
+  // the choice changes again, so that toggling does not accumulate bases (the Basis*-keyed maps need them kept alive)
+  map< pair< pair<int,int>, Camellia::EFunctionSpace >, BasisPtr > _inactiveQuadHGRADBases;
+  map< pair< pair<int,int>, Camellia::EFunctionSpace >, BasisPtr > _inactiveConformingQuadHGRADBases;
   
   bool _useEnrichedTraces; // i.e. p+1, not p (default is true: this is what we need to prove optimal convergence)
   bool _useLobattoForQuadHGRAD;
@@ -118,7 +122,8 @@ public:
   // the following convenience methods belong in Basis or perhaps a wrapper thereof
   set<int> sideFieldIndices( BasisPtr basis, bool includeSideSubcells = true); // includeSideSubcells: e.g. include vertices as part of quad sides
   
-  void setUseLobattoForQuadHGrad(bool value);
+  bool useLobattoForQuadHGrad();
+  void setUseLobattoForQuadHGrad(bool value); // clears cached quad HGRAD bases if the choice changes
   void setUseLobattoForQuadHDiv(bool value);
   
   static Teuchos::RCP<BasisFactory> basisFactory(); // shared, global BasisFactory
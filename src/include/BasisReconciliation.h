@@ -46,7 +46,8 @@ private:
   map< pair< SideRefinedBasisPair, Permutation> , SubBasisReconciliationWeights > _sideReconcilationWeights_h;
   
   // this is the only map that actually needs to remain, after the code simplification described above...
-  map< pair< SubcellRefinedBasisPair, Permutation> , SubBasisReconciliationWeights > _subcellReconcilationWeights;
+  // (entries are shared with the process-wide cache, below; holding the RCP here keeps the references we return valid even after eviction there)
+  map< pair< SubcellRefinedBasisPair, Permutation> , Teuchos::RCP<SubBasisReconciliationWeights> > _subcellReconcilationWeights;
   
   // trace to field reconciliation:
   // we do need a separate container for maps from fields to traces, because each can have a distinct LinearTerm describing
@@ -73,6 +74,13 @@ private:
   static FieldContainer<double> filterBasisValues(const FieldContainer<double> &basisValues, set<int> &filter);
   
   static SubBasisReconciliationWeights filterToInclude(set<int> &rowOrdinals, set<int> &colOrdinals, SubBasisReconciliationWeights &weights);
+  
+  // process-wide cache support: keys identify bases and refinement patterns by value rather than by address, so that they remain
+  // meaningful across BasisReconciliation instances, meshes, and (when saved to disk) processes.
+  static string basisSignature(BasisPtr basis);
+  static string refinementBranchSignature(RefinementBranch &refinements);
+  static Teuchos::RCP<SubBasisReconciliationWeights> sharedCacheLookup(const string &key);
+  static void sharedCacheInsert(const string &key, Teuchos::RCP<SubBasisReconciliationWeights> weights);
 public:
   BasisReconciliation(bool cacheResults = true) { _cacheResults = cacheResults; }
 
@@ -126,6 +134,10 @@ public:
   
   static SubBasisReconciliationWeights sumWeights(SubBasisReconciliationWeights aWeights, SubBasisReconciliationWeights bWeights);
   
+  // for hierarchical bases of the same family (Lobatto, Legendre) on the same topology, the coarser basis's functions are
+  // a subset of the finer basis's, and the weights are 0/1 without any fitting.  Returns false if the bases are not recognized as such.
+  static bool hierarchicalEmbeddingWeights(BasisPtr finerBasis, BasisPtr coarserBasis, SubBasisReconciliationWeights &weights);
+  
   static set<int> interiorDofOrdinalsForBasis(BasisPtr basis);
   
   static set<unsigned> internalDofOrdinalsForFinerBasis(BasisPtr finerBasis, RefinementBranch refinements); // which degrees of freedom in the finer basis have empty support on the boundary of the coarser basis's reference element? -- these are the ones for which the constrained weights are determined in computeConstrainedWeights.
@@ -133,6 +145,16 @@ public:
   
   static unsigned minimumSubcellDimension(BasisPtr basis); // for continuity enforcement
   
+  // the process-wide cache of subcell reconciliation weights, shared by all BasisReconciliation instances (and therefore by all meshes and GMG levels).
+  // it is thread-safe, and bounded in memory: when the capacity is exceeded, the least recently used weights are evicted.
+  static void setSharedCacheCapacity(long long capacityInBytes); // default is 256 MB; 0 disables the shared cache
+  static long long sharedCacheCapacity();
+  static long long sharedCacheSize(); // in bytes, including the basis signatures used in the keys
+  static int sharedCacheEntryCount();
+  static void clearSharedCache();
+  static void saveSharedCache(string filePath); // writes the cached weights so that a later run can loadSharedCache() instead of recomputing them
+  static void loadSharedCache(string filePath); // adds the weights in the file to the shared cache (subject to capacity)
+  
 public:
   // !! this method exposed publicly primarily for testing purposes.
   static void mapFineSubcellPointsToCoarseDomain(FieldContainer<double> &coarseDomainPoints, const FieldContainer<double> &fineSubcellPoints,
@@ -29,8 +29,6 @@ using namespace Intrepid;
  **/
 
 class CondensedDofInterpreter : public DofInterpreter {
-protected:
-  map<GlobalIndexType, FieldContainer<double> > _localLoadVectors;       // will be used by interpretGlobalData if _storeLocalStiffnessMatrices is true
 private:
   bool _storeLocalStiffnessMatrices;
   Mesh* _mesh; // for element type lookup, and for determination of which dofs are trace dofs
@@ -38,9 +36,35 @@ private:
   RHSPtr _rhs;
   LagrangeConstraints* _lagrangeConstraints;
   set<int> _uncondensibleVarIDs;
-  map<GlobalIndexType, FieldContainer<double> > _localStiffnessMatrices; // will be used by interpretGlobalData if _storeLocalStiffnessMatrices is true
-  map<GlobalIndexType, FieldContainer<GlobalIndexType> > _localInterpretedDofIndices;       // will be used by interpretGlobalData if _storeLocalStiffnessMatrices is true
+  
+  // Stored local data (used by interpretGlobalData if _storeLocalStiffnessMatrices is true), per element type and by the cells'
+  // local indices.  The stiffness matrices are symmetric, so only their upper triangles are kept, packed column by column (LAPACK's
+  // packed 'U' format); the matrices of each element type are stored contiguously, in the order of the cells' local indices.
+  struct LocalDataStorage {
+    int numTrialDofs;
+    vector<double> packedMatrices; // numTrialDofs * (numTrialDofs + 1) / 2 entries per cell
+    vector<bool> isStored;         // whether the stiffness is stored, by local cell index
+    vector< FieldContainer<double> > loadVectors;                    // by local cell index; empty if not stored
+    vector< FieldContainer<GlobalIndexType> > interpretedDofIndices; // by local cell index; empty if not stored
+  };
+  map<ElementType*, LocalDataStorage> _localData;
+  map<GlobalIndexType, pair<ElementType*, int> > _localCellIndices; // cellID --> (element type, local cell index); see localCellIndex()
 
+  // Cholesky factors of the field blocks, kept (if _storeFieldFactorizations is true) for field recovery in interpretGlobalCoefficients().
+  // Cells of one element type share the field/flux split, so each type's data is stored in contiguous arrays, cell after cell.
+  struct FieldFactorization {
+    vector<int> fieldIndices, fluxIndices; // local dof indices
+    vector<double> factors;   // per cell: the upper Cholesky factor U of K_ff, packed (fieldCount * (fieldCount + 1) / 2 entries)
+    vector<double> couplings; // per cell: U^-T [K_fb | f_f] (fieldCount x (fluxCount + 1), column-major)
+    vector<int> freeOrdinals; // ordinals of discarded factorizations, reused before the arrays grow
+  };
+  bool _storeFieldFactorizations;
+  map<ElementType*, FieldFactorization> _fieldFactorizations;
+  map<GlobalIndexType, pair<ElementType*, int> > _fieldFactorizationOrdinals; // cellID --> (element type, cell ordinal in its arrays)
+  
+  // drops the cell's stored factorization, if any: it is stale once the cell's stiffness or load changes
+  void discardFieldFactorization(GlobalIndexType cellID);
+  
   GlobalIndexType _myGlobalDofIndexOffset;
   IndexType _myGlobalDofIndexCount;
   
@@ -54,14 +78,44 @@ private:
                       const FieldContainer<double> &K, Epetra_SerialDenseMatrix &K_field,
                       Epetra_SerialDenseMatrix &K_coupl, Epetra_SerialDenseMatrix &K_flux);
   
+  // as above, for the field and coupling blocks only, taking K in packed storage (see LocalDataStorage)
+  void getSubmatrices(set<int> fieldIndices, set<int> fluxIndices, const double *packedK,
+                      Epetra_SerialDenseMatrix &K_field, Epetra_SerialDenseMatrix &K_coupl);
+  
   void getSubvectors(set<int> fieldIndices, set<int> fluxIndices, const FieldContainer<double> &b, Epetra_SerialDenseVector &b_field, Epetra_SerialDenseVector &b_flux);
   
+  // index of entry (i,j) of a symmetric matrix in packed upper-triangular storage
+  static int packedIndex(int i, int j) { return (i <= j) ? i + j * (j + 1) / 2 : j + i * (i + 1) / 2; }
+  
+  pair<ElementType*, int> localCellIndex(GlobalIndexType cellID); // on first use for an element type, indexes all its rank-local cells
+  bool haveStoredStiffness(GlobalIndexType cellID);
+  const double* storedPackedStiffness(GlobalIndexType cellID); // requires haveStoredStiffness(cellID)
+  void storeStiffness(GlobalIndexType cellID, const double *K, int n); // K is n x n, row-major (as in a FieldContainer); stores its symmetric part
+  FieldContainer<double> & storedLoad(GlobalIndexType cellID);                          // empty if none is stored
+  FieldContainer<GlobalIndexType> & storedInterpretedDofIndices(GlobalIndexType cellID); // empty if none are stored
+  
+  // the local (uninterpreted) dof indices of the condensible (field) and uncondensible (flux) dofs, in increasing order
+  void getLocalFieldAndFluxIndices(DofOrderingPtr trialOrder, vector<int> &fieldIndices, vector<int> &fluxIndices);
+  
+  vector<double> _fieldBlockWorkspace, _couplingWorkspace; // column-major workspace for choleskyCondense()
+  
+  // true if the n x n matrix K (row-major) is symmetric to within relativeTol times its largest entry (cf. BF::checkSymmetry())
+  static bool isSymmetric(const double *K, int n, double relativeTol = 1e-10);
+  
+  // Condenses the field dofs out of the n x n system (K, f) -- K stored row-major, as in a FieldContainer -- using a
+  // Cholesky factorization of the (SPD) field block K_ff.  With K_ff = U^T U and Z = U^-T [K_fb | f_f], the condensed
+  // system is K_bb - Z_b^T Z_b (one SYRK) and f_b - Z_b^T z_f (one GEMV); it is returned in K_condensed and f_condensed.
+  // Returns false if K is not symmetric (only its upper triangle is read) or the field block is not numerically positive
+  // definite, in which case the outputs are undefined.
+  bool choleskyCondense(const double *K, const double *f, int n, const vector<int> &fieldIndices, const vector<int> &fluxIndices,
+                        FieldContainer<double> &K_condensed, FieldContainer<double> &f_condensed);
+  
   void initializeGlobalDofIndices();
   map<GlobalIndexType, GlobalIndexType> interpretedFluxMapForPartition(PartitionIndexType partition, bool storeFluxDofIndices);
   
   void computeAndStoreLocalStiffnessAndLoad(GlobalIndexType cellID);
   
-  void getLocalData(GlobalIndexType cellID, FieldContainer<double> &stiffness, FieldContainer<double> &load, FieldContainer<GlobalIndexType> &interpretedDofIndices);
+  void getLocalData(GlobalIndexType cellID, const double* &packedStiffness, FieldContainer<double> &load, FieldContainer<GlobalIndexType> &interpretedDofIndices);
 public:
   CondensedDofInterpreter(Mesh* mesh, IPPtr ip, RHSPtr rhs, LagrangeConstraints* lagrangeConstraints, const set<int> &fieldIDsToExclude, bool storeLocalStiffnessMatrices);
   
@@ -72,6 +126,7 @@ public:
   GlobalIndexType globalDofCount();
   set<GlobalIndexType> globalDofIndicesForPartition(PartitionIndexType rank);
   
+  // load-only version: condenses localData using the cell's stored stiffness (computing it if necessary), and stores the load
   void interpretLocalData(GlobalIndexType cellID, const FieldContainer<double> &localData,
                           FieldContainer<double> &globalData, FieldContainer<GlobalIndexType> &globalDofIndices);
   
@@ -81,6 +136,14 @@ public:
   void interpretLocalData(GlobalIndexType cellID, const FieldContainer<double> &localStiffnessData, const FieldContainer<double> &localLoadData,
                           FieldContainer<double> &globalStiffnessData, FieldContainer<double> &globalLoadData, FieldContainer<GlobalIndexType> &globalDofIndices);
   
+  // batched version of the above, for cells sharing an element type: localStiffnessData is (numCells, numTrialDofs, numTrialDofs)
+  // and localLoadData (numCells, numTrialDofs), with cellIDs giving the cell for each entry.  All cells must belong to this partition.
+  // Because field dofs are local to the cell, the condensation is done in the local dof ordering, for the whole batch, and only
+  // the condensed system is interpreted by the mesh.
+  void interpretLocalBatchData(const vector<GlobalIndexType> &cellIDs, const FieldContainer<double> &localStiffnessData,
+                               const FieldContainer<double> &localLoadData, vector< FieldContainer<double> > &globalStiffnessData,
+                               vector< FieldContainer<double> > &globalLoadData, vector< FieldContainer<GlobalIndexType> > &globalDofIndices);
+  
   virtual void interpretLocalCoefficients(GlobalIndexType cellID, const FieldContainer<double> &localCoefficients, Epetra_MultiVector &globalCoefficients);
   
   void interpretLocalBasisCoefficients(GlobalIndexType cellID, int varID, int sideOrdinal, const FieldContainer<double> &basisCoefficients,
@@ -94,11 +157,23 @@ public:
   
   bool varDofsAreCondensible(int varID, int sideOrdinal, DofOrderingPtr dofOrdering);
   
+  // if true, interpretLocalBatchData() keeps each cell's Cholesky factor of its field block, so that interpretGlobalCoefficients()
+  // recovers the fields with a GEMV and a triangular solve, without the local stiffness matrix; the factor is kept in place of the
+  // stiffness, which is recomputed if it is needed again.  Off by default; Solution::setStoreFieldFactorizations() sets it.
+  void setStoreFieldFactorizations(bool value);
+  bool getStoreFieldFactorizations();
+  
+  // bytes used on this rank by the stored field factorizations
+  long long fieldFactorizationStorageBytes();
+  
   void storeLoadForCell(GlobalIndexType cellID, const FieldContainer<double> &load);
-  void storeStiffnessForCell(GlobalIndexType cellID, const FieldContainer<double> &stiffness);
+  void storeStiffnessForCell(GlobalIndexType cellID, const FieldContainer<double> &stiffness); // a nonsymmetric stiffness is symmetrized
   
   const FieldContainer<double> & storedLocalLoadForCell(GlobalIndexType cellID);
-  const FieldContainer<double> & storedLocalStiffnessForCell(GlobalIndexType cellID);
+  FieldContainer<double> storedLocalStiffnessForCell(GlobalIndexType cellID); // unpacked from the symmetric storage; computed if not stored
+  
+  // bytes used on this rank by the stored local stiffness matrices
+  long long localStiffnessStorageBytes();
 };
 
 
@@ -31,9 +31,18 @@ struct CellConstraints {
 };
 
 class GDAMinimumRule : public GlobalDofAssignment {
+public:
+  //! Orderings for the owned cells when global dof indices are assigned in rebuildLookups().  Each cell's owned dofs are numbered
+  //! contiguously, so ordering cells for locality gives a global matrix with smaller bandwidth.
+  enum CellOrderingForDofs {
+    CELL_ID_ORDERING,              // ascending cell ID (the default)
+    HILBERT_CURVE_ORDERING,        // cell centroids ordered along a Hilbert curve
+    REVERSE_CUTHILL_MCKEE_ORDERING // reverse Cuthill-McKee on the graph of owned cells sharing a vertex or side
+  };
+private:
   BasisReconciliation _br;
-  map<GlobalIndexType, IndexType> _cellDofOffsets; // (cellID -> first partition-local dof index for that cell)  within the partition, offsets for the owned dofs in cell
-  map<GlobalIndexType, GlobalIndexType> _globalCellDofOffsets; // (cellID -> first global dof index for that cell)
+  CellOrderingForDofs _cellOrderingForDofs;
+  map<GlobalIndexType, GlobalIndexType> _globalCellDofOffsets; // (cellID -> first global dof index for that cell), for the non-owned cells that we refer to
   GlobalIndexType _partitionDofOffset; // add to partition-local dof indices to get a global dof index
   GlobalIndexType _partitionDofCount; // how many dofs belong to the local partition
   FieldContainer<IndexType> _partitionDofCounts; // how many dofs belong to each MPI rank.
@@ -48,10 +57,60 @@ class GDAMinimumRule : public GlobalDofAssignment {
   typedef map<unsigned, VarIDToDofIndices> SubCellOrdinalToMap; // key: subcell ordinal
   typedef vector< SubCellOrdinalToMap > SubCellDofIndexInfo; // index to vector: subcell dimension
 
-  map< GlobalIndexType, CellConstraints > _constraintsCache;
-  map< GlobalIndexType, LocalDofMapperPtr > _dofMapperCache;
-  map< GlobalIndexType, map<int, map<int, LocalDofMapperPtr> > > _dofMapperForVariableOnSideCache; // cellID --> side --> variable --> LocalDofMapper
-  map< GlobalIndexType, SubCellDofIndexInfo> _ownedGlobalDofIndicesCache; // (cellID --> SubCellDofIndexInfo)
+  struct CellCacheEntry {
+    bool hasConstraints;
+    CellConstraints constraints;
+    bool hasOwnedDofIndices;
+    SubCellDofIndexInfo ownedDofIndices; // relative to the cell's first global dof index
+    LocalDofMapperPtr dofMapper;
+    map<int, map<int, LocalDofMapperPtr> > dofMapperForVariableOnSide; // side --> variable --> LocalDofMapper
+    
+    CellCacheEntry() : hasConstraints(false), hasOwnedDofIndices(false) {}
+    void swap(CellCacheEntry &other);
+  };
+  
+  // per-cell caches for the cells owned by this rank are stored contiguously, in the order in which their dofs are numbered;
+  // other cells (typically ghosts of owned cells) that we need to look at are kept in a map.
+  vector<GlobalIndexType> _ownedCellIDs; // owned cell ordinal --> cellID
+  vector<int> _ownedCellOrdinals; // cellID --> owned cell ordinal, or -1 if the cell is not owned by this rank
+  vector<CellCacheEntry> _ownedCellCaches; // indexed by owned cell ordinal
+  vector<IndexType> _ownedCellDofOffsets; // indexed by owned cell ordinal: first partition-local dof index for the cell
+  map<GlobalIndexType, CellCacheEntry> _ghostCellCaches;
+  bool _cellCachesAreCurrent; // true when the constraints and owned dof caches reflect the mesh, up to local invalidations made by invalidateCellCachesNear()
+  
+  // the constraint weights applied in getBasisMapOld() depend only on the local configuration of each constraint step (bases, subcell
+  // ordinals, refinement branch, permutation, and the weights applied thus far), not on which cells are involved.  We memoize each step's
+  // results, so that for repeated configurations only the global dof ordinals need to be looked up.
+  struct ConstraintStepKey {
+    int prevWeightsID; // index into _constraintWeights
+    Camellia::Basis<>* appliedBasis;
+    unsigned appliedDimension, appliedSubcellOrdinal, appliedSideOrdinal;
+    RefinementBranch refinements;
+    unsigned ancestralSideOrdinal;
+    Camellia::Basis<>* constrainingBasis;
+    pair<unsigned,unsigned> constrainingCellTopoKey;
+    unsigned constrainingDimension, constrainingSideOrdinal, constrainingSubcellOrdinal;
+    unsigned composedPermutation;
+    int minimumConstraintDimension;
+    
+    bool operator<(const ConstraintStepKey &other) const;
+  };
+  struct ConstraintStep {
+    vector<int> subSubcellWeightsIDs; // indexed by (d-1)-subcell ordinal in the constraining subcell; -1 where the weights are empty
+    SubBasisReconciliationWeights interiorWeights;
+  };
+  vector<SubBasisReconciliationWeights> _constraintWeights;
+  map<int, int> _unitConstraintWeightsID; // basis cardinality --> index into _constraintWeights of the identity weights
+  map<ConstraintStepKey, ConstraintStep> _constraintSteps;
+  
+  int ownedCellOrdinal(GlobalIndexType cellID);
+  CellCacheEntry &cellCache(GlobalIndexType cellID); // creates an entry for a non-owned cell if one does not exist
+  GlobalIndexType globalCellDofOffset(GlobalIndexType cellID);
+  void importNonOwnedCellDofOffsets(); // fills _globalCellDofOffsets with point-to-point communication
+  set<GlobalIndexType> cellsOwningDofsFor(const set<IndexType> &cellIDs); // cells whose offsets we need to determine the given cells' global dof indices
+  void importDofOffsetsForCells(const set<GlobalIndexType> &cellIDs); // adds entries to _globalCellDofOffsets for those not already known
+  void reindexOwnedCellCaches(const vector<GlobalIndexType> &orderedOwnedCellIDs);
+  LocalDofMapperPtr dofMapperForCell(GlobalIndexType cellID); // the whole-cell mapper, skipping the constraints lookup when it is cached
   
   vector<unsigned> allBasisDofOrdinalsVector(int basisCardinality);
   
@@ -66,6 +125,7 @@ class GDAMinimumRule : public GlobalDofAssignment {
   BasisMap getBasisMap(GlobalIndexType cellID, SubCellDofIndexInfo& dofOwnershipInfo, VarPtr var, int sideOrdinal);
   
   SubCellDofIndexInfo getOwnedGlobalDofIndices(GlobalIndexType cellID, CellConstraints &cellConstraints);
+  SubCellDofIndexInfo getOwnedCellRelativeDofIndices(GlobalIndexType cellID, CellConstraints &cellConstraints); // as above, but relative to the cell's first global dof index
   SubCellDofIndexInfo getGlobalDofIndices(GlobalIndexType cellID, CellConstraints &cellConstraints);
   
   set<GlobalIndexType> getFittableGlobalDofIndices(GlobalIndexType cellID, CellConstraints &constraints, int sideOrdinal); // returns the global dof indices for basis functions which have support on the given side (i.e. their support intersected with the side has positive measure).  This is determined by taking the union of the global dof indices defined on all the constraining sides for the given side (the constraining sides are by definition unconstrained).
@@ -74,6 +134,11 @@ class GDAMinimumRule : public GlobalDofAssignment {
   
   RefinementBranch volumeRefinementsForSideEntity(IndexType sideEntityIndex);
   
+  vector<GlobalIndexType> orderedCellIDsForDofNumbering(const set<GlobalIndexType> &cellIDs);
+  
+  // ! Removes cached constraints and owned dof layouts for the given cells and two layers of vertex neighbors (plus their ancestors).
+  void invalidateCellCachesNear(const set<GlobalIndexType> &changedCellIDs);
+  
 public:
   // these are public just for easier testing:
   CellConstraints getCellConstraints(GlobalIndexType cellID);
@@ -99,6 +164,8 @@ public:
   set<GlobalIndexType> globalDofIndicesForCell(GlobalIndexType cellID);
   set<GlobalIndexType> globalDofIndicesForPartition(PartitionIndexType partitionNumber);
   
+  void importCellDofOffsets(const set<GlobalIndexType> &cellIDs);
+  
   set<GlobalIndexType> ownedGlobalDofIndicesForCell(GlobalIndexType cellID);
   
   set<GlobalIndexType> partitionOwnedGlobalFieldIndices();
@@ -117,6 +184,11 @@ public:
   void printConstraintInfo(GlobalIndexType cellID);
   void printGlobalDofInfo();
   void rebuildLookups();
+  
+  CellOrderingForDofs getCellOrderingForDofs();
+  //! Sets the order in which owned cells are visited when global dof indices are assigned; calls rebuildLookups(), and rebuilds the
+  //! global coefficient vectors of registered Solutions from their cell-local coefficients.
+  void setCellOrderingForDofs(CellOrderingForDofs ordering);
 };
 
 #endif /* defined(__Camellia_debug__GDAMinimumRule__) */
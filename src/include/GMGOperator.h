@@ -59,16 +59,25 @@ class GMGOperator : public Epetra_Operator {
   Teuchos::RCP<Epetra_MultiVector> _diag_sqrt; // square root of the diagonal of the fine (global) stiffness matrix
   Teuchos::RCP<Epetra_MultiVector> _diag_inv; // inverse of the diagonal
   
-  mutable double _timeMapFineToCoarse, _timeMapCoarseToFine, _timeCoarseImport, _timeConstruction, _timeCoarseSolve, _timeLocalCoefficientMapConstruction, _timeComputeCoarseStiffnessMatrix, _timeProlongationOperatorConstruction;  // totals over the life of the object
+  mutable double _timeMapFineToCoarse, _timeMapCoarseToFine, _timeCoarseImport, _timeConstruction, _timeCoarseSolve, _timeLocalCoefficientMapConstruction, _timeComputeCoarseStiffnessMatrix, _timeProlongationOperatorConstruction, _timeSetUpSmoother, _timeApplySmoother;  // totals over the life of the object
   
   mutable bool _haveSolvedOnCoarseMesh; // if this is true, then we can call resolve() instead of solve().
   
+  mutable Teuchos::RCP<Epetra_CrsMatrix> _factoredCoarseStiffness; // the matrix from which _coarseSolver's factorization was computed
+  
   Teuchos::RCP<Epetra_CrsMatrix> _P; // prolongation operator
   
   Teuchos::RCP<Epetra_Operator> _smoother;
+  
+  Teuchos::RCP<GMGOperator> _coarseOperator; // if set, the coarse solve is approximated by a multigrid cycle on the coarse mesh instead of using _coarseSolver
+  Epetra_CrsMatrix* _fineStiffnessMatrix; // set by computeCoarseStiffnessMatrix(); used for residuals in post-smoothing and coarse cycles
+  
+  // applies sweepCount smoother iterations Y += S^-1 (X - A Y); if initialGuessIsZero, the first sweep skips the residual computation
+  void smooth(const Epetra_MultiVector &X, Epetra_MultiVector &Y, int sweepCount, bool initialGuessIsZero) const;
 public: // promoted these two to public for testing purposes:
   LocalDofMapperPtr getLocalCoefficientMap(GlobalIndexType fineCellID) const;
   GlobalIndexType getCoarseCellID(GlobalIndexType fineCellID) const;
+  RefinementBranch getRefinementBranch(GlobalIndexType fineCellID) const; // from the coarse ancestor to the fine cell
 
   set<GlobalIndexTypeToCast> setCoarseRHSVector(const Epetra_MultiVector &X, Epetra_FEVector &coarseRHSVector) const;
   
@@ -208,18 +217,46 @@ public:
   
   void setSchwarzFactorizationType(FactorType choice);
   
+  //! For CAMELLIA_ADDITIVE_SCHWARZ: if true, use one dense direct subdomain solve per rank-local cell (with the smoother
+  //! overlap counted in cell neighbors), in place of one solve per rank; the cell solves run in parallel under OpenMP.
+  void setUseCellSchwarzSubdomains(bool value);
+  
   enum SmootherChoice {
     POINT_JACOBI,
     POINT_SYMMETRIC_GAUSS_SEIDEL,
     BLOCK_JACOBI,
     BLOCK_SYMMETRIC_GAUSS_SEIDEL,
     IFPACK_ADDITIVE_SCHWARZ,
-    CAMELLIA_ADDITIVE_SCHWARZ
+    CAMELLIA_ADDITIVE_SCHWARZ,
+    CHEBYSHEV // Chebyshev polynomial in the Jacobi-scaled stiffness matrix; needs only matrix-vector products
   };
   
   void setSmootherType(SmootherChoice smootherType);
   void setSmootherOverlap(int overlap);
   
+  //! Sets parameters for the CHEBYSHEV smoother.
+  /*! The polynomial targets the interval [lambda_max / eigenvalueRatio, lambda_max] of the spectrum of D^-1 A, where
+   lambda_max is estimated at setup by powerIterations power-method iterations (and enlarged by 10% to guard against
+   underestimation).
+   
+   \param In
+   degree - polynomial degree; each smoother application costs this many fine matrix-vector products
+   \param In
+   powerIterations - power-method iterations used to estimate lambda_max
+   \param In
+   eigenvalueRatio - ratio of the largest to the smallest eigenvalue targeted by the polynomial
+   */
+  void setChebyshevParameters(int degree, int powerIterations = 10, double eigenvalueRatio = 30.0);
+  
+  //! Returns the (enlarged) estimate of the largest eigenvalue of D^-1 A computed at the last CHEBYSHEV smoother setup.
+  double getChebyshevMaxEigenvalue() const;
+  
+  //! Total time spent (on this rank) setting up the smoother, over the life of the object (or since clearTimings()).
+  double getSmootherSetUpTime() const;
+  
+  //! Total time spent (on this rank) applying the smoother, over the life of the object (or since clearTimings()).
+  double getSmootherApplyTime() const;
+  
   void setLevelOfFill(int fillLevel);
   void setFillRatio(double fillRatio);
   
@@ -241,11 +278,112 @@ public:
   
   //! Returns the Solution object used in the coarse solve.
   SolutionPtr getCoarseSolution();
+  
+  //! @name Multilevel cycles
+  //@{
+  
+  //! Sets a GMGOperator to approximate the coarse solve, in place of the coarse Solver.
+  /*! The coarse operator's fine mesh should be this operator's coarse mesh, and its fine dof interpreter and partition
+   map should be those of getCoarseSolution().  Its coarse stiffness matrix is computed recursively whenever this
+   operator's is.  The cycle type, composition type and smoothing counts set on this operator are copied to it.
+   
+   \param In
+   coarseOperator - the operator for the next-coarser level; null restores the direct coarse solve
+   */
+  void setCoarseOperator(Teuchos::RCP<GMGOperator> coarseOperator);
+  
+  //! Returns the coarse GMGOperator, or null if the coarse solve is direct.
+  Teuchos::RCP<GMGOperator> getCoarseOperator();
+  
+  //! Returns the number of mesh levels in the hierarchy, counting the fine mesh (2 for a two-level operator).
+  int levelCount() const;
+  
+  //! cycle choices when a coarse GMGOperator is set.  On each level, a V-cycle applies the coarse operator once, a W-cycle twice.
+  enum CycleType {
+    V_CYCLE,
+    W_CYCLE
+  };
+  
+  //! Sets the cycle type on this and all coarser levels.
+  void setCycleType(CycleType cycleType);
+  
+  //! how the smoother and the coarse correction are combined on each level.
+  /*! ADDITIVE computes the pre-smoothing sweeps and the coarse correction independently from the incoming residual, and
+   sums them.  MULTIPLICATIVE pre-smooths, recomputes the residual with the fine stiffness matrix, restricts that for the
+   coarse correction, and then post-smooths; this costs one extra fine matrix-vector product per application, but
+   usually needs markedly fewer outer iterations.  SYMMETRIC_MULTIPLICATIVE is MULTIPLICATIVE with as many post- as
+   pre-smoothing sweeps, so that the operator is symmetric when the smoother is, and CG remains applicable.
+   */
+  enum CompositionType {
+    ADDITIVE,
+    MULTIPLICATIVE,
+    SYMMETRIC_MULTIPLICATIVE
+  };
+  
+  //! Sets the composition type on this and all coarser levels.
+  void setCompositionType(CompositionType compositionType);
+  
+  //! Sets the number of smoother sweeps on this and all coarser levels.
+  /*! Pre-smoothing sweeps are computed from the incoming residual and added to the coarse correction (as in the
+   additive two-level scheme); post-smoothing sweeps then start from that sum, using the fine stiffness matrix to
+   update the residual.  The default (1,0) is the additive two-level scheme.  With no post-smoothing, the operator is
+   symmetric whenever the smoother is, so that it may be used with CG.  (See also CompositionType.)
+   
+   \param In
+   preSmoothingCount - sweeps applied to the incoming residual
+   \param In
+   postSmoothingCount - sweeps applied after the coarse correction
+   */
+  void setSmoothingCounts(int preSmoothingCount, int postSmoothingCount);
+  //@}
+  
+  //! @name Coarse factorization reuse
+  //@{
+  
+  //! what is done to the coarse solver's factorization at the next coarse solve
+  enum CoarseFactorizationReuse {
+    FULL_FACTORIZATION,    // symbolic and numeric factorization
+    NUMERIC_FACTORIZATION, // the sparsity pattern is unchanged; reuse the symbolic factorization
+    NO_FACTORIZATION       // the coarse stiffness matrix changed little; keep using the existing factorization
+  };
+  
+  //! Allows computeCoarseStiffnessMatrix() to retain the coarse solver's factorization.
+  /*! In adaptive loops where only the fine mesh is refined (via setFineMesh()), the coarse stiffness matrix P^T A P
+   often keeps its sparsity pattern, and changes little.  When reuseSymbolicFactorization is true and the new coarse
+   stiffness matrix has the same sparsity pattern as the one last factored, only the numeric factorization is redone.
+   If additionally the relative change in Frobenius norm is below numericReuseTolerance, the old factorization is kept
+   as is; the coarse solve is then inexact, but remains a fixed linear operator, so that the GMGOperator is still a
+   valid preconditioner.  Has no effect when a coarse GMGOperator is set (see setCoarseFactorizationReuse() on it).
+   
+   \param In
+   reuseSymbolicFactorization - whether to reuse the symbolic factorization when the sparsity pattern is unchanged
+   \param In
+   numericReuseTolerance - relative change below which the numeric factorization is also reused; 0 disables this
+   */
+  void setCoarseFactorizationReuse(bool reuseSymbolicFactorization, double numericReuseTolerance = 0.0);
+  
+  //! Returns the decision made by the most recent call to computeCoarseStiffnessMatrix().
+  CoarseFactorizationReuse getCoarseFactorizationReuse() const;
+  //@}
 private:
+  bool _reuseCoarseSymbolicFactorization;
+  double _coarseNumericReuseTolerance;
+  CoarseFactorizationReuse _coarseFactorizationReuse; // decided by computeCoarseStiffnessMatrix()
+  mutable bool _coarseNumericFactorizationPending; // set when _coarseFactorizationReuse is NUMERIC_FACTORIZATION, cleared by the coarse solve
+  
+  CycleType _cycleType;
+  CompositionType _compositionType;
+  int _preSmoothingCount, _postSmoothingCount;
+  
   SmootherChoice _smootherType;
   int _smootherOverlap;
   
+  int _chebyshevDegree, _chebyshevPowerIterations;
+  double _chebyshevEigenvalueRatio;
+  double _chebyshevMaxEigenvalue;
+  
   FactorType _schwarzBlockFactorizationType;
+  bool _useCellSchwarzSubdomains;
   int _levelOfFill;
   double _fillRatio;
 };
@@ -46,6 +46,12 @@ public:
   GMGSolver(BCPtr zeroBCs, MeshPtr coarseMesh, IPPtr coarseIP, MeshPtr fineMesh, Teuchos::RCP<DofInterpreter> fineDofInterpreter,
             Epetra_Map finePartitionMap, int maxIters, double tol, Teuchos::RCP<Solver> coarseSolver, bool useStaticCondensation);
   GMGSolver(SolutionPtr fineSolution, MeshPtr coarseMesh, int maxIters, double tol, Teuchos::RCP<Solver> coarseSolver, bool useStaticCondensation);
+  // multilevel hierarchy: coarseMeshes run from the next-coarser mesh to the coarsest, on which coarsestSolver is used
+  GMGSolver(SolutionPtr fineSolution, vector<MeshPtr> coarseMeshes, int maxIters, double tol, Teuchos::RCP<Solver> coarsestSolver, bool useStaticCondensation);
+  
+  // p-multigrid hierarchy for the above: meshes on copies of fineMesh's topology, halving the H1 order (starting from the
+  // lowest order in fineMesh) until it reaches 1, with the same test enrichment.  Empty if fineMesh is already lowest-order.
+  static vector<MeshPtr> pCoarsenedMeshes(MeshPtr fineMesh);
   
   double condest();
   
@@ -65,6 +65,7 @@ protected:
   void constructActiveCellMap();
   
   void projectParentCoefficientsOntoUnsetChildren();
+  void reinitializeRegisteredSolutions(); // call after global dof indices change without refinement (e.g., repartitioning)
   virtual void rebuildLookups() = 0;
   
   // private constructor for subclass's implementation of deepCopy()
@@ -125,6 +126,11 @@ public:
 
   virtual set<GlobalIndexType> globalDofIndicesForCell(GlobalIndexType cellID) = 0;
   
+  //! Collective.  Global dof indices are guaranteed to be available for the cells owned by this rank and their ghost layer; before
+  //! interpreting data for other cells (e.g. all active cells, or the cells returned by cellIDsForPoints()), call this with those cells.
+  //! Entries remain valid until the next rebuildLookups().
+  virtual void importCellDofOffsets(const set<GlobalIndexType> &cellIDs);
+  
   virtual IndexType localDofCount() = 0; // local to the MPI node
   
   // ! method for setting mesh and meshTopology after a deep copy of GDA.  Doesn't rebuild anything!!
@@ -22,12 +22,14 @@ namespace Camellia {
     
     Intrepid::FieldContainer<double> _legendreL2normsSquared, _lobattoL2normsSquared;
     void initializeL2normValues();
-    int dofOrdinalMap(int xDofOrdinal, int yDofOrdinal) const;
   public:
     LobattoHGRAD_QuadBasis(int degree, bool conforming = false); // conforming means not strictly hierarchical, but has e.g. vertex dofs defined...
     LobattoHGRAD_QuadBasis(int degree_x, int degree_y, bool conforming = false);
     
     void getValues(ArrayScalar &values, const ArrayScalar &refPoints, Intrepid::EOperator operatorType) const;
+    
+    int dofOrdinalMap(int xDofOrdinal, int yDofOrdinal) const; // the tensor-product function with the given Lobatto indices
+    bool isConforming() const;
   };
 }
 
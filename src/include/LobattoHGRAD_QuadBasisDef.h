@@ -193,4 +193,9 @@ namespace Camellia {
     }
     
   }
+  
+  template<class Scalar, class ArrayScalar>
+  bool LobattoHGRAD_QuadBasis<Scalar,ArrayScalar>::isConforming() const {
+    return _conforming;
+  }
 } // namespace Camellia
\ No newline at end of file
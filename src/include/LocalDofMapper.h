@@ -36,10 +36,24 @@ class LocalDofMapper { // maps a whole trial ordering
 //  void addSubBasisMapMatrixContribution(int varID, int sideOrdinal, BasisMap basisMap, const FieldContainer<double> &localData, FieldContainer<double> &globalData);
   void addReverseSubBasisMapVectorContribution(int varID, int sideOrdinal, BasisMap basisMap, const FieldContainer<double> &globalData, FieldContainer<double> &localData);
 //  void addReverseSubBasisMapMatrixContribution(int varID, int sideOrdinal, BasisMap basisMap, const FieldContainer<double> &globalData, FieldContainer<double> &localData);
-  FieldContainer<double> mapLocalDataMatrix(const FieldContainer<double> &localData, bool fittableGlobalDofsOnly);
   
   FieldContainer<double> _localCoefficientsFitMatrix; // used for fitLocalCoefficients
   
+  // the local-to-global map as a whole, flattened into compressed rows: row i holds the (global ordinal, weight) pairs to which local dof i contributes.
+  struct CompactMap {
+    bool isBuilt;
+    bool isGather; // true when each local dof contributes with unit weight to at most one global ordinal, and no global ordinal receives more than one
+    vector<int> rowOffsets; // size localDofCount + 1
+    vector<unsigned> globalOrdinals;
+    vector<double> weights;
+    vector<int> localDofForGlobalOrdinal; // for gathers: the local dof that maps to each global ordinal, or -1
+    CompactMap() : isBuilt(false), isGather(false) {}
+  };
+  CompactMap _compactMaps[2]; // indexed by fittableGlobalDofsOnly
+  
+  CompactMap &compactMap(bool fittableGlobalDofsOnly); // builds the compact map on first request
+  void addCompactEntries(int varID, int sideOrdinal, BasisMap &basisMap, bool fittableGlobalDofsOnly, vector< map<unsigned, double> > &localRows);
+  
 public:
   LocalDofMapper(DofOrderingPtr dofOrdering, map< int, BasisMap > volumeMaps,
                  set<GlobalIndexType> fittableGlobalDofOrdinalsInVolume,
@@ -133,6 +133,10 @@ class Mesh : public RefinementObserver, public DofInterpreter {
 
   vector< Teuchos::RCP<RefinementObserver> > _registeredObservers; // meshes that should be modified upon refinement (must differ from this only in bilinearForm; must have identical geometry & cellIDs)
 
+  // assembly costs recorded by Solution, cellID --> (measured cost, modeled cost at the time of measurement); entries are removed when a cell is refined
+  map<GlobalIndexType, pair<double,double> > _measuredCellCosts;
+  double _measuredCellCostTotal, _modeledCellCostTotalForMeasuredCells; // ratio calibrates modeled costs against measured ones
+
 
   map<IndexType, GlobalIndexType> getGlobalVertexIDs(const FieldContainer<double> &vertexCoordinates);
 
@@ -146,6 +150,8 @@ class Mesh : public RefinementObserver, public DofInterpreter {
 
   void setNeighbor(ElementPtr elemPtr, unsigned elemSide, ElementPtr neighborPtr, unsigned neighborSide);
 
+  void discardCellAssemblyCost(GlobalIndexType cellID);
+
   GlobalIndexType getVertexIndex(double x, double y, double tol=1e-14);
   
   void verticesForCells(FieldContainer<double>& vertices, vector<GlobalIndexType> &cellIDs);
@@ -217,6 +223,22 @@ public:
 
   int cellPolyOrder(GlobalIndexType cellID);
 
+  // ! Relative cost of assembling the cell's local stiffness matrix and load, for use as a partitioning weight.  Returns the
+  // ! cost recorded by recordCellAssemblyCost() if there is one; otherwise, modeledCellCost(), scaled to match the units of
+  // ! any recorded costs.  Recorded costs are rank-local until synchronizeCellAssemblyCosts() is called; before that, only
+  // ! meaningful for rank-local cells.
+  double cellCost(GlobalIndexType cellID);
+  // ! Model of the cell's assembly cost based on its trial and test dof counts: integration of the Gram and stiffness
+  // ! matrices at each cubature point, Cholesky factorization of the Gram matrix, and the optimal test function solves.
+  double modeledCellCost(GlobalIndexType cellID);
+  // ! Records a measured assembly cost (e.g. seconds) for the cell; Solution does this during populateStiffnessAndLoad().
+  // ! The record is discarded when the cell is h- or p-refined.
+  void recordCellAssemblyCost(GlobalIndexType cellID, double cost);
+  void clearCellAssemblyCosts();
+  // ! Collective: shares every rank's recorded costs with all ranks, so that cellCost() agrees across ranks for every active cell.
+  // ! The partition policies call this before weighting by cost.
+  void synchronizeCellAssemblyCosts();
+
   void enforceOneIrregularity();
 //  void enforceOneIrregularity(vector< Teuchos::RCP<Solution> > solutions);
 
@@ -20,12 +20,30 @@ using namespace Intrepid;
 #include "Mesh.h"
 
 class MeshPartitionPolicy {
+protected:
+  bool _weightByCellCost;
 public:
+  MeshPartitionPolicy() : _weightByCellCost(false) {}
   virtual ~MeshPartitionPolicy() {}
   virtual void partitionMesh(Mesh *mesh, PartitionIndexType numPartitions);
   
+  // ! When true, partitions balance the total Mesh::cellCost() of their cells rather than the number of cells.  (Off by default.)
+  void setWeightByCellCost(bool value);
+  bool weightByCellCost();
+  
+  // ! Divides the active cells, in cellID order, into contiguous chunks of (nearly) equal count or, if weightByCellCost is true, of
+  // ! (nearly) equal total cost.  This is what the default partitionMesh() does.  With weightByCellCost, this is collective (see
+  // ! Mesh::synchronizeCellAssemblyCosts()).
+  static vector< set<GlobalIndexType> > contiguousPartitions(Mesh *mesh, PartitionIndexType numPartitions, bool weightByCellCost);
+  // ! Max over partitions of the partition's total Mesh::cellCost(), divided by the average; 1.0 is perfect balance.
+  static double costImbalance(Mesh *mesh, const vector< set<GlobalIndexType> > &partitions);
+  // ! Active side neighbors of the active cell, mapped to the number of trace and flux dofs the two cells share: the smaller of the two
+  // ! cells' dof counts on the shared side, summed over shared sides.  Symmetric, so suitable as graph edge weights.
+  static map<GlobalIndexType, int> traceCouplingWeights(Mesh *mesh, GlobalIndexType cellID);
+  
   static MeshPartitionPolicyPtr standardPartitionPolicy(); // aims to balance across all MPI ranks; present implementation uses Zoltan
   static MeshPartitionPolicyPtr oneRankPartitionPolicy(int rank=0); // all cells belong to the rank specified
+  static MeshPartitionPolicyPtr traceGraphPartitionPolicy(); // Zoltan graph partitioning (PHG) of the side-neighbor graph, weighted by traceCouplingWeights()
 };
 
 #endif
@@ -36,21 +36,25 @@ typedef Teuchos::RCP<Cell> CellPtr;
 class MeshTopology {
   unsigned _spaceDim; // dimension of the mesh
   
-  map< vector<double>, IndexType > _vertexMap; // maps into indices in the vertices list -- here just for vertex identification (i.e. so we don't add the same vertex twice)
-  vector< vector<double> > _vertices; // vertex locations
+  vector<double> _vertexCoordinates; // vertex locations, stored contiguously: coordinate d of vertex i is at i * _spaceDim + d
+  vector<IndexType> _vertexHashTable; // open-addressing (linear probing) hash table of vertex indices, hashed on quantized coordinates -- here just for vertex identification (i.e. so we don't add the same vertex twice).  Empty slots are (IndexType)-1.
   
   vector< PeriodicBCPtr > _periodicBCs;
   map<IndexType, set< pair<int, int> > > _periodicBCIndicesMatchingNode; // pair: first = index in _periodicBCs; second: 0 or 1, indicating first or second part of the identification matches.  IndexType is the vertex index.
   map< pair<IndexType, pair<int,int> >, IndexType > _equivalentNodeViaPeriodicBC;
   
   // the following entity vectors are indexed on dimension of the entities
-  vector< vector< vector<IndexType> > > _entities; // vertices, edges, faces, solids, etc., up to dimension (_spaceDim - 1).  Innermost container is sorted by value of IndexType (nodes). The outer two indices are entityDim, entityIndex.
-  vector< map< vector<IndexType>, IndexType > > _knownEntities; // map keys are vectors of sorted vertex indices, values are entity indices in _entities[d]
-  vector< vector< vector<IndexType> > > _canonicalEntityOrdering;
+  IndexType _vertexCount;
+  // entities of dimension 1 through (_spaceDim - 1) are stored in CSR form: the vertices (in canonical order) of entity i of dimension d
+  // are _entityVertices[d][_entityVertexOffsets[d][i]] through _entityVertices[d][_entityVertexOffsets[d][i+1]-1].  (Entries for d=0 are unused;
+  // the vertex index is the entity index.)
+  vector< vector<IndexType> > _entityVertexOffsets;
+  vector< vector<IndexType> > _entityVertices;
+  vector< vector<IndexType> > _entityHashTables; // for entity identification: open-addressing hash tables of entity indices, hashed on sorted vertex indices.  Empty slots are (IndexType)-1.
   vector< vector< vector< pair<IndexType, unsigned> > > > _activeCellsForEntities; // inner vector entries are sorted (cellIndex, entityIndexInCell) (entityIndexInCell aka subcord)--I'm vascillating on whether this should contain entries for active ancestral cells.  Today, I think it should not.  I think we should have another set of activeEntities.  Things in that list either themselves have active cells or an ancestor that has an active cell.  So if your parent is inactive and you don't have any active cells of your own, then you know you can deactivate.
   vector< vector< vector<IndexType> > > _sidesForEntities; // vector indices: dimension d, entity index; innermost container stores entity indices of dimension _spaceDim-1 belonging to cells that contain the indicated entity, sorted by index.
-  map< IndexType, pair< pair<IndexType, unsigned>, pair<IndexType, unsigned> > > _cellsForSideEntities; // key: sideEntityIndex.  value.first is (cellIndex1, sideOrdinal1), value.second is (cellIndex2, sideOrdinal2).  On initialization, (cellIndex2, sideOrdinal2) == ((IndexType)-1,(IndexType)-1).
-  set<IndexType> _boundarySides; // entities of dimension _spaceDim-1 on the mesh boundary
+  vector< pair< pair<IndexType, unsigned>, pair<IndexType, unsigned> > > _cellsForSideEntities; // index: sideEntityIndex.  value.first is (cellIndex1, sideOrdinal1), value.second is (cellIndex2, sideOrdinal2).  On initialization, (cellIndex2, sideOrdinal2) == ((IndexType)-1,(IndexType)-1); sides without cells have cellIndex1 == (IndexType)-1.
+  vector<bool> _boundarySides; // index: sideEntityIndex; true for sides on the mesh boundary
   vector< map< IndexType, vector< pair<IndexType, unsigned> > > > _parentEntities; // map from entity to its possible parents.  Not every entity has a parent.  We support entities having multiple parents.  Such things will be useful in the context of anisotropic refinements.  The pair entries here are (parentEntityIndex, refinementOrdinal), where the refinementOrdinal is the index into the _childEntities[d][parentEntityIndex] vector.
   
   vector< map< IndexType, pair<IndexType, unsigned> > > _generalizedParentEntities; // map from entity to its nearest generalized parent.  map entries are (parentEntityIndex, parentEntityDimension).  Generalized parents may be higher-dimensional or equal-dimensional to the child entity.
@@ -61,11 +65,24 @@ class MeshTopology {
   set< IndexType > _activeCells;
   set< IndexType > _rootCells; // cells without parents
   
+  // distributed storage (see pruneToRankLocalCells()): cells outside the rank-local set have null entries in _cells
+  bool _isPruned;
+  set< IndexType > _prunedOwnedCells; // the owned cells passed to the last pruneToRankLocalCells() call
+  map< IndexType, IndexType > _prunedFirstChildIndices; // stored, refined cells whose children are not stored --> index of the first child
+  
   // these guys presently only support 2D:
   set< IndexType > _cellIDsWithCurves;
   map< pair<IndexType, IndexType>, ParametricCurvePtr > _edgeToCurveMap;
   Teuchos::RCP<MeshTransformationFunction> _transformationFunction; // for dealing with those curves
   
+  // uniform-grid spatial index over active cells, for point location.  Built lazily by cellIDsForPoints(), kept up to date on refinement,
+  // and discarded (rebuilt on next use) when a root cell is added or the active cell count has grown substantially since the last build.
+  vector<double> _cellGridMin, _cellGridSpacing;
+  vector<int> _cellGridDims;
+  vector< vector<IndexType> > _cellGridBuckets; // flattened, x index varies fastest.  Empty when the index has not been built.
+  vector<double> _cellBoundingBoxes; // indexed by cellIndex * 2 * _spaceDim: min coordinates, then max coordinates.  Set for cells in the index.
+  IndexType _cellGridBuildActiveCellCount;
+  
   map< pair<unsigned,unsigned>, CellTopoPtr > _knownTopologies; // (shards key, tensorial degree) -> topo.  Might want to move this to a CellTopoFactory, but it is fairly simple
   
   //  set<IndexType> activeDescendants(IndexType d, IndexType entityIndex);
@@ -85,7 +102,15 @@ class MeshTopology {
   
   void determineGeneralizedParentsForRefinement(CellPtr cell, RefinementPatternPtr refPattern);
   
+  void addEntityToHashTable(unsigned d, IndexType entityIndex);
+  IndexType entityHashTableSlot(unsigned d, const vector<IndexType> &sortedVertices);
+  IndexType findEntity(unsigned d, const vector<IndexType> &sortedVertices); // returns -1 if no such entity
+  bool isBoundarySide(IndexType sideEntityIndex);
+  void setBoundarySide(IndexType sideEntityIndex, bool isBoundary);
+  void addVertexToHashTable(IndexType vertexIndex);
   IndexType getVertexIndexAdding(const vector<double> &vertex, double tol);
+  unsigned vertexHashTableSlot(const vector<long long> &quantizedCoords);
+  void rebuildVertexHashTable(unsigned tableSize);
   vector<IndexType> getVertexIndices(const FieldContainer<double> &vertices);
   vector<IndexType> getVertexIndices(const vector< vector<double> > &vertices);
   map<unsigned, IndexType> getVertexIndicesMap(const FieldContainer<double> &vertices);
@@ -95,6 +120,7 @@ class MeshTopology {
   void printVertex(IndexType vertexIndex);
   void printVertices(set<IndexType> vertexIndices);
   void refineCellEntities(CellPtr cell, RefinementPatternPtr refPattern); // ensures that the appropriate child entities exist, and parental relationships are recorded in _parentEntities
+  void refineCellWithVertices(CellPtr cell, RefinementPatternPtr refPattern, const vector<IndexType> &refinedVertexIndices); // refinedVertexIndices: vertex indices corresponding to refPattern->verticesOnReferenceCell()
   void setEntityGeneralizedParent(unsigned entityDim, IndexType entityIndex, unsigned parentDim, IndexType parentEntityIndex);
   
   GlobalDofAssignment* _gda; // for cubature degree lookups
@@ -103,6 +129,15 @@ class MeshTopology {
   
   void addSideForEntity(unsigned entityDim, IndexType entityIndex, IndexType sideEntityIndex); // maintains _sidesForEntities container
   
+  // cell grid (spatial index) support:
+  void addCellToGrid(IndexType cellIndex);
+  void buildCellGrid();
+  bool cellBoundingBoxContainsPoint(IndexType cellIndex, const vector<double> &point); // uses the stored bounding box
+  IndexType cellIDForPointFromRootCells(const vector<double> &point);
+  vector<int> cellGridBucketsForCell(IndexType cellIndex); // flattened ordinals of the buckets overlapping the cell's stored bounding box
+  void removeCellFromGrid(IndexType cellIndex);
+  void storeCellBoundingBox(IndexType cellIndex);
+  
   // ! private method for deep-copying Cells during MeshToplogy::deepCopy()
   void deepCopyCells();
 public:
@@ -160,6 +195,29 @@ public:
   
   set< pair<IndexType, unsigned> > getCellsContainingEntity(unsigned d, IndexType entityIndex);
   vector< IndexType > getSidesContainingEntity(unsigned d, IndexType entityIndex);
+
+  // ! Returns the ancestors of the indicated cells (not including the cells themselves, unless one is an ancestor of another).
+  set<IndexType> getAncestorCellIndices(const set<IndexType> &cellIndices);
+
+  // ! Returns one layer of ghost cells for the indicated (owned) cells: the active cells not in ownedCellIndices that share a vertex,
+  // ! an edge, or a side (possibly a broken edge or side) with some owned cell.
+  set<IndexType> getGhostCellIndices(const set<IndexType> &ownedCellIndices);
+
+  // ! Returns the cells that a rank owning ownedCellIndices needs to hold in a distributed topology: the owned cells, one layer of
+  // ! ghost cells, and all the ancestors of these (required for determining constraints).
+  set<IndexType> getRankLocalCellIndices(const set<IndexType> &ownedCellIndices);
+
+  // ! Switches this topology to distributed storage: discards all cells outside getRankLocalCellIndices(ownedCellIndices), along with
+  // ! the vertices and entities that only they use.  Cell indices are unchanged; refining a cell that is not stored just reserves indices
+  // ! for its children, so the pruned topology stays consistent with those on other ranks as long as every rank applies the same
+  // ! refinements.  Entity and vertex indices become rank-local, getActiveCellIndices() and activeCellCount() report stored cells only,
+  // ! and ghost cells do not know about neighbors outside the rank-local set.  Siblings of rank-local cells are also stored; one that is
+  // ! refined, with no rank-local descendants, is inactive but stores no children.  A pruned topology can be pruned again only to cells
+  // ! that were owned (or descend from cells that were owned) at the previous pruning.  Curvilinear geometry is not supported.
+  // ! This mode is not yet used by Mesh: GlobalDofAssignment, Boundary and Solution still require the full topology.
+  void pruneToRankLocalCells(const set<IndexType> &ownedCellIndices);
+  bool isPruned();
+  bool cellIsStored(IndexType cellIndex); // false for cells discarded by pruneToRankLocalCells()
   
   RefinementBranch getSideConstraintRefinementBranch(IndexType sideEntityIndex); // Returns a RefinementBranch that goes from the constraining side to the side indicated.
   
@@ -168,9 +226,15 @@ public:
   IndexType getSubEntityIndex(unsigned d, IndexType entityIndex, unsigned subEntityDim, unsigned subEntityOrdinal);
   unsigned getSubEntityPermutation(unsigned d, IndexType entityIndex, unsigned subEntityDim, unsigned subEntityOrdinal);
   bool getVertexIndex(const vector<double> &vertex, IndexType &vertexIndex, double tol=1e-14);
-  const vector<double>& getVertex(IndexType vertexIndex);
+  vector<double> getVertex(IndexType vertexIndex); // copies the coordinates; prefer getVertexCoordinates() in loops
+  // ! Returns a pointer to the _spaceDim coordinates of the vertex, within contiguous storage.  Valid until the next vertex is added.
+  const double* getVertexCoordinates(IndexType vertexIndex);
   FieldContainer<double> physicalCellNodesForCell(unsigned cellIndex, bool includeCellDimension = false);
   void refineCell(IndexType cellIndex, RefinementPatternPtr refPattern);
+  
+  // ! Refines all the indicated cells with refPattern.  Equivalent to calling refineCell() on each (in order), but computes the new vertices
+  // ! for all the cells together.  All cells must be active and have the topology of refPattern.
+  void refineCells(const set<IndexType> &cellIndices, RefinementPatternPtr refPattern);
   IndexType cellCount();
   IndexType activeCellCount();
   
@@ -130,6 +130,7 @@ private:
   bool _writeMatrixToMatrixMarketFile;
   bool _writeRHSToMatrixMarketFile;
   bool _zmcsAsRankOneUpdate;
+  bool _storeFieldFactorizations; // passed on to the CondensedDofInterpreter used for condensed solves
   
   std::string _matrixFilePath;
   std::string _rhsFilePath;
@@ -341,6 +342,11 @@ public:
 
   void setUseCondensedSolve(bool value);
   
+  // if true, condensed solves keep each cell's Cholesky factor of its field block in place of its local stiffness matrix,
+  // and recover the fields from it (see CondensedDofInterpreter::setStoreFieldFactorizations()).  Off by default.
+  void setStoreFieldFactorizations(bool value);
+  bool getStoreFieldFactorizations();
+  
   void writeStatsToFile(const std::string &filePath, int precision=4);
 
   std::vector<int> getZeroMeanConstraints();
@@ -35,6 +35,12 @@ public:
     // subclasses may override to reuse factorization information
     return solve();
   }
+  virtual int resolveWithNewValues() {
+    // must be preceded by a call to solve(); caller attests that the system matrix has the same sparsity pattern as at
+    // the last call to solve(), though its values may have changed (the matrix object may also have been replaced via
+    // problem().SetOperator()).  Subclasses may override to reuse the symbolic factorization.
+    return solve();
+  }
 
   enum SolverChoice {
     KLU,
@@ -95,6 +101,15 @@ public:
       return solve();
     }
   }
+  int resolveWithNewValues() {
+    if (_savedSolver.get() != NULL) {
+      int err = _savedSolver->NumericFactorization(); // reuses the symbolic factorization
+      if (err != 0) return err;
+      return _savedSolver->Solve();
+    } else {
+      return solve();
+    }
+  }
 };
 
 using namespace std;
@@ -127,6 +142,15 @@ public:
       return solve();
     }
   }
+  int resolveWithNewValues() {
+    if (_savedSolver.get() != NULL) {
+      int err = _savedSolver->NumericFactorization(); // reuses the symbolic factorization
+      if (err != 0) return err;
+      return _savedSolver->Solve();
+    } else {
+      return solve();
+    }
+  }
 };
 #endif
 
@@ -256,6 +280,15 @@ public:
       return solve();
     }
   }
+  int resolveWithNewValues() {
+    if (_savedSolver.get() != NULL) {
+      int err = _savedSolver->NumericFactorization(); // reuses the analysis phase
+      if (err != 0) return err;
+      return _savedSolver->Solve();
+    } else {
+      return solve();
+    }
+  }
 };
 #else
 class MumpsSolver : public Solver {
@@ -21,12 +21,28 @@ class ZoltanMeshPartitionPolicy : public MeshPartitionPolicy {
   string _ZoltanPartitioner; // default to block
   string _debug_level;
 
+  // incremental repartitioning (see setIncrementalRepartitioning()):
+  bool _incremental;
+  double _imbalanceThreshold;
+  double _repartitionMultiplier;
+  bool _reportMigration;
+  
+  // statistics from the last partitionMesh() call:
+  double _imbalanceBeforePartitioning;
+  bool _didRebalance;
+  long _migratedCellCount;
+  long _migratedBytes;
+  
+  void initializeRepartitioningState();
+
   //helper functions for query functions
 //  int getNextActiveIndex(FieldContainer<int> &partitionedActiveCells);
 //  static GlobalIndexType getIndexOfGID(int myNode, FieldContainer<GlobalIndexType> &partitionedActiveCells,GlobalIndexType globalID);
 //  vector<GlobalIndexType> getListOfActiveGlobalIDs(FieldContainer<GlobalIndexType> partitionedActiveCells);
 
   static set<GlobalIndexType> getRankLocalCellIDs(Mesh* mesh);
+  static PartitionIndexType currentPartitionForCell(Mesh* mesh, GlobalIndexType cellID);
+  static void setPartitionsFromRankLocalCells(Mesh* mesh, const set<GlobalIndexType> &rankLocalCells, int numNodes);
   
   //Zoltan query functions
   static int get_number_of_objects(void *data, int *ierr);
@@ -34,6 +50,10 @@ class ZoltanMeshPartitionPolicy : public MeshPartitionPolicy {
   static int get_num_geom(void *data, int *ierr);
   static void get_geom_list(void *data,int num_gid_entries, int num_lid_entries, int num_obj,ZOLTAN_ID_PTR global_ids, ZOLTAN_ID_PTR local_ids, int num_dim, double *geom_vec, int *ierr);  
 
+  // graph query functions (used when the partitioner is "GRAPH"); edges join side neighbors, weighted by shared trace dofs
+  static void get_num_edges_list(void *data, int num_gid_entries, int num_lid_entries, int num_obj, ZOLTAN_ID_PTR global_ids, ZOLTAN_ID_PTR local_ids, int *num_edges, int *ierr);
+  static void get_edge_list(void *data, int num_gid_entries, int num_lid_entries, int num_obj, ZOLTAN_ID_PTR global_ids, ZOLTAN_ID_PTR local_ids, int *num_edges, ZOLTAN_ID_PTR nbor_global_ids, int *nbor_procs, int wgt_dim, float *ewgts, int *ierr);
+
   //Reftree refinement pattern query functions
 //  static int get_num_coarse_elem(void *data, int *ierr);
 //  static void get_coarse_elem_list(void *data, int num_gid_entries, int num_lid_entries, ZOLTAN_ID_PTR global_ids, ZOLTAN_ID_PTR local_ids, int *assigned, int *num_vert, ZOLTAN_ID_PTR vertices, int *in_order, ZOLTAN_ID_PTR in_vertex, ZOLTAN_ID_PTR out_vertex, int *ierr);
@@ -67,6 +87,23 @@ class ZoltanMeshPartitionPolicy : public MeshPartitionPolicy {
   ZoltanMeshPartitionPolicy();
   ZoltanMeshPartitionPolicy(string partitionerName);
   virtual void partitionMesh(Mesh *mesh, PartitionIndexType numPartitions);
+  
+  // ! Incremental mode starts from the current partition (refined cells' children stay with their parents' ranks).  If that
+  // ! partition's imbalance -- max rank load over average, counting cells or, with setWeightByCellCost(), summing
+  // ! Mesh::cellCost() -- is within imbalanceThreshold, it is kept and nothing migrates.  Otherwise, Zoltan's PHG repartitions
+  // ! (LB_APPROACH REPARTITION), trading cut size against the bytes CellDataMigration would ship for each moved cell.  Geometric
+  // ! partitioners don't know about the current distribution, so in this mode they are replaced by PHG graph repartitioning.
+  void setIncrementalRepartitioning(bool value, double imbalanceThreshold = 1.1);
+  // ! Zoltan's PHG_REPART_MULTIPLIER: weight of communication volume relative to migration cost (default 100); smaller values migrate less.
+  void setRepartitionMultiplier(double value);
+  // ! When true, rank 0 prints the imbalance and migration volume each time the mesh is partitioned.
+  void setReportMigration(bool value);
+  
+  // statistics from the most recent partitionMesh() call, summed over all ranks:
+  double imbalanceBeforePartitioning();
+  bool didRebalance();
+  long migratedCellCount();
+  long migratedBytes();
 };
 
 #endif
@@ -17,11 +17,15 @@
 #include "CamelliaCellTools.h"
 
 #include "BasisReconciliation.h"
+#include "LobattoHGRAD_LineBasis.h"
+#include "LobattoHGRAD_QuadBasis.h"
 
 #include "BasisCache.h"
 
 #include "SerialDenseWrapper.h"
 
+#include <cstdio>
+
 namespace {
   TEUCHOS_UNIT_TEST( BasisReconciliation, MapFineSubcellPointsToCoarseSubcell_Vertex)
   {
@@ -701,4 +705,94 @@ namespace {
       }
     }
   }
+  
+  TEUCHOS_UNIT_TEST( BasisReconciliation, SharedCacheReuseAndPersistence )
+  {
+    CellTopoPtr quadTopo = CellTopology::quad();
+    BasisPtr coarseBasis = BasisFactory::basisFactory()->getBasis(2, quadTopo, Camellia::FUNCTION_SPACE_HGRAD);
+    BasisPtr fineBasis = BasisFactory::basisFactory()->getBasis(3, quadTopo, Camellia::FUNCTION_SPACE_HGRAD);
+    
+    RefinementBranch oneRefinement;
+    RefinementPatternPtr regularRefinement = RefinementPattern::regularRefinementPattern(quadTopo);
+    oneRefinement.push_back( make_pair(regularRefinement.get(), 2) );
+    
+    unsigned vertexNodePermutation = 0;
+    long long defaultCapacity = BasisReconciliation::sharedCacheCapacity();
+    BasisReconciliation::clearSharedCache();
+    
+    BasisReconciliation br1;
+    SubBasisReconciliationWeights weights = br1.constrainedWeights(fineBasis, oneRefinement, coarseBasis, vertexNodePermutation);
+    TEST_EQUALITY(BasisReconciliation::sharedCacheEntryCount(), 1);
+    
+    // a second instance (as for another mesh or GMG level) should find the weights in the shared cache
+    BasisReconciliation br2;
+    SubBasisReconciliationWeights weights2 = br2.constrainedWeights(fineBasis, oneRefinement, coarseBasis, vertexNodePermutation);
+    TEST_EQUALITY(BasisReconciliation::sharedCacheEntryCount(), 1);
+    TEST_COMPARE_FLOATING_ARRAYS(weights.weights, weights2.weights, 1e-15);
+    
+    // round trip through a file
+    string filePath = "BasisReconciliationSharedCacheTest.txt";
+    BasisReconciliation::saveSharedCache(filePath);
+    BasisReconciliation::clearSharedCache();
+    TEST_EQUALITY(BasisReconciliation::sharedCacheEntryCount(), 0);
+    TEST_EQUALITY(BasisReconciliation::sharedCacheSize(), 0); // the basis signatures go, too
+    BasisReconciliation::loadSharedCache(filePath);
+    remove(filePath.c_str());
+    TEST_EQUALITY(BasisReconciliation::sharedCacheEntryCount(), 1);
+    
+    BasisReconciliation br3;
+    SubBasisReconciliationWeights weights3 = br3.constrainedWeights(fineBasis, oneRefinement, coarseBasis, vertexNodePermutation);
+    TEST_EQUALITY(BasisReconciliation::sharedCacheEntryCount(), 1);
+    TEST_COMPARE_FLOATING_ARRAYS(weights.weights, weights3.weights, 1e-15);
+    TEST_ASSERT(weights.fineOrdinals == weights3.fineOrdinals);
+    TEST_ASSERT(weights.coarseOrdinals == weights3.coarseOrdinals);
+    
+    // shrinking the capacity evicts entries; instances that already hold the weights keep them
+    BasisReconciliation::setSharedCacheCapacity(1);
+    TEST_EQUALITY(BasisReconciliation::sharedCacheEntryCount(), 0);
+    TEST_EQUALITY(BasisReconciliation::sharedCacheSize(), 0);
+    SubBasisReconciliationWeights weights4 = br3.constrainedWeights(fineBasis, oneRefinement, coarseBasis, vertexNodePermutation);
+    TEST_COMPARE_FLOATING_ARRAYS(weights.weights, weights4.weights, 1e-15);
+    
+    BasisReconciliation::setSharedCacheCapacity(defaultCapacity);
+  }
+  
+  TEUCHOS_UNIT_TEST( BasisReconciliation, HierarchicalEmbedding_LobattoQuad )
+  {
+    // each coarse function should be the weighted sum of fine functions
+    bool conforming = false;
+    BasisPtr fineBasis = Teuchos::rcp( new LobattoHGRAD_QuadBasis<>(4, conforming) );
+    BasisPtr coarseBasis = Teuchos::rcp( new LobattoHGRAD_QuadBasis<>(2, conforming) );
+
+    SubBasisReconciliationWeights weights;
+    TEST_ASSERT(BasisReconciliation::hierarchicalEmbeddingWeights(fineBasis, coarseBasis, weights));
+    TEST_EQUALITY(weights.coarseOrdinals.size(), coarseBasis->getCardinality());
+
+    int numPoints = 3;
+    FieldContainer<double> refPoints(numPoints, 2);
+    refPoints(0,0) = -0.3; refPoints(0,1) =  0.7;
+    refPoints(1,0) =  0.5; refPoints(1,1) = -0.9;
+    refPoints(2,0) =  0.1; refPoints(2,1) =  0.2;
+    FieldContainer<double> fineValues(fineBasis->getCardinality(), numPoints);
+    FieldContainer<double> coarseValues(coarseBasis->getCardinality(), numPoints);
+    fineBasis->getValues(fineValues, refPoints, Intrepid::OPERATOR_VALUE);
+    coarseBasis->getValues(coarseValues, refPoints, Intrepid::OPERATOR_VALUE);
+
+    vector<int> fineOrdinals(weights.fineOrdinals.begin(), weights.fineOrdinals.end());
+    vector<int> coarseOrdinals(weights.coarseOrdinals.begin(), weights.coarseOrdinals.end());
+    double tol = 1e-14;
+    for (int j=0; j<coarseOrdinals.size(); j++) {
+      for (int pointOrdinal=0; pointOrdinal<numPoints; pointOrdinal++) {
+        double embeddedValue = 0;
+        for (int i=0; i<fineOrdinals.size(); i++) {
+          embeddedValue += weights.weights(i,j) * fineValues(fineOrdinals[i],pointOrdinal);
+        }
+        TEST_COMPARE(abs(embeddedValue - coarseValues(coarseOrdinals[j],pointOrdinal)), <, tol);
+      }
+    }
+
+    // bases from different families are not embedded
+    BasisPtr lineBasis = Teuchos::rcp( new LobattoHGRAD_LineBasis<>(2, conforming) );
+    TEST_ASSERT(!BasisReconciliation::hierarchicalEmbeddingWeights(fineBasis, lineBasis, weights));
+  }
 } // namespace
\ No newline at end of file
@@ -0,0 +1,380 @@
+//
+//  CondensedDofInterpreterTests.cpp
+//  Camellia
+//
+
+#include "BasisCache.h"
+#include "BC.h"
+#include "BF.h"
+#include "CondensedDofInterpreter.h"
+#include "DofOrdering.h"
+#include "MeshFactory.h"
+#include "PoissonFormulation.h"
+#include "RHS.h"
+#include "Solution.h"
+
+#include "Teuchos_UnitTestHarness.hpp"
+namespace {
+  // a 2x2 quad mesh for the Poisson formulation, optionally with the first cell refined (introducing hanging nodes)
+  MeshPtr poissonMesh(PoissonFormulation &form, bool refineFirstCell) {
+    int H1Order = 3, pToAddTest = 2;
+    MeshPtr mesh = MeshFactory::quadMesh(form.bf(), H1Order, pToAddTest, 1.0, 1.0, 2, 2);
+    if (refineFirstCell) {
+      set<GlobalIndexType> cellsToRefine;
+      cellsToRefine.insert(0);
+      mesh->hRefine(cellsToRefine, RefinementPattern::regularRefinementPatternQuad());
+    }
+    return mesh;
+  }
+
+  // largest entrywise difference between two containers of the same size
+  double maxDiff(const FieldContainer<double> &a, const FieldContainer<double> &b) {
+    double diff = 0;
+    for (int i=0; i<a.size(); i++) {
+      diff = max(diff, abs(a[i] - b[i]));
+    }
+    return diff;
+  }
+
+  // the given bilinear form, with each local stiffness matrix made nonsymmetric by adding relativePerturbation times its
+  // largest entry to its (0,1) entry
+  class NonsymmetricStiffnessBF : public BF {
+    double _relativePerturbation;
+  public:
+    NonsymmetricStiffnessBF(const BF &bf, double relativePerturbation) : BF(bf) {
+      _relativePerturbation = relativePerturbation;
+    }
+    void localStiffnessMatrixAndRHS(FieldContainer<double> &localStiffness, FieldContainer<double> &rhsVector,
+                                    IPPtr ip, BasisCachePtr ipBasisCache, RHSPtr rhs, BasisCachePtr basisCache) {
+      BF::localStiffnessMatrixAndRHS(localStiffness, rhsVector, ip, ipBasisCache, rhs, basisCache);
+      int numCells = localStiffness.dimension(0), n = localStiffness.dimension(1);
+      for (int cellOrdinal=0; cellOrdinal<numCells; cellOrdinal++) {
+        double maxEntry = 0;
+        for (int i=0; i<n; i++) {
+          for (int j=0; j<n; j++) {
+            maxEntry = max(maxEntry, abs(localStiffness(cellOrdinal,i,j)));
+          }
+        }
+        localStiffness(cellOrdinal,0,1) += _relativePerturbation * maxEntry;
+      }
+    }
+  };
+
+  TEUCHOS_UNIT_TEST( CondensedDofInterpreter, BatchCondensationMatchesCellwise )
+  {
+    // interpretLocalBatchData() condenses in the local dof ordering, before the mesh interprets the data;
+    // interpretLocalData() condenses the interpreted data.  On a mesh with hanging nodes, the two should agree.
+    int spaceDim = 2;
+    bool conformingTraces = true;
+    PoissonFormulation form(spaceDim,conformingTraces);
+    MeshPtr mesh = poissonMesh(form, true);
+
+    IPPtr ip = form.bf()->graphNorm();
+    RHSPtr rhs = RHS::rhs();
+    rhs->addTerm(1.0 * form.q());
+    LagrangeConstraints lagrangeConstraints;
+    set<int> fieldIDsToExclude;
+    bool storeLocalStiffnessMatrices = false;
+    CondensedDofInterpreter dofInterpreter(mesh.get(), ip, rhs, &lagrangeConstraints, fieldIDsToExclude, storeLocalStiffnessMatrices);
+
+    set<GlobalIndexType> myCellIDs = mesh->cellIDsInPartition();
+    vector<GlobalIndexType> cellIDs(myCellIDs.begin(), myCellIDs.end());
+    int numCells = cellIDs.size();
+    if (numCells == 0) return;
+    int numTrialDofs = mesh->getElementType(cellIDs[0])->trialOrderPtr->totalDofs();
+
+    FieldContainer<double> localStiffness(numCells,numTrialDofs,numTrialDofs), localLoad(numCells,numTrialDofs);
+    for (int cellOrdinal=0; cellOrdinal<numCells; cellOrdinal++) {
+      BasisCachePtr basisCache = BasisCache::basisCacheForCell(mesh, cellIDs[cellOrdinal]);
+      BasisCachePtr ipBasisCache = BasisCache::basisCacheForCell(mesh, cellIDs[cellOrdinal], true);
+      FieldContainer<double> cellStiffness(1,numTrialDofs,numTrialDofs), cellLoad(1,numTrialDofs);
+      form.bf()->localStiffnessMatrixAndRHS(cellStiffness, cellLoad, ip, ipBasisCache, rhs, basisCache);
+      for (int i=0; i<numTrialDofs; i++) {
+        localLoad(cellOrdinal,i) = cellLoad(0,i);
+        for (int j=0; j<numTrialDofs; j++) {
+          localStiffness(cellOrdinal,i,j) = cellStiffness(0,i,j);
+        }
+      }
+    }
+
+    vector< FieldContainer<double> > batchStiffness, batchLoad;
+    vector< FieldContainer<GlobalIndexType> > batchDofIndices;
+    dofInterpreter.interpretLocalBatchData(cellIDs, localStiffness, localLoad, batchStiffness, batchLoad, batchDofIndices);
+
+    double tol = 1e-10;
+    for (int cellOrdinal=0; cellOrdinal<numCells; cellOrdinal++) {
+      FieldContainer<double> cellStiffness(numTrialDofs,numTrialDofs), cellLoad(numTrialDofs);
+      for (int i=0; i<numTrialDofs; i++) {
+        cellLoad(i) = localLoad(cellOrdinal,i);
+        for (int j=0; j<numTrialDofs; j++) {
+          cellStiffness(i,j) = localStiffness(cellOrdinal,i,j);
+        }
+      }
+      FieldContainer<double> globalStiffness, globalLoad;
+      FieldContainer<GlobalIndexType> globalDofIndices;
+      dofInterpreter.interpretLocalData(cellIDs[cellOrdinal], cellStiffness, cellLoad, globalStiffness, globalLoad, globalDofIndices);
+
+      TEST_EQUALITY(batchDofIndices[cellOrdinal].size(), globalDofIndices.size());
+      if (batchDofIndices[cellOrdinal].size() != globalDofIndices.size()) continue;
+
+      for (int i=0; i<globalDofIndices.size(); i++) {
+        TEST_EQUALITY(batchDofIndices[cellOrdinal](i), globalDofIndices(i));
+      }
+      TEST_COMPARE(maxDiff(batchLoad[cellOrdinal], globalLoad), <, tol);
+      TEST_COMPARE(maxDiff(batchStiffness[cellOrdinal], globalStiffness), <, tol);
+    }
+  }
+
+  TEUCHOS_UNIT_TEST( CondensedDofInterpreter, LoadOnlyInterpretationMatchesFull )
+  {
+    // the load-only interpretLocalData() condenses the load against the stored (packed) stiffness, in the local dof ordering;
+    // on a mesh with hanging nodes, it should agree with the load condensed along with the stiffness
+    int spaceDim = 2;
+    bool conformingTraces = true;
+    PoissonFormulation form(spaceDim,conformingTraces);
+    MeshPtr mesh = poissonMesh(form, true);
+
+    IPPtr ip = form.bf()->graphNorm();
+    RHSPtr rhs = RHS::rhs();
+    rhs->addTerm(1.0 * form.q());
+    LagrangeConstraints lagrangeConstraints;
+    set<int> fieldIDsToExclude;
+    bool storeLocalStiffnessMatrices = true;
+    CondensedDofInterpreter dofInterpreter(mesh.get(), ip, rhs, &lagrangeConstraints, fieldIDsToExclude, storeLocalStiffnessMatrices);
+
+    double tol = 1e-10;
+    set<GlobalIndexType> myCellIDs = mesh->cellIDsInPartition();
+    for (set<GlobalIndexType>::iterator cellIDIt = myCellIDs.begin(); cellIDIt != myCellIDs.end(); cellIDIt++) {
+      GlobalIndexType cellID = *cellIDIt;
+      int numTrialDofs = mesh->getElementType(cellID)->trialOrderPtr->totalDofs();
+      BasisCachePtr basisCache = BasisCache::basisCacheForCell(mesh, cellID);
+      BasisCachePtr ipBasisCache = BasisCache::basisCacheForCell(mesh, cellID, true);
+      FieldContainer<double> cellStiffness(1,numTrialDofs,numTrialDofs), cellLoad(1,numTrialDofs);
+      form.bf()->localStiffnessMatrixAndRHS(cellStiffness, cellLoad, ip, ipBasisCache, rhs, basisCache);
+      cellStiffness.resize(numTrialDofs,numTrialDofs);
+      cellLoad.resize(numTrialDofs);
+
+      FieldContainer<double> globalStiffness, expectedLoad;
+      FieldContainer<GlobalIndexType> expectedDofIndices;
+      dofInterpreter.interpretLocalData(cellID, cellStiffness, cellLoad, globalStiffness, expectedLoad, expectedDofIndices);
+      dofInterpreter.storeLoadForCell(cellID, FieldContainer<double>(numTrialDofs)); // the load-only version should not read this
+
+      FieldContainer<double> globalLoad;
+      FieldContainer<GlobalIndexType> globalDofIndices;
+      dofInterpreter.interpretLocalData(cellID, cellLoad, globalLoad, globalDofIndices);
+
+      TEST_EQUALITY(globalDofIndices.size(), expectedDofIndices.size());
+      if (globalDofIndices.size() != expectedDofIndices.size()) continue;
+      for (int i=0; i<globalDofIndices.size(); i++) {
+        TEST_EQUALITY(globalDofIndices(i), expectedDofIndices(i));
+      }
+      TEST_COMPARE(maxDiff(globalLoad, expectedLoad), <, tol);
+      TEST_COMPARE(maxDiff(dofInterpreter.storedLocalLoadForCell(cellID), cellLoad), <, tol);
+    }
+  }
+
+  TEUCHOS_UNIT_TEST( CondensedDofInterpreter, StoredFieldFactorizationsRecoverFields )
+  {
+    // recovering the fields from the stored Cholesky factors should give the same solution as recovering them from
+    // the local stiffness matrices, which are then not kept
+    int spaceDim = 2;
+    bool conformingTraces = true;
+    PoissonFormulation form(spaceDim,conformingTraces);
+    MeshPtr mesh = poissonMesh(form, true);
+
+    RHSPtr rhs = RHS::rhs();
+    rhs->addTerm(1.0 * form.q());
+    BCPtr bc = BC::bc();
+    bc->addDirichlet(form.phi_hat(), SpatialFilter::allSpace(), Function::zero());
+
+    SolutionPtr expectedSolution = Solution::solution(mesh, bc, rhs, form.bf()->graphNorm());
+    expectedSolution->setUseCondensedSolve(true);
+    expectedSolution->solve();
+
+    SolutionPtr solution = Solution::solution(mesh, bc, rhs, form.bf()->graphNorm());
+    solution->setStoreFieldFactorizations(true);
+    solution->setUseCondensedSolve(true);
+    solution->solve();
+
+    CondensedDofInterpreter* expectedDofInterpreter = dynamic_cast<CondensedDofInterpreter*>(expectedSolution->getDofInterpreter().get());
+    CondensedDofInterpreter* dofInterpreter = dynamic_cast<CondensedDofInterpreter*>(solution->getDofInterpreter().get());
+    TEST_ASSERT((dofInterpreter != NULL) && (expectedDofInterpreter != NULL));
+    if ((dofInterpreter == NULL) || (expectedDofInterpreter == NULL)) return;
+    TEST_ASSERT(dofInterpreter->getStoreFieldFactorizations());
+
+    set<GlobalIndexType> myCellIDs = mesh->cellIDsInPartition();
+    if (myCellIDs.size() > 0) {
+      TEST_COMPARE(dofInterpreter->fieldFactorizationStorageBytes(), >, 0);
+      TEST_COMPARE(dofInterpreter->localStiffnessStorageBytes(), <, expectedDofInterpreter->localStiffnessStorageBytes());
+    }
+
+    double tol = 1e-10;
+    for (set<GlobalIndexType>::iterator cellIDIt = myCellIDs.begin(); cellIDIt != myCellIDs.end(); cellIDIt++) {
+      FieldContainer<double> expectedCoefficients = expectedSolution->allCoefficientsForCellID(*cellIDIt);
+      FieldContainer<double> coefficients = solution->allCoefficientsForCellID(*cellIDIt);
+      TEST_EQUALITY(coefficients.size(), expectedCoefficients.size());
+      if (coefficients.size() != expectedCoefficients.size()) continue;
+      TEST_COMPARE(maxDiff(coefficients, expectedCoefficients), <, tol);
+    }
+  }
+
+  TEUCHOS_UNIT_TEST( CondensedDofInterpreter, StoredFieldFactorizationsFollowLoadChanges )
+  {
+    // once a cell's load changes, its stored factorization is stale: the recovered fields should satisfy the new field equations,
+    // with the stiffness (not kept alongside the factorization) recomputed
+    int spaceDim = 2;
+    bool conformingTraces = true;
+    PoissonFormulation form(spaceDim,conformingTraces);
+    MeshPtr mesh = poissonMesh(form, false);
+
+    RHSPtr rhs = RHS::rhs();
+    rhs->addTerm(1.0 * form.q());
+    BCPtr bc = BC::bc();
+    bc->addDirichlet(form.phi_hat(), SpatialFilter::allSpace(), Function::zero());
+
+    SolutionPtr solution = Solution::solution(mesh, bc, rhs, form.bf()->graphNorm());
+    solution->setUseCondensedSolve(true);
+    solution->setStoreFieldFactorizations(true);
+    solution->solve();
+    CondensedDofInterpreter* dofInterpreter = dynamic_cast<CondensedDofInterpreter*>(solution->getDofInterpreter().get());
+    TEST_ASSERT(dofInterpreter != NULL);
+    if (dofInterpreter == NULL) return;
+
+    set<GlobalIndexType> myCellIDs = mesh->cellIDsInPartition();
+    for (set<GlobalIndexType>::iterator cellIDIt = myCellIDs.begin(); cellIDIt != myCellIDs.end(); cellIDIt++) {
+      GlobalIndexType cellID = *cellIDIt;
+      DofOrderingPtr trialOrder = mesh->getElementType(cellID)->trialOrderPtr;
+      int numTrialDofs = trialOrder->totalDofs();
+
+      FieldContainer<double> load = dofInterpreter->storedLocalLoadForCell(cellID);
+      for (int i=0; i<load.size(); i++) {
+        load[i] += 1.0;
+      }
+      dofInterpreter->storeLoadForCell(cellID, load);
+
+      FieldContainer<double> coefficients(numTrialDofs);
+      dofInterpreter->interpretGlobalCoefficients(cellID, coefficients, *solution->getLHSVector());
+      FieldContainer<double> stiffness = dofInterpreter->storedLocalStiffnessForCell(cellID);
+
+      set<int> trialIDs = trialOrder->getVarIDs();
+      double maxResidual = 0, scale = 0;
+      for (set<int>::iterator trialIDIt = trialIDs.begin(); trialIDIt != trialIDs.end(); trialIDIt++) {
+        const vector<int>* sides = &trialOrder->getSidesForVarID(*trialIDIt);
+        for (vector<int>::const_iterator sideIt = sides->begin(); sideIt != sides->end(); sideIt++) {
+          if (!dofInterpreter->varDofsAreCondensible(*trialIDIt, *sideIt, trialOrder)) continue;
+          const vector<int>* fieldIndices = &trialOrder->getDofIndices(*trialIDIt, *sideIt);
+          for (vector<int>::const_iterator fieldIt = fieldIndices->begin(); fieldIt != fieldIndices->end(); fieldIt++) {
+            int i = *fieldIt;
+            double residual = -load(i);
+            double rowScale = abs(load(i));
+            for (int j=0; j<numTrialDofs; j++) {
+              residual += stiffness(i,j) * coefficients(j);
+              rowScale += abs(stiffness(i,j) * coefficients(j));
+            }
+            maxResidual = max(maxResidual, abs(residual));
+            scale = max(scale, rowScale);
+          }
+        }
+      }
+      TEST_COMPARE(maxResidual, <=, 1e-10 * scale);
+    }
+  }
+
+  TEUCHOS_UNIT_TEST( CondensedDofInterpreter, StoredStiffnessIsPacked )
+  {
+    // stored local stiffness matrices keep only their upper triangles; they should come back intact, in about half the memory
+    int spaceDim = 2;
+    bool conformingTraces = true;
+    PoissonFormulation form(spaceDim,conformingTraces);
+    MeshPtr mesh = poissonMesh(form, false);
+
+    IPPtr ip = form.bf()->graphNorm();
+    RHSPtr rhs = RHS::rhs();
+    rhs->addTerm(1.0 * form.q());
+    LagrangeConstraints lagrangeConstraints;
+    set<int> fieldIDsToExclude;
+    bool storeLocalStiffnessMatrices = true;
+    CondensedDofInterpreter dofInterpreter(mesh.get(), ip, rhs, &lagrangeConstraints, fieldIDsToExclude, storeLocalStiffnessMatrices);
+
+    set<GlobalIndexType> myCellIDs = mesh->cellIDsInPartition();
+    map<GlobalIndexType, FieldContainer<double> > expectedStiffness;
+    long long fullStorageBytes = 0;
+    for (set<GlobalIndexType>::iterator cellIDIt = myCellIDs.begin(); cellIDIt != myCellIDs.end(); cellIDIt++) {
+      GlobalIndexType cellID = *cellIDIt;
+      int numTrialDofs = mesh->getElementType(cellID)->trialOrderPtr->totalDofs();
+      BasisCachePtr basisCache = BasisCache::basisCacheForCell(mesh, cellID);
+      BasisCachePtr ipBasisCache = BasisCache::basisCacheForCell(mesh, cellID, true);
+      FieldContainer<double> cellStiffness(1,numTrialDofs,numTrialDofs), cellLoad(1,numTrialDofs);
+      form.bf()->localStiffnessMatrixAndRHS(cellStiffness, cellLoad, ip, ipBasisCache, rhs, basisCache);
+      cellStiffness.resize(numTrialDofs,numTrialDofs);
+      dofInterpreter.storeStiffnessForCell(cellID, cellStiffness);
+      expectedStiffness[cellID] = cellStiffness;
+      fullStorageBytes += numTrialDofs * numTrialDofs * sizeof(double);
+    }
+
+    double tol = 1e-10; // the computed stiffness is symmetric up to roundoff
+    for (set<GlobalIndexType>::iterator cellIDIt = myCellIDs.begin(); cellIDIt != myCellIDs.end(); cellIDIt++) {
+      GlobalIndexType cellID = *cellIDIt;
+      FieldContainer<double> storedStiffness = dofInterpreter.storedLocalStiffnessForCell(cellID);
+      FieldContainer<double>* stiffness = &expectedStiffness[cellID];
+      TEST_EQUALITY(storedStiffness.size(), stiffness->size());
+      if (storedStiffness.size() != stiffness->size()) continue;
+      TEST_COMPARE(maxDiff(storedStiffness, *stiffness), <, tol);
+    }
+    TEST_COMPARE(dofInterpreter.localStiffnessStorageBytes(), <=, 0.55 * fullStorageBytes);
+  }
+
+  TEUCHOS_UNIT_TEST( CondensedDofInterpreter, NonsymmetricStiffnessIsSymmetrized )
+  {
+    // a local stiffness matrix that is not symmetric (beyond isSymmetric()'s tolerance) is stored as its symmetric part;
+    // a condensed solve should go through, and agree with the uncondensed solve up to the size of the asymmetry
+    int spaceDim = 2;
+    bool conformingTraces = true;
+    PoissonFormulation form(spaceDim,conformingTraces);
+    double relativePerturbation = 1e-9;
+    BFPtr bf = Teuchos::rcp( new NonsymmetricStiffnessBF(*form.bf(), relativePerturbation) );
+    int H1Order = 3, pToAddTest = 2;
+    MeshPtr mesh = MeshFactory::quadMesh(bf, H1Order, pToAddTest, 1.0, 1.0, 2, 2);
+
+    IPPtr ip = form.bf()->graphNorm();
+    RHSPtr rhs = RHS::rhs();
+    rhs->addTerm(1.0 * form.q());
+    BCPtr bc = BC::bc();
+    bc->addDirichlet(form.phi_hat(), SpatialFilter::allSpace(), Function::zero());
+
+    SolutionPtr expectedSolution = Solution::solution(mesh, bc, rhs, ip);
+    expectedSolution->solve();
+
+    SolutionPtr solution = Solution::solution(mesh, bc, rhs, ip);
+    solution->setUseCondensedSolve(true);
+    TEST_NOTHROW(solution->solve());
+    CondensedDofInterpreter* dofInterpreter = dynamic_cast<CondensedDofInterpreter*>(solution->getDofInterpreter().get());
+    TEST_ASSERT(dofInterpreter != NULL);
+    if (dofInterpreter == NULL) return;
+
+    double solutionTol = 1e-6, stiffnessTol = 1e-10;
+    set<GlobalIndexType> myCellIDs = mesh->cellIDsInPartition();
+    for (set<GlobalIndexType>::iterator cellIDIt = myCellIDs.begin(); cellIDIt != myCellIDs.end(); cellIDIt++) {
+      GlobalIndexType cellID = *cellIDIt;
+      FieldContainer<double> expectedCoefficients = expectedSolution->allCoefficientsForCellID(cellID);
+      FieldContainer<double> coefficients = solution->allCoefficientsForCellID(cellID);
+      TEST_EQUALITY(coefficients.size(), expectedCoefficients.size());
+      if (coefficients.size() != expectedCoefficients.size()) continue;
+      TEST_COMPARE(maxDiff(coefficients, expectedCoefficients), <, solutionTol);
+
+      int numTrialDofs = mesh->getElementType(cellID)->trialOrderPtr->totalDofs();
+      BasisCachePtr basisCache = BasisCache::basisCacheForCell(mesh, cellID);
+      BasisCachePtr ipBasisCache = BasisCache::basisCacheForCell(mesh, cellID, true);
+      FieldContainer<double> cellStiffness(1,numTrialDofs,numTrialDofs), cellLoad(1,numTrialDofs);
+      bf->localStiffnessMatrixAndRHS(cellStiffness, cellLoad, ip, ipBasisCache, rhs, basisCache);
+      FieldContainer<double> symmetricPart(numTrialDofs,numTrialDofs);
+      for (int i=0; i<numTrialDofs; i++) {
+        for (int j=0; j<numTrialDofs; j++) {
+          symmetricPart(i,j) = 0.5 * (cellStiffness(0,i,j) + cellStiffness(0,j,i));
+        }
+      }
+      FieldContainer<double> storedStiffness = dofInterpreter->storedLocalStiffnessForCell(cellID);
+      TEST_COMPARE(maxDiff(storedStiffness, symmetricPart), <, stiffnessTol);
+    }
+  }
+} // namespace
@@ -6,13 +6,23 @@
 //
 //
 
+#include "BasisFactory.h"
+#include "BF.h"
+#include "BasisReconciliation.h"
 #include "CamelliaDebugUtility.h"
 #include "GMGOperator.h"
+#include "GMGSolver.h"
 #include "MeshFactory.h"
 #include "PoissonFormulation.h"
 #include "RHS.h"
+#include "VarFactory.h"
 
 #include "Teuchos_UnitTestHarness.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 namespace {
   TEUCHOS_UNIT_TEST( GMGOperator, ProlongationOperatorLine )
   {
@@ -324,4 +334,394 @@ namespace {
 //    }
     
   }
-} // namespace
\ No newline at end of file
+  
+  const int MAX_GMG_ITERATIONS = 200;
+
+  // Poisson with unit forcing and zero Dirichlet data on fineMesh, and a GMGSolver over coarseMeshes (finest first) that does a
+  // direct (KLU) solve on the coarsest.  Tests set the options they exercise on the returned solver, then call solution->solve().
+  Teuchos::RCP<GMGSolver> poissonGMGSolver(PoissonFormulation &form, MeshPtr fineMesh, vector<MeshPtr> coarseMeshes, SolutionPtr &solution) {
+    RHSPtr rhs = RHS::rhs();
+    rhs->addTerm(1.0 * form.q());
+    BCPtr bc = BC::bc();
+    bc->addDirichlet(form.phi_hat(), SpatialFilter::allSpace(), Function::zero());
+    solution = Solution::solution(fineMesh, bc, rhs, form.bf()->graphNorm());
+
+    double tol = 1e-8;
+    bool useStaticCondensation = false;
+    SolverPtr coarsestSolver = Solver::getSolver(Solver::KLU, true);
+    Teuchos::RCP<GMGSolver> gmgSolver = Teuchos::rcp( new GMGSolver(solution, coarseMeshes, MAX_GMG_ITERATIONS, tol, coarsestSolver, useStaticCondensation) );
+    gmgSolver->setAztecOutput(0);
+    return gmgSolver;
+  }
+
+  // as above, on a 2 x 2 coarse quad mesh and a fine mesh obtained by refining it uniformly numRefinements times
+  Teuchos::RCP<GMGSolver> twoLevelPoissonGMGSolver(PoissonFormulation &form, int numRefinements, SolutionPtr &solution) {
+    int H1Order = 2, pToAddTest = 2;
+    MeshPtr coarseMesh = MeshFactory::quadMesh(form.bf(), H1Order, pToAddTest, 1.0, 1.0, 2, 2);
+    MeshPtr fineMesh = coarseMesh->deepCopy();
+    for (int refinement=0; refinement<numRefinements; refinement++) {
+      fineMesh->hRefine(fineMesh->getActiveCellIDs(), RefinementPattern::regularRefinementPatternQuad());
+    }
+    return poissonGMGSolver(form, fineMesh, vector<MeshPtr>(1, coarseMesh), solution);
+  }
+
+  int twoLevelIterationCount(GMGOperator::CompositionType compositionType, bool useConjugateGradient) {
+    int spaceDim = 2;
+    bool conformingTraces = true;
+    PoissonFormulation form(spaceDim, conformingTraces);
+    SolutionPtr solution;
+    int numRefinements = 2;
+    Teuchos::RCP<GMGSolver> gmgSolver = twoLevelPoissonGMGSolver(form, numRefinements, solution);
+    gmgSolver->setUseConjugateGradient(useConjugateGradient);
+    gmgSolver->gmgOperator().setCompositionType(compositionType);
+    solution->solve(gmgSolver);
+    return gmgSolver->iterationCount();
+  }
+
+  // ultraweak convection-diffusion, -epsilon Laplacian(u) + div(beta u) = 1 with zero Dirichlet data, on the same two-level
+  // 2 x 2 quad hierarchy as twoLevelPoissonGMGSolver(); returns the GMRES iteration count for the given composition type
+  int twoLevelConvectionDiffusionIterationCount(GMGOperator::CompositionType compositionType, double epsilon) {
+    VarFactory vf;
+    VarPtr sigma = vf.fieldVar("sigma", VECTOR_L2);
+    VarPtr u = vf.fieldVar("u", L2);
+    VarPtr u_hat = vf.traceVar("u_hat");
+    VarPtr t_n = vf.fluxVar("t_n");
+    VarPtr v = vf.testVar("v", HGRAD);
+    VarPtr tau = vf.testVar("tau", HDIV);
+
+    FunctionPtr beta = Function::vectorize(Function::constant(1.0), Function::constant(0.5));
+
+    BFPtr bf = Teuchos::rcp( new BF(vf) );
+    bf->addTerm((1.0/epsilon) * sigma, tau);
+    bf->addTerm(u, tau->div());
+    bf->addTerm(-u_hat, tau->dot_normal());
+    bf->addTerm(sigma - beta * u, v->grad());
+    bf->addTerm(t_n, v);
+
+    RHSPtr rhs = RHS::rhs();
+    rhs->addTerm(1.0 * v);
+    BCPtr bc = BC::bc();
+    bc->addDirichlet(u_hat, SpatialFilter::allSpace(), Function::zero());
+
+    int H1Order = 2, pToAddTest = 2;
+    MeshPtr coarseMesh = MeshFactory::quadMesh(bf, H1Order, pToAddTest, 1.0, 1.0, 2, 2);
+    MeshPtr fineMesh = coarseMesh->deepCopy();
+    int numRefinements = 2;
+    for (int refinement=0; refinement<numRefinements; refinement++) {
+      fineMesh->hRefine(fineMesh->getActiveCellIDs(), RefinementPattern::regularRefinementPatternQuad());
+    }
+    SolutionPtr solution = Solution::solution(fineMesh, bc, rhs, bf->graphNorm());
+
+    double tol = 1e-8;
+    bool useStaticCondensation = false;
+    SolverPtr coarsestSolver = Solver::getSolver(Solver::KLU, true);
+    Teuchos::RCP<GMGSolver> gmgSolver = Teuchos::rcp( new GMGSolver(solution, vector<MeshPtr>(1, coarseMesh), MAX_GMG_ITERATIONS, tol, coarsestSolver, useStaticCondensation) );
+    gmgSolver->setAztecOutput(0);
+    gmgSolver->setUseConjugateGradient(false);
+    gmgSolver->gmgOperator().setCompositionType(compositionType);
+    solution->solve(gmgSolver);
+    return gmgSolver->iterationCount();
+  }
+
+  TEUCHOS_UNIT_TEST( GMGOperator, MultiplicativeCompositionConvergesFaster )
+  {
+    // symmetric multiplicative composition should need no more CG iterations than the additive scheme
+    bool useConjugateGradient = true;
+    int additiveIterations = twoLevelIterationCount(GMGOperator::ADDITIVE, useConjugateGradient);
+    int symmetricIterations = twoLevelIterationCount(GMGOperator::SYMMETRIC_MULTIPLICATIVE, useConjugateGradient);
+    TEST_COMPARE(symmetricIterations, <=, additiveIterations);
+
+    // likewise for the nonsymmetric multiplicative composition, with GMRES
+    useConjugateGradient = false;
+    additiveIterations = twoLevelIterationCount(GMGOperator::ADDITIVE, useConjugateGradient);
+    int multiplicativeIterations = twoLevelIterationCount(GMGOperator::MULTIPLICATIVE, useConjugateGradient);
+    TEST_COMPARE(multiplicativeIterations, <=, additiveIterations);
+
+    // on a convection-dominated, nonsymmetric problem, the multiplicative composition should need strictly fewer GMRES iterations
+    double epsilon = 1e-2;
+    additiveIterations = twoLevelConvectionDiffusionIterationCount(GMGOperator::ADDITIVE, epsilon);
+    multiplicativeIterations = twoLevelConvectionDiffusionIterationCount(GMGOperator::MULTIPLICATIVE, epsilon);
+    TEST_COMPARE(multiplicativeIterations, <, additiveIterations);
+    TEST_COMPARE(multiplicativeIterations, <, MAX_GMG_ITERATIONS);
+  }
+  
+  TEUCHOS_UNIT_TEST( GMGOperator, ChebyshevSmoother )
+  {
+    int spaceDim = 2;
+    bool conformingTraces = true;
+    PoissonFormulation form(spaceDim, conformingTraces);
+    SolutionPtr solution;
+    Teuchos::RCP<GMGSolver> gmgSolver = twoLevelPoissonGMGSolver(form, 1, solution);
+    gmgSolver->gmgOperator().setSmootherType(GMGOperator::CHEBYSHEV);
+    solution->solve(gmgSolver);
+
+    // D^-1 A is similar to an SPD matrix, so the power-method estimate of its largest eigenvalue should be positive
+    TEST_COMPARE(gmgSolver->gmgOperator().getChebyshevMaxEigenvalue(), >, 0.0);
+    TEST_COMPARE(gmgSolver->iterationCount(), <, MAX_GMG_ITERATIONS);
+  }
+
+  TEUCHOS_UNIT_TEST( GMGOperator, CellSchwarzSubdomains )
+  {
+    // Camellia additive Schwarz with one subdomain per cell (solved in parallel when OpenMP is enabled)
+    int spaceDim = 2;
+    bool conformingTraces = true;
+    PoissonFormulation form(spaceDim, conformingTraces);
+    for (int overlap=0; overlap<=1; overlap++) {
+      SolutionPtr solution;
+      Teuchos::RCP<GMGSolver> gmgSolver = twoLevelPoissonGMGSolver(form, 1, solution);
+      gmgSolver->gmgOperator().setSmootherType(GMGOperator::CAMELLIA_ADDITIVE_SCHWARZ);
+      gmgSolver->gmgOperator().setUseCellSchwarzSubdomains(true);
+      gmgSolver->gmgOperator().setSmootherOverlap(overlap);
+      solution->solve(gmgSolver);
+      TEST_COMPARE(gmgSolver->iterationCount(), <, MAX_GMG_ITERATIONS);
+
+#ifdef _OPENMP
+      // the smoother set up and applied on several threads should agree with the one set up and applied on one
+      int maxThreads = omp_get_max_threads();
+      omp_set_num_threads(max(maxThreads,2));
+      solution->solve(gmgSolver); // sets the smoother up again, on several threads
+      Teuchos::RCP<Epetra_CrsMatrix> threadedSmoother = gmgSolver->gmgOperator().getSmootherAsMatrix();
+      omp_set_num_threads(1);
+      solution->solve(gmgSolver); // and on one
+      Teuchos::RCP<Epetra_CrsMatrix> serialSmoother = gmgSolver->gmgOperator().getSmootherAsMatrix();
+      omp_set_num_threads(maxThreads);
+
+      double tol = 1e-10;
+      int maxEntries = max(threadedSmoother->MaxNumEntries(), serialSmoother->MaxNumEntries());
+      vector<double> values(maxEntries);
+      vector<GlobalIndexTypeToCast> indices(maxEntries);
+      double maxDiff = 0, maxValue = 0;
+      for (int localRow=0; localRow<serialSmoother->NumMyRows(); localRow++) {
+        GlobalIndexTypeToCast globalRow = serialSmoother->GRID(localRow);
+        map<GlobalIndexTypeToCast, double> differences;
+        int numEntries;
+        serialSmoother->ExtractGlobalRowCopy(globalRow, maxEntries, numEntries, &values[0], &indices[0]);
+        for (int i=0; i<numEntries; i++) {
+          differences[indices[i]] += values[i];
+          maxValue = max(maxValue, abs(values[i]));
+        }
+        threadedSmoother->ExtractGlobalRowCopy(globalRow, maxEntries, numEntries, &values[0], &indices[0]);
+        for (int i=0; i<numEntries; i++) {
+          differences[indices[i]] -= values[i];
+        }
+        for (map<GlobalIndexTypeToCast, double>::iterator entryIt = differences.begin(); entryIt != differences.end(); entryIt++) {
+          maxDiff = max(maxDiff, abs(entryIt->second));
+        }
+      }
+      TEST_COMPARE(maxDiff, <=, tol * maxValue);
+#endif
+    }
+  }
+
+  TEUCHOS_UNIT_TEST( GMGOperator, CoarseFactorizationReuse )
+  {
+    // re-solving with an unchanged fine matrix gives an unchanged coarse stiffness matrix: with a positive tolerance,
+    // the factorization should be kept; with zero tolerance, only the numeric factorization redone.  Either way, the
+    // preconditioner, and therefore the iteration count, should be unchanged.
+    int spaceDim = 2;
+    bool conformingTraces = true;
+    PoissonFormulation form(spaceDim, conformingTraces);
+    SolutionPtr solution;
+    Teuchos::RCP<GMGSolver> gmgSolver = twoLevelPoissonGMGSolver(form, 1, solution);
+
+    bool reuseSymbolicFactorization = true;
+    double numericReuseTolerance = 1e-10;
+    gmgSolver->gmgOperator().setCoarseFactorizationReuse(reuseSymbolicFactorization, numericReuseTolerance);
+
+    solution->solve(gmgSolver);
+    TEST_EQUALITY(gmgSolver->gmgOperator().getCoarseFactorizationReuse(), GMGOperator::FULL_FACTORIZATION);
+    int firstIterationCount = gmgSolver->iterationCount();
+
+    solution->solve(gmgSolver);
+    TEST_EQUALITY(gmgSolver->gmgOperator().getCoarseFactorizationReuse(), GMGOperator::NO_FACTORIZATION);
+    TEST_EQUALITY(gmgSolver->iterationCount(), firstIterationCount);
+
+    numericReuseTolerance = 0.0;
+    gmgSolver->gmgOperator().setCoarseFactorizationReuse(reuseSymbolicFactorization, numericReuseTolerance);
+    solution->solve(gmgSolver);
+    TEST_EQUALITY(gmgSolver->gmgOperator().getCoarseFactorizationReuse(), GMGOperator::NUMERIC_FACTORIZATION);
+    TEST_EQUALITY(gmgSolver->iterationCount(), firstIterationCount);
+
+    // changing the test norm changes the values, but not the sparsity pattern, of the coarse stiffness matrix: only the
+    // numeric factorization should be redone, and the iteration count should match that of a freshly constructed solver
+    numericReuseTolerance = 1e-10;
+    gmgSolver->gmgOperator().setCoarseFactorizationReuse(reuseSymbolicFactorization, numericReuseTolerance);
+    double weightForL2TestTerms = 2.0;
+    solution->setIP(form.bf()->graphNorm(weightForL2TestTerms));
+    solution->solve(gmgSolver);
+    TEST_EQUALITY(gmgSolver->gmgOperator().getCoarseFactorizationReuse(), GMGOperator::NUMERIC_FACTORIZATION);
+
+    SolutionPtr freshSolution;
+    Teuchos::RCP<GMGSolver> freshGMGSolver = twoLevelPoissonGMGSolver(form, 1, freshSolution);
+    freshSolution->setIP(form.bf()->graphNorm(weightForL2TestTerms));
+    freshSolution->solve(freshGMGSolver);
+    TEST_EQUALITY(gmgSolver->iterationCount(), freshGMGSolver->iterationCount());
+
+    // after refining the fine mesh, the coarse stiffness matrix is recomputed with the new prolongation operator; the old
+    // factorization must not be kept, and again the iteration count should match that of a freshly constructed solver
+    MeshPtr fineMesh = solution->mesh();
+    set<GlobalIndexType> cellsToRefine;
+    cellsToRefine.insert(*fineMesh->getActiveCellIDs().begin());
+    fineMesh->hRefine(cellsToRefine, RefinementPattern::regularRefinementPatternQuad());
+    gmgSolver->setFineMesh(fineMesh, solution->getPartitionMap());
+    solution->solve(gmgSolver);
+    TEST_INEQUALITY(gmgSolver->gmgOperator().getCoarseFactorizationReuse(), GMGOperator::NO_FACTORIZATION);
+
+    MeshPtr coarseMesh = gmgSolver->gmgOperator().getCoarseSolution()->mesh();
+    freshGMGSolver = poissonGMGSolver(form, fineMesh, vector<MeshPtr>(1, coarseMesh), freshSolution);
+    freshSolution->setIP(form.bf()->graphNorm(weightForL2TestTerms));
+    freshSolution->solve(freshGMGSolver);
+    TEST_EQUALITY(gmgSolver->iterationCount(), freshGMGSolver->iterationCount());
+  }
+
+  // sets the shared BasisFactory's quad HGRAD family for the lifetime of the object, restoring the previous choice on destruction
+  class QuadHGradFamilyChoice {
+    bool _previouslyUsedLobatto;
+  public:
+    QuadHGradFamilyChoice(bool useLobatto) {
+      _previouslyUsedLobatto = BasisFactory::basisFactory()->useLobattoForQuadHGrad();
+      BasisFactory::basisFactory()->setUseLobattoForQuadHGrad(useLobatto);
+    }
+    ~QuadHGradFamilyChoice() {
+      BasisFactory::basisFactory()->setUseLobattoForQuadHGrad(_previouslyUsedLobatto);
+    }
+  };
+
+  // fills dense(fineOrdinal, coarseOrdinal) from the sparse weights
+  void denseWeights(const SubBasisReconciliationWeights &weights, FieldContainer<double> &dense) {
+    vector<int> fineOrdinals(weights.fineOrdinals.begin(), weights.fineOrdinals.end());
+    vector<int> coarseOrdinals(weights.coarseOrdinals.begin(), weights.coarseOrdinals.end());
+    for (int i=0; i<fineOrdinals.size(); i++) {
+      for (int j=0; j<coarseOrdinals.size(); j++) {
+        dense(fineOrdinals[i],coarseOrdinals[j]) = weights.weights(i,j);
+      }
+    }
+  }
+
+  TEUCHOS_UNIT_TEST( GMGOperator, PMultigridHierarchy )
+  {
+    // a single coarse cell, so that there is no h-hierarchy; the p-hierarchy has H1 orders 4 -> 2 -> 1
+    // use the hierarchical (Lobatto) quad HGRAD bases, whose p-coarsening is an embedding
+    QuadHGradFamilyChoice lobattoChoice(true);
+    BasisFactoryPtr basisFactory = BasisFactory::basisFactory();
+
+    // the embedding weights should agree with those the nodal interpolation computes
+    int H1Orders[3] = {4, 2, 1};
+    double tol = 1e-12;
+    BasisReconciliation basisReconciliation;
+    for (int level=0; level<2; level++) {
+      BasisPtr fineBasis = basisFactory->getBasis(H1Orders[level], shards::Quadrilateral<4>::key, Camellia::FUNCTION_SPACE_HGRAD);
+      BasisPtr coarseBasis = basisFactory->getBasis(H1Orders[level+1], shards::Quadrilateral<4>::key, Camellia::FUNCTION_SPACE_HGRAD);
+      SubBasisReconciliationWeights embeddingWeights;
+      TEST_ASSERT(BasisReconciliation::hierarchicalEmbeddingWeights(fineBasis, coarseBasis, embeddingWeights));
+      SubBasisReconciliationWeights interpolationWeights = basisReconciliation.constrainedWeights(fineBasis, coarseBasis, 0);
+
+      FieldContainer<double> embedding(fineBasis->getCardinality(), coarseBasis->getCardinality());
+      FieldContainer<double> interpolation(fineBasis->getCardinality(), coarseBasis->getCardinality());
+      denseWeights(embeddingWeights, embedding);
+      denseWeights(interpolationWeights, interpolation);
+      double maxDiff = 0;
+      for (int i=0; i<embedding.size(); i++) {
+        maxDiff = max(maxDiff, abs(embedding[i] - interpolation[i]));
+      }
+      TEST_COMPARE(maxDiff, <, tol);
+    }
+
+    int spaceDim = 2;
+    bool conformingTraces = true;
+    PoissonFormulation form(spaceDim, conformingTraces);
+    int H1Order = 4, pToAddTest = 2;
+    MeshPtr mesh = MeshFactory::quadMesh(form.bf(), H1Order, pToAddTest, 1.0, 1.0, 1, 1);
+
+    vector<MeshPtr> coarseMeshes = GMGSolver::pCoarsenedMeshes(mesh);
+    TEST_EQUALITY(coarseMeshes.size(), 2);
+    if (coarseMeshes.size() != 2) return;
+    GlobalIndexType cellID = *mesh->getActiveCellIDs().begin();
+    TEST_EQUALITY(coarseMeshes[0]->globalDofAssignment()->getH1Order(cellID), 2);
+    TEST_EQUALITY(coarseMeshes[1]->globalDofAssignment()->getH1Order(cellID), 1);
+
+    SolutionPtr solution;
+    Teuchos::RCP<GMGSolver> gmgSolver = poissonGMGSolver(form, mesh, coarseMeshes, solution);
+    TEST_EQUALITY(gmgSolver->gmgOperator().levelCount(), 3);
+    solution->solve(gmgSolver);
+    TEST_COMPARE(gmgSolver->iterationCount(), <, MAX_GMG_ITERATIONS);
+  }
+
+  TEUCHOS_UNIT_TEST( GMGOperator, PMultigridProlongationEmbedsH1Field )
+  {
+    // the Poisson fields above are L2, so the Lobatto HGRAD embedding only shows up in P through the traces.  Use a primal
+    // formulation, whose field u is H1, and check that on a single cell P's rows for u are exactly the embedding weights
+    QuadHGradFamilyChoice lobattoChoice(true);
+
+    VarFactory vf;
+    VarPtr u = vf.fieldVar("u", HGRAD);
+    VarPtr sigma_n = vf.fluxVar("sigma_n");
+    VarPtr v = vf.testVar("v", HGRAD);
+    BFPtr bf = Teuchos::rcp( new BF(vf) );
+    bf->addTerm(u->grad(), v->grad());
+    bf->addTerm(-sigma_n, v);
+    IPPtr ip = bf->graphNorm();
+
+    int H1Order = 4, pToAddTest = 2;
+    MeshPtr fineMesh = MeshFactory::quadMesh(bf, H1Order, pToAddTest, 1.0, 1.0, 1, 1);
+    vector<MeshPtr> coarseMeshes = GMGSolver::pCoarsenedMeshes(fineMesh);
+    TEST_COMPARE(coarseMeshes.size(), >, 0);
+    if (coarseMeshes.size() == 0) return;
+    MeshPtr coarseMesh = coarseMeshes[0];
+    GlobalIndexType cellID = *fineMesh->getActiveCellIDs().begin();
+
+    SolutionPtr fineSoln = Solution::solution(fineMesh);
+    fineSoln->setIP(ip);
+    BCPtr bc = BC::bc();
+    SolverPtr coarseSolver = Solver::getSolver(Solver::KLU, true);
+    bool useStaticCondensation = false;
+    bool fineSolverUsesDiagonalScaling = false;
+    GMGOperator gmgOperator(bc,coarseMesh,ip,fineMesh,fineSoln->getDofInterpreter(),
+                            fineSoln->getPartitionMap(),coarseSolver, useStaticCondensation, fineSolverUsesDiagonalScaling);
+    Teuchos::RCP<Epetra_CrsMatrix> P = gmgOperator.constructProlongationOperator();
+
+    // distinct coarse coefficients, so that each column of P's u block is seen
+    SolutionPtr coarseSoln = Solution::solution(coarseMesh);
+    coarseSoln->setIP(ip);
+    coarseSoln->initializeLHSVector();
+    Teuchos::RCP<Epetra_FEVector> coarseSolutionVector = coarseSoln->getLHSVector();
+    for (int i=0; i<coarseSolutionVector->MyLength(); i++) {
+      (*coarseSolutionVector)[0][i] = 1.0 + coarseSolutionVector->Map().GID(i);
+    }
+    coarseSoln->importSolution();
+
+    fineSoln->initializeLHSVector();
+    fineSoln->getLHSVector()->PutScalar(0);
+    P->Multiply(false, *coarseSolutionVector, *fineSoln->getLHSVector());
+    fineSoln->importSolution();
+
+    set<GlobalIndexType> cellIDs = fineMesh->getActiveCellIDs();
+    coarseSoln->importSolutionForOffRankCells(cellIDs);
+    fineSoln->importSolutionForOffRankCells(cellIDs);
+    bool warnAboutOffRank = false;
+    FieldContainer<double> coarseCoefficients = coarseSoln->allCoefficientsForCellID(cellID, warnAboutOffRank);
+    FieldContainer<double> fineCoefficients = fineSoln->allCoefficientsForCellID(cellID, warnAboutOffRank);
+
+    DofOrderingPtr fineTrialOrder = fineMesh->getElementType(cellID)->trialOrderPtr;
+    DofOrderingPtr coarseTrialOrder = coarseMesh->getElementType(cellID)->trialOrderPtr;
+    BasisPtr fineBasis = fineTrialOrder->getBasis(u->ID());
+    BasisPtr coarseBasis = coarseTrialOrder->getBasis(u->ID());
+    SubBasisReconciliationWeights embeddingWeights;
+    TEST_ASSERT(BasisReconciliation::hierarchicalEmbeddingWeights(fineBasis, coarseBasis, embeddingWeights));
+    FieldContainer<double> embedding(fineBasis->getCardinality(), coarseBasis->getCardinality());
+    denseWeights(embeddingWeights, embedding);
+
+    vector<int> fineDofIndices = fineTrialOrder->getDofIndices(u->ID());
+    vector<int> coarseDofIndices = coarseTrialOrder->getDofIndices(u->ID());
+    double maxDiff = 0;
+    for (int i=0; i<fineBasis->getCardinality(); i++) {
+      double expectedValue = 0;
+      for (int j=0; j<coarseBasis->getCardinality(); j++) {
+        expectedValue += embedding(i,j) * coarseCoefficients(coarseDofIndices[j]);
+      }
+      maxDiff = max(maxDiff, abs(fineCoefficients(fineDofIndices[i]) - expectedValue));
+    }
+    double tol = 1e-12;
+    TEST_COMPARE(maxDiff, <, tol);
+  }
+} // namespace
@@ -0,0 +1,104 @@
+//
+//  LocalDofMapperTests.cpp
+//  Camellia
+//
+
+#include "GDAMinimumRule.h"
+#include "LocalDofMapper.h"
+#include "MeshFactory.h"
+#include "PoissonFormulation.h"
+
+#include "Teuchos_UnitTestHarness.hpp"
+namespace {
+  MeshPtr makeRefinedPoissonMesh() {
+    // a couple of refinements, so that some cells have hanging-node constraints (matrix sub-basis maps) and others do not
+    int spaceDim = 2;
+    bool conformingTraces = true;
+    PoissonFormulation form(spaceDim,conformingTraces);
+    int H1Order = 3, pToAddTest = 2;
+    MeshPtr mesh = MeshFactory::quadMesh(form.bf(), H1Order, pToAddTest, 1.0, 1.0, 2, 2);
+
+    set<GlobalIndexType> cellsToRefine;
+    cellsToRefine.insert(0);
+    mesh->hRefine(cellsToRefine, RefinementPattern::regularRefinementPatternQuad());
+    cellsToRefine.clear();
+    cellsToRefine.insert(*mesh->getActiveCellIDs().rbegin());
+    mesh->hRefine(cellsToRefine, RefinementPattern::regularRefinementPatternQuad());
+    return mesh;
+  }
+
+  TEUCHOS_UNIT_TEST( LocalDofMapper, MapLocalDataMatchesSubBasisMaps )
+  {
+    // mapLocalData() uses the compact representation of the map; mapLocalDataVolume() and mapLocalDataSide() apply the
+    // sub-basis maps directly.  Build the local-to-global matrix A column by column using the latter, and check that
+    // mapLocalData() gives A * x for vectors and A * L * A^T for matrices.
+    MeshPtr mesh = makeRefinedPoissonMesh();
+    GDAMinimumRule* minRule = dynamic_cast<GDAMinimumRule*>(mesh->globalDofAssignment().get());
+
+    double tol = 1e-12;
+    set<GlobalIndexType> activeCellIDs = mesh->getActiveCellIDs();
+    for (set<GlobalIndexType>::iterator cellIDIt = activeCellIDs.begin(); cellIDIt != activeCellIDs.end(); cellIDIt++) {
+      GlobalIndexType cellID = *cellIDIt;
+      CellConstraints constraints = minRule->getCellConstraints(cellID);
+      LocalDofMapperPtr dofMapper = minRule->getDofMapper(cellID, constraints);
+
+      int localDofCount = mesh->getElementType(cellID)->trialOrderPtr->totalDofs();
+      int sideCount = mesh->getElementType(cellID)->cellTopoPtr->getSideCount();
+      int globalDofCount = dofMapper->globalIndices().size();
+
+      FieldContainer<double> A(globalDofCount, localDofCount);
+      FieldContainer<double> unitVector(localDofCount);
+      for (int j=0; j<localDofCount; j++) {
+        unitVector(j) = 1.0;
+        FieldContainer<double> column(globalDofCount);
+        bool fittableGlobalDofsOnly = false;
+        dofMapper->mapLocalDataVolume(unitVector, column, fittableGlobalDofsOnly);
+        for (int sideOrdinal=0; sideOrdinal<sideCount; sideOrdinal++) {
+          dofMapper->mapLocalDataSide(unitVector, column, fittableGlobalDofsOnly, sideOrdinal);
+        }
+        for (int I=0; I<globalDofCount; I++) {
+          A(I,j) = column(I);
+        }
+        unitVector(j) = 0.0;
+      }
+
+      FieldContainer<double> localVector(localDofCount);
+      FieldContainer<double> localMatrix(localDofCount, localDofCount);
+      for (int i=0; i<localDofCount; i++) {
+        localVector(i) = sin(1.0 + i);
+        for (int j=0; j<localDofCount; j++) {
+          localMatrix(i,j) = cos(1.0 + i + 2.0 * j);
+        }
+      }
+
+      FieldContainer<double> mappedVector = dofMapper->mapLocalData(localVector, false);
+      FieldContainer<double> mappedMatrix = dofMapper->mapLocalData(localMatrix, false);
+
+      TEST_EQUALITY(mappedVector.dimension(0), globalDofCount);
+      TEST_EQUALITY(mappedMatrix.dimension(0), globalDofCount);
+
+      double maxDiff = 0;
+      for (int I=0; I<globalDofCount; I++) {
+        double expectedValue = 0;
+        for (int i=0; i<localDofCount; i++) {
+          expectedValue += A(I,i) * localVector(i);
+        }
+        maxDiff = max(maxDiff, abs(expectedValue - mappedVector(I)));
+        for (int J=0; J<globalDofCount; J++) {
+          double expectedEntry = 0;
+          for (int i=0; i<localDofCount; i++) {
+            if (A(I,i) == 0) continue;
+            for (int j=0; j<localDofCount; j++) {
+              expectedEntry += A(I,i) * localMatrix(i,j) * A(J,j);
+            }
+          }
+          maxDiff = max(maxDiff, abs(expectedEntry - mappedMatrix(I,J)));
+        }
+      }
+      TEST_ASSERT(maxDiff < tol);
+      if (maxDiff >= tol) {
+        cout << "cell " << cellID << ": maxDiff = " << maxDiff << endl;
+      }
+    }
+  }
+} // namespace
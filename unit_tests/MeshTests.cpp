@@ -7,9 +7,16 @@
 //
 
 #include "BasisCache.h"
+#include "BC.h"
+#include "GDAMinimumRule.h"
 #include "GlobalDofAssignment.h"
 #include "MeshFactory.h"
+#include "MeshPartitionPolicy.h"
+#include "MPIWrapper.h"
 #include "PoissonFormulation.h"
+#include "RHS.h"
+#include "Solution.h"
+#include "ZoltanMeshPartitionPolicy.h"
 
 #include <cstdio>
 
@@ -187,4 +194,446 @@ namespace {
     // delete the file we created
     remove(meshFile.c_str());
   }
+  
+  TEUCHOS_UNIT_TEST( Mesh, CellOrderingForDofsIsPermutation )
+  {
+    // each cell ordering should renumber the global dofs without changing how many each cell sees
+    int spaceDim = 2;
+    bool conformingTraces = true;
+    PoissonFormulation form(spaceDim,conformingTraces);
+    int H1Order = 2, pToAddTest = 2;
+    MeshPtr mesh = MeshFactory::quadMesh(form.bf(), H1Order, pToAddTest, 1.0, 1.0, 4, 4);
+    
+    set<GlobalIndexType> cellsToRefine;
+    cellsToRefine.insert(0);
+    cellsToRefine.insert(5);
+    mesh->hRefine(cellsToRefine, RefinementPattern::regularRefinementPatternQuad());
+    
+    GDAMinimumRule* minRule = dynamic_cast<GDAMinimumRule*>(mesh->globalDofAssignment().get());
+    TEST_ASSERT(minRule != NULL);
+    if (minRule == NULL) return;
+    
+    GlobalIndexType globalDofCount = mesh->globalDofCount();
+    set<GlobalIndexType> activeCellIDs = mesh->getActiveCellIDs();
+    map<GlobalIndexType, int> cellDofCounts;
+    for (set<GlobalIndexType>::iterator cellIDIt = activeCellIDs.begin(); cellIDIt != activeCellIDs.end(); cellIDIt++) {
+      cellDofCounts[*cellIDIt] = mesh->globalDofIndicesForCell(*cellIDIt).size();
+    }
+    
+    vector<GDAMinimumRule::CellOrderingForDofs> orderings;
+    orderings.push_back(GDAMinimumRule::HILBERT_CURVE_ORDERING);
+    orderings.push_back(GDAMinimumRule::REVERSE_CUTHILL_MCKEE_ORDERING);
+    orderings.push_back(GDAMinimumRule::CELL_ID_ORDERING);
+    
+    for (int i=0; i<orderings.size(); i++) {
+      minRule->setCellOrderingForDofs(orderings[i]);
+      TEST_EQUALITY(mesh->globalDofCount(), globalDofCount);
+      set<GlobalIndexType> allDofs;
+      for (set<GlobalIndexType>::iterator cellIDIt = activeCellIDs.begin(); cellIDIt != activeCellIDs.end(); cellIDIt++) {
+        set<GlobalIndexType> cellDofs = mesh->globalDofIndicesForCell(*cellIDIt);
+        TEST_EQUALITY(cellDofs.size(), cellDofCounts[*cellIDIt]);
+        allDofs.insert(cellDofs.begin(), cellDofs.end());
+      }
+      TEST_EQUALITY(allDofs.size(), globalDofCount);
+      if (allDofs.size() > 0) {
+        TEST_EQUALITY(*allDofs.rbegin(), globalDofCount - 1);
+      }
+    }
+  }
+  
+  TEUCHOS_UNIT_TEST( Mesh, CellOrderingForDofsUpdatesSolutions )
+  {
+    // changing the cell ordering renumbers the global dofs; a registered Solution's global coefficients should follow
+    int spaceDim = 2;
+    bool conformingTraces = true;
+    PoissonFormulation form(spaceDim,conformingTraces);
+    int H1Order = 2, pToAddTest = 2;
+    MeshPtr mesh = MeshFactory::quadMesh(form.bf(), H1Order, pToAddTest, 1.0, 1.0, 4, 4);
+    set<GlobalIndexType> cellsToRefine;
+    cellsToRefine.insert(5);
+    mesh->hRefine(cellsToRefine, RefinementPattern::regularRefinementPatternQuad());
+    
+    GDAMinimumRule* minRule = dynamic_cast<GDAMinimumRule*>(mesh->globalDofAssignment().get());
+    TEST_ASSERT(minRule != NULL);
+    if (minRule == NULL) return;
+    
+    RHSPtr rhs = RHS::rhs();
+    rhs->addTerm(1.0 * form.q());
+    BCPtr bc = BC::bc();
+    bc->addDirichlet(form.phi_hat(), SpatialFilter::allSpace(), Function::zero());
+    SolutionPtr solution = Solution::solution(mesh, bc, rhs, form.bf()->graphNorm());
+    solution->solve();
+    
+    set<GlobalIndexType> myCellIDs = mesh->cellIDsInPartition();
+    map<GlobalIndexType, FieldContainer<double> > expectedCoefficients;
+    for (set<GlobalIndexType>::iterator cellIDIt = myCellIDs.begin(); cellIDIt != myCellIDs.end(); cellIDIt++) {
+      expectedCoefficients[*cellIDIt] = solution->allCoefficientsForCellID(*cellIDIt);
+    }
+    
+    minRule->setCellOrderingForDofs(GDAMinimumRule::REVERSE_CUTHILL_MCKEE_ORDERING);
+    solution->importSolution(); // cell coefficients from the global vector, under the new numbering
+    
+    double tol = 1e-14;
+    for (set<GlobalIndexType>::iterator cellIDIt = myCellIDs.begin(); cellIDIt != myCellIDs.end(); cellIDIt++) {
+      FieldContainer<double> coefficients = solution->allCoefficientsForCellID(*cellIDIt);
+      TEST_EQUALITY(coefficients.size(), expectedCoefficients[*cellIDIt].size());
+      if (coefficients.size() != expectedCoefficients[*cellIDIt].size()) continue;
+      double maxDiff = 0;
+      for (int i=0; i<coefficients.size(); i++) {
+        maxDiff = max(maxDiff, abs(coefficients[i] - expectedCoefficients[*cellIDIt][i]));
+      }
+      TEST_COMPARE(maxDiff, <, tol);
+    }
+  }
+  
+  TEUCHOS_UNIT_TEST( Mesh, GlobalDofIndicesForAllActiveCells )
+  {
+    // rebuildLookups() makes global dof indices available only near our own cells; after importCellDofOffsets(), they should be
+    // available for every active cell, and between them cover all the global dofs
+    int spaceDim = 2;
+    bool conformingTraces = true;
+    PoissonFormulation form(spaceDim,conformingTraces);
+    int H1Order = 2, pToAddTest = 2;
+    MeshPtr mesh = MeshFactory::quadMesh(form.bf(), H1Order, pToAddTest, 1.0, 1.0, 4, 4);
+    set<GlobalIndexType> cellsToRefine;
+    cellsToRefine.insert(5);
+    mesh->hRefine(cellsToRefine, RefinementPattern::regularRefinementPatternQuad());
+    
+    set<GlobalIndexType> activeCellIDs = mesh->getActiveCellIDs();
+    mesh->globalDofAssignment()->importCellDofOffsets(activeCellIDs);
+    
+    GlobalIndexType globalDofCount = mesh->globalDofAssignment()->globalDofCount();
+    set<GlobalIndexType> globalDofIndices;
+    for (set<GlobalIndexType>::iterator cellIDIt = activeCellIDs.begin(); cellIDIt != activeCellIDs.end(); cellIDIt++) {
+      set<GlobalIndexType> cellDofIndices = mesh->globalDofAssignment()->globalDofIndicesForCell(*cellIDIt);
+      globalDofIndices.insert(cellDofIndices.begin(), cellDofIndices.end());
+    }
+    TEST_EQUALITY(globalDofIndices.size(), globalDofCount);
+    if (globalDofIndices.size() > 0) {
+      TEST_EQUALITY(*globalDofIndices.rbegin(), globalDofCount - 1);
+    }
+    
+    // importGlobalSolution() interprets every active cell; our own cells should get the same coefficients as from importSolution()
+    RHSPtr rhs = RHS::rhs();
+    rhs->addTerm(1.0 * form.q());
+    BCPtr bc = BC::bc();
+    bc->addDirichlet(form.phi_hat(), SpatialFilter::allSpace(), Function::zero());
+    SolutionPtr solution = Solution::solution(mesh, bc, rhs, form.bf()->graphNorm());
+    solution->solve();
+    
+    set<GlobalIndexType> myCellIDs = mesh->cellIDsInPartition();
+    map<GlobalIndexType, FieldContainer<double> > expectedCoefficients;
+    for (set<GlobalIndexType>::iterator cellIDIt = myCellIDs.begin(); cellIDIt != myCellIDs.end(); cellIDIt++) {
+      expectedCoefficients[*cellIDIt] = solution->allCoefficientsForCellID(*cellIDIt);
+    }
+    
+    solution->importGlobalSolution();
+    
+    double tol = 1e-14;
+    for (set<GlobalIndexType>::iterator cellIDIt = myCellIDs.begin(); cellIDIt != myCellIDs.end(); cellIDIt++) {
+      FieldContainer<double> coefficients = solution->allCoefficientsForCellID(*cellIDIt);
+      TEST_EQUALITY(coefficients.size(), expectedCoefficients[*cellIDIt].size());
+      if (coefficients.size() != expectedCoefficients[*cellIDIt].size()) continue;
+      double maxDiff = 0;
+      for (int i=0; i<coefficients.size(); i++) {
+        maxDiff = max(maxDiff, abs(coefficients[i] - expectedCoefficients[*cellIDIt][i]));
+      }
+      TEST_COMPARE(maxDiff, <, tol);
+    }
+  }
+  
+  TEUCHOS_UNIT_TEST( Mesh, LocalRefinementMatchesFreshDofAssignment )
+  {
+    // refinements only invalidate cached constraints near the refined cells; check that the resulting global dofs
+    // agree with those of a mesh whose dof assignment was built from scratch on the same topology
+    int spaceDim = 2;
+    bool conformingTraces = true;
+    PoissonFormulation form(spaceDim,conformingTraces);
+    int H1Order = 2, pToAddTest = 2;
+    MeshPtr mesh = MeshFactory::quadMesh(form.bf(), H1Order, pToAddTest, 1.0, 1.0, 4, 4);
+    
+    int numRefinements = 3;
+    for (int refinement=0; refinement<numRefinements; refinement++) {
+      // refine the lowest-numbered active cell, so that later refinements land next to earlier ones
+      set<GlobalIndexType> cellsToRefine;
+      cellsToRefine.insert(*mesh->getActiveCellIDs().begin());
+      mesh->hRefine(cellsToRefine, RefinementPattern::regularRefinementPatternQuad());
+    }
+    
+    MeshPtr freshMesh = Teuchos::rcp( new Mesh(mesh->getTopology()->deepCopy(), form.bf(), H1Order, pToAddTest) );
+    
+    TEST_EQUALITY(freshMesh->globalDofCount(), mesh->globalDofCount());
+    set<GlobalIndexType> activeCellIDs = mesh->getActiveCellIDs();
+    for (set<GlobalIndexType>::iterator cellIDIt = activeCellIDs.begin(); cellIDIt != activeCellIDs.end(); cellIDIt++) {
+      set<GlobalIndexType> dofIndices = mesh->globalDofIndicesForCell(*cellIDIt);
+      set<GlobalIndexType> freshDofIndices = freshMesh->globalDofIndicesForCell(*cellIDIt);
+      vector<GlobalIndexType> dofIndicesVector(dofIndices.begin(), dofIndices.end());
+      vector<GlobalIndexType> freshDofIndicesVector(freshDofIndices.begin(), freshDofIndices.end());
+      TEST_COMPARE_ARRAYS(dofIndicesVector, freshDofIndicesVector);
+    }
+  }
+  
+  TEUCHOS_UNIT_TEST( Mesh, PartitionByCellCostReducesImbalance )
+  {
+    // p-refine the first half of the cells, so that partitions with equal cell counts carry very different assembly work
+    int spaceDim = 2;
+    bool conformingTraces = true;
+    PoissonFormulation form(spaceDim,conformingTraces);
+    int H1Order = 2, pToAddTest = 2;
+    MeshPtr mesh = MeshFactory::quadMesh(form.bf(), H1Order, pToAddTest, 1.0, 1.0, 8, 8);
+    
+    set<GlobalIndexType> activeCellIDs = mesh->getActiveCellIDs();
+    set<GlobalIndexType> cellsToPRefine;
+    for (set<GlobalIndexType>::iterator cellIDIt = activeCellIDs.begin(); cellIDIt != activeCellIDs.end(); cellIDIt++) {
+      if (cellsToPRefine.size() < activeCellIDs.size() / 2) cellsToPRefine.insert(*cellIDIt);
+    }
+    int pToAdd = 3;
+    mesh->pRefine(cellsToPRefine, pToAdd);
+    
+    GlobalIndexType refinedCellID = *cellsToPRefine.begin(), unrefinedCellID = *activeCellIDs.rbegin();
+    TEST_ASSERT(mesh->cellCost(refinedCellID) > 4.0 * mesh->cellCost(unrefinedCellID));
+    
+    int numPartitions = 4;
+    vector< set<GlobalIndexType> > countPartitions = MeshPartitionPolicy::contiguousPartitions(mesh.get(), numPartitions, false);
+    vector< set<GlobalIndexType> > costPartitions = MeshPartitionPolicy::contiguousPartitions(mesh.get(), numPartitions, true);
+    
+    set<GlobalIndexType> partitionedCellIDs;
+    for (int partitionNumber=0; partitionNumber<numPartitions; partitionNumber++) {
+      partitionedCellIDs.insert(costPartitions[partitionNumber].begin(), costPartitions[partitionNumber].end());
+    }
+    TEST_EQUALITY(partitionedCellIDs.size(), activeCellIDs.size());
+    
+    double countImbalance = MeshPartitionPolicy::costImbalance(mesh.get(), countPartitions);
+    double costImbalance = MeshPartitionPolicy::costImbalance(mesh.get(), costPartitions);
+    TEST_ASSERT(countImbalance > 1.5);
+    TEST_ASSERT(costImbalance < 1.25);
+    TEST_ASSERT(costImbalance < countImbalance);
+  }
+  
+  TEUCHOS_UNIT_TEST( Mesh, RecordedCellCostDiscardedOnRefinement )
+  {
+    int spaceDim = 2;
+    bool conformingTraces = true;
+    PoissonFormulation form(spaceDim,conformingTraces);
+    int H1Order = 2, pToAddTest = 2;
+    MeshPtr mesh = MeshFactory::quadMesh(form.bf(), H1Order, pToAddTest, 1.0, 1.0, 2, 2);
+    
+    GlobalIndexType cellID = 0, otherCellID = 1;
+    double modeledCost = mesh->modeledCellCost(cellID);
+    TEST_FLOATING_EQUALITY(mesh->cellCost(cellID), modeledCost, 1e-15);
+    
+    // recorded costs take precedence, and unmeasured cells' modeled costs are rescaled to the same units
+    double recordedCost = 1e-3;
+    mesh->recordCellAssemblyCost(cellID, recordedCost);
+    TEST_FLOATING_EQUALITY(mesh->cellCost(cellID), recordedCost, 1e-15);
+    TEST_FLOATING_EQUALITY(mesh->cellCost(otherCellID), mesh->modeledCellCost(otherCellID) * recordedCost / modeledCost, 1e-12);
+    
+    set<GlobalIndexType> cellsToPRefine;
+    cellsToPRefine.insert(cellID);
+    mesh->pRefine(cellsToPRefine);
+    TEST_FLOATING_EQUALITY(mesh->cellCost(cellID), mesh->modeledCellCost(cellID), 1e-15);
+    TEST_ASSERT(mesh->modeledCellCost(cellID) > modeledCost);
+  }
+  
+  TEUCHOS_UNIT_TEST( Mesh, MeasuredCellCostsDrivePartitioning )
+  {
+    int spaceDim = 2;
+    bool conformingTraces = true;
+    PoissonFormulation form(spaceDim,conformingTraces);
+    int H1Order = 2, pToAddTest = 2;
+    MeshPtr mesh = MeshFactory::quadMesh(form.bf(), H1Order, pToAddTest, 1.0, 1.0, 8, 8);
+    
+    // assembly records a measured cost for each rank-local cell, replacing the modeled one
+    RHSPtr rhs = RHS::rhs();
+    rhs->addTerm(1.0 * form.q());
+    BCPtr bc = BC::bc();
+    bc->addDirichlet(form.phi_hat(), SpatialFilter::allSpace(), Function::zero());
+    SolutionPtr solution = Solution::solution(mesh, bc, rhs, form.bf()->graphNorm());
+    solution->solve();
+    
+    set<GlobalIndexType> myCellIDs = mesh->cellIDsInPartition();
+    for (set<GlobalIndexType>::iterator cellIDIt = myCellIDs.begin(); cellIDIt != myCellIDs.end(); cellIDIt++) {
+      // measured costs are in seconds, modeled costs in operation counts; for a 2D quad with these orders they are far apart
+      TEST_COMPARE(mesh->cellCost(*cellIDIt), <, 1e-3 * mesh->modeledCellCost(*cellIDIt));
+    }
+    
+    // the cells all have the same modeled cost; measurements that make the first half expensive should move the partition boundaries
+    set<GlobalIndexType> activeCellIDs = mesh->getActiveCellIDs();
+    int cellOrdinal = 0;
+    double cheapCost = 1e-4, expensiveCost = 20 * cheapCost;
+    for (set<GlobalIndexType>::iterator cellIDIt = activeCellIDs.begin(); cellIDIt != activeCellIDs.end(); cellIDIt++, cellOrdinal++) {
+      mesh->recordCellAssemblyCost(*cellIDIt, (cellOrdinal < activeCellIDs.size() / 2) ? expensiveCost : cheapCost);
+    }
+    
+    int numPartitions = 4;
+    vector< set<GlobalIndexType> > countPartitions = MeshPartitionPolicy::contiguousPartitions(mesh.get(), numPartitions, false);
+    vector< set<GlobalIndexType> > costPartitions = MeshPartitionPolicy::contiguousPartitions(mesh.get(), numPartitions, true);
+    TEST_ASSERT(costPartitions[0].size() < countPartitions[0].size());
+    TEST_ASSERT(MeshPartitionPolicy::costImbalance(mesh.get(), countPartitions) > 1.5);
+    TEST_ASSERT(MeshPartitionPolicy::costImbalance(mesh.get(), costPartitions) < 1.25);
+    
+    // the same through the (Zoltan) standard policy, across the MPI ranks
+    MeshPartitionPolicyPtr partitionPolicy = MeshPartitionPolicy::standardPartitionPolicy();
+    partitionPolicy->setWeightByCellCost(true);
+    mesh->setPartitionPolicy(partitionPolicy);
+    
+    int numRanks = Teuchos::GlobalMPISession::getNProc();
+    vector< set<GlobalIndexType> > zoltanPartitions(numRanks);
+    set<GlobalIndexType> partitionedCellIDs;
+    for (int rank=0; rank<numRanks; rank++) {
+      zoltanPartitions[rank] = mesh->globalDofAssignment()->cellsInPartition(rank);
+      partitionedCellIDs.insert(zoltanPartitions[rank].begin(), zoltanPartitions[rank].end());
+    }
+    TEST_EQUALITY(partitionedCellIDs.size(), activeCellIDs.size());
+    TEST_COMPARE(mesh->cellCost(*activeCellIDs.begin()), ==, expensiveCost); // repartitioning keeps the measurements
+    TEST_ASSERT(MeshPartitionPolicy::costImbalance(mesh.get(), zoltanPartitions) < 1.25);
+  }
+  
+  TEUCHOS_UNIT_TEST( Mesh, MeasuredCellCostsGiveConsistentPartitions )
+  {
+    // Each rank measures only its own cells, and the ranks' measurements differ.  Cost-weighted partitioning must still give every
+    // rank the same cell costs, and the same partitions.
+    int spaceDim = 2;
+    bool conformingTraces = true;
+    PoissonFormulation form(spaceDim,conformingTraces);
+    int H1Order = 2, pToAddTest = 2;
+    MeshPtr mesh = MeshFactory::quadMesh(form.bf(), H1Order, pToAddTest, 1.0, 1.0, 8, 8);
+    
+    int rank = Teuchos::GlobalMPISession::getRank();
+    int numRanks = Teuchos::GlobalMPISession::getNProc();
+    set<GlobalIndexType> myCellIDs = mesh->cellIDsInPartition();
+    int cellOrdinal = 0;
+    for (set<GlobalIndexType>::iterator cellIDIt = myCellIDs.begin(); cellIDIt != myCellIDs.end(); cellIDIt++, cellOrdinal++) {
+      if (cellOrdinal % 3 == 2) continue; // leave some cells to the (calibrated) model
+      mesh->recordCellAssemblyCost(*cellIDIt, 1e-4 * (rank + 1) * (cellOrdinal % 2 + 1));
+    }
+    
+    set<GlobalIndexType> activeCellIDs = mesh->getActiveCellIDs();
+    int numCells = activeCellIDs.size();
+    int numPartitions = 4;
+    vector< set<GlobalIndexType> > partitions = MeshPartitionPolicy::contiguousPartitions(mesh.get(), numPartitions, true);
+    
+    // a value agrees across ranks iff its sum is numRanks times it and its sum of squares is numRanks times its square
+    FieldContainer<double> costs(numCells, 2), partitionNumbers(numCells, 2);
+    cellOrdinal = 0;
+    for (set<GlobalIndexType>::iterator cellIDIt = activeCellIDs.begin(); cellIDIt != activeCellIDs.end(); cellIDIt++, cellOrdinal++) {
+      double cost = mesh->cellCost(*cellIDIt);
+      costs(cellOrdinal,0) = cost;
+      costs(cellOrdinal,1) = cost * cost;
+      for (int partitionNumber=0; partitionNumber<numPartitions; partitionNumber++) {
+        if (partitions[partitionNumber].find(*cellIDIt) != partitions[partitionNumber].end()) {
+          partitionNumbers(cellOrdinal,0) = partitionNumber;
+          partitionNumbers(cellOrdinal,1) = partitionNumber * partitionNumber;
+        }
+      }
+    }
+    FieldContainer<double> myCosts = costs, myPartitionNumbers = partitionNumbers;
+    MPIWrapper::entryWiseSum(costs);
+    MPIWrapper::entryWiseSum(partitionNumbers);
+    double tol = 1e-12;
+    for (cellOrdinal=0; cellOrdinal<numCells; cellOrdinal++) {
+      for (int i=0; i<2; i++) {
+        TEST_FLOATING_EQUALITY(costs(cellOrdinal,i), numRanks * myCosts(cellOrdinal,i), tol);
+        TEST_EQUALITY(partitionNumbers(cellOrdinal,i), numRanks * myPartitionNumbers(cellOrdinal,i));
+      }
+    }
+    
+    // through the (Zoltan) standard policy: every rank should agree on every cell's owner
+    MeshPartitionPolicyPtr partitionPolicy = MeshPartitionPolicy::standardPartitionPolicy();
+    partitionPolicy->setWeightByCellCost(true);
+    mesh->setPartitionPolicy(partitionPolicy);
+    FieldContainer<double> owners(numCells, 2);
+    cellOrdinal = 0;
+    for (set<GlobalIndexType>::iterator cellIDIt = activeCellIDs.begin(); cellIDIt != activeCellIDs.end(); cellIDIt++, cellOrdinal++) {
+      double owner = mesh->partitionForCellID(*cellIDIt);
+      owners(cellOrdinal,0) = owner;
+      owners(cellOrdinal,1) = owner * owner;
+    }
+    FieldContainer<double> myOwners = owners;
+    MPIWrapper::entryWiseSum(owners);
+    for (cellOrdinal=0; cellOrdinal<numCells; cellOrdinal++) {
+      for (int i=0; i<2; i++) {
+        TEST_EQUALITY(owners(cellOrdinal,i), numRanks * myOwners(cellOrdinal,i));
+      }
+    }
+  }
+  
+  TEUCHOS_UNIT_TEST( Mesh, IncrementalRepartitioningIsThresholdGated )
+  {
+    int numRanks = Teuchos::GlobalMPISession::getNProc();
+    if (numRanks == 1) return; // with one rank there is nothing to balance
+    
+    int spaceDim = 2;
+    bool conformingTraces = true;
+    PoissonFormulation form(spaceDim,conformingTraces);
+    int H1Order = 2, pToAddTest = 2;
+    MeshPtr mesh = MeshFactory::quadMesh(form.bf(), H1Order, pToAddTest, 1.0, 1.0, 8, 8);
+    
+    Teuchos::RCP<ZoltanMeshPartitionPolicy> partitionPolicy = Teuchos::rcp( new ZoltanMeshPartitionPolicy() );
+    double imbalanceThreshold = 1.5;
+    partitionPolicy->setIncrementalRepartitioning(true, imbalanceThreshold);
+    mesh->setPartitionPolicy(partitionPolicy);
+    
+    // refining one cell adds three cells to one rank: well within the threshold, so the partition is kept
+    GlobalIndexType refinedCellID = *mesh->getActiveCellIDs().begin();
+    set<GlobalIndexType> expectedCellIDs = mesh->cellIDsInPartition();
+    bool ownRefinedCell = (expectedCellIDs.find(refinedCellID) != expectedCellIDs.end());
+    expectedCellIDs.erase(refinedCellID);
+    set<GlobalIndexType> cellsToRefine;
+    cellsToRefine.insert(refinedCellID);
+    mesh->hRefine(cellsToRefine, RefinementPattern::regularRefinementPatternQuad());
+    if (ownRefinedCell) {
+      vector<IndexType> childIndices = mesh->getTopology()->getCell(refinedCellID)->getChildIndices();
+      expectedCellIDs.insert(childIndices.begin(), childIndices.end());
+    }
+    TEST_ASSERT(!partitionPolicy->didRebalance());
+    TEST_EQUALITY(partitionPolicy->migratedCellCount(), 0);
+    TEST_ASSERT(mesh->cellIDsInPartition() == expectedCellIDs);
+    
+    // refining all of rank 0's cells quadruples its load: over the threshold, so cells migrate
+    cellsToRefine = mesh->globalDofAssignment()->cellsInPartition(0);
+    mesh->hRefine(cellsToRefine, RefinementPattern::regularRefinementPatternQuad());
+    TEST_ASSERT(partitionPolicy->imbalanceBeforePartitioning() > imbalanceThreshold);
+    TEST_ASSERT(partitionPolicy->didRebalance());
+    TEST_COMPARE(partitionPolicy->migratedCellCount(), >, 0);
+    TEST_COMPARE(partitionPolicy->migratedBytes(), >, 0);
+    // the statistics are global, so all ranks should report the same
+    double migratedCellCount = partitionPolicy->migratedCellCount();
+    TEST_EQUALITY(MPIWrapper::sum(migratedCellCount), numRanks * migratedCellCount);
+    
+    vector< set<GlobalIndexType> > partitions(numRanks);
+    for (int rank=0; rank<numRanks; rank++) {
+      partitions[rank] = mesh->globalDofAssignment()->cellsInPartition(rank);
+    }
+    TEST_COMPARE(MeshPartitionPolicy::costImbalance(mesh.get(), partitions), <, imbalanceThreshold);
+  }
+  
+  TEUCHOS_UNIT_TEST( Mesh, TraceCouplingWeightsAreSymmetric )
+  {
+    // graph partitioners need symmetric edge weights; check this across hanging sides, too
+    int spaceDim = 2;
+    bool conformingTraces = true;
+    PoissonFormulation form(spaceDim,conformingTraces);
+    int H1Order = 2, pToAddTest = 2;
+    MeshPtr mesh = MeshFactory::quadMesh(form.bf(), H1Order, pToAddTest, 1.0, 1.0, 3, 3);
+    
+    set<GlobalIndexType> cellsToRefine;
+    cellsToRefine.insert(4); // the middle cell
+    mesh->hRefine(cellsToRefine, RefinementPattern::regularRefinementPatternQuad());
+    
+    set<GlobalIndexType> activeCellIDs = mesh->getActiveCellIDs();
+    int edgeCount = 0;
+    for (set<GlobalIndexType>::iterator cellIDIt = activeCellIDs.begin(); cellIDIt != activeCellIDs.end(); cellIDIt++) {
+      map<GlobalIndexType, int> weights = MeshPartitionPolicy::traceCouplingWeights(mesh.get(), *cellIDIt);
+      for (map<GlobalIndexType, int>::iterator weightIt = weights.begin(); weightIt != weights.end(); weightIt++) {
+        TEST_ASSERT(activeCellIDs.find(weightIt->first) != activeCellIDs.end());
+        TEST_ASSERT(weightIt->second > 0);
+        map<GlobalIndexType, int> neighborWeights = MeshPartitionPolicy::traceCouplingWeights(mesh.get(), weightIt->first);
+        TEST_EQUALITY(neighborWeights[*cellIDIt], weightIt->second);
+        edgeCount++;
+      }
+    }
+    // 3x3 grid has 12 interior sides; refining the middle cell replaces its 4 sides with 8 half-sides and adds 4 interior ones
+    TEST_EQUALITY(edgeCount, 2 * (12 - 4 + 8 + 4));
+  }
 } // namespace
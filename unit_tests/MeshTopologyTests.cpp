@@ -14,6 +14,18 @@
 #include "MeshFactory.h"
 
 namespace {
+  // a pruned topology's active cells should be exactly the stored cells that are active in the full topology
+  void testPrunedActiveCells(MeshTopologyPtr fullMeshTopo, MeshTopologyPtr prunedMeshTopo, Teuchos::FancyOStream &out, bool &success) {
+    const set<IndexType>* fullActiveCells = &fullMeshTopo->getActiveCellIndices();
+    set<IndexType> prunedActiveCells = prunedMeshTopo->getActiveCellIndices();
+    set<IndexType> expectedActiveCells;
+    for (set<IndexType>::const_iterator cellIt = fullActiveCells->begin(); cellIt != fullActiveCells->end(); cellIt++) {
+      if (prunedMeshTopo->cellIsStored(*cellIt)) expectedActiveCells.insert(*cellIt);
+    }
+    TEST_ASSERT(prunedActiveCells == expectedActiveCells);
+    TEST_EQUALITY(prunedMeshTopo->activeCellCount(), expectedActiveCells.size());
+  }
+
   TEUCHOS_UNIT_TEST( MeshTopology, InitialMeshEntitiesActiveCellCount)
   {
     // one easy way to create a quad mesh topology is to use MeshFactory
@@ -257,4 +269,321 @@ namespace {
       }
     }
   }
+  TEUCHOS_UNIT_TEST(MeshTopology, GhostAndRankLocalCells)
+  {
+    int spaceDim = 2;
+    bool conformingTraces = false;
+    PoissonFormulation formulation(spaceDim, conformingTraces);
+    BFPtr bf = formulation.bf();
+
+    int H1Order = 1, pToAddTest = 2;
+    double width = 1.0, height = 1.0;
+    int horizontalElements = 3, verticalElements = 3;
+    MeshPtr mesh = MeshFactory::quadMesh(bf, H1Order, pToAddTest, width, height, horizontalElements, verticalElements);
+    MeshTopologyPtr meshTopo = mesh->getTopology();
+
+    // on a 3x3 mesh, the center cell is the only one with no boundary sides
+    IndexType centerCellIndex = -1;
+    set<IndexType> activeCells = meshTopo->getActiveCellIndices();
+    for (set<IndexType>::iterator cellIt = activeCells.begin(); cellIt != activeCells.end(); cellIt++) {
+      CellPtr cell = meshTopo->getCell(*cellIt);
+      int interiorSideCount = 0;
+      for (int sideOrdinal=0; sideOrdinal<cell->getSideCount(); sideOrdinal++) {
+        if (cell->getNeighborInfo(sideOrdinal).first != -1) interiorSideCount++;
+      }
+      if (interiorSideCount == 4) {
+        centerCellIndex = *cellIt;
+      }
+    }
+    TEST_INEQUALITY(centerCellIndex, -1);
+
+    set<IndexType> ownedCells;
+    ownedCells.insert(centerCellIndex);
+    set<IndexType> ghostCells = meshTopo->getGhostCellIndices(ownedCells);
+    TEST_EQUALITY(ghostCells.size(), 8);
+    TEST_ASSERT(ghostCells.find(centerCellIndex) == ghostCells.end());
+
+    // refine the center cell; its children's ghosts are the 8 original neighbors
+    mesh->hRefine(ownedCells, RefinementPattern::regularRefinementPatternQuad());
+
+    vector<IndexType> childIndices = meshTopo->getCell(centerCellIndex)->getChildIndices();
+    set<IndexType> ownedChildren(childIndices.begin(), childIndices.end());
+    set<IndexType> ghostCellsAfterRefinement = meshTopo->getGhostCellIndices(ownedChildren);
+    TEST_EQUALITY(ghostCellsAfterRefinement.size(), 8);
+    for (set<IndexType>::iterator cellIt = ghostCells.begin(); cellIt != ghostCells.end(); cellIt++) {
+      TEST_ASSERT(ghostCellsAfterRefinement.find(*cellIt) != ghostCellsAfterRefinement.end());
+    }
+
+    // rank-local cells: owned children, 8 ghosts, and the (inactive) parent
+    set<IndexType> rankLocalCells = meshTopo->getRankLocalCellIndices(ownedChildren);
+    TEST_EQUALITY(rankLocalCells.size(), ownedChildren.size() + 8 + 1);
+    TEST_ASSERT(rankLocalCells.find(centerCellIndex) != rankLocalCells.end());
+
+    // owning a single cell adjacent to the refined one: its ghosts include the children of the center cell that touch it
+    IndexType cornerCellIndex = 0;
+    set<IndexType> ownedCorner;
+    ownedCorner.insert(cornerCellIndex);
+    set<IndexType> cornerGhosts = meshTopo->getGhostCellIndices(ownedCorner);
+    for (set<IndexType>::iterator cellIt = cornerGhosts.begin(); cellIt != cornerGhosts.end(); cellIt++) {
+      TEST_ASSERT(!meshTopo->getCell(*cellIt)->isParent());
+    }
+  }
+  TEUCHOS_UNIT_TEST(MeshTopology, PruneToRankLocalCells)
+  {
+    int spaceDim = 2;
+    bool conformingTraces = false;
+    PoissonFormulation formulation(spaceDim, conformingTraces);
+    BFPtr bf = formulation.bf();
+    
+    int H1Order = 1, pToAddTest = 2;
+    double width = 1.0, height = 1.0;
+    int horizontalElements = 4, verticalElements = 4;
+    MeshPtr mesh = MeshFactory::quadMesh(bf, H1Order, pToAddTest, width, height, horizontalElements, verticalElements);
+    
+    // refine one cell near the middle of the owned region, one in the ghost layer, and one outside the rank-local set
+    RefinementPatternPtr refPattern = RefinementPattern::regularRefinementPatternQuad();
+    FieldContainer<double> points(3,spaceDim);
+    points(0,0) = 0.4; points(0,1) = 0.4;
+    points(1,0) = 0.6; points(1,1) = 0.6;
+    points(2,0) = 0.9; points(2,1) = 0.1;
+    vector<IndexType> cellIDs = mesh->getTopology()->cellIDsForPoints(points);
+    set<GlobalIndexType> cellsToRefine(cellIDs.begin(), cellIDs.end());
+    mesh->hRefine(cellsToRefine, refPattern);
+    
+    MeshTopologyPtr fullMeshTopo = mesh->getTopology()->deepCopy();
+    MeshTopologyPtr prunedMeshTopo = mesh->getTopology()->deepCopy();
+    
+    // the ghost-layer cell that was just refined has children outside the ghost layer; refine one of these twice, so that it is
+    // stored (as a sibling of ghosts) but none of its descendants are
+    FieldContainer<double> siblingPoint(1,spaceDim);
+    siblingPoint(0,0) = 0.7; siblingPoint(0,1) = 0.7;
+    IndexType ghostSiblingIndex = fullMeshTopo->cellIDsForPoints(siblingPoint)[0];
+    for (int i=0; i<2; i++) {
+      set<IndexType> siblingDescendant;
+      siblingDescendant.insert(fullMeshTopo->cellIDsForPoints(siblingPoint)[0]);
+      fullMeshTopo->refineCells(siblingDescendant, refPattern);
+      prunedMeshTopo->refineCells(siblingDescendant, refPattern);
+    }
+    
+    // own the left half of the mesh
+    set<IndexType> ownedCells;
+    set<IndexType> activeCells = fullMeshTopo->getActiveCellIndices();
+    for (set<IndexType>::iterator cellIt = activeCells.begin(); cellIt != activeCells.end(); cellIt++) {
+      if (fullMeshTopo->getCellCentroid(*cellIt)[0] < 0.5) ownedCells.insert(*cellIt);
+    }
+    prunedMeshTopo->pruneToRankLocalCells(ownedCells);
+    TEST_ASSERT(prunedMeshTopo->isPruned());
+    TEST_EQUALITY(prunedMeshTopo->cellCount(), fullMeshTopo->cellCount());
+    TEST_COMPARE(prunedMeshTopo->approximateMemoryFootprint(), <, fullMeshTopo->approximateMemoryFootprint());
+    TEST_ASSERT(!prunedMeshTopo->cellIsStored(cellIDs[2]));
+    TEST_ASSERT(prunedMeshTopo->cellIsStored(ghostSiblingIndex));
+    TEST_ASSERT(!prunedMeshTopo->cellIsStored(fullMeshTopo->getCell(ghostSiblingIndex)->getChildIndices()[0]));
+    
+    for (int refinementNumber=0; refinementNumber<2; refinementNumber++) {
+      testPrunedActiveCells(fullMeshTopo, prunedMeshTopo, out, success);
+
+      // owned cells should look the same in the pruned topology as in the full one
+      for (set<IndexType>::iterator cellIt = ownedCells.begin(); cellIt != ownedCells.end(); cellIt++) {
+        TEST_ASSERT(prunedMeshTopo->cellIsStored(*cellIt));
+        CellPtr fullCell = fullMeshTopo->getCell(*cellIt);
+        CellPtr prunedCell = prunedMeshTopo->getCell(*cellIt);
+        for (int vertexOrdinal=0; vertexOrdinal<fullCell->vertices().size(); vertexOrdinal++) {
+          TEST_COMPARE_FLOATING_ARRAYS(prunedMeshTopo->getVertex(prunedCell->vertices()[vertexOrdinal]),
+                                       fullMeshTopo->getVertex(fullCell->vertices()[vertexOrdinal]), 1e-15);
+        }
+        for (int sideOrdinal=0; sideOrdinal<fullCell->getSideCount(); sideOrdinal++) {
+          TEST_EQUALITY(prunedCell->getNeighborInfo(sideOrdinal).first, fullCell->getNeighborInfo(sideOrdinal).first);
+          TEST_EQUALITY(prunedCell->getNeighborInfo(sideOrdinal).second, fullCell->getNeighborInfo(sideOrdinal).second);
+        }
+      }
+      set<IndexType> fullGhosts = fullMeshTopo->getGhostCellIndices(ownedCells);
+      set<IndexType> prunedGhosts = prunedMeshTopo->getGhostCellIndices(ownedCells);
+      TEST_ASSERT(fullGhosts == prunedGhosts);
+      
+      // refine an owned cell and a cell that the pruned topology does not store; cell indices should stay in sync
+      set<IndexType> refinedCells;
+      refinedCells.insert(*ownedCells.begin());
+      for (set<IndexType>::iterator cellIt = activeCells.begin(); cellIt != activeCells.end(); cellIt++) {
+        if (!prunedMeshTopo->cellIsStored(*cellIt)) {
+          refinedCells.insert(*cellIt);
+          break;
+        }
+      }
+      fullMeshTopo->refineCells(refinedCells, refPattern);
+      prunedMeshTopo->refineCells(refinedCells, refPattern);
+      TEST_EQUALITY(prunedMeshTopo->cellCount(), fullMeshTopo->cellCount());
+      
+      vector<IndexType> childIndices = fullMeshTopo->getCell(*ownedCells.begin())->getChildIndices();
+      ownedCells.erase(ownedCells.begin());
+      ownedCells.insert(childIndices.begin(), childIndices.end());
+      activeCells = fullMeshTopo->getActiveCellIndices();
+    }
+    
+    // pruning again to descendants of owned cells is allowed; pruning to cells that were not owned is not
+    prunedMeshTopo->pruneToRankLocalCells(ownedCells);
+    TEST_EQUALITY(prunedMeshTopo->cellCount(), fullMeshTopo->cellCount());
+    testPrunedActiveCells(fullMeshTopo, prunedMeshTopo, out, success);
+    set<IndexType> ghostCells = fullMeshTopo->getGhostCellIndices(ownedCells);
+    TEST_THROW(prunedMeshTopo->pruneToRankLocalCells(ghostCells), std::invalid_argument);
+  }
+  TEUCHOS_UNIT_TEST(MeshTopology, GhostCellsIncludeBrokenEdgeNeighbors)
+  {
+    // On a 2x2x1 hex mesh, refine the cell at the origin twice toward the vertical edge it shares with its diagonal neighbor.  The
+    // grandchild touching the middle of that edge shares no vertex and no side with the diagonal neighbor, only a broken edge.
+    vector<double> dimensions(3,1.0);
+    vector<int> elementCounts(3,2);
+    elementCounts[2] = 1;
+    MeshTopologyPtr meshTopo = MeshFactory::rectilinearMeshTopology(dimensions, elementCounts);
+    RefinementPatternPtr refPattern = RefinementPattern::regularRefinementPatternHexahedron();
+    
+    FieldContainer<double> points(2,3);
+    points(0,0) = 0.45; points(0,1) = 0.45; points(0,2) = 0.3; // ends up in the grandchild [0.375,0.5]^2 x [0.25,0.5]
+    points(1,0) = 0.75; points(1,1) = 0.75; points(1,2) = 0.5; // in the diagonal neighbor
+    IndexType diagonalCellIndex = meshTopo->cellIDsForPoints(points)[1];
+    for (int i=0; i<2; i++) {
+      set<IndexType> cellsToRefine;
+      cellsToRefine.insert(meshTopo->cellIDsForPoints(points)[0]);
+      meshTopo->refineCells(cellsToRefine, refPattern);
+    }
+    IndexType ownedCellIndex = meshTopo->cellIDsForPoints(points)[0];
+    
+    const vector<IndexType>* ownedVertices = &meshTopo->getCell(ownedCellIndex)->vertices();
+    const vector<IndexType>* diagonalVertices = &meshTopo->getCell(diagonalCellIndex)->vertices();
+    for (vector<IndexType>::const_iterator vertexIt = ownedVertices->begin(); vertexIt != ownedVertices->end(); vertexIt++) {
+      TEST_ASSERT(std::find(diagonalVertices->begin(), diagonalVertices->end(), *vertexIt) == diagonalVertices->end());
+    }
+    
+    set<IndexType> ownedCells;
+    ownedCells.insert(ownedCellIndex);
+    set<IndexType> ghostCells = meshTopo->getGhostCellIndices(ownedCells);
+    TEST_ASSERT(ghostCells.find(diagonalCellIndex) != ghostCells.end());
+  }
+  TEUCHOS_UNIT_TEST(MeshTopology, CellIDsForPoints)
+  {
+    int spaceDim = 2;
+    bool conformingTraces = false;
+    PoissonFormulation formulation(spaceDim, conformingTraces);
+    BFPtr bf = formulation.bf();
+    
+    int H1Order = 1, pToAddTest = 2;
+    double width = 2.0, height = 1.0;
+    int horizontalElements = 4, verticalElements = 3;
+    MeshPtr mesh = MeshFactory::quadMesh(bf, H1Order, pToAddTest, width, height, horizontalElements, verticalElements);
+    MeshTopologyPtr meshTopo = mesh->getTopology();
+    
+    for (int refinementNumber=0; refinementNumber<3; refinementNumber++) {
+      // each active cell's centroid should be located in that cell
+      set<IndexType> activeCells = meshTopo->getActiveCellIndices();
+      FieldContainer<double> points(activeCells.size() + 1, spaceDim);
+      int pointOrdinal = 0;
+      for (set<IndexType>::iterator cellIt = activeCells.begin(); cellIt != activeCells.end(); cellIt++, pointOrdinal++) {
+        vector<double> centroid = meshTopo->getCellCentroid(*cellIt);
+        for (int d=0; d<spaceDim; d++) {
+          points(pointOrdinal,d) = centroid[d];
+        }
+      }
+      // last point lies outside the mesh
+      points(pointOrdinal,0) = -1.0;
+      points(pointOrdinal,1) = 0.5;
+      
+      vector<IndexType> cellIDs = meshTopo->cellIDsForPoints(points);
+      pointOrdinal = 0;
+      for (set<IndexType>::iterator cellIt = activeCells.begin(); cellIt != activeCells.end(); cellIt++, pointOrdinal++) {
+        TEST_EQUALITY(cellIDs[pointOrdinal], *cellIt);
+      }
+      TEST_EQUALITY(cellIDs[pointOrdinal], -1);
+      
+      // refine the first active cell (after the first pass, the point index is built, and must be updated by refinement)
+      set<GlobalIndexType> cellsToRefine;
+      cellsToRefine.insert(*activeCells.begin());
+      mesh->hRefine(cellsToRefine, RefinementPattern::regularRefinementPatternQuad());
+    }
+  }
+  TEUCHOS_UNIT_TEST(MeshTopology, VertexIdentificationWithinTolerance)
+  {
+    int spaceDim = 2;
+    MeshTopology meshTopo(spaceDim);
+    
+    // vertices lying exactly on (and near) quantization bucket boundaries should still be identified within tolerance
+    double x0 = 1e-8, y0 = 0.0, h = 0.5;
+    vector< vector<double> > quadVertices(4, vector<double>(spaceDim));
+    quadVertices[0][0] = x0;     quadVertices[0][1] = y0;
+    quadVertices[1][0] = x0 + h; quadVertices[1][1] = y0;
+    quadVertices[2][0] = x0 + h; quadVertices[2][1] = y0 + h;
+    quadVertices[3][0] = x0;     quadVertices[3][1] = y0 + h;
+    
+    CellPtr cell = meshTopo.addCell(Camellia::CellTopology::quad(), quadVertices);
+    TEST_EQUALITY(meshTopo.getEntityCount(0), 4);
+    
+    double tol = 1e-12;
+    for (int vertexOrdinal=0; vertexOrdinal<quadVertices.size(); vertexOrdinal++) {
+      IndexType expectedVertexIndex = cell->vertices()[vertexOrdinal];
+      for (int perturbationSign=-1; perturbationSign<=1; perturbationSign++) {
+        vector<double> vertex = quadVertices[vertexOrdinal];
+        for (int d=0; d<spaceDim; d++) {
+          vertex[d] += perturbationSign * tol / 4;
+        }
+        IndexType vertexIndex;
+        TEST_ASSERT(meshTopo.getVertexIndex(vertex, vertexIndex, tol));
+        TEST_EQUALITY(vertexIndex, expectedVertexIndex);
+      }
+      TEST_COMPARE_FLOATING_ARRAYS(meshTopo.getVertex(expectedVertexIndex), quadVertices[vertexOrdinal], 1e-15);
+    }
+    
+    // a point farther than tol away should not match
+    vector<double> vertex = quadVertices[0];
+    vertex[0] += 2 * tol;
+    IndexType vertexIndex;
+    TEST_ASSERT(!meshTopo.getVertexIndex(vertex, vertexIndex, tol));
+  }
+  TEUCHOS_UNIT_TEST(MeshTopology, RefineCellsMatchesRefineCell)
+  {
+    int spaceDim = 2;
+    bool conformingTraces = false;
+    PoissonFormulation formulation(spaceDim, conformingTraces);
+    BFPtr bf = formulation.bf();
+    
+    int H1Order = 1, pToAddTest = 2;
+    double width = 1.0, height = 1.0;
+    int horizontalElements = 3, verticalElements = 2;
+    MeshPtr mesh = MeshFactory::quadMesh(bf, H1Order, pToAddTest, width, height, horizontalElements, verticalElements);
+    
+    MeshTopologyPtr bulkMeshTopo = mesh->getTopology()->deepCopy();
+    MeshTopologyPtr serialMeshTopo = mesh->getTopology()->deepCopy();
+    
+    RefinementPatternPtr refPattern = RefinementPattern::regularRefinementPatternQuad();
+    for (int refinementNumber=0; refinementNumber<2; refinementNumber++) {
+      // refine every other active cell, so that the refinement includes both neighboring and non-neighboring cells
+      set<IndexType> activeCells = bulkMeshTopo->getActiveCellIndices();
+      set<IndexType> cellsToRefine;
+      int cellOrdinal = 0;
+      for (set<IndexType>::iterator cellIt = activeCells.begin(); cellIt != activeCells.end(); cellIt++, cellOrdinal++) {
+        if ((cellOrdinal % 2 == 0) || (cellOrdinal == 1)) cellsToRefine.insert(*cellIt);
+      }
+      
+      bulkMeshTopo->refineCells(cellsToRefine, refPattern);
+      for (set<IndexType>::iterator cellIt = cellsToRefine.begin(); cellIt != cellsToRefine.end(); cellIt++) {
+        serialMeshTopo->refineCell(*cellIt, refPattern);
+      }
+    }
+    
+    TEST_EQUALITY(bulkMeshTopo->cellCount(), serialMeshTopo->cellCount());
+    for (int d=0; d<spaceDim; d++) {
+      TEST_EQUALITY(bulkMeshTopo->getEntityCount(d), serialMeshTopo->getEntityCount(d));
+    }
+    
+    for (IndexType cellIndex=0; cellIndex<bulkMeshTopo->cellCount(); cellIndex++) {
+      CellPtr bulkCell = bulkMeshTopo->getCell(cellIndex);
+      CellPtr serialCell = serialMeshTopo->getCell(cellIndex);
+      
+      vector<unsigned> bulkVertexIndices = bulkCell->vertices();
+      vector<unsigned> serialVertexIndices = serialCell->vertices();
+      TEST_COMPARE_ARRAYS(bulkVertexIndices, serialVertexIndices);
+      
+      for (int sideOrdinal=0; sideOrdinal<bulkCell->getSideCount(); sideOrdinal++) {
+        TEST_EQUALITY(bulkCell->getNeighborInfo(sideOrdinal).first, serialCell->getNeighborInfo(sideOrdinal).first);
+        TEST_EQUALITY(bulkCell->getNeighborInfo(sideOrdinal).second, serialCell->getNeighborInfo(sideOrdinal).second);
+      }
+    }
+  }
 } // namespace
\ No newline at end of file